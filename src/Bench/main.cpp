@@ -0,0 +1,603 @@
+#include "../Lib/CSGDataGPU.hpp"
+#include "../Lib/CSGExpressionCompiler.hpp"
+#include "../Lib/CSGIntervalEvaluator.hpp"
+#include "../Lib/CSGMassProperties.hpp"
+#include "../Lib/CSGTreeSerialization.hpp"
+#include "../Lib/JSONWriter.hpp"
+#include "../Lib/Log.hpp"
+#include "../Lib/ParallelFor.hpp"
+#include "../Lib/SceneGenerators.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+
+namespace SZV
+{
+
+namespace
+{
+
+using Clock= std::chrono::steady_clock;
+
+struct BenchSettings
+{
+	size_t runs= 10u;
+	float scale= 1.0f;
+	std::string output_file= "SazavaBench.json";
+	std::string scene_filter; // Run only scenes with name containing this string.
+	bool benchmark_compiler= false;
+	size_t compiler_points= 1u << 20u;
+	bool benchmark_mass_properties= false;
+	size_t classify_grid_size= 0u; // Zero means no box classification benchmark.
+	bool benchmark_parsing= false;
+};
+
+struct StageTimes
+{
+	std::vector<double> times_s;
+
+	void Add(const Clock::time_point start, const Clock::time_point end)
+	{
+		times_s.push_back(std::chrono::duration<double>(end - start).count());
+	}
+};
+
+struct StageStats
+{
+	double min_ms= 0.0;
+	double median_ms= 0.0;
+	double mean_ms= 0.0;
+};
+
+StageStats GetStageStats(StageTimes times)
+{
+	StageStats stats;
+	if(times.times_s.empty())
+		return stats;
+
+	std::sort(times.times_s.begin(), times.times_s.end());
+	stats.min_ms= times.times_s.front() * 1000.0;
+	stats.median_ms= times.times_s[times.times_s.size() / 2u] * 1000.0;
+
+	double sum= 0.0;
+	for(const double t : times.times_s)
+		sum+= t;
+	stats.mean_ms= sum / double(times.times_s.size()) * 1000.0;
+
+	return stats;
+}
+
+size_t CountCSGTreeNodes_r(const CSGTree::CSGTreeNode& node)
+{
+	return std::visit(
+		[](const auto& el) -> size_t
+		{
+			using T= std::decay_t<decltype(el)>;
+			if constexpr(
+				std::is_same_v<T, CSGTree::MulChain> ||
+				std::is_same_v<T, CSGTree::AddChain> ||
+				std::is_same_v<T, CSGTree::SubChain> ||
+				std::is_same_v<T, CSGTree::AddArray> ||
+				std::is_same_v<T, CSGTree::Instance>)
+			{
+				size_t result= 1u;
+				for(const CSGTree::CSGTreeNode& child : el.elements)
+					result+= CountCSGTreeNodes_r(child);
+				return result;
+			}
+			else
+				return 1u;
+		},
+		node);
+}
+
+void CountLowLevelTreeNodes_r(const TreeElementsLowLevel::TreeElement& node, size_t& out_nodes, size_t& out_leafs)
+{
+	++out_nodes;
+	std::visit(
+		[&](const auto& el)
+		{
+			using T= std::decay_t<decltype(el)>;
+			if constexpr(std::is_same_v<T, TreeElementsLowLevel::Leaf>)
+				++out_leafs;
+			else if constexpr(std::is_same_v<T, TreeElementsLowLevel::Grid>)
+			{
+				for(const TreeElementsLowLevel::TreeElement& element : el.elements)
+					CountLowLevelTreeNodes_r(element, out_nodes, out_leafs);
+			}
+			else if constexpr(!std::is_same_v<T, TreeElementsLowLevel::OneLeaf>)
+			{
+				CountLowLevelTreeNodes_r(*el.l, out_nodes, out_leafs);
+				CountLowLevelTreeNodes_r(*el.r, out_nodes, out_leafs);
+			}
+		},
+		node);
+}
+
+void WriteStageStats(JSONWriter& writer, const char* const key, const StageStats& stats, const size_t items)
+{
+	writer.BeginObject(key);
+	writer.Write("min_ms", stats.min_ms);
+	writer.Write("median_ms", stats.median_ms);
+	writer.Write("mean_ms", stats.mean_ms);
+	writer.Write("items_per_second", stats.median_ms > 0.0 ? double(items) / (stats.median_ms * 0.001) : 0.0);
+	writer.EndObject();
+}
+
+// Compare batch classification of boxes of a regular grid over scene bounding box against classification of each box separately.
+void BenchmarkBoxClassification(const BenchmarkScene& scene, const size_t grid_size, JSONWriter& writer)
+{
+	const CSGFlatTree tree= BuildFlatTree(scene.root);
+
+	BoxesSoA boxes;
+	const m_Vec3 bb_size= tree.bb.max - tree.bb.min;
+	const m_Vec3 cell_size= bb_size / float(grid_size);
+	for(size_t z= 0u; z < grid_size; ++z)
+	for(size_t y= 0u; y < grid_size; ++y)
+	for(size_t x= 0u; x < grid_size; ++x)
+	{
+		const m_Vec3 min= tree.bb.min + m_Vec3(cell_size.x * float(x), cell_size.y * float(y), cell_size.z * float(z));
+		boxes.push_back(BoundingBox{ min, min + cell_size });
+	}
+
+	std::vector<BoxClass> single_classes(boxes.size()), batch_classes(boxes.size());
+
+	const Clock::time_point single_start= Clock::now();
+	CSGFlatExpression pruned_expression;
+	std::vector<ClassifyStackElement> stack;
+	for(size_t i= 0u; i < boxes.size(); ++i)
+	{
+		const BoundingBox box
+		{
+			m_Vec3(boxes.min_x[i], boxes.min_y[i], boxes.min_z[i]),
+			m_Vec3(boxes.max_x[i], boxes.max_y[i], boxes.max_z[i]),
+		};
+		single_classes[i]= ClassifyBox(tree, tree.expression, box, pruned_expression, stack);
+	}
+	const Clock::time_point single_end= Clock::now();
+
+	BatchClassifyState state;
+	ClassifyBoxes(tree, tree.expression, boxes, batch_classes.data(), state);
+	const Clock::time_point batch_end= Clock::now();
+
+	size_t mismatches= 0u;
+	for(size_t i= 0u; i < boxes.size(); ++i)
+		mismatches+= single_classes[i] != batch_classes[i] ? 1u : 0u;
+	if(mismatches > 0u)
+		Log::Warning("Box classification mismatches for scene \"", scene.name, "\": ", mismatches);
+
+	const double single_time_s= std::chrono::duration<double>(single_end - single_start).count();
+	const double batch_time_s= std::chrono::duration<double>(batch_end - single_end).count();
+
+	writer.BeginObject("box_classification");
+	writer.Write("boxes", boxes.size());
+	writer.Write("single_time_s", single_time_s);
+	writer.Write("batch_time_s", batch_time_s);
+	writer.Write("single_boxes_per_second", single_time_s > 0.0 ? double(boxes.size()) / single_time_s : 0.0);
+	writer.Write("batch_boxes_per_second", batch_time_s > 0.0 ? double(boxes.size()) / batch_time_s : 0.0);
+	writer.Write("mismatches", mismatches);
+	writer.EndObject();
+}
+
+// Compare JSON scene parsing from stream, sequential parsing from memory and parallel parsing from memory.
+// Throughput is measured in bytes per second.
+void BenchmarkParsing(const BenchmarkScene& scene, const size_t runs, JSONWriter& writer)
+{
+	std::ostringstream stream;
+	SerializeCSGExpressionTree(scene.root, stream);
+	const std::string json= stream.str();
+
+	// Measure parallel parsing even on single-threaded machine, in order to see its overhead.
+	const size_t parallel_thread_count= std::max(size_t(2u), GetDefaultThreadCount());
+
+	StageTimes stream_times, sequential_times, parallel_times;
+	bool ok= true;
+	// First run is warm-up.
+	for(size_t run= 0u; run < runs + 1u; ++run)
+	{
+		const Clock::time_point stream_start= Clock::now();
+		std::istringstream input_stream(json);
+		ok&= DeserializeCSGExpressionTree(input_stream) != std::nullopt;
+		const Clock::time_point sequential_start= Clock::now();
+		ok&= DeserializeCSGExpressionTree(json.data(), json.size(), "", 1u) != std::nullopt;
+		const Clock::time_point parallel_start= Clock::now();
+		ok&= DeserializeCSGExpressionTree(json.data(), json.size(), "", parallel_thread_count) != std::nullopt;
+		const Clock::time_point parallel_end= Clock::now();
+
+		if(run == 0u)
+			continue;
+		stream_times.Add(stream_start, sequential_start);
+		sequential_times.Add(sequential_start, parallel_start);
+		parallel_times.Add(parallel_start, parallel_end);
+	}
+
+	if(!ok)
+		Log::Warning("Can not parse serialized scene \"", scene.name, "\"");
+
+	writer.BeginObject("json_parsing");
+	writer.Write("size_bytes", json.size());
+	writer.Write("hardware_threads", GetDefaultThreadCount());
+	writer.Write("parallel_threads", parallel_thread_count);
+	writer.Write("ok", ok);
+	WriteStageStats(writer, "stream", GetStageStats(stream_times), json.size());
+	WriteStageStats(writer, "memory_sequential", GetStageStats(sequential_times), json.size());
+	WriteStageStats(writer, "memory_parallel", GetStageStats(parallel_times), json.size());
+	writer.EndObject();
+}
+
+// Returns false if scene produces empty output - such scene measures nothing.
+bool RunSceneBenchmark(const BenchmarkScene& scene, const BenchSettings& settings, JSONWriter& writer)
+{
+	// Log writes into stdout too, do not mix it with results.
+	if(settings.output_file != "-")
+		Log::Info("Benchmarking scene \"", scene.name, "\" (", scene.parameters, ")");
+
+	StageTimes low_level_tree_times, low_level_tree_binary_times, scene_mesh_tree_times, flat_tree_times;
+
+	const std::vector<uint8_t> scene_binary= SerializeCSGTreeBinary(scene.root);
+	const CSGTreeBinaryView scene_binary_view(scene_binary.data(), scene_binary.size());
+
+	GPUSurfacesVector surfaces, binary_surfaces;
+	GPUTransformsVector transforms, binary_transforms;
+	VerticesVector vertices;
+	IndicesVector indices;
+	CSGExpressionGPUBuffer expressions;
+	size_t flat_tree_leafs= 0u, flat_tree_expression_size= 0u;
+	size_t low_level_nodes= 0u, low_level_leafs= 0u;
+
+	// First run is warm-up.
+	for(size_t run= 0u; run < settings.runs + 1u; ++run)
+	{
+		surfaces.clear();
+		transforms.clear();
+		vertices.clear();
+		indices.clear();
+		expressions.clear();
+
+		const Clock::time_point low_level_tree_start= Clock::now();
+		const TreeElementsLowLevel::TreeElement low_level_tree= BuildLowLevelTree(surfaces, transforms, scene.root);
+		const Clock::time_point low_level_tree_end= Clock::now();
+
+		BuildSceneMeshTree(vertices, indices, expressions, low_level_tree);
+		const Clock::time_point scene_mesh_tree_end= Clock::now();
+
+		const CSGFlatTree flat_tree= BuildFlatTree(low_level_tree, surfaces, transforms);
+		const Clock::time_point flat_tree_end= Clock::now();
+
+		binary_surfaces.clear();
+		binary_transforms.clear();
+		const Clock::time_point low_level_tree_binary_start= Clock::now();
+		const TreeElementsLowLevel::TreeElement low_level_tree_binary= BuildLowLevelTree(binary_surfaces, binary_transforms, scene_binary_view);
+		const Clock::time_point low_level_tree_binary_end= Clock::now();
+
+		if(run == 0u)
+		{
+			CountLowLevelTreeNodes_r(low_level_tree, low_level_nodes, low_level_leafs);
+			flat_tree_leafs= flat_tree.leafs.size();
+			flat_tree_expression_size= flat_tree.expression.size();
+			continue;
+		}
+
+		low_level_tree_times.Add(low_level_tree_start, low_level_tree_end);
+		low_level_tree_binary_times.Add(low_level_tree_binary_start, low_level_tree_binary_end);
+		scene_mesh_tree_times.Add(low_level_tree_end, scene_mesh_tree_end);
+		flat_tree_times.Add(scene_mesh_tree_end, flat_tree_end);
+	}
+
+	const size_t csg_nodes= CountCSGTreeNodes_r(scene.root);
+
+	writer.BeginObject();
+	writer.Write("name", scene.name);
+	writer.Write("parameters", scene.parameters);
+
+	writer.BeginObject("counts");
+	writer.Write("csg_tree_nodes", csg_nodes);
+	writer.Write("low_level_tree_nodes", low_level_nodes);
+	writer.Write("low_level_tree_leafs", low_level_leafs);
+	writer.Write("surfaces", surfaces.size());
+	writer.Write("transforms", transforms.size());
+	writer.Write("vertices", vertices.size());
+	writer.Write("indices", indices.size());
+	writer.Write("expressions_buffer_elements", expressions.size());
+	writer.Write("flat_tree_leafs", flat_tree_leafs);
+	writer.Write("flat_tree_expression_ops", flat_tree_expression_size);
+	// Index type is 16-bit, renderer can not draw such scene.
+	writer.Write("index_overflow", vertices.size() > size_t(std::numeric_limits<IndexType>::max()) + 1u);
+	writer.EndObject();
+
+	// Sizes are computed from element counts and element sizes, not measured allocations.
+	writer.BeginObject("computed_sizes_bytes");
+	writer.Write("low_level_tree", low_level_nodes * sizeof(TreeElementsLowLevel::TreeElement));
+	writer.Write("surfaces", surfaces.size() * sizeof(GPUSurface));
+	writer.Write("transforms", transforms.size() * sizeof(GPUTransform));
+	writer.Write("vertices", vertices.size() * sizeof(SurfaceVertex));
+	writer.Write("indices", indices.size() * sizeof(IndexType));
+	writer.Write("expressions_buffer", expressions.size() * sizeof(CSGExpressionGPUBufferType));
+	writer.Write("flat_tree", flat_tree_leafs * sizeof(CSGFlatLeaf) + flat_tree_expression_size * sizeof(CSGFlatExpressionOp));
+	writer.Write("binary_scene", scene_binary.size());
+	writer.EndObject();
+
+	// Throughput is measured in input items per second: CSG nodes for low-level tree build, low-level leafs for other stages.
+	writer.BeginObject("stages");
+	WriteStageStats(writer, "build_low_level_tree", GetStageStats(low_level_tree_times), csg_nodes);
+	WriteStageStats(writer, "build_low_level_tree_from_binary", GetStageStats(low_level_tree_binary_times), csg_nodes);
+	WriteStageStats(writer, "build_scene_mesh_tree", GetStageStats(scene_mesh_tree_times), low_level_leafs);
+	WriteStageStats(writer, "build_flat_tree", GetStageStats(flat_tree_times), low_level_leafs);
+	writer.EndObject();
+
+	if(settings.benchmark_compiler)
+	{
+		const CSGCompilerBenchmarkResult compiler_result=
+			BenchmarkCSGExpressionCompiler(BuildFlatTree(scene.root), settings.compiler_points);
+
+		writer.BeginObject("expression_compiler");
+		writer.Write("compiled", compiler_result.compiled);
+		writer.Write("too_large", compiler_result.too_large);
+		writer.Write("compilation_time_s", compiler_result.compilation_time_s);
+		writer.Write("interpreted_points_per_second", compiler_result.interpreted_points_per_second);
+		writer.Write("compiled_points_per_second", compiler_result.compiled_points_per_second);
+		writer.Write("compiled_single_points_per_second", compiler_result.compiled_single_points_per_second);
+		writer.Write("mismatches", compiler_result.mismatches);
+		writer.EndObject();
+	}
+
+	if(settings.classify_grid_size > 0u)
+		BenchmarkBoxClassification(scene, settings.classify_grid_size, writer);
+
+	if(settings.benchmark_parsing)
+		BenchmarkParsing(scene, settings.runs, writer);
+
+	if(settings.benchmark_mass_properties)
+	{
+		const Clock::time_point start= Clock::now();
+		const MassProperties mass_properties= CalculateMassProperties(scene.root);
+		const double wall_time_s= std::chrono::duration<double>(Clock::now() - start).count();
+
+		writer.BeginObject("mass_properties");
+		writer.Write("wall_time_s", wall_time_s);
+		writer.Write("classification_time_s", mass_properties.classification_time_s);
+		writer.Write("sampling_time_s", mass_properties.sampling_time_s);
+		writer.Write("samples", size_t(mass_properties.samples));
+		writer.Write("samples_per_second", mass_properties.sampling_time_s > 0.0 ? double(mass_properties.samples) / mass_properties.sampling_time_s : 0.0);
+		writer.Write("point_evaluations", size_t(mass_properties.point_evaluations));
+		writer.Write("cells_inside", mass_properties.cells_inside);
+		writer.Write("cells_outside", mass_properties.cells_outside);
+		writer.Write("cells_boundary", mass_properties.cells_boundary);
+		writer.Write("rounds", size_t(mass_properties.rounds));
+		writer.Write("converged", mass_properties.converged);
+		writer.Write("volume", mass_properties.volume);
+		writer.Write("volume_error", mass_properties.volume_error);
+		writer.Write("surface_area", mass_properties.surface_area);
+		writer.EndObject();
+	}
+
+	const bool empty_output= vertices.empty() || indices.empty() || expressions.empty();
+	writer.Write("empty_output", empty_output);
+
+	writer.EndObject();
+
+	if(empty_output)
+		Log::Warning("Scene \"", scene.name, "\" produces empty output");
+	return !empty_output;
+}
+
+// Compare mass properties of simple shapes against analytic values. Returns false if any of them does not match.
+bool RunMassPropertiesCheck(JSONWriter& writer)
+{
+	constexpr double pi= 3.14159265358979323846;
+
+	struct CheckShape
+	{
+		const char* name;
+		CSGTree::CSGTreeNode root;
+		double expected_volume;
+		double expected_center_of_mass[3];
+	};
+
+	// Sphere is shifted from box center, so that center of mass is not trivial.
+	const double box_volume= 4.0 * 4.0 * 4.0;
+	const double sphere_volume= 4.0 / 3.0 * pi;
+	const double sphere_center[3]{ 0.75, -0.5, 0.25 };
+	CSGTree::SubChain box_minus_sphere;
+	box_minus_sphere.elements.push_back(CSGTree::Box{ m_Vec3(0.0f, 0.0f, 0.0f), m_Vec3(4.0f, 4.0f, 4.0f), m_Vec3(0.0f, 0.0f, 0.0f) });
+	box_minus_sphere.elements.push_back(
+		CSGTree::Ellipsoid{ m_Vec3(float(sphere_center[0]), float(sphere_center[1]), float(sphere_center[2])), m_Vec3(2.0f, 2.0f, 2.0f), m_Vec3(0.0f, 0.0f, 0.0f) });
+
+	const double box_minus_sphere_volume= box_volume - sphere_volume;
+	const double box_minus_sphere_center_scale= -sphere_volume / box_minus_sphere_volume;
+
+	const CheckShape shapes[]
+	{
+		// Rotated shapes, so that their faces are not aligned with octree cells. Shapes are centered away from origin.
+		{
+			"box",
+			CSGTree::Box{ m_Vec3(0.5f, -1.0f, 2.0f), m_Vec3(2.0f, 3.0f, 4.0f), m_Vec3(30.0f, 20.0f, 10.0f) },
+			2.0 * 3.0 * 4.0,
+			{ 0.5, -1.0, 2.0 },
+		},
+		{
+			"ellipsoid",
+			CSGTree::Ellipsoid{ m_Vec3(-1.0f, 0.5f, 0.0f), m_Vec3(2.0f, 3.0f, 4.0f), m_Vec3(15.0f, 40.0f, 5.0f) },
+			4.0 / 3.0 * pi * 1.0 * 1.5 * 2.0,
+			{ -1.0, 0.5, 0.0 },
+		},
+		{
+			"box_minus_sphere",
+			box_minus_sphere,
+			box_minus_sphere_volume,
+			{
+				box_minus_sphere_center_scale * sphere_center[0],
+				box_minus_sphere_center_scale * sphere_center[1],
+				box_minus_sphere_center_scale * sphere_center[2],
+			},
+		},
+	};
+
+	bool all_passed= true;
+	writer.BeginArray("mass_properties_check");
+	for(const CheckShape& shape : shapes)
+	{
+		const MassProperties mass_properties= CalculateMassProperties(shape.root);
+		const double error= std::abs(mass_properties.volume - shape.expected_volume);
+		// Sampling is stochastic, allow deviation within 5 standard errors plus small relative tolerance for floating point errors.
+		const bool volume_passed= error <= 5.0 * mass_properties.volume_error + shape.expected_volume * 1.0e-4;
+
+		double center_of_mass_square_error= 0.0;
+		for(size_t j= 0u; j < 3u; ++j)
+		{
+			const double d= mass_properties.center_of_mass[j] - shape.expected_center_of_mass[j];
+			center_of_mass_square_error+= d * d;
+		}
+		const double center_of_mass_error= std::sqrt(center_of_mass_square_error);
+		// Same tolerance for center of mass, with relative part taken from characteristic shape size.
+		const bool center_of_mass_passed=
+			center_of_mass_error <= 5.0 * mass_properties.center_of_mass_error + std::cbrt(shape.expected_volume) * 1.0e-4;
+
+		const bool passed= volume_passed && center_of_mass_passed;
+		all_passed&= passed;
+
+		if(!volume_passed)
+			Log::Warning(
+				"Mass properties check failed for \"", shape.name, "\": volume ", mass_properties.volume,
+				", expected ", shape.expected_volume, ", standard error ", mass_properties.volume_error);
+		if(!center_of_mass_passed)
+			Log::Warning(
+				"Mass properties check failed for \"", shape.name, "\": center of mass (",
+				mass_properties.center_of_mass[0], ", ", mass_properties.center_of_mass[1], ", ", mass_properties.center_of_mass[2],
+				"), expected (",
+				shape.expected_center_of_mass[0], ", ", shape.expected_center_of_mass[1], ", ", shape.expected_center_of_mass[2],
+				"), distance ", center_of_mass_error, ", standard error ", mass_properties.center_of_mass_error);
+
+		writer.BeginObject();
+		writer.Write("name", shape.name);
+		writer.Write("volume", mass_properties.volume);
+		writer.Write("expected_volume", shape.expected_volume);
+		writer.Write("volume_error", mass_properties.volume_error);
+		writer.BeginArray("center_of_mass");
+		for(size_t j= 0u; j < 3u; ++j)
+			writer.Write(nullptr, mass_properties.center_of_mass[j]);
+		writer.EndArray();
+		writer.BeginArray("expected_center_of_mass");
+		for(size_t j= 0u; j < 3u; ++j)
+			writer.Write(nullptr, shape.expected_center_of_mass[j]);
+		writer.EndArray();
+		writer.Write("center_of_mass_distance", center_of_mass_error);
+		writer.Write("center_of_mass_error", mass_properties.center_of_mass_error);
+		writer.Write("passed", passed);
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	return all_passed;
+}
+
+void PrintUsage()
+{
+	std::cout <<
+		"Usage: SazavaBench [options]\n"
+		"Options:\n"
+		"  --runs N          number of measured runs for each scene (default 10)\n"
+		"  --scale S         scenes size multiplier (default 1)\n"
+		"  --scene NAME      run only scenes with name containing NAME\n"
+		"  --output FILE     output JSON file (default SazavaBench.json), \"-\" for stdout\n"
+		"  --compiler        also benchmark native expression compiler\n"
+		"  --compiler-points N  number of points for expression compiler benchmark\n"
+		"  --classify N      also benchmark batch classification of N^3 boxes against per-box classification\n"
+		"  --mass-properties also benchmark mass properties calculation and check it against analytic values\n"
+		"  --parsing         also benchmark JSON scene parsing: from stream, sequential and parallel from memory\n";
+}
+
+bool ParseArgs(const int argc, const char* const argv[], BenchSettings& settings)
+{
+	for(int i= 1; i < argc; ++i)
+	{
+		const char* const arg= argv[i];
+		const bool has_value= i + 1 < argc;
+		if(std::strcmp(arg, "--runs") == 0 && has_value)
+			settings.runs= size_t(std::max(1l, std::strtol(argv[++i], nullptr, 10)));
+		else if(std::strcmp(arg, "--scale") == 0 && has_value)
+			settings.scale= std::max(1.0e-3f, std::strtof(argv[++i], nullptr));
+		else if(std::strcmp(arg, "--scene") == 0 && has_value)
+			settings.scene_filter= argv[++i];
+		else if(std::strcmp(arg, "--output") == 0 && has_value)
+			settings.output_file= argv[++i];
+		else if(std::strcmp(arg, "--compiler") == 0)
+			settings.benchmark_compiler= true;
+		else if(std::strcmp(arg, "--parsing") == 0)
+			settings.benchmark_parsing= true;
+		else if(std::strcmp(arg, "--compiler-points") == 0 && has_value)
+			settings.compiler_points= size_t(std::max(1l, std::strtol(argv[++i], nullptr, 10)));
+		else if(std::strcmp(arg, "--classify") == 0 && has_value)
+			settings.classify_grid_size= size_t(std::max(1l, std::strtol(argv[++i], nullptr, 10)));
+		else if(std::strcmp(arg, "--mass-properties") == 0)
+			settings.benchmark_mass_properties= true;
+		else
+			return false;
+	}
+
+	return true;
+}
+
+int Main(const int argc, const char* const argv[])
+{
+	BenchSettings settings;
+	if(!ParseArgs(argc, argv, settings))
+	{
+		PrintUsage();
+		return -1;
+	}
+
+	std::ofstream output_file;
+	if(settings.output_file != "-")
+	{
+		output_file.open(settings.output_file, std::ios::out | std::ios::trunc);
+		if(!output_file.is_open())
+		{
+			Log::Warning("Can not open output file \"", settings.output_file, "\"");
+			return -1;
+		}
+	}
+	std::ostream& output= settings.output_file == "-" ? std::cout : output_file;
+
+	JSONWriter writer(output);
+	writer.BeginObject();
+	writer.Write("runs", settings.runs);
+	writer.Write("scale", double(settings.scale));
+	writer.BeginArray("scenes");
+
+	bool failed= false;
+	for(const BenchmarkScene& scene : GenerateBenchmarkScenes(settings.scale))
+	{
+		if(!settings.scene_filter.empty() && scene.name.find(settings.scene_filter) == std::string::npos)
+			continue;
+		if(!RunSceneBenchmark(scene, settings, writer))
+			failed= true;
+	}
+
+	writer.EndArray();
+
+	if(settings.benchmark_mass_properties && !RunMassPropertiesCheck(writer))
+		failed= true;
+
+	writer.EndObject();
+	output << std::endl;
+
+	if(settings.output_file != "-")
+		Log::Info("Benchmark results written into \"", settings.output_file, "\"");
+	return failed ? 1 : 0;
+}
+
+} // namespace
+
+} // namespace SZV
+
+int main(const int argc, const char* argv[])
+{
+	return SZV::Main(argc, argv);
+}
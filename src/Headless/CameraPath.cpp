@@ -0,0 +1,96 @@
+#include "CameraPath.hpp"
+#include "../Lib/Log.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace SZV
+{
+
+namespace
+{
+
+const float g_pi= 3.1415926535f;
+
+} // namespace
+
+CameraPath CameraPath::MakeOrbit(const float radius, const float height)
+{
+	CameraPath path;
+
+	// Camera looks along (-sin(azimuth), cos(azimuth)), so for position (sin(a), -cos(a)) * radius azimuth is "a".
+	const size_t key_frame_count= 64u;
+	const float elevation= -std::atan2(height, radius);
+	for(size_t i= 0u; i <= key_frame_count; ++i)
+	{
+		const float azimuth= float(i) / float(key_frame_count) * 2.0f * g_pi;
+
+		CameraKeyFrame key_frame;
+		key_frame.pos= m_Vec3(std::sin(azimuth) * radius, -std::cos(azimuth) * radius, height);
+		key_frame.azimuth= azimuth;
+		key_frame.elevation= elevation;
+		path.key_frames_.push_back(key_frame);
+	}
+
+	return path;
+}
+
+CameraPath CameraPath::LoadFromFile(const std::string& file_name)
+{
+	CameraPath path;
+
+	std::ifstream file(file_name);
+	if(!file.is_open())
+	{
+		Log::Warning("Can not open camera path file \"", file_name, "\"");
+		return path;
+	}
+
+	std::string line;
+	size_t line_number= 0u;
+	while(std::getline(file, line))
+	{
+		++line_number;
+		if(line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream stream(line);
+		CameraKeyFrame key_frame;
+		if(!(stream >> key_frame.pos.x >> key_frame.pos.y >> key_frame.pos.z >> key_frame.azimuth >> key_frame.elevation))
+		{
+			Log::Warning("Invalid camera key frame at line ", line_number, " of \"", file_name, "\"");
+			return CameraPath();
+		}
+		path.key_frames_.push_back(key_frame);
+	}
+
+	return path;
+}
+
+bool CameraPath::IsEmpty() const
+{
+	return key_frames_.empty();
+}
+
+CameraKeyFrame CameraPath::Evaluate(const float t) const
+{
+	if(key_frames_.empty())
+		return CameraKeyFrame{ m_Vec3(0.0f, 0.0f, 0.0f), 0.0f, 0.0f };
+	if(key_frames_.size() == 1u)
+		return key_frames_.front();
+
+	const float pos= std::max(0.0f, std::min(t, 1.0f)) * float(key_frames_.size() - 1u);
+	const size_t index= std::min(size_t(pos), key_frames_.size() - 2u);
+	const float k= pos - float(index);
+
+	const CameraKeyFrame& a= key_frames_[index];
+	const CameraKeyFrame& b= key_frames_[index + 1u];
+
+	CameraKeyFrame result;
+	result.pos= a.pos * (1.0f - k) + b.pos * k;
+	result.azimuth= a.azimuth * (1.0f - k) + b.azimuth * k;
+	result.elevation= a.elevation * (1.0f - k) + b.elevation * k;
+	return result;
+}
+
+} // namespace SZV
@@ -0,0 +1,36 @@
+#pragma once
+#include "../Lib/Vec.hpp"
+#include <string>
+#include <vector>
+
+namespace SZV
+{
+
+struct CameraKeyFrame
+{
+	m_Vec3 pos;
+	float azimuth= 0.0f;
+	float elevation= 0.0f;
+};
+
+// Camera position for scripted rendering. Position is linearly interpolated between key frames.
+class CameraPath
+{
+public:
+	// Circle around origin with given radius and height, camera looks at origin.
+	static CameraPath MakeOrbit(float radius, float height);
+
+	// Load key frames from text file. Each line contains "x y z azimuth elevation", angles are in radians.
+	// Empty lines and lines, started with '#', are ignored. Returns empty path on failure.
+	static CameraPath LoadFromFile(const std::string& file_name);
+
+	bool IsEmpty() const;
+
+	// Parameter is in range [0; 1] - from first to last key frame.
+	CameraKeyFrame Evaluate(float t) const;
+
+private:
+	std::vector<CameraKeyFrame> key_frames_;
+};
+
+} // namespace SZV
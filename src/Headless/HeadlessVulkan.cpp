@@ -0,0 +1,522 @@
+#include "HeadlessVulkan.hpp"
+#include "../Lib/Assert.hpp"
+#include "../Lib/Log.hpp"
+#include "../Lib/Profiler.hpp"
+#include <cstring>
+#include <limits>
+
+namespace SZV
+{
+
+namespace
+{
+
+vk::PhysicalDeviceFeatures GetRequiredDeviceFeatures(const vk::PhysicalDevice physical_device)
+{
+	const vk::PhysicalDeviceFeatures supported_features= physical_device.getFeatures();
+
+	vk::PhysicalDeviceFeatures features;
+	features.setPipelineStatisticsQuery(supported_features.pipelineStatisticsQuery); // Optional, for GPU profiling.
+	return features;
+}
+
+std::string VulkanVersionToString(const uint32_t version)
+{
+	return
+		std::to_string(version >> 22u) + "." +
+		std::to_string((version >> 12u) & ((1u << 10u) - 1u)) + "." +
+		std::to_string(version & ((1u << 12u) - 1u));
+}
+
+VkBool32 VulkanDebugReportCallback(
+	VkDebugReportFlagsEXT flags,
+	VkDebugReportObjectTypeEXT object_type,
+	uint64_t  object,
+	size_t location,
+	int32_t message_code,
+	const char* const layer_prefix,
+	const char* const message,
+	void* user_data)
+{
+	(void)flags;
+	(void)location;
+	(void)message_code;
+	(void)layer_prefix;
+	(void)user_data;
+
+	Log::Warning(
+		message, "\n",
+		" object= ", object,
+		" type= ", vk::to_string(vk::DebugReportObjectTypeEXT(object_type)));
+
+	return VK_FALSE;
+}
+
+} // namespace
+
+HeadlessVulkan::HeadlessVulkan(const vk::Extent2D viewport_size, const std::string& device_name)
+	: viewport_size_(viewport_size)
+{
+	#ifdef DEBUG
+	const bool use_debug_extensions_and_layers= true;
+	#else
+	const bool use_debug_extensions_and_layers= false;
+	#endif
+
+	// No surface extensions are needed.
+	std::vector<const char*> extensions_list;
+	if(use_debug_extensions_and_layers)
+		extensions_list.push_back("VK_EXT_debug_report");
+
+	// Create Vulkan instance.
+	const vk::ApplicationInfo vk_app_info(
+		"SazavaHeadless",
+		VK_MAKE_VERSION(0, 0, 1),
+		"Sazava",
+		VK_MAKE_VERSION(0, 0, 1),
+		VK_MAKE_VERSION(1, 0, 0));
+
+	vk::InstanceCreateInfo vk_instance_create_info(
+		vk::InstanceCreateFlags(),
+		&vk_app_info,
+		0u, nullptr,
+		uint32_t(extensions_list.size()), extensions_list.data());
+
+	if(use_debug_extensions_and_layers)
+	{
+		const std::vector<vk::LayerProperties> vk_layer_properties= vk::enumerateInstanceLayerProperties();
+		static const char* const possible_validation_layers[]
+		{
+			"VK_LAYER_LUNARG_core_validation",
+			"VK_LAYER_KHRONOS_validation",
+		};
+
+		for(const char* const& layer_name : possible_validation_layers)
+			for(const vk::LayerProperties& property : vk_layer_properties)
+				if(std::strcmp(property.layerName, layer_name) == 0)
+				{
+					vk_instance_create_info.enabledLayerCount= 1u;
+					vk_instance_create_info.ppEnabledLayerNames= &layer_name;
+					break;
+				}
+	}
+
+	vk_instance_= vk::createInstanceUnique(vk_instance_create_info);
+	Log::Info("Vulkan instance created");
+
+	if(use_debug_extensions_and_layers)
+	{
+		if(const auto vkCreateDebugReportCallbackEXT=
+			PFN_vkCreateDebugReportCallbackEXT(vk_instance_->getProcAddr("vkCreateDebugReportCallbackEXT")))
+		{
+			const vk::DebugReportCallbackCreateInfoEXT debug_report_callback_create_info(
+				vk::DebugReportFlagBitsEXT::eWarning | vk::DebugReportFlagBitsEXT::eError,
+				VulkanDebugReportCallback);
+
+			vkCreateDebugReportCallbackEXT(
+				*vk_instance_,
+				&static_cast<const VkDebugReportCallbackCreateInfoEXT&>(debug_report_callback_create_info),
+				nullptr,
+				&vk_debug_report_callback_);
+			if(vk_debug_report_callback_ != VK_NULL_HANDLE)
+				Log::Info("Vulkan debug callback installed");
+		}
+	}
+
+	// Select physical device. Use device with given name if it is specified, else prefer discrete GPU.
+	const std::vector<vk::PhysicalDevice> physical_devices= vk_instance_->enumeratePhysicalDevices();
+	if(physical_devices.empty())
+		Log::FatalError("No Vulkan devices found");
+
+	vk::PhysicalDevice physical_device= physical_devices.front();
+	if(!device_name.empty())
+	{
+		bool found= false;
+		for(const vk::PhysicalDevice& physical_device_candidate : physical_devices)
+		{
+			const vk::PhysicalDeviceProperties properties= physical_device_candidate.getProperties();
+			if(std::strstr(properties.deviceName, device_name.c_str()) != nullptr)
+			{
+				physical_device= physical_device_candidate;
+				found= true;
+				break;
+			}
+		}
+		if(!found)
+			Log::FatalError("Could not find Vulkan device \"", device_name, "\"");
+	}
+	else if(physical_devices.size() > 1u)
+	{
+		for(const vk::PhysicalDevice& physical_device_candidate : physical_devices)
+		{
+			const vk::PhysicalDeviceProperties properties= physical_device_candidate.getProperties();
+			if(properties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu)
+			{
+				physical_device= physical_device_candidate;
+				break;
+			}
+		}
+	}
+
+	{
+		const vk::PhysicalDeviceProperties properties= physical_device.getProperties();
+		Log::Info("");
+		Log::Info("Vulkan physical device selected");
+		Log::Info("API version: ", VulkanVersionToString(properties.apiVersion));
+		Log::Info("Driver version: ", VulkanVersionToString(properties.driverVersion));
+		Log::Info("Vendor ID: ", properties.vendorID);
+		Log::Info("Device ID: ", properties.deviceID);
+		Log::Info("Device type: ", vk::to_string(properties.deviceType));
+		Log::Info("Device name: ", properties.deviceName);
+		Log::Info("");
+	}
+
+	// Select queue family. Graphics queue supports also compute and transfer.
+	const std::vector<vk::QueueFamilyProperties> queue_family_properties= physical_device.getQueueFamilyProperties();
+	uint32_t queue_family_index= ~0u;
+	for(uint32_t i= 0u; i < queue_family_properties.size(); ++i)
+	{
+		if(queue_family_properties[i].queueCount > 0 &&
+			(queue_family_properties[i].queueFlags & vk::QueueFlagBits::eGraphics) != vk::QueueFlagBits(0))
+		{
+			queue_family_index= i;
+			break;
+		}
+	}
+
+	if(queue_family_index == ~0u)
+		Log::FatalError("Could not select queue family index");
+
+	vk_queue_family_index_= queue_family_index;
+
+	const float queue_priority= 1.0f;
+	const vk::DeviceQueueCreateInfo vk_device_queue_create_info(
+		vk::DeviceQueueCreateFlags(),
+		queue_family_index,
+		1u, &queue_priority);
+
+	const vk::PhysicalDeviceFeatures physical_device_features= GetRequiredDeviceFeatures(physical_device);
+	enabled_features_= physical_device_features;
+
+	const vk::DeviceCreateInfo vk_device_create_info(
+		vk::DeviceCreateFlags(),
+		1u, &vk_device_queue_create_info,
+		0u, nullptr,
+		0u, nullptr,
+		&physical_device_features);
+
+	vk::Device vk_device_tmp;
+	if((physical_device.createDevice(&vk_device_create_info, nullptr, &vk_device_tmp)) != vk::Result::eSuccess)
+		Log::FatalError("Could not create Vulkan device");
+	vk_device_.reset(vk_device_tmp);
+	Log::Info("Vulkan logical device created");
+
+	pipeline_cache_= std::make_unique<PipelineCache>(*vk_device_, physical_device, "SazavaHeadless_pipeline_cache.bin");
+
+	vk_queue_= vk_device_->getQueue(queue_family_index, 0u);
+
+	memory_properties_= physical_device.getMemoryProperties();
+	physical_device_= physical_device;
+
+	// Create render pass for drawing into offscreen image. Result is copied into buffer for reading.
+
+	const vk::AttachmentDescription vk_attachment_description(
+		vk::AttachmentDescriptionFlags(),
+		c_image_format,
+		vk::SampleCountFlagBits::e1,
+		vk::AttachmentLoadOp::eDontCare,
+		vk::AttachmentStoreOp::eStore,
+		vk::AttachmentLoadOp::eDontCare,
+		vk::AttachmentStoreOp::eDontCare,
+		vk::ImageLayout::eUndefined,
+		vk::ImageLayout::eTransferSrcOptimal);
+
+	const vk::AttachmentReference vk_attachment_reference(
+		0u,
+		vk::ImageLayout::eColorAttachmentOptimal);
+
+	const vk::SubpassDescription vk_subpass_description(
+		vk::SubpassDescriptionFlags(),
+		vk::PipelineBindPoint::eGraphics,
+		0u, nullptr,
+		1u, &vk_attachment_reference);
+
+	// Make color writes visible for following copy.
+	const vk::SubpassDependency vk_subpass_dependency(
+		0u,
+		VK_SUBPASS_EXTERNAL,
+		vk::PipelineStageFlagBits::eColorAttachmentOutput,
+		vk::PipelineStageFlagBits::eTransfer,
+		vk::AccessFlagBits::eColorAttachmentWrite,
+		vk::AccessFlagBits::eTransferRead);
+
+	vk_render_pass_=
+		vk_device_->createRenderPassUnique(
+			vk::RenderPassCreateInfo(
+				vk::RenderPassCreateFlags(),
+				1u, &vk_attachment_description,
+				1u, &vk_subpass_description,
+				1u, &vk_subpass_dependency));
+
+	// Create offscreen image.
+	{
+		image_=
+			vk_device_->createImageUnique(
+				vk::ImageCreateInfo(
+					vk::ImageCreateFlags(),
+					vk::ImageType::e2D,
+					c_image_format,
+					vk::Extent3D(viewport_size_.width, viewport_size_.height, 1u),
+					1u,
+					1u,
+					vk::SampleCountFlagBits::e1,
+					vk::ImageTiling::eOptimal,
+					vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+					vk::SharingMode::eExclusive,
+					0u, nullptr,
+					vk::ImageLayout::eUndefined));
+
+		const vk::MemoryRequirements image_memory_requirements= vk_device_->getImageMemoryRequirements(*image_);
+
+		vk::MemoryAllocateInfo vk_memory_allocate_info(image_memory_requirements.size);
+		for(uint32_t i= 0u; i < memory_properties_.memoryTypeCount; ++i)
+		{
+			if((image_memory_requirements.memoryTypeBits & (1u << i)) != 0 &&
+				(memory_properties_.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) != vk::MemoryPropertyFlags())
+				vk_memory_allocate_info.memoryTypeIndex= i;
+		}
+
+		image_memory_= vk_device_->allocateMemoryUnique(vk_memory_allocate_info);
+		vk_device_->bindImageMemory(*image_, *image_memory_, 0u);
+
+		image_view_=
+			vk_device_->createImageViewUnique(
+				vk::ImageViewCreateInfo(
+					vk::ImageViewCreateFlags(),
+					*image_,
+					vk::ImageViewType::e2D,
+					c_image_format,
+					vk::ComponentMapping(),
+					vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0u, 1u, 0u, 1u)));
+
+		framebuffer_=
+			vk_device_->createFramebufferUnique(
+				vk::FramebufferCreateInfo(
+					vk::FramebufferCreateFlags(),
+					*vk_render_pass_,
+					1u, &*image_view_,
+					viewport_size_.width, viewport_size_.height, 1u));
+	}
+
+	// Create buffer for reading of image. It must be host-visible.
+	{
+		const vk::DeviceSize buffer_size= vk::DeviceSize(viewport_size_.width) * vk::DeviceSize(viewport_size_.height) * 4u;
+
+		readback_buffer_=
+			vk_device_->createBufferUnique(
+				vk::BufferCreateInfo(
+					vk::BufferCreateFlags(),
+					buffer_size,
+					vk::BufferUsageFlagBits::eTransferDst));
+
+		const vk::MemoryRequirements buffer_memory_requirements= vk_device_->getBufferMemoryRequirements(*readback_buffer_);
+
+		const vk::MemoryPropertyFlags required_flags= vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+		vk::MemoryAllocateInfo memory_allocate_info(buffer_memory_requirements.size, ~0u);
+		for(uint32_t i= 0u; i < memory_properties_.memoryTypeCount; ++i)
+		{
+			if((buffer_memory_requirements.memoryTypeBits & (1u << i)) != 0 &&
+				(memory_properties_.memoryTypes[i].propertyFlags & required_flags) == required_flags)
+			{
+				memory_allocate_info.memoryTypeIndex= i;
+				break;
+			}
+		}
+		if(memory_allocate_info.memoryTypeIndex == ~0u)
+			Log::FatalError("Could not find host-visible memory for image reading");
+
+		readback_buffer_memory_= vk_device_->allocateMemoryUnique(memory_allocate_info);
+		vk_device_->bindBufferMemory(*readback_buffer_, *readback_buffer_memory_, 0u);
+	}
+
+	// Create command pull.
+	vk_command_pool_= vk_device_->createCommandPoolUnique(
+		vk::CommandPoolCreateInfo(
+			vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+			queue_family_index));
+
+	// Frames are rendered synchronously, so single command buffer is enough.
+	command_buffer_=
+		std::move(
+		vk_device_->allocateCommandBuffersUnique(
+			vk::CommandBufferAllocateInfo(
+				*vk_command_pool_,
+				vk::CommandBufferLevel::ePrimary,
+				1u)).front());
+
+	submit_fence_= vk_device_->createFenceUnique(vk::FenceCreateInfo());
+}
+
+HeadlessVulkan::~HeadlessVulkan()
+{
+	Log::Info("Vulkan deinitialization");
+
+	// Sync before destruction.
+	vk_device_->waitIdle();
+
+	if(vk_debug_report_callback_ != VK_NULL_HANDLE)
+	{
+		if(const auto vkDestroyDebugReportCallbackEXT=
+			PFN_vkDestroyDebugReportCallbackEXT(vk_instance_->getProcAddr("vkDestroyDebugReportCallbackEXT")))
+			vkDestroyDebugReportCallbackEXT(*vk_instance_, vk_debug_report_callback_, nullptr);
+	}
+}
+
+vk::CommandBuffer HeadlessVulkan::BeginFrame()
+{
+	const vk::CommandBuffer command_buffer= *command_buffer_;
+	command_buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	return command_buffer;
+}
+
+void HeadlessVulkan::EndFrame(const DrawFunctions& draw_functions, const bool read_back)
+{
+	const vk::CommandBuffer command_buffer= *command_buffer_;
+
+	command_buffer.beginRenderPass(
+		vk::RenderPassBeginInfo(
+			*vk_render_pass_,
+			*framebuffer_,
+			vk::Rect2D(vk::Offset2D(0, 0), viewport_size_),
+			0u, nullptr),
+		vk::SubpassContents::eInline);
+
+	{
+		SZV_PROFILE_ZONE("draw functions");
+		for(const DrawFunction& draw_function : draw_functions)
+			draw_function(command_buffer);
+	}
+
+	command_buffer.endRenderPass();
+
+	if(read_back)
+	{
+		const vk::BufferImageCopy copy_region(
+			0u, 0u, 0u,
+			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0u, 0u, 1u),
+			vk::Offset3D(0, 0, 0),
+			vk::Extent3D(viewport_size_.width, viewport_size_.height, 1u));
+
+		command_buffer.copyImageToBuffer(
+			*image_,
+			vk::ImageLayout::eTransferSrcOptimal,
+			*readback_buffer_,
+			1u, &copy_region);
+
+		const vk::BufferMemoryBarrier buffer_memory_barrier(
+			vk::AccessFlagBits::eTransferWrite,
+			vk::AccessFlagBits::eHostRead,
+			VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+			*readback_buffer_,
+			0u, VK_WHOLE_SIZE);
+
+		command_buffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eHost,
+			vk::DependencyFlags(),
+			0u, nullptr,
+			1u, &buffer_memory_barrier,
+			0u, nullptr);
+	}
+
+	command_buffer.end();
+
+	vk_queue_.submit(
+		vk::SubmitInfo(
+			0u, nullptr, nullptr,
+			1u, &command_buffer,
+			0u, nullptr),
+		*submit_fence_);
+
+	{
+		SZV_PROFILE_ZONE("wait for frame fence");
+		vk_device_->waitForFences(
+			1u, &*submit_fence_,
+			VK_TRUE,
+			std::numeric_limits<uint64_t>::max());
+	}
+	vk_device_->resetFences(1u, &*submit_fence_);
+
+	if(read_back)
+	{
+		const size_t data_size= size_t(viewport_size_.width) * size_t(viewport_size_.height) * 4u;
+		frame_image_data_.resize(data_size);
+
+		void* const data= vk_device_->mapMemory(*readback_buffer_memory_, 0u, vk::DeviceSize(data_size));
+		std::memcpy(frame_image_data_.data(), data, data_size);
+		vk_device_->unmapMemory(*readback_buffer_memory_);
+	}
+}
+
+const std::vector<uint8_t>& HeadlessVulkan::GetFrameImageData() const
+{
+	return frame_image_data_;
+}
+
+vk::Device HeadlessVulkan::GetVulkanDevice() const
+{
+	return *vk_device_;
+}
+
+vk::Extent2D HeadlessVulkan::GetViewportSize() const
+{
+	return viewport_size_;
+}
+
+uint32_t HeadlessVulkan::GetQueueFamilyIndex() const
+{
+	return vk_queue_family_index_;
+}
+
+vk::RenderPass HeadlessVulkan::GetRenderPass() const
+{
+	return *vk_render_pass_;
+}
+
+bool HeadlessVulkan::HasDepthBuffer() const
+{
+	return false;
+}
+
+vk::PhysicalDeviceMemoryProperties HeadlessVulkan::GetMemoryProperties() const
+{
+	return memory_properties_;
+}
+
+vk::PhysicalDevice HeadlessVulkan::GetPhysicalDevice() const
+{
+	return physical_device_;
+}
+
+vk::PipelineCache HeadlessVulkan::GetPipelineCache() const
+{
+	return pipeline_cache_->Get();
+}
+
+vk::PhysicalDeviceFeatures HeadlessVulkan::GetEnabledDeviceFeatures() const
+{
+	return enabled_features_;
+}
+
+uint32_t HeadlessVulkan::GetFramesInFlightCount() const
+{
+	// Each frame is finished in "EndFrame".
+	return 1u;
+}
+
+uint32_t HeadlessVulkan::GetCurrentFrameIndex() const
+{
+	return 0u;
+}
+
+} // namespace SZV
@@ -0,0 +1,77 @@
+#pragma once
+#include "../Lib/I_WindowVulkan.hpp"
+#include "../Lib/PipelineCache.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SZV
+{
+
+// Vulkan context without window, surface and swapchain.
+// Frames are rendered into offscreen image, which may be read back into host memory.
+// Works with software drivers (like lavapipe), so it may be used on machines without GPU.
+class HeadlessVulkan final : public I_WindowVulkan
+{
+public:
+	using DrawFunction= std::function<void(vk::CommandBuffer)>;
+	using DrawFunctions= std::vector<DrawFunction>;
+
+	// Image format is always RGBA8.
+	static constexpr vk::Format c_image_format= vk::Format::eR8G8B8A8Unorm;
+
+public:
+	// Device with name containing given string is used, if it is not empty.
+	HeadlessVulkan(vk::Extent2D viewport_size, const std::string& device_name);
+	~HeadlessVulkan();
+
+	vk::CommandBuffer BeginFrame();
+	// Submit frame and wait for its completion. If "read_back" is true, rendered image is copied into host memory.
+	void EndFrame(const DrawFunctions& draw_functions, bool read_back);
+
+	// Pixels of last frame, read back. RGBA8, rows without padding.
+	const std::vector<uint8_t>& GetFrameImageData() const;
+
+	vk::Device GetVulkanDevice() const override;
+	vk::Extent2D GetViewportSize() const override;
+	uint32_t GetQueueFamilyIndex() const override;
+	vk::RenderPass GetRenderPass() const override; // Render pass for rendering into offscreen image.
+	bool HasDepthBuffer() const override;
+	vk::PhysicalDeviceMemoryProperties GetMemoryProperties() const override;
+	vk::PhysicalDevice GetPhysicalDevice() const override;
+	vk::PipelineCache GetPipelineCache() const override;
+	vk::PhysicalDeviceFeatures GetEnabledDeviceFeatures() const override;
+	uint32_t GetFramesInFlightCount() const override;
+	uint32_t GetCurrentFrameIndex() const override;
+
+private:
+	// Keep here order of construction.
+	vk::UniqueInstance vk_instance_;
+	VkDebugReportCallbackEXT vk_debug_report_callback_= VK_NULL_HANDLE;
+	vk::UniqueDevice vk_device_;
+	std::unique_ptr<PipelineCache> pipeline_cache_;
+	vk::Queue vk_queue_= nullptr;
+	uint32_t vk_queue_family_index_= ~0u;
+	const vk::Extent2D viewport_size_;
+	vk::PhysicalDeviceMemoryProperties memory_properties_;
+	vk::PhysicalDevice physical_device_;
+	vk::PhysicalDeviceFeatures enabled_features_;
+
+	vk::UniqueRenderPass vk_render_pass_;
+
+	vk::UniqueImage image_;
+	vk::UniqueDeviceMemory image_memory_;
+	vk::UniqueImageView image_view_;
+	vk::UniqueFramebuffer framebuffer_;
+
+	vk::UniqueBuffer readback_buffer_;
+	vk::UniqueDeviceMemory readback_buffer_memory_;
+
+	vk::UniqueCommandPool vk_command_pool_;
+	vk::UniqueCommandBuffer command_buffer_;
+	vk::UniqueFence submit_fence_;
+
+	std::vector<uint8_t> frame_image_data_;
+};
+
+} // namespace SZV
@@ -0,0 +1,398 @@
+#include "../Lib/CSGRenderer.hpp"
+#include "../Lib/CSGTreeSerialization.hpp"
+#include "../Lib/GPUProfiler.hpp"
+#include "../Lib/JSONWriter.hpp"
+#include "../Lib/Log.hpp"
+#include "../Lib/SceneGenerators.hpp"
+#include "CameraPath.hpp"
+#include "HeadlessVulkan.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+
+namespace SZV
+{
+
+namespace
+{
+
+using Clock= std::chrono::steady_clock;
+
+struct HeadlessSettings
+{
+	uint32_t width= 640u;
+	uint32_t height= 480u;
+	size_t frames= 120u;
+	std::string device_name;
+	std::string scene_name= "random_union";
+	std::string scene_file; // Load scene from file instead of generation, if not empty.
+	float scene_scale= 1.0f;
+	std::string camera_path_file; // Orbit is used if empty.
+	float orbit_radius= 12.0f;
+	float orbit_height= 4.0f;
+	float time_step_s= 1.0f / 60.0f;
+	bool read_back= true;
+	bool specialized_shaders= false;
+	bool exposure_check= false;
+	std::string output_file= "SazavaHeadless.json";
+	std::string hashes_out_file;
+	std::string hashes_ref_file;
+	std::string dump_directory;
+};
+
+struct FrameStats
+{
+	double cpu_time_ms= 0.0; // Time from frame start to completion of GPU work, including readback.
+	double gpu_time_ms= -1.0; // Negative if not available.
+	uint64_t hash= 0u;
+};
+
+// FNV-1a.
+uint64_t HashImageData(const std::vector<uint8_t>& data)
+{
+	uint64_t hash= 14695981039346656037ull;
+	for(const uint8_t b : data)
+	{
+		hash^= uint64_t(b);
+		hash*= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::string HashToString(const uint64_t hash)
+{
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)hash);
+	return buf;
+}
+
+void WritePPM(const std::string& file_name, const std::vector<uint8_t>& rgba, const uint32_t width, const uint32_t height)
+{
+	std::ofstream file(file_name, std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!file.is_open())
+	{
+		Log::Warning("Can not write image \"", file_name, "\"");
+		return;
+	}
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	std::vector<char> rgb(size_t(width) * size_t(height) * 3u);
+	for(size_t i= 0u; i < size_t(width) * size_t(height); ++i)
+	{
+		rgb[i * 3u + 0u]= char(rgba[i * 4u + 0u]);
+		rgb[i * 3u + 1u]= char(rgba[i * 4u + 1u]);
+		rgb[i * 3u + 2u]= char(rgba[i * 4u + 2u]);
+	}
+	file.write(rgb.data(), std::streamsize(rgb.size()));
+}
+
+std::vector<std::string> ReadLines(const std::string& file_name)
+{
+	std::vector<std::string> result;
+	std::ifstream file(file_name);
+	std::string line;
+	while(std::getline(file, line))
+		if(!line.empty())
+			result.push_back(line);
+	return result;
+}
+
+void PrintUsage()
+{
+	std::cout <<
+		"Usage: SazavaHeadless [options]\n"
+		"Options:\n"
+		"  --width W, --height H   image size (default 640x480)\n"
+		"  --frames N              number of frames (default 120)\n"
+		"  --device NAME           use Vulkan device with name containing NAME (for example \"llvmpipe\")\n"
+		"  --scene NAME            generated scene: deep_sub_chain, add_array_grid, random_union, nested_mul_sub,\n"
+		"                          referenced_parts, instanced_part\n"
+		"  --scale S               scene size multiplier (default 1)\n"
+		"  --scene-file FILE       load scene from JSON or binary (.szvb) file instead of generated scene\n"
+		"  --camera-path FILE      camera key frames file, lines \"x y z azimuth elevation\"\n"
+		"  --orbit R H             orbit camera radius and height, if no camera path file is given (default 12 4)\n"
+		"  --time-step S           fixed time step for time-dependent effects (default 1/60)\n"
+		"  --no-readback           do not read rendered images (pure performance run, no hashes)\n"
+		"  --specialized-shaders   compile specialized shaders for scene\n"
+		"  --exposure-check        compare GPU exposure calculation with reference implementation, exit code is 1 on mismatch\n"
+		"  --output FILE           JSON results file (default SazavaHeadless.json)\n"
+		"  --hashes-out FILE       write image hash for each frame into file\n"
+		"  --hashes-ref FILE       compare image hashes with reference file, exit code is 1 on mismatch\n"
+		"  --dump DIR              write each frame as PPM image into directory\n";
+}
+
+bool ParseArgs(const int argc, const char* const argv[], HeadlessSettings& settings)
+{
+	for(int i= 1; i < argc; ++i)
+	{
+		const char* const arg= argv[i];
+		const bool has_value= i + 1 < argc;
+		if(std::strcmp(arg, "--width") == 0 && has_value)
+			settings.width= uint32_t(std::max(1l, std::strtol(argv[++i], nullptr, 10)));
+		else if(std::strcmp(arg, "--height") == 0 && has_value)
+			settings.height= uint32_t(std::max(1l, std::strtol(argv[++i], nullptr, 10)));
+		else if(std::strcmp(arg, "--frames") == 0 && has_value)
+			settings.frames= size_t(std::max(1l, std::strtol(argv[++i], nullptr, 10)));
+		else if(std::strcmp(arg, "--device") == 0 && has_value)
+			settings.device_name= argv[++i];
+		else if(std::strcmp(arg, "--scene") == 0 && has_value)
+			settings.scene_name= argv[++i];
+		else if(std::strcmp(arg, "--scene-file") == 0 && has_value)
+			settings.scene_file= argv[++i];
+		else if(std::strcmp(arg, "--scale") == 0 && has_value)
+			settings.scene_scale= std::max(1.0e-3f, std::strtof(argv[++i], nullptr));
+		else if(std::strcmp(arg, "--camera-path") == 0 && has_value)
+			settings.camera_path_file= argv[++i];
+		else if(std::strcmp(arg, "--orbit") == 0 && i + 2 < argc)
+		{
+			settings.orbit_radius= std::strtof(argv[++i], nullptr);
+			settings.orbit_height= std::strtof(argv[++i], nullptr);
+		}
+		else if(std::strcmp(arg, "--time-step") == 0 && has_value)
+			settings.time_step_s= std::max(0.0f, std::strtof(argv[++i], nullptr));
+		else if(std::strcmp(arg, "--no-readback") == 0)
+			settings.read_back= false;
+		else if(std::strcmp(arg, "--specialized-shaders") == 0)
+			settings.specialized_shaders= true;
+		else if(std::strcmp(arg, "--exposure-check") == 0)
+			settings.exposure_check= true;
+		else if(std::strcmp(arg, "--output") == 0 && has_value)
+			settings.output_file= argv[++i];
+		else if(std::strcmp(arg, "--hashes-out") == 0 && has_value)
+			settings.hashes_out_file= argv[++i];
+		else if(std::strcmp(arg, "--hashes-ref") == 0 && has_value)
+			settings.hashes_ref_file= argv[++i];
+		else if(std::strcmp(arg, "--dump") == 0 && has_value)
+			settings.dump_directory= argv[++i];
+		else
+			return false;
+	}
+
+	return true;
+}
+
+int Main(const int argc, const char* const argv[])
+{
+	HeadlessSettings settings;
+	if(!ParseArgs(argc, argv, settings))
+	{
+		PrintUsage();
+		return -1;
+	}
+
+	CSGTree::CSGTreeNode scene_root;
+	if(!settings.scene_file.empty())
+	{
+		std::optional<CSGTree::CSGTreeNode> loaded_root= LoadCSGExpressionTree(settings.scene_file);
+		if(loaded_root == std::nullopt)
+		{
+			Log::Warning("Can not load scene \"", settings.scene_file, "\"");
+			return -1;
+		}
+		scene_root= std::move(*loaded_root);
+	}
+	else
+	{
+		bool found= false;
+		for(BenchmarkScene& scene : GenerateBenchmarkScenes(settings.scene_scale))
+			if(scene.name == settings.scene_name)
+			{
+				scene_root= std::move(scene.root);
+				found= true;
+			}
+		if(!found)
+		{
+			Log::Warning("Unknown scene \"", settings.scene_name, "\"");
+			return -1;
+		}
+	}
+
+	const CameraPath camera_path=
+		settings.camera_path_file.empty()
+			? CameraPath::MakeOrbit(settings.orbit_radius, settings.orbit_height)
+			: CameraPath::LoadFromFile(settings.camera_path_file);
+	if(camera_path.IsEmpty())
+		return -1;
+
+	std::vector<FrameStats> frame_stats(settings.frames);
+	size_t exposure_mismatches= 0u;
+	{
+		HeadlessVulkan headless_vulkan(vk::Extent2D(settings.width, settings.height), settings.device_name);
+		// Frames are synchronous, so profiler results are available almost immediately.
+		GPUProfiler gpu_profiler(headless_vulkan, 32u, 2u);
+		CSGRenderer csg_renderer(headless_vulkan);
+		csg_renderer.SetGPUProfiler(&gpu_profiler);
+		csg_renderer.SetUseSpecializedShaders(settings.specialized_shaders);
+		// Real time between frames depends on machine, use fixed step for reproducible images.
+		csg_renderer.SetFixedTimeStep(settings.time_step_s);
+		csg_renderer.SetExposureReadback(settings.exposure_check);
+
+		// Scene is static, build it only once.
+		csg_renderer.SetScene(std::make_shared<const CSGSceneData>(BuildCSGSceneData(scene_root)));
+		// Measure frames, drawn with specialized shader, not with generic shader, used until specialized one is ready.
+		if(settings.specialized_shaders)
+			csg_renderer.WaitForSpecializedPipeline();
+
+		CameraController camera_controller(float(settings.width) / float(settings.height));
+
+		for(size_t frame= 0u; frame < settings.frames; ++frame)
+		{
+			const Clock::time_point frame_start_time= Clock::now();
+
+			const CameraKeyFrame key_frame=
+				camera_path.Evaluate(settings.frames <= 1u ? 0.0f : float(frame) / float(settings.frames - 1u));
+			camera_controller.SetPosition(key_frame.pos, key_frame.azimuth, key_frame.elevation);
+
+			const vk::CommandBuffer command_buffer= headless_vulkan.BeginFrame();
+			gpu_profiler.BeginFrame(command_buffer);
+			csg_renderer.BeginFrame(command_buffer, camera_controller);
+
+			headless_vulkan.EndFrame(
+				{
+					[&](const vk::CommandBuffer command_buffer)
+					{
+						csg_renderer.EndFrame(command_buffer);
+					},
+				},
+				settings.read_back);
+
+			// Frame is finished in "EndFrame", so exposure results may be read.
+			ExposureCalculationResult exposure_result;
+			if(settings.exposure_check && csg_renderer.GetExposureReadback(exposure_result))
+			{
+				const std::string mismatch= CheckExposureCalculation(exposure_result, csg_renderer.GetExposureSettings());
+				if(!mismatch.empty())
+				{
+					Log::Warning("Frame ", frame, " exposure mismatch: ", mismatch);
+					++exposure_mismatches;
+				}
+			}
+
+			FrameStats& stats= frame_stats[frame];
+			stats.cpu_time_ms= std::chrono::duration<double, std::milli>(Clock::now() - frame_start_time).count();
+
+			const GPUProfiler::FrameResult& gpu_result= gpu_profiler.GetLastFrameResult();
+			if(gpu_result.frame_index < frame_stats.size())
+				frame_stats[size_t(gpu_result.frame_index)].gpu_time_ms= gpu_result.total_time_ms;
+
+			if(settings.read_back)
+			{
+				const std::vector<uint8_t>& image_data= headless_vulkan.GetFrameImageData();
+				stats.hash= HashImageData(image_data);
+				if(!settings.dump_directory.empty())
+				{
+					char file_name[32];
+					std::snprintf(file_name, sizeof(file_name), "/frame_%05u.ppm", uint32_t(frame));
+					WritePPM(settings.dump_directory + file_name, image_data, settings.width, settings.height);
+				}
+			}
+		}
+	}
+
+	// Write results.
+	{
+		std::ofstream file(settings.output_file, std::ios::out | std::ios::trunc);
+		if(!file.is_open())
+			Log::Warning("Can not open output file \"", settings.output_file, "\"");
+
+		double cpu_time_sum= 0.0, gpu_time_sum= 0.0;
+		size_t gpu_time_count= 0u;
+
+		JSONWriter writer(file);
+		writer.BeginObject();
+		writer.Write("width", size_t(settings.width));
+		writer.Write("height", size_t(settings.height));
+		if(settings.scene_file.empty())
+		{
+			writer.Write("scene", settings.scene_name);
+			writer.Write("scale", double(settings.scene_scale));
+		}
+		else
+			writer.Write("scene_file", settings.scene_file);
+		writer.BeginArray("frames");
+		for(const FrameStats& stats : frame_stats)
+		{
+			writer.BeginObject();
+			writer.Write("cpu_ms", stats.cpu_time_ms);
+			if(stats.gpu_time_ms >= 0.0)
+			{
+				writer.Write("gpu_ms", stats.gpu_time_ms);
+				gpu_time_sum+= stats.gpu_time_ms;
+				++gpu_time_count;
+			}
+			if(settings.read_back)
+				writer.Write("hash", HashToString(stats.hash));
+			writer.EndObject();
+			cpu_time_sum+= stats.cpu_time_ms;
+		}
+		writer.EndArray();
+		writer.Write("mean_cpu_ms", cpu_time_sum / double(frame_stats.size()));
+		writer.Write("mean_gpu_ms", gpu_time_count > 0u ? gpu_time_sum / double(gpu_time_count) : 0.0);
+		writer.EndObject();
+		file << "\n";
+
+		Log::Info("Rendered ", frame_stats.size(), " frames, mean frame time ", cpu_time_sum / double(frame_stats.size()), " ms");
+	}
+
+	if(settings.exposure_check)
+	{
+		if(exposure_mismatches > 0u)
+		{
+			Log::Warning(exposure_mismatches, " frames have exposure mismatch");
+			return 1;
+		}
+		Log::Info("Exposure calculation matches reference implementation");
+	}
+
+	if(!settings.read_back)
+		return 0;
+
+	if(!settings.hashes_out_file.empty())
+	{
+		std::ofstream file(settings.hashes_out_file, std::ios::out | std::ios::trunc);
+		for(const FrameStats& stats : frame_stats)
+			file << HashToString(stats.hash) << "\n";
+	}
+
+	if(!settings.hashes_ref_file.empty())
+	{
+		const std::vector<std::string> reference_hashes= ReadLines(settings.hashes_ref_file);
+		if(reference_hashes.size() != frame_stats.size())
+		{
+			Log::Warning("Reference contains ", reference_hashes.size(), " hashes, but ", frame_stats.size(), " frames were rendered");
+			return 1;
+		}
+
+		size_t mismatches= 0u;
+		for(size_t i= 0u; i < frame_stats.size(); ++i)
+		{
+			if(reference_hashes[i] != HashToString(frame_stats[i].hash))
+			{
+				Log::Warning("Frame ", i, " image mismatch: expected ", reference_hashes[i], ", got ", HashToString(frame_stats[i].hash));
+				++mismatches;
+			}
+		}
+
+		if(mismatches > 0u)
+		{
+			Log::Warning(mismatches, " frames mismatch reference");
+			return 1;
+		}
+		Log::Info("All frames match reference");
+	}
+
+	return 0;
+}
+
+} // namespace
+
+} // namespace SZV
+
+int main(const int argc, const char* argv[])
+{
+	return SZV::Main(argc, argv);
+}
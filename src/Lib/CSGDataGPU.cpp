@@ -1,5 +1,6 @@
 #include "CSGDataGPU.hpp"
 #include "Assert.hpp"
+#include "Profiler.hpp"
 
 namespace SZV
 {
@@ -7,17 +8,6 @@ namespace SZV
 namespace
 {
 
-// If this changed, surface shader must be chaged too!
-enum class GPUCSGExpressionCodes : CSGExpressionGPUBufferType
-{
-	Mul= 0,
-	Add= 1,
-	Sub= 2,
-
-	Leaf= 3,
-	OneLeaf= 4,
-};
-
 enum class CSGExpressionBuildResult
 {
 	Variable,
@@ -136,6 +126,53 @@ CSGExpressionBuildResult BUILDCSGExpressionNode_impl(CSGExpressionGPUBuffer& out
 	return CSGExpressionBuildResult::Variable;
 }
 
+// Build union of grid elements, except given one. Only cells near target box are visited.
+CSGExpressionBuildResult BUILDCSGGridExpression(
+	CSGExpressionGPUBuffer& out_expression,
+	const BoundingBox& target_bb,
+	const TreeElementsLowLevel::Grid& node,
+	const size_t skip_element_index)
+{
+	size_t begin[3], end[3];
+	GetGridCellsRange(node, target_bb, begin, end);
+
+	const size_t prev_size= out_expression.size();
+	CSGExpressionBuildResult result= CSGExpressionBuildResult::AlwaysZero;
+
+	for(size_t x= begin[0]; x < end[0]; ++x)
+	for(size_t y= begin[1]; y < end[1]; ++y)
+	for(size_t z= begin[2]; z < end[2]; ++z)
+	{
+		const size_t cell_offset= ((x * node.size[1] + y) * node.size[2] + z) * node.cell_element_count;
+		for(size_t i= 0u; i < node.cell_element_count; ++i)
+		{
+			const size_t element_index= cell_offset + i;
+			if(element_index == skip_element_index)
+				continue;
+
+			const CSGExpressionBuildResult element_result= BUILDCSGExpression_r(out_expression, target_bb, node.elements[element_index]);
+			if(element_result == CSGExpressionBuildResult::AlwaysOne)
+			{
+				out_expression.resize(prev_size);
+				return CSGExpressionBuildResult::AlwaysOne;
+			}
+			else if(element_result == CSGExpressionBuildResult::Variable)
+			{
+				if(result == CSGExpressionBuildResult::Variable)
+					out_expression.push_back(CSGExpressionGPUBufferType(GPUCSGExpressionCodes::Add));
+				result= CSGExpressionBuildResult::Variable;
+			}
+		}
+	}
+
+	return result;
+}
+
+CSGExpressionBuildResult BUILDCSGExpressionNode_impl(CSGExpressionGPUBuffer& out_expression, const BoundingBox& target_bb, const TreeElementsLowLevel::Grid& node)
+{
+	return BUILDCSGGridExpression(out_expression, target_bb, node, node.elements.size());
+}
+
 CSGExpressionBuildResult BUILDCSGExpressionNode_impl(CSGExpressionGPUBuffer& out_expression, const BoundingBox& target_bb, const TreeElementsLowLevel::Leaf& node)
 {
 	if (node.bb.max.x < target_bb.min.x || node.bb.min.x > target_bb.max.x ||
@@ -143,8 +180,17 @@ CSGExpressionBuildResult BUILDCSGExpressionNode_impl(CSGExpressionGPUBuffer& out
 		node.bb.max.z < target_bb.min.z || node.bb.min.z > target_bb.max.z )
 		return CSGExpressionBuildResult::AlwaysZero;
 
-	out_expression.push_back(CSGExpressionGPUBufferType(GPUCSGExpressionCodes::Leaf));
-	out_expression.push_back(CSGExpressionGPUBufferType(node.surface_index));
+	if(node.transform_index == 0u)
+	{
+		out_expression.push_back(CSGExpressionGPUBufferType(GPUCSGExpressionCodes::Leaf));
+		out_expression.push_back(CSGExpressionGPUBufferType(node.surface_index));
+	}
+	else
+	{
+		out_expression.push_back(CSGExpressionGPUBufferType(GPUCSGExpressionCodes::InstancedLeaf));
+		out_expression.push_back(CSGExpressionGPUBufferType(node.surface_index));
+		out_expression.push_back(CSGExpressionGPUBufferType(node.transform_index));
+	}
 	return CSGExpressionBuildResult::Variable;
 }
 
@@ -203,6 +249,17 @@ void BuildSceneMeshNode_impl(
 	BuildSceneMeshNode_r(out_vertices, out_indices, out_expressions, nodes_stack, *node.r);
 }
 
+void BuildSceneMeshNode_impl(
+	VerticesVector& out_vertices,
+	IndicesVector& out_indices,
+	CSGExpressionGPUBuffer& out_expressions,
+	NodesStack& nodes_stack,
+	const TreeElementsLowLevel::Grid& node)
+{
+	for(const TreeElementsLowLevel::TreeElement& element : node.elements)
+		BuildSceneMeshNode_r(out_vertices, out_indices, out_expressions, nodes_stack, element);
+}
+
 void BuildSceneMeshNode_impl(
 	VerticesVector& out_vertices,
 	IndicesVector& out_indices,
@@ -212,6 +269,7 @@ void BuildSceneMeshNode_impl(
 {
 	const size_t start_offset= out_expressions.size();
 	out_expressions.push_back(CSGExpressionGPUBufferType(node.surface_index));
+	out_expressions.push_back(CSGExpressionGPUBufferType(node.transform_index));
 
 	const size_t expression_size_offset= out_expressions.size();
 	out_expressions.push_back(0); // Reserve place for size.
@@ -254,6 +312,12 @@ void BuildSceneMeshNode_impl(
 			const bool this_is_left= mul->l.get() == nodes_stack[i];
 			process_mul(BUILDCSGExpression_r(out_expressions, node.bb, this_is_left ? *mul->r : *mul->l));
 		}
+		else if(const auto grid= std::get_if<TreeElementsLowLevel::Grid>(el))
+		{
+			// Elements of grid are stored contiguously, so index of this element is known from its address.
+			const size_t this_index= size_t(nodes_stack[i] - grid->elements.data());
+			process_sub(BUILDCSGGridExpression(out_expressions, node.bb, *grid, this_index));
+		}
 		else if(const auto sub= std::get_if<TreeElementsLowLevel::Sub>(el))
 		{
 			const bool this_is_left= sub->l.get() == nodes_stack[i];
@@ -305,8 +369,23 @@ void BuildSceneMeshTree(
 	CSGExpressionGPUBuffer& out_expressions,
 	const TreeElementsLowLevel::TreeElement& root)
 {
+	SZV_PROFILE_FUNCTION();
+
 	NodesStack nodes_stack;
 	BuildSceneMeshNode_r(out_vertices, out_indices, out_expressions, nodes_stack, root);
 }
 
+CSGSceneData BuildCSGSceneData(const CSGTree::CSGTreeNode& root)
+{
+	SZV_PROFILE_FUNCTION();
+
+	CSGSceneData scene_data;
+	BuildSceneMeshTree(
+		scene_data.vertices,
+		scene_data.indices,
+		scene_data.expressions,
+		BuildLowLevelTree(scene_data.surfaces, scene_data.transforms, root));
+	return scene_data;
+}
+
 } // namespace SZV
@@ -19,10 +19,40 @@ using IndicesVector= std::vector<IndexType>;
 using CSGExpressionGPUBufferType= uint32_t;
 using CSGExpressionGPUBuffer= std::vector<CSGExpressionGPUBufferType>;
 
+// If this changed, surface shader and shader generator must be chaged too!
+enum class GPUCSGExpressionCodes : CSGExpressionGPUBufferType
+{
+	Mul= 0,
+	Add= 1,
+	Sub= 2,
+
+	Leaf= 3,
+	OneLeaf= 4,
+	InstancedLeaf= 5,
+};
+
+// Expressions buffer contains expression for each leaf:
+// surface index, transform index, end offset of expression, list of postfix operations.
+// Leaf operation is followed by surface index. Instanced leaf operation is followed by surface index and transform index.
+// Leaf operation is used for surfaces in world space (with zero transform index), instanced leaf operation - for other surfaces.
+
 void BuildSceneMeshTree(
 	VerticesVector& out_vertices,
 	IndicesVector& out_indices,
 	CSGExpressionGPUBuffer& out_expressions,
 	const TreeElementsLowLevel::TreeElement& root);
 
+// All CPU-side data of scene, ready for uploading into GPU buffers.
+struct CSGSceneData
+{
+	VerticesVector vertices;
+	IndicesVector indices;
+	GPUSurfacesVector surfaces;
+	GPUTransformsVector transforms;
+	CSGExpressionGPUBuffer expressions;
+};
+
+// Build low-level tree and mesh. Thread-safe, may be called in background thread.
+CSGSceneData BuildCSGSceneData(const CSGTree::CSGTreeNode& root);
+
 } // namespace SZV
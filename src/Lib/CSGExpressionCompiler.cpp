@@ -0,0 +1,529 @@
+#include "CSGExpressionCompiler.hpp"
+#include "Assert.hpp"
+#include "CacheDirectory.hpp"
+#include "Log.hpp"
+#include "ParallelFor.hpp"
+#include "Process.hpp"
+#include "SHA256.hpp"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <random>
+
+#ifndef _WIN32
+#include <dlfcn.h>
+#endif
+
+namespace SZV
+{
+
+namespace
+{
+
+using Clock= std::chrono::steady_clock;
+
+double GetTimeS(const Clock::time_point start, const Clock::time_point end)
+{
+	return double((end - start).count()) * double(Clock::duration::period::num) / double(Clock::duration::period::den);
+}
+
+// Use hexadecimal form for exact constants representation.
+std::string FloatLiteral(const float f)
+{
+	char buf[64];
+	std::snprintf(buf, sizeof(buf), "(%af)", double(f));
+	return buf;
+}
+
+// Write surface value calculation in the same order as interpreter does, to produce identical results.
+// Terms with zero coefficients are skipped - adding of zero does not change sum.
+// Result is expression of uint8_t value - 1 inside leaf, 0 outside. Coordinates are named "x", "y", "z".
+std::string GenerateLeafExpression(const CSGFlatLeaf& leaf)
+{
+	const GPUSurface& s= leaf.surface;
+	const std::pair<float, const char*> terms[]
+	{
+		{ s.xx, "x * x" },
+		{ s.yy, "y * y" },
+		{ s.zz, "z * z" },
+		{ s.xy, "x * y" },
+		{ s.xz, "x * z" },
+		{ s.yz, "y * z" },
+		{ s.x, "x" },
+		{ s.y, "y" },
+		{ s.z, "z" },
+	};
+
+	std::string sum;
+	for(const auto& term : terms)
+	{
+		if(term.first == 0.0f)
+			continue;
+		if(!sum.empty())
+			sum+= " + ";
+		sum+= FloatLiteral(term.first) + " * " + term.second;
+	}
+	if(sum.empty())
+		sum= FloatLiteral(s.k);
+	else
+		sum+= " + " + FloatLiteral(s.k);
+
+	const BoundingBox& bb= leaf.bb;
+	return
+		"uint8_t("
+		"(x >= " + FloatLiteral(bb.min.x) + ") & (x <= " + FloatLiteral(bb.max.x) + ") & " +
+		"(y >= " + FloatLiteral(bb.min.y) + ") & (y <= " + FloatLiteral(bb.max.y) + ") & " +
+		"(z >= " + FloatLiteral(bb.min.z) + ") & (z <= " + FloatLiteral(bb.max.z) + ") & " +
+		"(" + sum + " < 0.0f))";
+}
+
+std::string GetCompiler(const CSGCompilerSettings& settings)
+{
+	if(!settings.compiler.empty())
+		return settings.compiler;
+	if(const char* const cxx= std::getenv("CXX"))
+		return cxx;
+	return "c++";
+}
+
+std::string ReadFile(const std::filesystem::path& path)
+{
+	std::ifstream file(path);
+	std::ostringstream stream;
+	stream << file.rdbuf();
+	return stream.str();
+}
+
+#ifndef _WIN32
+
+// Compile units in parallel and link them into library in given directory, than move library into given path.
+bool BuildLibrary(
+	const std::vector<std::string>& sources,
+	const std::string& compiler,
+	const std::vector<std::string>& flags,
+	const std::filesystem::path& work_directory,
+	const std::filesystem::path& library_path)
+{
+	const auto get_unit_path=
+		[&](const size_t index, const char* const extension)
+		{
+			return work_directory / ("unit_" + std::to_string(index) + extension);
+		};
+
+	for(size_t i= 0u; i < sources.size(); ++i)
+	{
+		const std::filesystem::path source_path= get_unit_path(i, ".cpp");
+		std::ofstream source_file(source_path);
+		source_file << sources[i];
+		if(!source_file)
+		{
+			Log::Warning("Can not write ", source_path.string());
+			return false;
+		}
+	}
+
+	std::vector<uint8_t> unit_compiled(sources.size(), 0u);
+	ParallelFor(
+		sources.size(), 0u,
+		[&](const size_t i)
+		{
+			std::vector<std::string> args;
+			args.push_back(compiler);
+			args.insert(args.end(), flags.begin(), flags.end());
+			args.push_back("-c");
+			args.push_back("-o");
+			args.push_back(get_unit_path(i, ".o").string());
+			args.push_back(get_unit_path(i, ".cpp").string());
+			unit_compiled[i]= RunProcess(args, get_unit_path(i, ".log").string()) ? 1u : 0u;
+		});
+
+	for(size_t i= 0u; i < sources.size(); ++i)
+	{
+		if(unit_compiled[i] == 0u)
+		{
+			Log::Warning("CSG expression compilation failed, unit ", i, "\n", ReadFile(get_unit_path(i, ".log")));
+			return false;
+		}
+	}
+
+	const std::filesystem::path library_temp_path= work_directory / "library.so";
+	const std::filesystem::path link_log_path= work_directory / "link.log";
+	std::vector<std::string> args{ compiler, "-shared", "-o", library_temp_path.string() };
+	for(size_t i= 0u; i < sources.size(); ++i)
+		args.push_back(get_unit_path(i, ".o").string());
+	if(!RunProcess(args, link_log_path.string()))
+	{
+		Log::Warning("CSG expression linking failed\n", ReadFile(link_log_path));
+		return false;
+	}
+
+	// Rename is atomic, so other processes see either no library or complete library.
+	std::error_code ec;
+	std::filesystem::rename(library_temp_path, library_path, ec);
+	if(ec)
+	{
+		Log::Warning("Can not rename ", library_temp_path.string(), ": ", ec.message());
+		return false;
+	}
+
+	return true;
+}
+
+#endif
+
+} // namespace
+
+std::vector<std::string> GenerateCSGExpressionSources(const CSGFlatTree& tree, const CSGFlatExpression& expression, const std::string& function_name)
+{
+	// Points are processed in blocks. Each leaf and each operation is a separate loop over block, values are stored in stack of block-sized arrays.
+	// Stack positions are known at generation time, so they are written as constants.
+	// Loops have constant trip count, so they are vectorized without remainder handling, last partial block is padded.
+	// Operations are grouped into separate functions of limited size, because compilation time of one huge function grows superlinearly.
+	// Functions are grouped into several translation units, which may be compiled in parallel.
+	// Single points are classified by separate scalar code, because evaluation of whole block for one point is wasteful.
+	const size_t c_block_size= 64u;
+	const size_t c_ops_per_function= 64u;
+	const size_t c_functions_per_unit= 8u;
+	// Larger stack is not placed on call stack, in order to avoid its overflow.
+	const size_t c_max_local_stack_size_bytes= 64u * 1024u;
+
+	const std::string block_declarations=
+		"#include <cstddef>\n"
+		"#include <cstdint>\n"
+		"#include <cstring>\n"
+		"\n"
+		"constexpr size_t c_block_size= " + std::to_string(c_block_size) + ";\n"
+		"using Block= uint8_t[c_block_size];\n"
+		"\n";
+	const std::string block_function_params= "(const float* __restrict xs, const float* __restrict ys, const float* __restrict zs, Block* __restrict s)";
+	const std::string point_function_params= "(const float x, const float y, const float z, uint8_t* __restrict s)";
+
+	std::vector<std::string> units;
+	std::string main_declarations;
+	std::string main_block_calls;
+	std::string main_point_calls;
+
+	std::string* unit= nullptr;
+	std::string block_function, point_function;
+	size_t stack_size= 0u, max_stack_size= 0u;
+	size_t function_index= 0u, ops_in_function= 0u;
+	for(const CSGFlatExpressionOp& op : expression)
+	{
+		if(ops_in_function == 0u)
+		{
+			if(function_index % c_functions_per_unit == 0u)
+			{
+				units.push_back(block_declarations);
+				unit= &units.back();
+			}
+
+			const std::string block_name= function_name + "Chunk" + std::to_string(function_index);
+			const std::string point_name= function_name + "PointChunk" + std::to_string(function_index);
+			block_function= "void " + block_name + block_function_params + "\n{\n";
+			point_function= "void " + point_name + point_function_params + "\n{\n";
+			main_declarations+= "void " + block_name + block_function_params + ";\n";
+			main_declarations+= "void " + point_name + point_function_params + ";\n";
+			main_block_calls+= "\t\t" + block_name + "(x, y, z, s);\n";
+			main_point_calls+= "\t" + point_name + "(x, y, z, s);\n";
+		}
+
+		switch(op.code)
+		{
+		case CSGFlatExpressionOp::Code::Leaf:
+			{
+				const std::string dst= std::to_string(stack_size);
+				const std::string value= GenerateLeafExpression(tree.leafs[op.leaf_index]);
+				block_function+= "\tfor(size_t i= 0; i < c_block_size; ++i)\n";
+				block_function+= "\t{\n";
+				block_function+= "\t\tconst float x= xs[i], y= ys[i], z= zs[i];\n";
+				block_function+= "\t\ts[" + dst + "][i]= " + value + ";\n";
+				block_function+= "\t}\n";
+				point_function+= "\ts[" + dst + "]= " + value + ";\n";
+				++stack_size;
+			}
+			break;
+
+		case CSGFlatExpressionOp::Code::OneLeaf:
+			block_function+= "\tfor(size_t i= 0; i < c_block_size; ++i)\n";
+			block_function+= "\t\ts[" + std::to_string(stack_size) + "][i]= 1;\n";
+			point_function+= "\ts[" + std::to_string(stack_size) + "]= 1;\n";
+			++stack_size;
+			break;
+
+		case CSGFlatExpressionOp::Code::Mul:
+		case CSGFlatExpressionOp::Code::Add:
+		case CSGFlatExpressionOp::Code::Sub:
+			{
+				SZV_ASSERT(stack_size >= 2u);
+				const std::string l= "s[" + std::to_string(stack_size - 2u) + "]";
+				const std::string r= "s[" + std::to_string(stack_size - 1u) + "]";
+				--stack_size;
+
+				// Bitwise operations are used to avoid branches.
+				const auto get_value=
+					[&](const std::string& a, const std::string& b)
+					{
+						if(op.code == CSGFlatExpressionOp::Code::Mul)
+							return a + " & " + b;
+						else if(op.code == CSGFlatExpressionOp::Code::Add)
+							return a + " | " + b;
+						else
+							return a + " & (" + b + " ^ 1)";
+					};
+
+				block_function+= "\tfor(size_t i= 0; i < c_block_size; ++i)\n";
+				block_function+= "\t\t" + l + "[i]= uint8_t(" + get_value(l + "[i]", r + "[i]") + ");\n";
+				point_function+= "\t" + l + "= uint8_t(" + get_value(l, r) + ");\n";
+			}
+			break;
+		}
+		max_stack_size= std::max(max_stack_size, stack_size);
+
+		++ops_in_function;
+		if(ops_in_function == c_ops_per_function)
+		{
+			*unit+= block_function + "}\n\n" + point_function + "}\n\n";
+			ops_in_function= 0u;
+			++function_index;
+		}
+	}
+	SZV_ASSERT(stack_size == 1u);
+	if(ops_in_function > 0u)
+		*unit+= block_function + "}\n\n" + point_function + "}\n\n";
+
+	// Stack size is known, so no allocation is needed.
+	const bool local_stack= max_stack_size * c_block_size <= c_max_local_stack_size_bytes;
+	const std::string stack_size_str= std::to_string(max_stack_size);
+
+	std::string out= block_declarations;
+	out+= main_declarations;
+	out+= "\n";
+	out+= "extern \"C\" void " + function_name + "(const float* __restrict xs, const float* __restrict ys, const float* __restrict zs, uint8_t* __restrict out, size_t count)\n";
+	out+= "{\n";
+	if(local_stack)
+		out+= "\tBlock s[" + stack_size_str + "];\n";
+	else
+		out+= "\tstatic thread_local Block s[" + stack_size_str + "];\n";
+	out+= "\tfloat tail_x[c_block_size]{}, tail_y[c_block_size]{}, tail_z[c_block_size]{};\n";
+	out+= "\tfor(size_t offset= 0; offset < count; offset+= c_block_size)\n";
+	out+= "\t{\n";
+	out+= "\t\tconst float* x= xs + offset;\n";
+	out+= "\t\tconst float* y= ys + offset;\n";
+	out+= "\t\tconst float* z= zs + offset;\n";
+	out+= "\t\tconst size_t n= count - offset < c_block_size ? count - offset : c_block_size;\n";
+	out+= "\t\tif(n < c_block_size)\n";
+	out+= "\t\t{\n";
+	out+= "\t\t\tstd::memcpy(tail_x, x, n * sizeof(float));\n";
+	out+= "\t\t\tstd::memcpy(tail_y, y, n * sizeof(float));\n";
+	out+= "\t\t\tstd::memcpy(tail_z, z, n * sizeof(float));\n";
+	out+= "\t\t\tx= tail_x;\n";
+	out+= "\t\t\ty= tail_y;\n";
+	out+= "\t\t\tz= tail_z;\n";
+	out+= "\t\t}\n";
+	out+= main_block_calls;
+	out+= "\t\tstd::memcpy(out + offset, s[0], n);\n";
+	out+= "\t}\n";
+	out+= "}\n";
+	out+= "\n";
+	out+= "extern \"C\" uint8_t " + function_name + "Point(const float x, const float y, const float z)\n";
+	out+= "{\n";
+	if(local_stack)
+		out+= "\tuint8_t s[" + stack_size_str + "];\n";
+	else
+		out+= "\tstatic thread_local uint8_t s[" + stack_size_str + "];\n";
+	out+= main_point_calls;
+	out+= "\treturn s[0];\n";
+	out+= "}\n";
+
+	units.insert(units.begin(), std::move(out));
+	return units;
+}
+
+void ClassifyPointsInterpreted(
+	const CSGFlatTree& tree,
+	const CSGFlatExpression& expression,
+	const float* const x, const float* const y, const float* const z,
+	uint8_t* const out,
+	const size_t count)
+{
+	std::vector<bool> stack;
+	for(size_t i= 0u; i < count; ++i)
+		out[i]= uint8_t(IsPointInside(tree, expression, m_Vec3(x[i], y[i], z[i]), stack));
+}
+
+std::unique_ptr<CSGCompiledExpression> CSGCompiledExpression::Compile(
+	const CSGFlatTree& tree,
+	const CSGFlatExpression& expression,
+	const CSGCompilerSettings& settings)
+{
+#ifdef _WIN32
+	SZV_UNUSED(tree);
+	SZV_UNUSED(expression);
+	SZV_UNUSED(settings);
+	Log::Warning("CSG expressions compilation is not supported on this platform");
+	return nullptr;
+#else
+	if(expression.size() > settings.max_expression_size)
+	{
+		Log::Info("CSG expression with ", expression.size(), " operations is too large for compilation");
+		return nullptr;
+	}
+
+	const char* const function_name= "SZVClassifyPoints";
+	const std::string point_function_name= std::string(function_name) + "Point";
+	const std::vector<std::string> sources= GenerateCSGExpressionSources(tree, expression, function_name);
+
+	// Libraries from cache are loaded without checks, so cache must be writable only by current user.
+	const std::optional<std::filesystem::path> directory= GetCacheDirectory("csg", settings.cache_directory);
+	if(directory == std::nullopt)
+		return nullptr;
+
+	const std::string compiler= GetCompiler(settings);
+	// Higher optimization levels greatly increase compilation time of generated code, but give almost no speed-up.
+	// Vectorization is enabled separately, since it gives large speed-up for loops over blocks of points.
+	std::vector<std::string> flags{ "-std=c++17", "-O1", "-ftree-vectorize", "-ffp-contract=off", "-fPIC" };
+	if(settings.optimize_for_host_cpu)
+		flags.push_back("-march=native");
+
+	SHA256 hasher;
+	hasher.Update(compiler);
+	for(const std::string& flag : flags)
+	{
+		hasher.Update("\0", 1u);
+		hasher.Update(flag);
+	}
+	for(const std::string& source : sources)
+	{
+		hasher.Update("\0", 1u);
+		hasher.Update(source);
+	}
+	const std::string hash_str= SHA256DigestToHex(hasher.Finish());
+
+	const std::filesystem::path library_path= *directory / ("csg_" + hash_str + ".so");
+	if(!std::filesystem::exists(library_path))
+	{
+		// Other processes may compile same expression at same time, so all intermediate files are created in private directory.
+		// Result is moved into cache atomically, so only complete library may be loaded.
+		const std::optional<std::filesystem::path> work_directory= CreatePrivateWorkDirectory(*directory);
+		if(work_directory == std::nullopt)
+			return nullptr;
+
+		const bool built= BuildLibrary(sources, compiler, flags, *work_directory, library_path);
+
+		std::error_code ec;
+		std::filesystem::remove_all(*work_directory, ec);
+		if(!built)
+			return nullptr;
+	}
+
+	void* const library_handle= dlopen(library_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if(library_handle == nullptr)
+	{
+		Log::Warning("Can not load ", library_path.string(), ": ", dlerror());
+		return nullptr;
+	}
+
+	const auto function= reinterpret_cast<CSGClassifyPointsFunction>(dlsym(library_handle, function_name));
+	const auto point_function= reinterpret_cast<CSGClassifyPointFunction>(dlsym(library_handle, point_function_name.c_str()));
+	if(function == nullptr || point_function == nullptr)
+	{
+		Log::Warning("Can not find function in ", library_path.string());
+		dlclose(library_handle);
+		return nullptr;
+	}
+
+	return std::unique_ptr<CSGCompiledExpression>(new CSGCompiledExpression(library_handle, function, point_function));
+#endif
+}
+
+CSGCompiledExpression::CSGCompiledExpression(
+	void* const library_handle,
+	const CSGClassifyPointsFunction function,
+	const CSGClassifyPointFunction point_function)
+	: library_handle_(library_handle), function_(function), point_function_(point_function)
+{
+}
+
+CSGCompiledExpression::~CSGCompiledExpression()
+{
+#ifndef _WIN32
+	dlclose(library_handle_);
+#endif
+}
+
+bool CSGCompiledExpression::IsPointInside(const m_Vec3& pos) const
+{
+	return point_function_(pos.x, pos.y, pos.z) != 0u;
+}
+
+void CSGCompiledExpression::ClassifyPoints(const float* const x, const float* const y, const float* const z, uint8_t* const out, const size_t count) const
+{
+	function_(x, y, z, out, count);
+}
+
+CSGCompilerBenchmarkResult BenchmarkCSGExpressionCompiler(
+	const CSGFlatTree& tree,
+	const size_t num_points,
+	const CSGCompilerSettings& settings)
+{
+	CSGCompilerBenchmarkResult result;
+
+	std::mt19937 generator(0u);
+	std::uniform_real_distribution<float> distribution_x(tree.bb.min.x, tree.bb.max.x);
+	std::uniform_real_distribution<float> distribution_y(tree.bb.min.y, tree.bb.max.y);
+	std::uniform_real_distribution<float> distribution_z(tree.bb.min.z, tree.bb.max.z);
+
+	std::vector<float> x(num_points), y(num_points), z(num_points);
+	for(size_t i= 0u; i < num_points; ++i)
+	{
+		x[i]= distribution_x(generator);
+		y[i]= distribution_y(generator);
+		z[i]= distribution_z(generator);
+	}
+
+	std::vector<uint8_t> interpreted_result(num_points), compiled_result(num_points);
+
+	const Clock::time_point interpretation_start_time= Clock::now();
+	ClassifyPointsInterpreted(tree, tree.expression, x.data(), y.data(), z.data(), interpreted_result.data(), num_points);
+	const double interpretation_time_s= GetTimeS(interpretation_start_time, Clock::now());
+	result.interpreted_points_per_second= double(num_points) / std::max(interpretation_time_s, 1.0e-9);
+
+	if(tree.expression.size() > settings.max_expression_size)
+	{
+		result.too_large= true;
+		return result;
+	}
+
+	const Clock::time_point compilation_start_time= Clock::now();
+	const std::unique_ptr<CSGCompiledExpression> compiled= CSGCompiledExpression::Compile(tree, tree.expression, settings);
+	result.compilation_time_s= GetTimeS(compilation_start_time, Clock::now());
+	if(compiled == nullptr)
+		return result;
+	result.compiled= true;
+
+	const Clock::time_point compiled_start_time= Clock::now();
+	compiled->ClassifyPoints(x.data(), y.data(), z.data(), compiled_result.data(), num_points);
+	const double compiled_time_s= GetTimeS(compiled_start_time, Clock::now());
+	result.compiled_points_per_second= double(num_points) / std::max(compiled_time_s, 1.0e-9);
+
+	for(size_t i= 0u; i < num_points; ++i)
+		if(interpreted_result[i] != compiled_result[i])
+			++result.mismatches;
+
+	// Single points are classified via separate code, check it too.
+	const Clock::time_point single_points_start_time= Clock::now();
+	for(size_t i= 0u; i < num_points; ++i)
+		compiled_result[i]= uint8_t(compiled->IsPointInside(m_Vec3(x[i], y[i], z[i])));
+	const double single_points_time_s= GetTimeS(single_points_start_time, Clock::now());
+	result.compiled_single_points_per_second= double(num_points) / std::max(single_points_time_s, 1.0e-9);
+
+	for(size_t i= 0u; i < num_points; ++i)
+		if(interpreted_result[i] != compiled_result[i])
+			++result.mismatches;
+
+	return result;
+}
+
+} // namespace SZV
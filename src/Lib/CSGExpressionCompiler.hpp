@@ -0,0 +1,93 @@
+#pragma once
+#include "CSGIntervalEvaluator.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SZV
+{
+
+// Function, which classifies points. Result is 1 for points inside, 0 for points outside.
+using CSGClassifyPointsFunction= void(*)(const float* x, const float* y, const float* z, uint8_t* out, size_t count);
+// Same, but for single point.
+using CSGClassifyPointFunction= uint8_t(*)(float x, float y, float z);
+
+// Generate C++ sources of points classification function with given name.
+// Expression is translated into branchless code with surface parameters inlined as constants.
+// Points are processed in blocks, each leaf and operation is a loop over block.
+// Code is split into functions of limited size and these functions are split into several translation units.
+// First unit contains function with given name and function for single point with "Point" suffix,
+// all units should be compiled and linked together.
+std::vector<std::string> GenerateCSGExpressionSources(const CSGFlatTree& tree, const CSGFlatExpression& expression, const std::string& function_name);
+
+// Reference implementation, which interprets expression.
+void ClassifyPointsInterpreted(
+	const CSGFlatTree& tree,
+	const CSGFlatExpression& expression,
+	const float* x, const float* y, const float* z,
+	uint8_t* out,
+	size_t count);
+
+struct CSGCompilerSettings
+{
+	// Compiler executable. Empty means value of "CXX" environment variable or "c++".
+	std::string compiler;
+	// Directory for compiled libraries. Empty means per-user cache directory (see "GetCacheDirectory").
+	// Libraries are named by SHA-256 of compiler, flags and source, so it works as a cache.
+	// Directory must be owned by current user and must not be accessible for others, otherwise compilation fails.
+	std::string cache_directory;
+	bool optimize_for_host_cpu= true;
+	// Compilation takes about 7 ms per operation on single core, so it pays off only for not very large expressions.
+	// Larger expressions are not compiled, use interpreter for them.
+	size_t max_expression_size= 8192u;
+};
+
+// Expression, compiled into native code.
+// Generated sources are compiled in parallel and linked into shared library using system C++ compiler, library is loaded at runtime.
+// Supported only on POSIX systems.
+class CSGCompiledExpression
+{
+public:
+	// Returns null in case of failure. Use interpreter as fallback.
+	static std::unique_ptr<CSGCompiledExpression> Compile(
+		const CSGFlatTree& tree,
+		const CSGFlatExpression& expression,
+		const CSGCompilerSettings& settings= CSGCompilerSettings());
+
+	CSGCompiledExpression(const CSGCompiledExpression&)= delete;
+	CSGCompiledExpression& operator=(const CSGCompiledExpression&)= delete;
+	~CSGCompiledExpression();
+
+	bool IsPointInside(const m_Vec3& pos) const;
+	void ClassifyPoints(const float* x, const float* y, const float* z, uint8_t* out, size_t count) const;
+
+	CSGClassifyPointsFunction GetFunction() const { return function_; }
+
+private:
+	CSGCompiledExpression(void* library_handle, CSGClassifyPointsFunction function, CSGClassifyPointFunction point_function);
+
+private:
+	void* const library_handle_;
+	const CSGClassifyPointsFunction function_;
+	const CSGClassifyPointFunction point_function_;
+};
+
+struct CSGCompilerBenchmarkResult
+{
+	bool compiled= false;
+	bool too_large= false; // Expression is larger than limit in settings, compilation is not performed.
+	double compilation_time_s= 0.0;
+	double interpreted_points_per_second= 0.0;
+	double compiled_points_per_second= 0.0;
+	double compiled_single_points_per_second= 0.0;
+	// Number of points with different results of compiled code and interpreter, for both batch and single point classification.
+	size_t mismatches= 0u;
+};
+
+// Compare compiled expression against interpreter on random points inside tree bounding box.
+CSGCompilerBenchmarkResult BenchmarkCSGExpressionCompiler(
+	const CSGFlatTree& tree,
+	size_t num_points,
+	const CSGCompilerSettings& settings= CSGCompilerSettings());
+
+} // namespace SZV
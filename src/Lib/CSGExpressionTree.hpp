@@ -1,6 +1,8 @@
 #pragma once
 #include "Vec.hpp"
 #include <cstdint>
+#include <memory>
+#include <string>
 #include <variant>
 #include <vector>
 
@@ -23,6 +25,10 @@ struct Hyperboloid;
 struct ParabolicCylinder;
 struct HyperbolicCylinder;
 struct HyperbolicParaboloid;
+struct Reference;
+struct Instance;
+
+class ReferenceTarget;
 
 using CSGTreeNode= std::variant<
 	MulChain,
@@ -37,7 +43,9 @@ using CSGTreeNode= std::variant<
 	Hyperboloid,
 	ParabolicCylinder,
 	HyperbolicCylinder,
-	HyperbolicParaboloid>;
+	HyperbolicParaboloid,
+	Reference,
+	Instance>;
 
 struct MulChain
 {
@@ -128,6 +136,32 @@ struct HyperbolicParaboloid
 	// TODO - add more parameters.
 };
 
+// Transformed copy of shared subtree.
+struct Reference
+{
+	// Name of definition in same file, prefixed with "#", or path to external scene file.
+	std::string source;
+	m_Vec3 center;
+	m_Vec3 angles_deg;
+	// Shared between all references to same subtree. May be null for unresolved reference.
+	std::shared_ptr<ReferenceTarget> target;
+};
+
+// Placement of single copy of instanced subtree.
+struct InstanceTransform
+{
+	m_Vec3 center;
+	m_Vec3 angles_deg;
+};
+
+// Union of elements, copied with each of given transforms.
+// Unlike arrays and references, surfaces of elements are built only once and shared between all copies.
+struct Instance
+{
+	std::vector<CSGTreeNode> elements;
+	std::vector<InstanceTransform> transforms;
+};
+
 } // namespace CSGTree
 
 } // namespac SZV
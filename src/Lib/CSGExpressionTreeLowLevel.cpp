@@ -1,6 +1,11 @@
 #include "CSGExpressionTreeLowLevel.hpp"
+#include "Assert.hpp"
+#include "CSGTreeReference.hpp"
+#include "Log.hpp"
 #include "Mat.hpp"
+#include "Profiler.hpp"
 #include <array>
+#include <unordered_map>
 
 namespace SZV
 {
@@ -173,118 +178,248 @@ BoundingBox TransformBoundingBox(const BoundingBox& bb, const m_Vec3& center, co
 	return res;
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTree_r(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::CSGTreeNode& node);
+// List of references from root to current node, allocated on stack. Used for detection of reference cycles.
+struct ReferencePath
+{
+	const void* target;
+	const ReferencePath* prev;
+};
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::MulChain& node)
+// Transformation from space of node into world space.
+struct NodeTransform
 {
-	if(node.elements.empty())
-		return TreeElementsLowLevel::OneLeaf{};
-	else if(node.elements.size() == 1u)
-		return BuildLowLevelTree_r(out_surfaces, shift, node.elements.front());
+	m_Vec3 shift;
+	// Rows of rotation matrix from world space into space of node, same as result of "GetTransformedBasis".
+	BasisVecs basis;
+	const ReferencePath* reference_path;
+};
 
-	TreeElementsLowLevel::Mul mul;
-	mul.l= std::make_unique<TreeElementsLowLevel::TreeElement>(BuildLowLevelTree_r(out_surfaces, shift, node.elements[0]));
-	mul.r= std::make_unique<TreeElementsLowLevel::TreeElement>(BuildLowLevelTree_r(out_surfaces, shift, node.elements[1]));
+const NodeTransform c_root_transform
+{
+	m_Vec3(0.0f, 0.0f, 0.0f),
+	{ m_Vec3(1.0f, 0.0f, 0.0f), m_Vec3(0.0f, 1.0f, 0.0f), m_Vec3(0.0f, 0.0f, 1.0f) },
+	nullptr,
+};
 
-	for (size_t i= 2u; i < node.elements.size(); ++i)
-	{
-		TreeElementsLowLevel::Mul mul_element;
-		mul_element.l= std::make_unique<TreeElementsLowLevel::TreeElement>(std::move(mul));
-		mul_element.r= std::make_unique<TreeElementsLowLevel::TreeElement>(BuildLowLevelTree_r(out_surfaces, shift, node.elements[i]));
-		mul= std::move(mul_element);
-	}
+m_Vec3 TransformVector(const NodeTransform& transform, const m_Vec3& v)
+{
+	return transform.basis[0] * v.x + transform.basis[1] * v.y + transform.basis[2] * v.z;
+}
 
-	return std::move(mul);
+m_Vec3 TransformPoint(const NodeTransform& transform, const m_Vec3& p)
+{
+	return TransformVector(transform, p) + transform.shift;
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::AddChain& node)
+BasisVecs TransformBasis(const NodeTransform& transform, const BasisVecs& basis)
 {
-	if(node.elements.empty())
-		return TreeElementsLowLevel::OneLeaf{};
-	else if(node.elements.size() == 1u)
-		return BuildLowLevelTree_r(out_surfaces, shift, node.elements.front());
+	return { TransformVector(transform, basis[0]), TransformVector(transform, basis[1]), TransformVector(transform, basis[2]) };
+}
 
-	TreeElementsLowLevel::Add add;
-	add.l= std::make_unique<TreeElementsLowLevel::TreeElement>(BuildLowLevelTree_r(out_surfaces, shift, node.elements[0]));
-	add.r= std::make_unique<TreeElementsLowLevel::TreeElement>(BuildLowLevelTree_r(out_surfaces, shift, node.elements[1]));
+const GPUTransform c_identity_gpu_transform
+{
+	m_Vec3(1.0f, 0.0f, 0.0f), m_Vec3(0.0f, 1.0f, 0.0f), m_Vec3(0.0f, 0.0f, 1.0f),
+	m_Vec3(0.0f, 0.0f, 0.0f),
+};
 
-	for (size_t i= 2u; i < node.elements.size(); ++i)
+// Apply node transform to result of given GPU transform.
+GPUTransform TransformGPUTransform(const NodeTransform& transform, const GPUTransform& gpu_transform)
+{
+	return
 	{
-		TreeElementsLowLevel::Add add_element;
-		add_element.l= std::make_unique<TreeElementsLowLevel::TreeElement>(std::move(add));
-		add_element.r= std::make_unique<TreeElementsLowLevel::TreeElement>(BuildLowLevelTree_r(out_surfaces, shift, node.elements[i]));
-		add= std::move(add_element);
-	}
+		TransformVector(transform, gpu_transform.x_vec),
+		TransformVector(transform, gpu_transform.y_vec),
+		TransformVector(transform, gpu_transform.z_vec),
+		TransformPoint(transform, gpu_transform.shift),
+	};
+}
 
-	return std::move(add);
+bool IsReferenceInPath(const ReferencePath* path, const void* const target)
+{
+	for(; path != nullptr; path= path->prev)
+	{
+		if(path->target == target)
+			return true;
+	}
+	return false;
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::SubChain& node)
+// Target of reference, built once in its own space, like instanced subtree.
+struct BuiltReferenceTarget
+{
+	TreeElementsLowLevel::TreeElement tree;
+	// Relative to space of target.
+	GPUTransformsVector transforms;
+	// Target is kept alive until end of build, so its address is not reused by another target.
+	std::shared_ptr<const void> keep_alive;
+};
+
+// Key is target of reference.
+using ReferenceCache= std::unordered_map<const void*, BuiltReferenceTarget>;
+
+// Transforms are relative to space, where surfaces are built - world space or space of instanced subtree.
+// Reference cache is shared by all spaces.
+struct BuildOutput
+{
+	GPUSurfacesVector& surfaces;
+	GPUTransformsVector& transforms;
+	ReferenceCache& reference_cache;
+};
+
+TreeElementsLowLevel::TreeElement BuildLowLevelTree_r(BuildOutput& out, const NodeTransform& transform, const CSGTree::CSGTreeNode& node);
+
+// Build left-associative chain of binary operations. Elements are built via given function, called for each element index.
+template<typename ChainElement, typename BuildElementFunc>
+TreeElementsLowLevel::TreeElement BuildChain(const size_t element_count, const BuildElementFunc& build_element)
 {
-	if(node.elements.empty())
+	if(element_count == 0u)
 		return TreeElementsLowLevel::OneLeaf{};
-	else if(node.elements.size() == 1u)
-		return BuildLowLevelTree_r(out_surfaces, shift, node.elements.front());
+	else if(element_count == 1u)
+		return build_element(0u);
 
-	TreeElementsLowLevel::Sub sub;
-	sub.l= std::make_unique<TreeElementsLowLevel::TreeElement>(BuildLowLevelTree_r(out_surfaces, shift, node.elements[0]));
-	sub.r= std::make_unique<TreeElementsLowLevel::TreeElement>(BuildLowLevelTree_r(out_surfaces, shift, node.elements[1]));
+	ChainElement chain;
+	chain.l= std::make_unique<TreeElementsLowLevel::TreeElement>(build_element(0u));
+	chain.r= std::make_unique<TreeElementsLowLevel::TreeElement>(build_element(1u));
 
-	for (size_t i= 2u; i < node.elements.size(); ++i)
+	for (size_t i= 2u; i < element_count; ++i)
 	{
-		TreeElementsLowLevel::Sub sub_element;
-		sub_element.l= std::make_unique<TreeElementsLowLevel::TreeElement>(std::move(sub));
-		sub_element.r= std::make_unique<TreeElementsLowLevel::TreeElement>(BuildLowLevelTree_r(out_surfaces, shift, node.elements[i]));
-		sub= std::move(sub_element);
+		ChainElement chain_element;
+		chain_element.l= std::make_unique<TreeElementsLowLevel::TreeElement>(std::move(chain));
+		chain_element.r= std::make_unique<TreeElementsLowLevel::TreeElement>(build_element(i));
+		chain= std::move(chain_element);
 	}
 
-	return std::move(sub);
+	return TreeElementsLowLevel::TreeElement(std::move(chain));
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::AddArray& node)
+const float c_infinite_size= 1.0e24f;
+
+// Tolerance of search of grid cells, in cells. Covers rounding errors of positions of cells.
+const float c_grid_cells_tolerance= 1.0f / 64.0f;
+
+BoundingBox UniteBoundingBoxes(const BoundingBox& l, const BoundingBox& r)
 {
-	TreeElementsLowLevel::Add add;
+	return
+	{
+		m_Vec3(std::min(l.min.x, r.min.x), std::min(l.min.y, r.min.y), std::min(l.min.z, r.min.z)),
+		m_Vec3(std::max(l.max.x, r.max.x), std::max(l.max.y, r.max.y), std::max(l.max.z, r.max.z)),
+	};
+}
 
-	BasisVecs basis= GetTransformedBasis(node.angles_deg);
-	basis[0]*= node.step.x;
-	basis[1]*= node.step.y;
-	basis[2]*= node.step.z;
+// Get box, outside which expression of node is always zero.
+BoundingBox GetTreeBoundingBox_r(const TreeElementsLowLevel::TreeElement& node)
+{
+	return std::visit(
+		[&](const auto& el) -> BoundingBox
+		{
+			using T= std::decay_t<decltype(el)>;
+			if constexpr(std::is_same_v<T, TreeElementsLowLevel::Leaf>)
+				return el.bb;
+			else if constexpr(std::is_same_v<T, TreeElementsLowLevel::OneLeaf>)
+				return { m_Vec3(-c_infinite_size, -c_infinite_size, -c_infinite_size), m_Vec3(c_infinite_size, c_infinite_size, c_infinite_size) };
+			else if constexpr(std::is_same_v<T, TreeElementsLowLevel::Add>)
+				return UniteBoundingBoxes(GetTreeBoundingBox_r(*el.l), GetTreeBoundingBox_r(*el.r));
+			else if constexpr(std::is_same_v<T, TreeElementsLowLevel::Grid>)
+			{
+				BoundingBox bb= el.cell_bb;
+				for(size_t i= 0u; i < 3u; ++i)
+				{
+					const m_Vec3 last_cell_shift= el.steps[i] * float(el.size[i] - 1u);
+					bb.min+= m_Vec3(std::min(last_cell_shift.x, 0.0f), std::min(last_cell_shift.y, 0.0f), std::min(last_cell_shift.z, 0.0f));
+					bb.max+= m_Vec3(std::max(last_cell_shift.x, 0.0f), std::max(last_cell_shift.y, 0.0f), std::max(last_cell_shift.z, 0.0f));
+				}
+				return bb;
+			}
+			else // Result of multiplication and subtraction is zero where left operand is zero.
+				return GetTreeBoundingBox_r(*el.l);
+		},
+		node);
+}
 
-	for(size_t x= 0; x < node.size[0]; ++x)
-	for(size_t y= 0; y < node.size[1]; ++y)
-	for(size_t z= 0; z < node.size[2]; ++z)
-	for (const CSGTree::CSGTreeNode& element_node : node.elements)
+// Build union of array elements as grid. Elements are built via given function, called for element index and element transform.
+template<typename BuildElementFunc>
+TreeElementsLowLevel::TreeElement BuildArray(
+	const NodeTransform& transform,
+	const uint8_t* const size,
+	const m_Vec3& step,
+	const m_Vec3& angles_deg,
+	const size_t element_count,
+	const BuildElementFunc& build_element)
+{
+	const size_t cell_count= size_t(size[0]) * size_t(size[1]) * size_t(size[2]);
+	if(cell_count == 0u || element_count == 0u)
+		return TreeElementsLowLevel::OneLeaf{};
+
+	BasisVecs basis= GetTransformedBasis(angles_deg);
+	basis[0]*= step.x;
+	basis[1]*= step.y;
+	basis[2]*= step.z;
+
+	TreeElementsLowLevel::Grid grid;
+	grid.cell_element_count= element_count;
+	for(size_t i= 0u; i < 3u; ++i)
+	{
+		grid.size[i]= size[i];
+		grid.steps[i]= TransformVector(transform, basis[i]);
+	}
+	grid.elements.reserve(cell_count * element_count);
+
+	for(size_t x= 0; x < size[0]; ++x)
+	for(size_t y= 0; y < size[1]; ++y)
+	for(size_t z= 0; z < size[2]; ++z)
+	for (size_t i= 0; i < element_count; ++i)
 	{
 		const m_Vec3 self_shift= basis[0] * float(x) + basis[1] * float(y) + basis[2] * float(z);
 
-		auto el= std::make_unique<TreeElementsLowLevel::TreeElement>(BuildLowLevelTree_r(out_surfaces, self_shift + shift, element_node));
+		NodeTransform element_transform= transform;
+		element_transform.shift= TransformPoint(transform, self_shift);
 
-		if(add.l == nullptr)
-			add.l= std::move(el);
-		else if(add.r == nullptr)
-			add.r= std::move(el);
-		else
-		{
-			TreeElementsLowLevel::Add add_element;
-			add_element.l= std::make_unique<TreeElementsLowLevel::TreeElement>(std::move(add));
-			add_element.r= std::move(el);
-			add= std::move(add_element);
-		}
+		grid.elements.push_back(build_element(i, element_transform));
 	}
 
-	if(add.l == nullptr && add.r == nullptr)
-		return TreeElementsLowLevel::OneLeaf{};
-	if(add.l == nullptr)
-		return std::move(*add.r);
-	if(add.r == nullptr)
-		return std::move(*add.l);
+	if(grid.elements.size() == 1u)
+		return std::move(grid.elements.front());
+
+	grid.cell_bb= GetTreeBoundingBox_r(grid.elements.front());
+	for(size_t i= 1u; i < element_count; ++i)
+		grid.cell_bb= UniteBoundingBoxes(grid.cell_bb, GetTreeBoundingBox_r(grid.elements[i]));
 
-	return std::move(add);
+	return TreeElementsLowLevel::TreeElement(std::move(grid));
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::Ellipsoid& node)
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::MulChain& node)
 {
-	const auto basis= GetTransformedBasis(node.angles_deg);
+	return BuildChain<TreeElementsLowLevel::Mul>(
+		node.elements.size(),
+		[&](const size_t i){ return BuildLowLevelTree_r(out, transform, node.elements[i]); });
+}
+
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::AddChain& node)
+{
+	return BuildChain<TreeElementsLowLevel::Add>(
+		node.elements.size(),
+		[&](const size_t i){ return BuildLowLevelTree_r(out, transform, node.elements[i]); });
+}
+
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::SubChain& node)
+{
+	return BuildChain<TreeElementsLowLevel::Sub>(
+		node.elements.size(),
+		[&](const size_t i){ return BuildLowLevelTree_r(out, transform, node.elements[i]); });
+}
+
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::AddArray& node)
+{
+	return BuildArray(
+		transform, node.size, node.step, node.angles_deg,
+		node.elements.size(),
+		[&](const size_t i, const NodeTransform& element_transform){ return BuildLowLevelTree_r(out, element_transform, node.elements[i]); });
+}
+
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::Ellipsoid& node)
+{
+	const auto basis= TransformBasis(transform, GetTransformedBasis(node.angles_deg));
+	const m_Vec3 center= TransformPoint(transform, node.center);
 
 	GPUSurface surface{};
 	surface.xx= 4.0f / (node.size.x * node.size.x);
@@ -294,23 +429,24 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 	surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 	surface.vec1= m_Vec3(0.0f, 0.0f, 1.0f);
 
-	const size_t surface_index= out_surfaces.size();
-	out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+	const size_t surface_index= out.surfaces.size();
+	out.surfaces.push_back(TransformSurface(surface, center, basis));
 
 	const BoundingBox bb{ -node.size * 0.5f, node.size * 0.5f };
 
 	TreeElementsLowLevel::Leaf leaf;
 	leaf.surface_index= surface_index;
-	leaf.bb= TransformBoundingBox(bb, node.center + shift, basis);
+	leaf.bb= TransformBoundingBox(bb, center, basis);
 	return leaf;
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::Box& node)
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::Box& node)
 {
-	const auto basis= GetTransformedBasis(node.angles_deg);
+	const auto basis= TransformBasis(transform, GetTransformedBasis(node.angles_deg));
+	const m_Vec3 center= TransformPoint(transform, node.center);
 
 	// Represent three pairs of parallel planes of box using three quadratic surfaces.
-	const size_t surface_index= out_surfaces.size();
+	const size_t surface_index= out.surfaces.size();
 
 	{
 		GPUSurface surface{};
@@ -318,7 +454,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.25f * node.size.x * node.size.x;
 		surface.vec0= m_Vec3(0.0f, 1.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 0.0f, 1.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 	{
 		GPUSurface surface{};
@@ -326,7 +462,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.25f * node.size.y * node.size.y;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 0.0f, 1.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 	{
 		GPUSurface surface{};
@@ -334,11 +470,11 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.25f * node.size.z * node.size.z;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 1.0f, 0.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 
 	const BoundingBox bb{ -node.size * 0.5f, node.size * 0.5f };
-	const BoundingBox bb_transformed= TransformBoundingBox(bb, node.center + shift, basis);
+	const BoundingBox bb_transformed= TransformBoundingBox(bb, center, basis);
 
 	TreeElementsLowLevel::Leaf leafs[3];
 	for (size_t i= 0u; i < 3u; ++i)
@@ -359,11 +495,12 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 	};
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::Cylinder& node)
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::Cylinder& node)
 {
-	const auto basis= GetTransformedBasis(node.angles_deg);
+	const auto basis= TransformBasis(transform, GetTransformedBasis(node.angles_deg));
+	const m_Vec3 center= TransformPoint(transform, node.center);
 
-	const size_t surface_index= out_surfaces.size();
+	const size_t surface_index= out.surfaces.size();
 
 	{
 		GPUSurface surface{};
@@ -372,7 +509,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -1.0f;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 0.0f, 1.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 	{
 		GPUSurface surface{};
@@ -380,11 +517,11 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.25f * node.size.z * node.size.z;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 1.0f, 0.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 
 	const BoundingBox bb{ -node.size * 0.5f, node.size * 0.5f };
-	const BoundingBox bb_transformed= TransformBoundingBox(bb, node.center + shift, basis);
+	const BoundingBox bb_transformed= TransformBoundingBox(bb, center, basis);
 
 	TreeElementsLowLevel::Leaf leafs[2];
 	for (size_t i= 0u; i < 2u; ++i)
@@ -400,11 +537,12 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 	};
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::Cone& node)
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::Cone& node)
 {
-	const auto basis= GetTransformedBasis(node.angles_deg);
+	const auto basis= TransformBasis(transform, GetTransformedBasis(node.angles_deg));
+	const m_Vec3 center= TransformPoint(transform, node.center);
 
-	const size_t surface_index= out_surfaces.size();
+	const size_t surface_index= out.surfaces.size();
 
 	const float square_z= node.size.z * node.size.z;
 	const float k= -0.25f * square_z;
@@ -418,7 +556,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= k;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 0.0f, 1.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 	{
 		GPUSurface surface{};
@@ -426,11 +564,11 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= k;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 1.0f, 0.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 
 	const BoundingBox bb{ -node.size * 0.5f, node.size * 0.5f };
-	const BoundingBox bb_transformed= TransformBoundingBox(bb, node.center + shift, basis);
+	const BoundingBox bb_transformed= TransformBoundingBox(bb, center, basis);
 
 	TreeElementsLowLevel::Leaf leafs[2];
 	for (size_t i= 0u; i < 2u; ++i)
@@ -446,11 +584,12 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 	};
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::Paraboloid& node)
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::Paraboloid& node)
 {
-	const auto basis= GetTransformedBasis(node.angles_deg);
+	const auto basis= TransformBasis(transform, GetTransformedBasis(node.angles_deg));
+	const m_Vec3 center= TransformPoint(transform, node.center);
 
-	const size_t surface_index= out_surfaces.size();
+	const size_t surface_index= out.surfaces.size();
 
 	{
 		GPUSurface surface{};
@@ -461,7 +600,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.5f * node.size.z;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 0.0f, 1.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 	{
 		GPUSurface surface{};
@@ -469,11 +608,11 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.5f * node.size.z;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 1.0f, 0.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 
 	const BoundingBox bb{ -node.size * 0.5f, node.size * 0.5f };
-	const BoundingBox bb_transformed= TransformBoundingBox(bb, node.center + shift, basis);
+	const BoundingBox bb_transformed= TransformBoundingBox(bb, center, basis);
 
 	TreeElementsLowLevel::Leaf leafs[2];
 	for (size_t i= 0u; i < 2u; ++i)
@@ -489,11 +628,12 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 	};
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::Hyperboloid& node)
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::Hyperboloid& node)
 {
-	const auto basis= GetTransformedBasis(node.angles_deg);
+	const auto basis= TransformBasis(transform, GetTransformedBasis(node.angles_deg));
+	const m_Vec3 center= TransformPoint(transform, node.center);
 
-	const size_t surface_index= out_surfaces.size();
+	const size_t surface_index= out.surfaces.size();
 
 	const float square_z= node.size.z * node.size.z;
 	{
@@ -506,7 +646,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= k;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 0.0f, 1.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 	{
 		GPUSurface surface{};
@@ -514,11 +654,11 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.25f * square_z;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 1.0f, 0.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 
 	const BoundingBox bb{ -node.size * 0.5f, node.size * 0.5f };
-	const BoundingBox bb_transformed= TransformBoundingBox(bb, node.center + shift, basis);
+	const BoundingBox bb_transformed= TransformBoundingBox(bb, center, basis);
 
 	TreeElementsLowLevel::Leaf leafs[2];
 	for (size_t i= 0u; i < 2u; ++i)
@@ -534,11 +674,12 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 	};
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::ParabolicCylinder& node)
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::ParabolicCylinder& node)
 {
-	const auto basis= GetTransformedBasis(node.angles_deg);
+	const auto basis= TransformBasis(transform, GetTransformedBasis(node.angles_deg));
+	const m_Vec3 center= TransformPoint(transform, node.center);
 
-	const size_t surface_index= out_surfaces.size();
+	const size_t surface_index= out.surfaces.size();
 
 	// Parabolic surface.
 	{
@@ -548,7 +689,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.5f * node.size.z;
 		surface.vec0= m_Vec3(0.0f, 1.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 0.0f, 1.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 	// Upper bounding plane.
 	{
@@ -557,7 +698,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.5f * node.size.z;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 1.0f, 0.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 	// Pair of side bounding planes.
 	{
@@ -566,11 +707,11 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.25f * node.size.y * node.size.y;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 0.0f, 1.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 
 	const BoundingBox bb{ -node.size * 0.5f, node.size * 0.5f };
-	const BoundingBox bb_transformed= TransformBoundingBox(bb, node.center + shift, basis);
+	const BoundingBox bb_transformed= TransformBoundingBox(bb, center, basis);
 
 	TreeElementsLowLevel::Leaf leafs[3];
 	for (size_t i= 0u; i < 3u; ++i)
@@ -591,11 +732,12 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 	};
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::HyperbolicCylinder& node)
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::HyperbolicCylinder& node)
 {
-	const auto basis= GetTransformedBasis(node.angles_deg);
+	const auto basis= TransformBasis(transform, GetTransformedBasis(node.angles_deg));
+	const m_Vec3 center= TransformPoint(transform, node.center);
 
-	const size_t surface_index= out_surfaces.size();
+	const size_t surface_index= out.surfaces.size();
 
 	const float square_z= node.size.z * node.size.z;
 	{
@@ -607,7 +749,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= k;
 		surface.vec0= m_Vec3(0.0f, 1.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 0.0f, 1.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 	// Pair of top and bottom bounding planes.
 	{
@@ -616,7 +758,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.25f * square_z;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 1.0f, 0.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 	// Pair of side bounding planes.
 	{
@@ -625,11 +767,11 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.25f * node.size.y * node.size.y;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 0.0f, 1.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 
 	const BoundingBox bb{ -node.size * 0.5f, node.size * 0.5f };
-	const BoundingBox bb_transformed= TransformBoundingBox(bb, node.center + shift, basis);
+	const BoundingBox bb_transformed= TransformBoundingBox(bb, center, basis);
 
 	TreeElementsLowLevel::Leaf leafs[3];
 	for (size_t i= 0u; i < 3u; ++i)
@@ -650,11 +792,12 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 	};
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::HyperbolicParaboloid& node)
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::HyperbolicParaboloid& node)
 {
-	const auto basis= GetTransformedBasis(node.angles_deg);
+	const auto basis= TransformBasis(transform, GetTransformedBasis(node.angles_deg));
+	const m_Vec3 center= TransformPoint(transform, node.center);
 
-	const size_t surface_index= out_surfaces.size();
+	const size_t surface_index= out.surfaces.size();
 
 	{ // Hyperbolic paraboloid itself.
 		GPUSurface surface{};
@@ -663,7 +806,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.z= 1.0f;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 1.0f, 0.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 	{ // Pair of bounding planes.
 		GPUSurface surface{};
@@ -671,7 +814,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.5f * node.height;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 0.0f, 1.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 	{ // Single bounding plane.
 		GPUSurface surface{};
@@ -679,7 +822,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		surface.k= -0.5f * node.height;
 		surface.vec0= m_Vec3(1.0f, 0.0f, 0.0f);
 		surface.vec1= m_Vec3(0.0f, 1.0f, 0.0f);
-		out_surfaces.push_back(TransformSurface(surface, node.center + shift, basis));
+		out.surfaces.push_back(TransformSurface(surface, center, basis));
 	}
 
 	const float half_size_x= std::sqrt(node.height);
@@ -689,7 +832,7 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 		{ -half_size_x, -half_size_y, -0.5f * node.height },
 		{ +half_size_x, +half_size_y, +0.5f * node.height },
 	};
-	const BoundingBox bb_transformed= TransformBoundingBox(bb, node.center + shift, basis);
+	const BoundingBox bb_transformed= TransformBoundingBox(bb, center, basis);
 
 	TreeElementsLowLevel::Leaf leafs[3];
 	for (size_t i= 0u; i < 3u; ++i)
@@ -710,21 +853,376 @@ TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(GPUSurfacesVector&
 	};
 }
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTree_r(GPUSurfacesVector& out_surfaces, const m_Vec3& shift, const CSGTree::CSGTreeNode& node)
+// Copy tree of instanced subtree for single instance. Surfaces are not copied, only bounding boxes and transform indices are changed.
+TreeElementsLowLevel::TreeElement InstantiateTree_r(
+	const TreeElementsLowLevel::TreeElement& node,
+	const NodeTransform& transform,
+	const size_t transforms_offset)
+{
+	return std::visit(
+		[&](const auto& el)
+		{
+			using T= std::decay_t<decltype(el)>;
+			if constexpr(std::is_same_v<T, TreeElementsLowLevel::Leaf>)
+			{
+				TreeElementsLowLevel::Leaf leaf;
+				leaf.surface_index= el.surface_index;
+				leaf.bb= TransformBoundingBox(el.bb, transform.shift, transform.basis);
+				leaf.transform_index= transforms_offset + el.transform_index;
+				return TreeElementsLowLevel::TreeElement(leaf);
+			}
+			else if constexpr(std::is_same_v<T, TreeElementsLowLevel::OneLeaf>)
+				return TreeElementsLowLevel::TreeElement(TreeElementsLowLevel::OneLeaf{});
+			else if constexpr(std::is_same_v<T, TreeElementsLowLevel::Grid>)
+			{
+				TreeElementsLowLevel::Grid grid;
+				grid.elements.reserve(el.elements.size());
+				for(const TreeElementsLowLevel::TreeElement& element : el.elements)
+					grid.elements.push_back(InstantiateTree_r(element, transform, transforms_offset));
+				grid.cell_element_count= el.cell_element_count;
+				for(size_t i= 0u; i < 3u; ++i)
+				{
+					grid.size[i]= el.size[i];
+					grid.steps[i]= TransformVector(transform, el.steps[i]);
+				}
+				grid.cell_bb= TransformBoundingBox(el.cell_bb, transform.shift, transform.basis);
+				return TreeElementsLowLevel::TreeElement(std::move(grid));
+			}
+			else
+			{
+				T res;
+				res.l= std::make_unique<TreeElementsLowLevel::TreeElement>(InstantiateTree_r(*el.l, transform, transforms_offset));
+				res.r= std::make_unique<TreeElementsLowLevel::TreeElement>(InstantiateTree_r(*el.r, transform, transforms_offset));
+				return TreeElementsLowLevel::TreeElement(std::move(res));
+			}
+		},
+		node);
+}
+
+// Copy subtree, built in its own space, into space of given output. Transforms of subtree are added into output.
+TreeElementsLowLevel::TreeElement InstantiateSubtree(
+	BuildOutput& out,
+	const TreeElementsLowLevel::TreeElement& subtree,
+	const GPUTransformsVector& subtree_transforms,
+	const NodeTransform& instance_transform)
+{
+	const size_t transforms_offset= out.transforms.size();
+	for(const GPUTransform& subtree_gpu_transform : subtree_transforms)
+		out.transforms.push_back(TransformGPUTransform(instance_transform, subtree_gpu_transform));
+
+	return InstantiateTree_r(subtree, instance_transform, transforms_offset);
+}
+
+// Build subtree only once, in its own space, via given function, called for output and transform of subtree.
+// Then create union of its copies, one for each transform, obtained via given function.
+template<typename GetInstanceTransformFunc, typename BuildSubtreeFunc>
+TreeElementsLowLevel::TreeElement BuildInstance(
+	BuildOutput& out,
+	const NodeTransform& transform,
+	const size_t instance_count,
+	const GetInstanceTransformFunc& get_instance_transform,
+	const BuildSubtreeFunc& build_subtree)
+{
+	if(instance_count == 0u)
+		return TreeElementsLowLevel::OneLeaf{};
+
+	// Instances inside subtree produce own transforms, relative to space of subtree.
+	GPUTransformsVector subtree_transforms{ c_identity_gpu_transform };
+	BuildOutput subtree_out{ out.surfaces, subtree_transforms, out.reference_cache };
+
+	NodeTransform subtree_transform= c_root_transform;
+	subtree_transform.reference_path= transform.reference_path;
+
+	const TreeElementsLowLevel::TreeElement subtree= build_subtree(subtree_out, subtree_transform);
+
+	return BuildChain<TreeElementsLowLevel::Add>(
+		instance_count,
+		[&](const size_t i)
+		{
+			const CSGTree::InstanceTransform instance= get_instance_transform(i);
+
+			NodeTransform instance_transform;
+			instance_transform.shift= TransformPoint(transform, instance.center);
+			instance_transform.basis= TransformBasis(transform, GetTransformedBasis(instance.angles_deg));
+			instance_transform.reference_path= transform.reference_path;
+
+			return InstantiateSubtree(out, subtree, subtree_transforms, instance_transform);
+		});
+}
+
+// Build target of reference via given function, called for output and transform of target.
+// Target is built only once, in its own space, and each reference to it is its instance.
+// So target, shared by many references, produces its surfaces only once.
+template<typename BuildTargetFunc>
+TreeElementsLowLevel::TreeElement BuildReference(
+	BuildOutput& out,
+	const NodeTransform& transform,
+	const m_Vec3& center,
+	const m_Vec3& angles_deg,
+	const void* const target,
+	std::shared_ptr<const void> target_keep_alive,
+	const BuildTargetFunc& build_target)
+{
+	if(IsReferenceInPath(transform.reference_path, target))
+	{
+		Log::Warning("Cycle of references detected");
+		return TreeElementsLowLevel::OneLeaf{};
+	}
+
+	auto it= out.reference_cache.find(target);
+	if(it == out.reference_cache.end())
+	{
+		const ReferencePath reference_path{ target, transform.reference_path };
+
+		NodeTransform target_transform= c_root_transform;
+		target_transform.reference_path= &reference_path;
+
+		BuiltReferenceTarget built;
+		built.transforms.push_back(c_identity_gpu_transform);
+		BuildOutput target_out{ out.surfaces, built.transforms, out.reference_cache };
+		built.tree= build_target(target_out, target_transform);
+		built.keep_alive= std::move(target_keep_alive);
+
+		it= out.reference_cache.emplace(target, std::move(built)).first;
+	}
+
+	NodeTransform instance_transform;
+	instance_transform.shift= TransformPoint(transform, center);
+	instance_transform.basis= TransformBasis(transform, GetTransformedBasis(angles_deg));
+	instance_transform.reference_path= transform.reference_path;
+
+	return InstantiateSubtree(out, it->second.tree, it->second.transforms, instance_transform);
+}
+
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::Instance& node)
+{
+	return BuildInstance(
+		out, transform,
+		node.transforms.size(),
+		[&](const size_t i){ return node.transforms[i]; },
+		[&](BuildOutput& subtree_out, const NodeTransform& subtree_transform)
+		{
+			return BuildChain<TreeElementsLowLevel::Add>(
+				node.elements.size(),
+				[&](const size_t i){ return BuildLowLevelTree_r(subtree_out, subtree_transform, node.elements[i]); });
+		});
+}
+
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeNode_impl(BuildOutput& out, const NodeTransform& transform, const CSGTree::Reference& node)
+{
+	// Unresolved reference is the same as empty "add" node.
+	if(node.target == nullptr)
+		return TreeElementsLowLevel::OneLeaf{};
+
+	return BuildReference(
+		out, transform, node.center, node.angles_deg, node.target.get(), node.target,
+		[&](BuildOutput& target_out, const NodeTransform& target_transform)
+		{
+			return BuildLowLevelTree_r(target_out, target_transform, node.target->GetNode());
+		});
+}
+
+TreeElementsLowLevel::TreeElement BuildLowLevelTree_r(BuildOutput& out, const NodeTransform& transform, const CSGTree::CSGTreeNode& node)
 {
 	return std::visit(
 		[&](const auto& el)
 		{
-			return BuildLowLevelTreeNode_impl(out_surfaces, shift, el);
+			return BuildLowLevelTreeNode_impl(out, transform, el);
 		},
 		node);
 }
 
+TreeElementsLowLevel::TreeElement BuildLowLevelTreeBinary_r(
+	BuildOutput& out,
+	const NodeTransform& transform,
+	const CSGTreeBinaryView& view,
+	const std::string& base_directory,
+	const uint32_t index)
+{
+	using CSGTreeBinary::NodeType;
+	using CSGTreeBinary::ReadLeafNode;
+
+	const CSGTreeBinary::Node& node= view.GetNode(index);
+	const auto build_element=
+		[&](const size_t i){ return BuildLowLevelTreeBinary_r(out, transform, view, base_directory, node.first_child + uint32_t(i)); };
+
+	switch(node.type)
+	{
+	case NodeType::MulChain:
+		return BuildChain<TreeElementsLowLevel::Mul>(node.child_count, build_element);
+	case NodeType::AddChain:
+		return BuildChain<TreeElementsLowLevel::Add>(node.child_count, build_element);
+	case NodeType::SubChain:
+		return BuildChain<TreeElementsLowLevel::Sub>(node.child_count, build_element);
+	case NodeType::AddArray:
+		return BuildArray(
+			transform,
+			node.array_size,
+			m_Vec3(node.center[0], node.center[1], node.center[2]),
+			m_Vec3(node.angles_deg[0], node.angles_deg[1], node.angles_deg[2]),
+			node.child_count,
+			[&](const size_t i, const NodeTransform& element_transform)
+			{
+				return BuildLowLevelTreeBinary_r(out, element_transform, view, base_directory, node.first_child + uint32_t(i));
+			});
+	case NodeType::Ellipsoid:
+		return BuildLowLevelTreeNode_impl(out, transform, ReadLeafNode<CSGTree::Ellipsoid>(node));
+	case NodeType::Box:
+		return BuildLowLevelTreeNode_impl(out, transform, ReadLeafNode<CSGTree::Box>(node));
+	case NodeType::Cylinder:
+		return BuildLowLevelTreeNode_impl(out, transform, ReadLeafNode<CSGTree::Cylinder>(node));
+	case NodeType::Cone:
+		return BuildLowLevelTreeNode_impl(out, transform, ReadLeafNode<CSGTree::Cone>(node));
+	case NodeType::Paraboloid:
+		return BuildLowLevelTreeNode_impl(out, transform, ReadLeafNode<CSGTree::Paraboloid>(node));
+	case NodeType::Hyperboloid:
+		return BuildLowLevelTreeNode_impl(out, transform, ReadLeafNode<CSGTree::Hyperboloid>(node));
+	case NodeType::ParabolicCylinder:
+		return BuildLowLevelTreeNode_impl(out, transform, ReadLeafNode<CSGTree::ParabolicCylinder>(node));
+	case NodeType::HyperbolicCylinder:
+		return BuildLowLevelTreeNode_impl(out, transform, ReadLeafNode<CSGTree::HyperbolicCylinder>(node));
+	case NodeType::HyperbolicParaboloid:
+		return BuildLowLevelTreeNode_impl(out, transform, ReadLeafNode<CSGTree::HyperbolicParaboloid>(node));
+	case NodeType::Reference:
+		if(node.child_count != 0u)
+		{
+			// Definition in same file - build its nodes directly.
+			return BuildReference(
+				out,
+				transform,
+				m_Vec3(node.center[0], node.center[1], node.center[2]),
+				m_Vec3(node.angles_deg[0], node.angles_deg[1], node.angles_deg[2]),
+				&view.GetNode(node.first_child),
+				nullptr, // View lives longer than build.
+				[&](BuildOutput& target_out, const NodeTransform& target_transform)
+				{
+					return BuildLowLevelTreeBinary_r(target_out, target_transform, view, base_directory, node.first_child);
+				});
+		}
+		else
+		{
+			const std::string source= view.GetString(node.source_offset);
+			// Unresolved reference is the same as empty "add" node.
+			if(IsDefinitionReferenceSource(source))
+				return TreeElementsLowLevel::OneLeaf{};
+
+			const std::shared_ptr<CSGTree::ReferenceTarget> target= GetExternalReferenceTarget(source, base_directory);
+			return BuildReference(
+				out,
+				transform,
+				m_Vec3(node.center[0], node.center[1], node.center[2]),
+				m_Vec3(node.angles_deg[0], node.angles_deg[1], node.angles_deg[2]),
+				target.get(),
+				target,
+				[&](BuildOutput& target_out, const NodeTransform& target_transform)
+				{
+					return BuildLowLevelTree_r(target_out, target_transform, target->GetNode());
+				});
+		}
+	case NodeType::Instance:
+		{
+			// Transforms are stored after elements.
+			const uint32_t element_count= node.child_count - node.transform_count;
+			const uint32_t first_transform= node.first_child + element_count;
+			return BuildInstance(
+				out, transform,
+				node.transform_count,
+				[&](const size_t i)
+				{
+					const CSGTreeBinary::Node& transform_node= view.GetNode(first_transform + uint32_t(i));
+					return CSGTree::InstanceTransform
+					{
+						m_Vec3(transform_node.center[0], transform_node.center[1], transform_node.center[2]),
+						m_Vec3(transform_node.angles_deg[0], transform_node.angles_deg[1], transform_node.angles_deg[2]),
+					};
+				},
+				[&](BuildOutput& subtree_out, const NodeTransform& subtree_transform)
+				{
+					return BuildChain<TreeElementsLowLevel::Add>(
+						element_count,
+						[&](const size_t i)
+						{
+							return BuildLowLevelTreeBinary_r(subtree_out, subtree_transform, view, base_directory, node.first_child + uint32_t(i));
+						});
+				});
+		}
+	case NodeType::InstanceTransform: // Transforms are read together with instance.
+	case NodeType::NumTypes:
+		break;
+	}
+
+	SZV_ASSERT(false); // Types are checked in view constructor.
+	return TreeElementsLowLevel::OneLeaf{};
+}
+
 } // namespace
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTree(GPUSurfacesVector& out_surfaces, const CSGTree::CSGTreeNode& root)
+TreeElementsLowLevel::TreeElement BuildLowLevelTree(GPUSurfacesVector& out_surfaces, GPUTransformsVector& out_transforms, const CSGTree::CSGTreeNode& root)
+{
+	SZV_PROFILE_FUNCTION();
+	if(out_transforms.empty())
+		out_transforms.push_back(c_identity_gpu_transform);
+
+	ReferenceCache reference_cache;
+	BuildOutput out{ out_surfaces, out_transforms, reference_cache };
+	return BuildLowLevelTree_r(out, c_root_transform, root);
+}
+
+TreeElementsLowLevel::TreeElement BuildLowLevelTree(
+	GPUSurfacesVector& out_surfaces,
+	GPUTransformsVector& out_transforms,
+	const CSGTreeBinaryView& view,
+	const std::string& base_directory)
+{
+	SZV_PROFILE_FUNCTION();
+	if(out_transforms.empty())
+		out_transforms.push_back(c_identity_gpu_transform);
+
+	if(view.IsEmpty())
+		return TreeElementsLowLevel::OneLeaf{};
+
+	ReferenceCache reference_cache;
+	BuildOutput out{ out_surfaces, out_transforms, reference_cache };
+	return BuildLowLevelTreeBinary_r(out, c_root_transform, view, base_directory, 0u);
+}
+
+void GetGridCellsRange(const TreeElementsLowLevel::Grid& grid, const BoundingBox& bb, size_t out_begin[3], size_t out_end[3])
+{
+	// Cell intersects given box if shift of cell is inside this box.
+	const m_Vec3 shift_min= bb.min - grid.cell_bb.max;
+	const m_Vec3 shift_max= bb.max - grid.cell_bb.min;
+	const m_Vec3 center= (shift_min + shift_max) * 0.5f;
+	const m_Vec3 half_size= (shift_max - shift_min) * 0.5f;
+
+	for(size_t i= 0u; i < 3u; ++i)
+	{
+		out_begin[i]= 0u;
+		out_end[i]= grid.size[i];
+
+		// Steps are perpendicular, so cell coordinate is projection of shift onto step.
+		const m_Vec3& step= grid.steps[i];
+		const float step_square_length= mVec3Dot(step, step);
+		if(!(step_square_length > 0.0f))
+			continue;
+
+		const float center_coord= mVec3Dot(center, step) / step_square_length;
+		const float half_size_coord=
+			(std::abs(step.x) * half_size.x + std::abs(step.y) * half_size.y + std::abs(step.z) * half_size.z) / step_square_length +
+			c_grid_cells_tolerance;
+		const float min_coord= center_coord - half_size_coord;
+		const float max_coord= center_coord + half_size_coord;
+		if(!(min_coord <= max_coord))
+			continue;
+
+		const float size_f= float(grid.size[i]);
+		out_begin[i]= size_t(std::max(0.0f, std::min(std::ceil(min_coord), size_f)));
+		out_end[i]= size_t(std::max(0.0f, std::min(std::floor(max_coord) + 1.0f, size_f)));
+	}
+}
+
+GPUSurface GetWorldSpaceSurface(const GPUSurface& surface, const GPUTransform& transform)
 {
-	return BuildLowLevelTree_r(out_surfaces, m_Vec3(0.0f, 0.0f, 0.0f), root);
+	return TransformSurface(surface, transform.shift, { transform.x_vec, transform.y_vec, transform.z_vec });
 }
 
 } // namespace SZV
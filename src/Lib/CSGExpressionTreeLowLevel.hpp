@@ -1,8 +1,10 @@
 #pragma once
 #include "Vec.hpp"
 #include "CSGExpressionTree.hpp"
+#include "CSGTreeBinary.hpp"
 #include <memory>
 #include <variant>
+#include <vector>
 
 namespace SZV
 {
@@ -19,18 +21,22 @@ namespace TreeElementsLowLevel
 struct Add;
 struct Mul;
 struct Sub;
+struct Grid;
 struct OneLeaf{};
 
 struct Leaf
 {
 	size_t surface_index;
-	BoundingBox bb;
+	BoundingBox bb; // In world space.
+	// Transformation of surface into world space. Zero means identity - surface is already in world space.
+	size_t transform_index= 0u;
 };
 
 using TreeElement= std::variant<
 	Add,
 	Mul,
 	Sub,
+	Grid,
 	Leaf,
 	OneLeaf >;
 
@@ -52,6 +58,20 @@ struct Sub
 	std::unique_ptr<TreeElement> r;
 };
 
+// Union of elements, placed in cells of regular grid. Elements of each cell are translated copies of elements of first cell.
+// Grid allows to find elements near given box without visiting all elements.
+struct Grid
+{
+	// Elements of all cells. Cells are ordered by x, y, z, each cell contains "cell_element_count" elements.
+	std::vector<TreeElement> elements;
+	size_t cell_element_count= 0u;
+	size_t size[3]{};
+	// Shifts between neighbour cells along grid axes in world space. Should be perpendicular.
+	m_Vec3 steps[3];
+	// Bounding box of elements of first cell in world space.
+	BoundingBox cell_bb;
+};
+
 } // namespace TreeElementsLowLevel
 
 struct GPUSurface
@@ -73,6 +93,33 @@ static_assert(sizeof(GPUSurface) == sizeof(float) * 16, "Invalid size");
 
 using GPUSurfacesVector= std::vector<GPUSurface>;
 
-TreeElementsLowLevel::TreeElement BuildLowLevelTree(GPUSurfacesVector& out_surfaces, const CSGTree::CSGTreeNode& root);
+// Rigid transformation of instance from its own space into world space.
+// Surfaces of instanced subtree or of reference target are stored once, in space of subtree, and are transformed via this.
+struct GPUTransform
+{
+	// Axes of instance space in world space.
+	m_Vec3 x_vec, y_vec, z_vec;
+	// Origin of instance space in world space.
+	m_Vec3 shift;
+};
+static_assert(sizeof(GPUTransform) == sizeof(float) * 12, "Invalid size");
+
+using GPUTransformsVector= std::vector<GPUTransform>;
+
+// Transforms list always starts with identity transform. If given list is empty, identity transform is added.
+TreeElementsLowLevel::TreeElement BuildLowLevelTree(GPUSurfacesVector& out_surfaces, GPUTransformsVector& out_transforms, const CSGTree::CSGTreeNode& root);
+// Build directly from serialized tree, without creation of intermediate tree nodes.
+// Relative paths of external references are resolved against given directory.
+TreeElementsLowLevel::TreeElement BuildLowLevelTree(
+	GPUSurfacesVector& out_surfaces,
+	GPUTransformsVector& out_transforms,
+	const CSGTreeBinaryView& view,
+	const std::string& base_directory= "");
+
+// Get range of grid cells, which elements may intersect given box. Range is [begin; end).
+void GetGridCellsRange(const TreeElementsLowLevel::Grid& grid, const BoundingBox& bb, size_t out_begin[3], size_t out_end[3]);
+
+// Get coefficients of surface, transformed into world space.
+GPUSurface GetWorldSpaceSurface(const GPUSurface& surface, const GPUTransform& transform);
 
 } // namespace SZV
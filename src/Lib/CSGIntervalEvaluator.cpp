@@ -0,0 +1,475 @@
+#include "CSGIntervalEvaluator.hpp"
+#include "Assert.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace SZV
+{
+
+namespace
+{
+
+void FlattenTree_r(CSGFlatTree& tree, const GPUSurfacesVector& surfaces, const GPUTransformsVector& transforms, const TreeElementsLowLevel::TreeElement& node);
+
+template<typename T>
+void FlattenBinaryNode(CSGFlatTree& tree, const GPUSurfacesVector& surfaces, const GPUTransformsVector& transforms, const T& node, const CSGFlatExpressionOp::Code code)
+{
+	FlattenTree_r(tree, surfaces, transforms, *node.l);
+	FlattenTree_r(tree, surfaces, transforms, *node.r);
+	tree.expression.push_back(CSGFlatExpressionOp{ code, 0u });
+}
+
+void FlattenTreeNode_impl(CSGFlatTree& tree, const GPUSurfacesVector& surfaces, const GPUTransformsVector& transforms, const TreeElementsLowLevel::Mul& node)
+{
+	FlattenBinaryNode(tree, surfaces, transforms, node, CSGFlatExpressionOp::Code::Mul);
+}
+
+void FlattenTreeNode_impl(CSGFlatTree& tree, const GPUSurfacesVector& surfaces, const GPUTransformsVector& transforms, const TreeElementsLowLevel::Add& node)
+{
+	FlattenBinaryNode(tree, surfaces, transforms, node, CSGFlatExpressionOp::Code::Add);
+}
+
+void FlattenTreeNode_impl(CSGFlatTree& tree, const GPUSurfacesVector& surfaces, const GPUTransformsVector& transforms, const TreeElementsLowLevel::Sub& node)
+{
+	FlattenBinaryNode(tree, surfaces, transforms, node, CSGFlatExpressionOp::Code::Sub);
+}
+
+void FlattenTreeNode_impl(CSGFlatTree& tree, const GPUSurfacesVector& surfaces, const GPUTransformsVector& transforms, const TreeElementsLowLevel::Grid& node)
+{
+	// Flatten as left-associative chain of additions.
+	for(size_t i= 0u; i < node.elements.size(); ++i)
+	{
+		FlattenTree_r(tree, surfaces, transforms, node.elements[i]);
+		if(i > 0u)
+			tree.expression.push_back(CSGFlatExpressionOp{ CSGFlatExpressionOp::Code::Add, 0u });
+	}
+}
+
+void FlattenTreeNode_impl(CSGFlatTree& tree, const GPUSurfacesVector& surfaces, const GPUTransformsVector& transforms, const TreeElementsLowLevel::Leaf& node)
+{
+	tree.expression.push_back(CSGFlatExpressionOp{ CSGFlatExpressionOp::Code::Leaf, uint32_t(tree.leafs.size()) });
+	const GPUSurface& surface= surfaces[node.surface_index];
+	tree.leafs.push_back(
+		CSGFlatLeaf
+		{
+			node.transform_index == 0u ? surface : GetWorldSpaceSurface(surface, transforms[node.transform_index]),
+			node.bb,
+		});
+}
+
+void FlattenTreeNode_impl(CSGFlatTree& tree, const GPUSurfacesVector&, const GPUTransformsVector&, const TreeElementsLowLevel::OneLeaf&)
+{
+	tree.expression.push_back(CSGFlatExpressionOp{ CSGFlatExpressionOp::Code::OneLeaf, 0u });
+}
+
+void FlattenTree_r(CSGFlatTree& tree, const GPUSurfacesVector& surfaces, const GPUTransformsVector& transforms, const TreeElementsLowLevel::TreeElement& node)
+{
+	std::visit(
+		[&](const auto& el)
+		{
+			FlattenTreeNode_impl(tree, surfaces, transforms, el);
+		},
+		node);
+}
+
+bool IsInsideBox(const BoundingBox& bb, const m_Vec3& pos)
+{
+	return
+		pos.x >= bb.min.x && pos.x <= bb.max.x &&
+		pos.y >= bb.min.y && pos.y <= bb.max.y &&
+		pos.z >= bb.min.z && pos.z <= bb.max.z;
+}
+
+bool IsInsideLeaf(const CSGFlatLeaf& leaf, const m_Vec3& pos)
+{
+	if(!IsInsideBox(leaf.bb, pos))
+		return false;
+
+	const GPUSurface& s= leaf.surface;
+	const float val=
+		s.xx * pos.x * pos.x + s.yy * pos.y * pos.y + s.zz * pos.z * pos.z +
+		s.xy * pos.x * pos.y + s.xz * pos.x * pos.z + s.yz * pos.y * pos.z +
+		s.x * pos.x + s.y * pos.y + s.z * pos.z +
+		s.k;
+	return val < 0.0f;
+}
+
+// Centered form of the quadratic function range.
+// Function is written as f(c + d) = f(c) + dot(grad(c), d) + quadratic_part(d), where "c" is box center and |d| <= h, where "h" is box half-size.
+// This function is used both for single box and batch classification, so it should be simple enough for vectorization.
+inline void GetSurfaceRangeImpl(
+	const GPUSurface& s,
+	const float min_x, const float min_y, const float min_z,
+	const float max_x, const float max_y, const float max_z,
+	float& out_min, float& out_max)
+{
+	// Range is calculated in float arithmetic, so it is widened outwards to stay conservative despite rounding errors.
+	// Half-sizes are rounded up, so that box around rounded center still covers the whole input box.
+	const float half_scale= 1.0f + 2.0f * std::numeric_limits<float>::epsilon();
+	const float cx= (min_x + max_x) * 0.5f, cy= (min_y + max_y) * 0.5f, cz= (min_z + max_z) * 0.5f;
+	const float hx= std::max(max_x - cx, cx - min_x) * half_scale;
+	const float hy= std::max(max_y - cy, cy - min_y) * half_scale;
+	const float hz= std::max(max_z - cz, cz - min_z) * half_scale;
+
+	const float center_value=
+		s.xx * cx * cx + s.yy * cy * cy + s.zz * cz * cz +
+		s.xy * cx * cy + s.xz * cx * cz + s.yz * cy * cz +
+		s.x * cx + s.y * cy + s.z * cz +
+		s.k;
+
+	const float grad_x= 2.0f * s.xx * cx + s.xy * cy + s.xz * cz + s.x;
+	const float grad_y= 2.0f * s.yy * cy + s.xy * cx + s.yz * cz + s.y;
+	const float grad_z= 2.0f * s.zz * cz + s.xz * cx + s.yz * cy + s.z;
+	const float linear_range= std::abs(grad_x) * hx + std::abs(grad_y) * hy + std::abs(grad_z) * hz;
+
+	const float hx2= hx * hx, hy2= hy * hy, hz2= hz * hz;
+	const float mixed_range= std::abs(s.xy) * hx * hy + std::abs(s.xz) * hx * hz + std::abs(s.yz) * hy * hz;
+	const float square_min= std::min(s.xx, 0.0f) * hx2 + std::min(s.yy, 0.0f) * hy2 + std::min(s.zz, 0.0f) * hz2;
+	const float square_max= std::max(s.xx, 0.0f) * hx2 + std::max(s.yy, 0.0f) * hy2 + std::max(s.zz, 0.0f) * hz2;
+
+	// Accumulated rounding error of all sums above is bounded by sum of magnitudes of their terms, scaled by a few ulps per operation.
+	const float ax= std::abs(cx), ay= std::abs(cy), az= std::abs(cz);
+	const float center_magnitude=
+		std::abs(s.xx) * ax * ax + std::abs(s.yy) * ay * ay + std::abs(s.zz) * az * az +
+		std::abs(s.xy) * ax * ay + std::abs(s.xz) * ax * az + std::abs(s.yz) * ay * az +
+		std::abs(s.x) * ax + std::abs(s.y) * ay + std::abs(s.z) * az +
+		std::abs(s.k);
+	const float linear_magnitude=
+		(2.0f * std::abs(s.xx) * ax + std::abs(s.xy) * ay + std::abs(s.xz) * az + std::abs(s.x)) * hx +
+		(2.0f * std::abs(s.yy) * ay + std::abs(s.xy) * ax + std::abs(s.yz) * az + std::abs(s.y)) * hy +
+		(2.0f * std::abs(s.zz) * az + std::abs(s.xz) * ax + std::abs(s.yz) * ay + std::abs(s.z)) * hz;
+	const float magnitude= center_magnitude + linear_magnitude + mixed_range + square_max - square_min;
+	const float rounding_error= magnitude * (32.0f * std::numeric_limits<float>::epsilon());
+
+	out_min= center_value - linear_range - mixed_range + square_min - rounding_error;
+	out_max= center_value + linear_range + mixed_range + square_max + rounding_error;
+}
+
+size_t GetMaxStackDepth(const CSGFlatExpression& expression)
+{
+	size_t depth= 0u, max_depth= 0u;
+	for(const CSGFlatExpressionOp& op : expression)
+	{
+		if(op.code == CSGFlatExpressionOp::Code::Leaf || op.code == CSGFlatExpressionOp::Code::OneLeaf)
+		{
+			++depth;
+			max_depth= std::max(max_depth, depth);
+		}
+		else
+			--depth;
+	}
+	return max_depth;
+}
+
+void ClassifyLeafBatch(
+	const CSGFlatLeaf& leaf,
+	const BoxesSoA& boxes,
+	const BoundingBox& chunk_bb,
+	const size_t offset,
+	const size_t count,
+	uint8_t* const out)
+{
+	// Leafs usually cover small part of the scene, so whole chunk of nearby boxes may be rejected at once.
+	if (leaf.bb.max.x < chunk_bb.min.x || leaf.bb.min.x > chunk_bb.max.x ||
+		leaf.bb.max.y < chunk_bb.min.y || leaf.bb.min.y > chunk_bb.max.y ||
+		leaf.bb.max.z < chunk_bb.min.z || leaf.bb.min.z > chunk_bb.max.z )
+	{
+		std::fill_n(out, count, uint8_t(BoxClass::Outside));
+		return;
+	}
+
+	const float* const min_x= boxes.min_x.data() + offset;
+	const float* const min_y= boxes.min_y.data() + offset;
+	const float* const min_z= boxes.min_z.data() + offset;
+	const float* const max_x= boxes.max_x.data() + offset;
+	const float* const max_y= boxes.max_y.data() + offset;
+	const float* const max_z= boxes.max_z.data() + offset;
+	const BoundingBox bb= leaf.bb;
+
+	for(size_t i= 0u; i < count; ++i)
+	{
+		float range_min, range_max;
+		GetSurfaceRangeImpl(leaf.surface, min_x[i], min_y[i], min_z[i], max_x[i], max_y[i], max_z[i], range_min, range_max);
+
+		const bool overlaps=
+			bb.max.x >= min_x[i] && bb.min.x <= max_x[i] &&
+			bb.max.y >= min_y[i] && bb.min.y <= max_y[i] &&
+			bb.max.z >= min_z[i] && bb.min.z <= max_z[i];
+		const bool contained=
+			bb.min.x <= min_x[i] && bb.max.x >= max_x[i] &&
+			bb.min.y <= min_y[i] && bb.max.y >= max_y[i] &&
+			bb.min.z <= min_z[i] && bb.max.z >= max_z[i];
+
+		const uint8_t c= (range_max < 0.0f && contained) ? uint8_t(BoxClass::Inside) : uint8_t(BoxClass::Ambiguous);
+		out[i]= (overlaps && range_min < 0.0f) ? c : uint8_t(BoxClass::Outside);
+	}
+}
+
+} // namespace
+
+CSGFlatTree BuildFlatTree(const TreeElementsLowLevel::TreeElement& root, const GPUSurfacesVector& surfaces, const GPUTransformsVector& transforms)
+{
+	CSGFlatTree tree;
+	FlattenTree_r(tree, surfaces, transforms, root);
+
+	const float inf= 1.0e24f;
+	tree.bb= BoundingBox{ { +inf, +inf, +inf }, { -inf, -inf, -inf } };
+	for(const CSGFlatLeaf& leaf : tree.leafs)
+	{
+		tree.bb.min.x= std::min(tree.bb.min.x, leaf.bb.min.x);
+		tree.bb.min.y= std::min(tree.bb.min.y, leaf.bb.min.y);
+		tree.bb.min.z= std::min(tree.bb.min.z, leaf.bb.min.z);
+		tree.bb.max.x= std::max(tree.bb.max.x, leaf.bb.max.x);
+		tree.bb.max.y= std::max(tree.bb.max.y, leaf.bb.max.y);
+		tree.bb.max.z= std::max(tree.bb.max.z, leaf.bb.max.z);
+	}
+
+	return tree;
+}
+
+CSGFlatTree BuildFlatTree(const CSGTree::CSGTreeNode& root)
+{
+	GPUSurfacesVector surfaces;
+	GPUTransformsVector transforms;
+	const TreeElementsLowLevel::TreeElement tree= BuildLowLevelTree(surfaces, transforms, root);
+	return BuildFlatTree(tree, surfaces, transforms);
+}
+
+bool IsPointInside(const CSGFlatTree& tree, const CSGFlatExpression& expression, const m_Vec3& pos, std::vector<bool>& stack)
+{
+	stack.clear();
+	for(const CSGFlatExpressionOp& op : expression)
+	{
+		switch(op.code)
+		{
+		case CSGFlatExpressionOp::Code::Mul:
+			{
+				const bool r= stack.back(); stack.pop_back();
+				stack.back()= stack.back() && r;
+			}
+			break;
+		case CSGFlatExpressionOp::Code::Add:
+			{
+				const bool r= stack.back(); stack.pop_back();
+				stack.back()= stack.back() || r;
+			}
+			break;
+		case CSGFlatExpressionOp::Code::Sub:
+			{
+				const bool r= stack.back(); stack.pop_back();
+				stack.back()= stack.back() && !r;
+			}
+			break;
+		case CSGFlatExpressionOp::Code::Leaf:
+			stack.push_back(IsInsideLeaf(tree.leafs[op.leaf_index], pos));
+			break;
+		case CSGFlatExpressionOp::Code::OneLeaf:
+			stack.push_back(true);
+			break;
+		}
+	}
+
+	SZV_ASSERT(stack.size() == 1u);
+	return stack.front();
+}
+
+void GetSurfaceRange(const GPUSurface& surface, const BoundingBox& box, float& out_min, float& out_max)
+{
+	GetSurfaceRangeImpl(surface, box.min.x, box.min.y, box.min.z, box.max.x, box.max.y, box.max.z, out_min, out_max);
+}
+
+BoxClass ClassifyLeaf(const CSGFlatLeaf& leaf, const BoundingBox& box)
+{
+	if (leaf.bb.max.x < box.min.x || leaf.bb.min.x > box.max.x ||
+		leaf.bb.max.y < box.min.y || leaf.bb.min.y > box.max.y ||
+		leaf.bb.max.z < box.min.z || leaf.bb.min.z > box.max.z )
+		return BoxClass::Outside;
+
+	float range_min, range_max;
+	GetSurfaceRange(leaf.surface, box, range_min, range_max);
+
+	if(range_min >= 0.0f)
+		return BoxClass::Outside;
+	if(range_max < 0.0f && IsInsideBox(leaf.bb, box.min) && IsInsideBox(leaf.bb, box.max))
+		return BoxClass::Inside;
+	return BoxClass::Ambiguous;
+}
+
+BoxClass ClassifyBox(
+	const CSGFlatTree& tree,
+	const CSGFlatExpression& expression,
+	const BoundingBox& box,
+	CSGFlatExpression& out_expression,
+	std::vector<ClassifyStackElement>& stack)
+{
+	out_expression.clear();
+	stack.clear();
+
+	for(const CSGFlatExpressionOp& op : expression)
+	{
+		if(op.code == CSGFlatExpressionOp::Code::Leaf)
+		{
+			const BoxClass c= ClassifyLeaf(tree.leafs[op.leaf_index], box);
+			const size_t start= out_expression.size();
+			if(c == BoxClass::Ambiguous)
+				out_expression.push_back(op);
+			stack.push_back(ClassifyStackElement{ c, start });
+			continue;
+		}
+		if(op.code == CSGFlatExpressionOp::Code::OneLeaf)
+		{
+			stack.push_back(ClassifyStackElement{ BoxClass::Inside, out_expression.size() });
+			continue;
+		}
+
+		const ClassifyStackElement r= stack.back();
+		stack.pop_back();
+		ClassifyStackElement& l= stack.back();
+
+		// Constant operands produce no output, so only variable operands are stored in output expression.
+		const bool l_var= l.value == BoxClass::Ambiguous, r_var= r.value == BoxClass::Ambiguous;
+		switch(op.code)
+		{
+		case CSGFlatExpressionOp::Code::Mul:
+			if(l_var && r_var)
+				out_expression.push_back(op);
+			else if(l.value == BoxClass::Outside || r.value == BoxClass::Outside)
+			{
+				out_expression.resize(l.out_expression_start);
+				l.value= BoxClass::Outside;
+			}
+			else if(l.value == BoxClass::Inside)
+				l.value= r.value;
+			break;
+
+		case CSGFlatExpressionOp::Code::Add:
+			if(l_var && r_var)
+				out_expression.push_back(op);
+			else if(l.value == BoxClass::Inside || r.value == BoxClass::Inside)
+			{
+				out_expression.resize(l.out_expression_start);
+				l.value= BoxClass::Inside;
+			}
+			else if(l.value == BoxClass::Outside)
+				l.value= r.value;
+			break;
+
+		case CSGFlatExpressionOp::Code::Sub:
+			if(l_var && r_var)
+				out_expression.push_back(op);
+			else if(l.value == BoxClass::Outside || r.value == BoxClass::Inside)
+			{
+				out_expression.resize(l.out_expression_start);
+				l.value= BoxClass::Outside;
+			}
+			else if(r.value == BoxClass::Outside) {}
+			else if(l.value == BoxClass::Inside)
+			{
+				// Result is inversion of right operand.
+				out_expression.insert(out_expression.begin() + std::ptrdiff_t(l.out_expression_start), CSGFlatExpressionOp{ CSGFlatExpressionOp::Code::OneLeaf, 0u });
+				out_expression.push_back(op);
+				l.value= BoxClass::Ambiguous;
+			}
+			break;
+
+		case CSGFlatExpressionOp::Code::Leaf:
+		case CSGFlatExpressionOp::Code::OneLeaf:
+			SZV_ASSERT(false);
+			break;
+		}
+	}
+
+	SZV_ASSERT(stack.size() == 1u);
+	return stack.front().value;
+}
+
+void BoxesSoA::clear()
+{
+	min_x.clear(); min_y.clear(); min_z.clear();
+	max_x.clear(); max_y.clear(); max_z.clear();
+}
+
+void BoxesSoA::push_back(const BoundingBox& box)
+{
+	min_x.push_back(box.min.x); min_y.push_back(box.min.y); min_z.push_back(box.min.z);
+	max_x.push_back(box.max.x); max_y.push_back(box.max.y); max_z.push_back(box.max.z);
+}
+
+void ClassifyBoxes(
+	const CSGFlatTree& tree,
+	const CSGFlatExpression& expression,
+	const BoxesSoA& boxes,
+	BoxClass* const out_classes,
+	BatchClassifyState& state)
+{
+	// Chunk size is chosen to keep stack data in L1 cache.
+	const size_t c_chunk_size= 256u;
+
+	const size_t max_stack_depth= GetMaxStackDepth(expression);
+	state.stack.resize(max_stack_depth * c_chunk_size);
+
+	for(size_t offset= 0u; offset < boxes.size(); offset+= c_chunk_size)
+	{
+		const size_t count= std::min(c_chunk_size, boxes.size() - offset);
+
+		BoundingBox chunk_bb{ { boxes.min_x[offset], boxes.min_y[offset], boxes.min_z[offset] }, { boxes.max_x[offset], boxes.max_y[offset], boxes.max_z[offset] } };
+		for(size_t i= offset + 1u; i < offset + count; ++i)
+		{
+			chunk_bb.min.x= std::min(chunk_bb.min.x, boxes.min_x[i]);
+			chunk_bb.min.y= std::min(chunk_bb.min.y, boxes.min_y[i]);
+			chunk_bb.min.z= std::min(chunk_bb.min.z, boxes.min_z[i]);
+			chunk_bb.max.x= std::max(chunk_bb.max.x, boxes.max_x[i]);
+			chunk_bb.max.y= std::max(chunk_bb.max.y, boxes.max_y[i]);
+			chunk_bb.max.z= std::max(chunk_bb.max.z, boxes.max_z[i]);
+		}
+
+		size_t stack_size= 0u;
+		for(const CSGFlatExpressionOp& op : expression)
+		{
+			if(op.code == CSGFlatExpressionOp::Code::Leaf)
+			{
+				ClassifyLeafBatch(tree.leafs[op.leaf_index], boxes, chunk_bb, offset, count, state.stack.data() + stack_size * c_chunk_size);
+				++stack_size;
+				continue;
+			}
+			if(op.code == CSGFlatExpressionOp::Code::OneLeaf)
+			{
+				std::fill_n(state.stack.data() + stack_size * c_chunk_size, count, uint8_t(BoxClass::Inside));
+				++stack_size;
+				continue;
+			}
+
+			SZV_ASSERT(stack_size >= 2u);
+			uint8_t* const l= state.stack.data() + (stack_size - 2u) * c_chunk_size;
+			const uint8_t* const r= state.stack.data() + (stack_size - 1u) * c_chunk_size;
+			--stack_size;
+
+			switch(op.code)
+			{
+			case CSGFlatExpressionOp::Code::Mul:
+				for(size_t i= 0u; i < count; ++i)
+					l[i]= std::min(l[i], r[i]);
+				break;
+			case CSGFlatExpressionOp::Code::Add:
+				for(size_t i= 0u; i < count; ++i)
+					l[i]= std::max(l[i], r[i]);
+				break;
+			case CSGFlatExpressionOp::Code::Sub:
+				for(size_t i= 0u; i < count; ++i)
+					l[i]= std::min(l[i], uint8_t(uint8_t(BoxClass::Inside) - r[i]));
+				break;
+			case CSGFlatExpressionOp::Code::Leaf:
+			case CSGFlatExpressionOp::Code::OneLeaf:
+				SZV_ASSERT(false);
+				break;
+			}
+		}
+
+		SZV_ASSERT(stack_size == 1u);
+		for(size_t i= 0u; i < count; ++i)
+			out_classes[offset + i]= BoxClass(state.stack[i]);
+	}
+}
+
+} // namespace SZV
@@ -0,0 +1,104 @@
+#pragma once
+#include "CSGExpressionTreeLowLevel.hpp"
+#include <vector>
+
+namespace SZV
+{
+
+// Result of conservative classification of a region.
+// Values are ordered, so that intersection is "min", union is "max" and inversion is "Inside - value".
+enum class BoxClass : uint8_t
+{
+	Outside= 0,
+	Ambiguous= 1,
+	Inside= 2,
+};
+
+// Flat postfix form of low-level tree, suitable for fast evaluation.
+struct CSGFlatExpressionOp
+{
+	enum class Code : uint32_t
+	{
+		Mul,
+		Add,
+		Sub,
+		Leaf,
+		OneLeaf,
+	};
+
+	Code code;
+	uint32_t leaf_index; // For leafs only.
+};
+
+using CSGFlatExpression= std::vector<CSGFlatExpressionOp>;
+
+struct CSGFlatLeaf
+{
+	GPUSurface surface;
+	BoundingBox bb; // Leaf is clipped by its bounding box.
+};
+
+struct CSGFlatTree
+{
+	std::vector<CSGFlatLeaf> leafs;
+	CSGFlatExpression expression;
+	BoundingBox bb; // Union of bounding boxes of all leafs.
+};
+
+// Instanced surfaces are transformed into world space.
+CSGFlatTree BuildFlatTree(const TreeElementsLowLevel::TreeElement& root, const GPUSurfacesVector& surfaces, const GPUTransformsVector& transforms);
+CSGFlatTree BuildFlatTree(const CSGTree::CSGTreeNode& root);
+
+// Expression may be whole tree expression or pruned expression, which was produced for region, containing given point.
+bool IsPointInside(const CSGFlatTree& tree, const CSGFlatExpression& expression, const m_Vec3& pos, std::vector<bool>& stack);
+
+// Calculate conservative range of the surface quadratic form over given box.
+// Centered form is used - value at box center plus bounds of linear and quadratic terms.
+// Range is widened outwards by a bound of float rounding errors, so that it contains exact range of the form.
+void GetSurfaceRange(const GPUSurface& surface, const BoundingBox& box, float& out_min, float& out_max);
+
+BoxClass ClassifyLeaf(const CSGFlatLeaf& leaf, const BoundingBox& box);
+
+struct ClassifyStackElement
+{
+	BoxClass value;
+	size_t out_expression_start;
+};
+
+// Classify box, using three-valued logic.
+// For ambiguous result pruned expression is written - with all subexpressions, constant inside given box, folded.
+// Pruned expression is valid only inside given box and may be used as input for classification of sub-boxes.
+BoxClass ClassifyBox(
+	const CSGFlatTree& tree,
+	const CSGFlatExpression& expression,
+	const BoundingBox& box,
+	CSGFlatExpression& out_expression,
+	std::vector<ClassifyStackElement>& stack);
+
+// Boxes in "structure of arrays" form.
+struct BoxesSoA
+{
+	std::vector<float> min_x, min_y, min_z;
+	std::vector<float> max_x, max_y, max_z;
+
+	size_t size() const { return min_x.size(); }
+	void clear();
+	void push_back(const BoundingBox& box);
+};
+
+struct BatchClassifyState
+{
+	std::vector<uint8_t> stack; // BoxClass values for chunk of boxes for each stack level.
+};
+
+// Classify many boxes at once, without pruned expression output.
+// Boxes are processed in chunks, each leaf and each operation are evaluated for whole chunk in tight loops, which are vectorized by compiler.
+// Leafs, which do not overlap bounding box of a chunk, are rejected for whole chunk, so nearby boxes should be placed next to each other.
+void ClassifyBoxes(
+	const CSGFlatTree& tree,
+	const CSGFlatExpression& expression,
+	const BoxesSoA& boxes,
+	BoxClass* out_classes,
+	BatchClassifyState& state);
+
+} // namespace SZV
@@ -0,0 +1,471 @@
+#include "CSGMassProperties.hpp"
+#include "Assert.hpp"
+#include "CSGIntervalEvaluator.hpp"
+#include "ParallelFor.hpp"
+#include <chrono>
+
+namespace SZV
+{
+
+namespace
+{
+
+using Clock= std::chrono::steady_clock;
+
+// Deeper cells are smaller than float precision of scene coordinates allows, so deeper subdivision is useless.
+constexpr uint32_t c_max_octree_depth= 20u;
+
+double GetTimeS(const Clock::time_point start, const Clock::time_point end)
+{
+	return double((end - start).count()) * double(Clock::duration::period::num) / double(Clock::duration::period::den);
+}
+
+bool IsInsideBox(const BoundingBox& bb, const m_Vec3& pos)
+{
+	return
+		pos.x >= bb.min.x && pos.x <= bb.max.x &&
+		pos.y >= bb.min.y && pos.y <= bb.max.y &&
+		pos.z >= bb.min.z && pos.z <= bb.max.z;
+}
+
+struct BoundaryCell
+{
+	BoundingBox box;
+	BoundingBox box_expanded; // Box, expanded by surface sampling distance.
+	CSGFlatExpression expression; // Simplified expression, valid inside expanded box.
+
+	// Sampling statistics.
+	uint64_t samples= 0u;
+	uint64_t inside_samples= 0u;
+	double inside_pos_sum[3]{ 0.0, 0.0, 0.0 };
+	uint64_t surface_crossings= 0u;
+	uint64_t point_evaluations= 0u;
+};
+
+struct OctreeAccumulator
+{
+	double volume= 0.0;
+	double moment[3]{ 0.0, 0.0, 0.0 };
+	size_t cells_inside= 0u;
+	size_t cells_outside= 0u;
+	std::vector<BoundaryCell> boundary_cells;
+};
+
+struct OctreeCell
+{
+	BoundingBox box;
+	uint32_t depth;
+	CSGFlatExpression expression;
+};
+
+double GetBoxVolume(const BoundingBox& box)
+{
+	return double(box.max.x - box.min.x) * double(box.max.y - box.min.y) * double(box.max.z - box.min.z);
+}
+
+BoundingBox ExpandBox(const BoundingBox& box, const float expand)
+{
+	return BoundingBox{ box.min - m_Vec3(expand, expand, expand), box.max + m_Vec3(expand, expand, expand) };
+}
+
+void GetSubCells(const BoundingBox& box, BoundingBox (&out_boxes)[8])
+{
+	const m_Vec3 center= (box.min + box.max) * 0.5f;
+	for(uint32_t i= 0u; i < 8u; ++i)
+	{
+		out_boxes[i].min.x= (i & 1u) == 0u ? box.min.x : center.x;
+		out_boxes[i].max.x= (i & 1u) == 0u ? center.x : box.max.x;
+		out_boxes[i].min.y= (i & 2u) == 0u ? box.min.y : center.y;
+		out_boxes[i].max.y= (i & 2u) == 0u ? center.y : box.max.y;
+		out_boxes[i].min.z= (i & 4u) == 0u ? box.min.z : center.z;
+		out_boxes[i].max.z= (i & 4u) == 0u ? center.z : box.max.z;
+	}
+}
+
+// Each cell is classified using its box, expanded by sampling distance, so simplified expression of boundary cell is valid in region, where surface samples are taken.
+// Expanded box of child cell lies inside expanded box of parent cell, so simplified expressions may be inherited.
+void BuildOctree_r(
+	const CSGFlatTree& scene,
+	const MassPropertiesSettings& settings,
+	const float expand,
+	const OctreeCell& cell,
+	OctreeAccumulator& accumulator,
+	std::vector<ClassifyStackElement>& stack)
+{
+	BoundingBox sub_boxes[8];
+	GetSubCells(cell.box, sub_boxes);
+
+	OctreeCell sub_cell;
+	sub_cell.depth= cell.depth + 1u;
+	for(const BoundingBox& sub_box : sub_boxes)
+	{
+		sub_cell.box= sub_box;
+		const BoundingBox box_expanded= ExpandBox(sub_box, expand);
+		const BoxClass c= ClassifyBox(scene, cell.expression, box_expanded, sub_cell.expression, stack);
+		if(c == BoxClass::Outside)
+			++accumulator.cells_outside;
+		else if(c == BoxClass::Inside)
+		{
+			const double volume= GetBoxVolume(sub_box);
+			const m_Vec3 center= (sub_box.min + sub_box.max) * 0.5f;
+			accumulator.volume+= volume;
+			accumulator.moment[0]+= volume * double(center.x);
+			accumulator.moment[1]+= volume * double(center.y);
+			accumulator.moment[2]+= volume * double(center.z);
+			++accumulator.cells_inside;
+		}
+		else if(sub_cell.depth >= settings.max_depth)
+		{
+			BoundaryCell boundary_cell;
+			boundary_cell.box= sub_box;
+			boundary_cell.box_expanded= box_expanded;
+			boundary_cell.expression= sub_cell.expression;
+			accumulator.boundary_cells.push_back(std::move(boundary_cell));
+		}
+		else
+			BuildOctree_r(scene, settings, expand, sub_cell, accumulator, stack);
+	}
+}
+
+// SplitMix64
+uint64_t NextRandom(uint64_t& state)
+{
+	state+= 0x9E3779B97F4A7C15ull;
+	uint64_t z= state;
+	z= (z ^ (z >> 30u)) * 0xBF58476D1CE4E5B9ull;
+	z= (z ^ (z >> 27u)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31u);
+}
+
+// Returns value in range [0; 1).
+float NextRandomFloat(uint64_t& state)
+{
+	return float(NextRandom(state) >> 40u) * (1.0f / float(1u << 24u));
+}
+
+m_Vec3 RandomDirection(uint64_t& state)
+{
+	const float z= NextRandomFloat(state) * 2.0f - 1.0f;
+	const float angle= NextRandomFloat(state) * (2.0f * 3.1415926535f);
+	const float r= std::sqrt(std::max(0.0f, 1.0f - z * z));
+	return m_Vec3(r * std::cos(angle), r * std::sin(angle), z);
+}
+
+m_Vec3 LerpBox(const BoundingBox& box, const m_Vec3& t)
+{
+	return m_Vec3(
+		box.min.x + (box.max.x - box.min.x) * t.x,
+		box.min.y + (box.max.y - box.min.y) * t.y,
+		box.min.z + (box.max.z - box.min.z) * t.z);
+}
+
+// Take one sampling round for given cell.
+// Volume samples are taken inside cell. Surface samples are taken inside expanded cell - segment with random direction and length of "sample_distance" is checked for surface crossing.
+// Only crossings inside the cell itself are counted.
+void SampleCell(
+	const CSGFlatTree& scene,
+	const MassPropertiesSettings& settings,
+	const float sample_distance,
+	const uint64_t cell_index,
+	const uint32_t round,
+	BoundaryCell& cell,
+	std::vector<bool>& stack)
+{
+	uint64_t random_state= settings.seed ^ (cell_index * 0xD1B54A32D192ED03ull) ^ (uint64_t(round) * 0x8CB92BA72F3D8DD7ull);
+	NextRandom(random_state);
+
+	const uint32_t strata= std::max(1u, settings.strata_per_axis);
+	const float inv_strata= 1.0f / float(strata);
+
+	for(uint32_t x= 0u; x < strata; ++x)
+	for(uint32_t y= 0u; y < strata; ++y)
+	for(uint32_t z= 0u; z < strata; ++z)
+	{
+		// Volume sample.
+		{
+			const m_Vec3 t(
+				(float(x) + NextRandomFloat(random_state)) * inv_strata,
+				(float(y) + NextRandomFloat(random_state)) * inv_strata,
+				(float(z) + NextRandomFloat(random_state)) * inv_strata);
+			const m_Vec3 pos= LerpBox(cell.box, t);
+
+			++cell.samples;
+			++cell.point_evaluations;
+			if(IsPointInside(scene, cell.expression, pos, stack))
+			{
+				++cell.inside_samples;
+				cell.inside_pos_sum[0]+= double(pos.x);
+				cell.inside_pos_sum[1]+= double(pos.y);
+				cell.inside_pos_sum[2]+= double(pos.z);
+			}
+		}
+		// Surface sample.
+		{
+			const m_Vec3 t(
+				(float(x) + NextRandomFloat(random_state)) * inv_strata,
+				(float(y) + NextRandomFloat(random_state)) * inv_strata,
+				(float(z) + NextRandomFloat(random_state)) * inv_strata);
+			m_Vec3 pos0= LerpBox(cell.box_expanded, t);
+			m_Vec3 pos1= pos0 + RandomDirection(random_state) * sample_distance;
+
+			const bool inside0= IsPointInside(scene, cell.expression, pos0, stack);
+			const bool inside1= IsPointInside(scene, cell.expression, pos1, stack);
+			cell.point_evaluations+= 2u;
+			if(inside0 != inside1)
+			{
+				// Find crossing point.
+				for(uint32_t i= 0u; i < 10u; ++i)
+				{
+					const m_Vec3 mid= (pos0 + pos1) * 0.5f;
+					++cell.point_evaluations;
+					if(IsPointInside(scene, cell.expression, mid, stack) == inside0)
+						pos0= mid;
+					else
+						pos1= mid;
+				}
+				if(IsInsideBox(cell.box, (pos0 + pos1) * 0.5f))
+					++cell.surface_crossings;
+			}
+		}
+	}
+}
+
+// Center of mass and its standard error (distance) by exact contribution of inner cells and current sampling statistics of boundary cells.
+void CalculateCenterOfMass(
+	const OctreeAccumulator& accumulator,
+	const double volume,
+	double (&out_center_of_mass)[3],
+	double& out_center_of_mass_error)
+{
+	out_center_of_mass[0]= out_center_of_mass[1]= out_center_of_mass[2]= 0.0;
+	out_center_of_mass_error= 0.0;
+	if(volume <= 0.0)
+		return;
+
+	double moment[3]{ accumulator.moment[0], accumulator.moment[1], accumulator.moment[2] };
+	for(const BoundaryCell& cell : accumulator.boundary_cells)
+	{
+		const double cell_volume= GetBoxVolume(cell.box);
+		for(size_t j= 0u; j < 3u; ++j)
+			moment[j]+= cell_volume * cell.inside_pos_sum[j] / double(cell.samples);
+	}
+
+	for(size_t j= 0u; j < 3u; ++j)
+		out_center_of_mass[j]= moment[j] / volume;
+
+	double center_of_mass_variance= 0.0;
+	for(const BoundaryCell& cell : accumulator.boundary_cells)
+	{
+		const double n= double(cell.samples);
+		const double cell_volume= GetBoxVolume(cell.box);
+
+		// Error of center of mass is mostly caused by errors of boundary cells filling.
+		const double fraction= (double(cell.inside_samples) + 0.5) / (n + 1.0);
+		const m_Vec3 center= (cell.box.min + cell.box.max) * 0.5f;
+		double square_dist= 0.0;
+		for(size_t j= 0u; j < 3u; ++j)
+		{
+			const double d= double((&center.x)[j]) - out_center_of_mass[j];
+			square_dist+= d * d;
+		}
+		center_of_mass_variance+= cell_volume * cell_volume * fraction * (1.0 - fraction) / n * square_dist;
+	}
+
+	out_center_of_mass_error= std::sqrt(center_of_mass_variance) / volume;
+}
+
+} // namespace
+
+MassProperties CalculateMassProperties(const CSGTree::CSGTreeNode& root, const MassPropertiesSettings& in_settings)
+{
+	MassProperties result;
+
+	MassPropertiesSettings settings= in_settings;
+	settings.max_depth= std::min(settings.max_depth, c_max_octree_depth);
+
+	const Clock::time_point classification_start_time= Clock::now();
+
+	const CSGFlatTree scene= BuildFlatTree(root);
+	if(scene.leafs.empty() || scene.bb.min.x >= scene.bb.max.x || scene.bb.min.y >= scene.bb.max.y || scene.bb.min.z >= scene.bb.max.z)
+	{
+		result.converged= true;
+		return result;
+	}
+
+	// Surface sampling distance is fraction of the smallest cell size.
+	const m_Vec3 scene_size= scene.bb.max - scene.bb.min;
+	const float min_cell_size= std::min(scene_size.x, std::min(scene_size.y, scene_size.z)) / float(1u << settings.max_depth);
+	const float sample_distance= 0.25f * min_cell_size;
+
+	// Build first levels of octree serially, than process subtrees in parallel.
+	OctreeAccumulator accumulator;
+	std::vector<OctreeCell> cells;
+	{
+		std::vector<ClassifyStackElement> stack;
+
+		OctreeCell root_cell;
+		// Expand root box, to capture surface crossings on scene bounding box border.
+		root_cell.box= ExpandBox(scene.bb, sample_distance);
+		root_cell.depth= 0u;
+		root_cell.expression= scene.expression;
+		cells.push_back(std::move(root_cell));
+
+		const uint32_t serial_depth= std::min(2u, settings.max_depth);
+		for(uint32_t depth= 0u; depth < serial_depth; ++depth)
+		{
+			std::vector<OctreeCell> next_cells;
+			for(const OctreeCell& cell : cells)
+			{
+				BoundingBox sub_boxes[8];
+				GetSubCells(cell.box, sub_boxes);
+				for(const BoundingBox& sub_box : sub_boxes)
+				{
+					OctreeCell sub_cell;
+					sub_cell.box= sub_box;
+					sub_cell.depth= cell.depth + 1u;
+					const BoundingBox box_expanded= ExpandBox(sub_box, sample_distance);
+					const BoxClass c= ClassifyBox(scene, cell.expression, box_expanded, sub_cell.expression, stack);
+					if(c == BoxClass::Outside)
+						++accumulator.cells_outside;
+					else if(c == BoxClass::Inside)
+					{
+						const double volume= GetBoxVolume(sub_box);
+						const m_Vec3 center= (sub_box.min + sub_box.max) * 0.5f;
+						accumulator.volume+= volume;
+						accumulator.moment[0]+= volume * double(center.x);
+						accumulator.moment[1]+= volume * double(center.y);
+						accumulator.moment[2]+= volume * double(center.z);
+						++accumulator.cells_inside;
+					}
+					else
+						next_cells.push_back(std::move(sub_cell));
+				}
+			}
+			cells= std::move(next_cells);
+		}
+
+		if(serial_depth == settings.max_depth)
+		{
+			for(OctreeCell& cell : cells)
+			{
+				BoundaryCell boundary_cell;
+				boundary_cell.box= cell.box;
+				boundary_cell.box_expanded= ExpandBox(cell.box, sample_distance);
+				boundary_cell.expression= std::move(cell.expression);
+				accumulator.boundary_cells.push_back(std::move(boundary_cell));
+			}
+			cells.clear();
+		}
+	}
+
+	std::vector<OctreeAccumulator> subtree_accumulators(cells.size());
+	ParallelFor(
+		cells.size(),
+		settings.thread_count,
+		[&](const size_t i)
+		{
+			std::vector<ClassifyStackElement> stack;
+			BuildOctree_r(scene, settings, sample_distance, cells[i], subtree_accumulators[i], stack);
+		});
+
+	for(OctreeAccumulator& subtree_accumulator : subtree_accumulators)
+	{
+		accumulator.volume+= subtree_accumulator.volume;
+		for(size_t j= 0u; j < 3u; ++j)
+			accumulator.moment[j]+= subtree_accumulator.moment[j];
+		accumulator.cells_inside+= subtree_accumulator.cells_inside;
+		accumulator.cells_outside+= subtree_accumulator.cells_outside;
+		for(BoundaryCell& cell : subtree_accumulator.boundary_cells)
+			accumulator.boundary_cells.push_back(std::move(cell));
+	}
+
+	result.cells_inside= accumulator.cells_inside;
+	result.cells_outside= accumulator.cells_outside;
+	result.cells_boundary= accumulator.boundary_cells.size();
+
+	const Clock::time_point sampling_start_time= Clock::now();
+	result.classification_time_s= GetTimeS(classification_start_time, sampling_start_time);
+
+	// Sample boundary cells in parallel, until target error is reached.
+	std::vector<BoundaryCell>& boundary_cells= accumulator.boundary_cells;
+	const size_t c_cells_per_task= 64u;
+	const size_t task_count= (boundary_cells.size() + c_cells_per_task - 1u) / c_cells_per_task;
+
+	for(uint32_t round= 0u; round < settings.max_rounds && !boundary_cells.empty(); ++round)
+	{
+		ParallelFor(
+			task_count,
+			settings.thread_count,
+			[&](const size_t task_index)
+			{
+				std::vector<bool> stack;
+				const size_t end= std::min(boundary_cells.size(), (task_index + 1u) * c_cells_per_task);
+				for(size_t i= task_index * c_cells_per_task; i < end; ++i)
+					SampleCell(scene, settings, sample_distance, i, round, boundary_cells[i], stack);
+			});
+
+		++result.rounds;
+
+		double volume= accumulator.volume;
+		double volume_variance= 0.0;
+		for(const BoundaryCell& cell : boundary_cells)
+		{
+			const double cell_volume= GetBoxVolume(cell.box);
+			const double n= double(cell.samples);
+			volume+= cell_volume * double(cell.inside_samples) / n;
+
+			// Use smoothed fraction for variance estimation, to avoid zero variance for cells with all samples inside or outside.
+			const double fraction= (double(cell.inside_samples) + 0.5) / (n + 1.0);
+			volume_variance+= cell_volume * cell_volume * fraction * (1.0 - fraction) / n;
+		}
+
+		result.volume_per_round.push_back(volume);
+		result.volume= volume;
+		result.volume_error= std::sqrt(volume_variance);
+		CalculateCenterOfMass(accumulator, result.volume, result.center_of_mass, result.center_of_mass_error);
+
+		// Center of mass error is measured relative to scene size, since center of mass itself may be close to zero.
+		if(volume > 0.0 &&
+			result.volume_error <= settings.target_relative_error * volume &&
+			result.center_of_mass_error <= settings.target_relative_error * double(scene_size.GetLength()))
+		{
+			result.converged= true;
+			break;
+		}
+	}
+
+	if(boundary_cells.empty())
+	{
+		result.volume= accumulator.volume;
+		CalculateCenterOfMass(accumulator, result.volume, result.center_of_mass, result.center_of_mass_error);
+		result.converged= true;
+	}
+
+	// Calculate final values.
+	double surface_area_variance= 0.0;
+	for(const BoundaryCell& cell : boundary_cells)
+	{
+		const double n= double(cell.samples);
+
+		// Each surface element with area "A" and normal "n" is crossed by segment with direction "d" with probability "distance * |dot(n, d)| * A / volume".
+		// For random direction average of |dot(n, d)| is 1/2.
+		const double expanded_volume= GetBoxVolume(cell.box_expanded);
+		const double crossing_probability= double(cell.surface_crossings) / n;
+		const double area_scale= 2.0 * expanded_volume / double(sample_distance);
+		result.surface_area+= area_scale * crossing_probability;
+
+		const double crossing_probability_smoothed= (double(cell.surface_crossings) + 0.5) / (n + 1.0);
+		surface_area_variance+= area_scale * area_scale * crossing_probability_smoothed * (1.0 - crossing_probability_smoothed) / n;
+
+		result.samples+= cell.samples;
+		result.point_evaluations+= cell.point_evaluations;
+	}
+
+	result.surface_area_error= std::sqrt(surface_area_variance);
+
+	result.sampling_time_s= GetTimeS(sampling_start_time, Clock::now());
+
+	return result;
+}
+
+} // namespace SZV
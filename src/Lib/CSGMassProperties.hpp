@@ -0,0 +1,58 @@
+#pragma once
+#include "CSGExpressionTree.hpp"
+#include <vector>
+
+namespace SZV
+{
+
+struct MassPropertiesSettings
+{
+	// Maximum depth of the octree. Cells of this depth, which are still partially filled, are sampled.
+	// Values above 20 are clamped to 20.
+	uint32_t max_depth= 6u;
+	// Number of strata along each axis of a boundary cell. Each sampling round takes one sample inside each stratum.
+	uint32_t strata_per_axis= 2u;
+	// Sampling stops after this number of rounds, even if target error is not reached.
+	uint32_t max_rounds= 32u;
+	// Sampling stops if both volume standard error relative to volume and center of mass standard error relative to scene size are less than this value.
+	double target_relative_error= 1.0e-3;
+	// Zero means number of hardware threads.
+	size_t thread_count= 0u;
+	uint64_t seed= 0u;
+};
+
+struct MassProperties
+{
+	// Uniform density is assumed.
+	double volume= 0.0;
+	double surface_area= 0.0;
+	double center_of_mass[3]{ 0.0, 0.0, 0.0 };
+
+	// Standard errors of estimations.
+	// Octree cells, which are fully inside, give exact contribution, so errors are caused only by sampling of boundary cells.
+	// Multiply errors by 3 to get bounds with confidence about 99.7%.
+	double volume_error= 0.0;
+	double surface_area_error= 0.0;
+	double center_of_mass_error= 0.0; // Error of center of mass position (distance).
+
+	// Convergence info.
+	bool converged= false;
+	uint32_t rounds= 0u;
+	std::vector<double> volume_per_round; // Volume estimation after each sampling round.
+
+	// Statistics.
+	size_t cells_inside= 0u;
+	size_t cells_outside= 0u;
+	size_t cells_boundary= 0u;
+	uint64_t samples= 0u;
+	uint64_t point_evaluations= 0u;
+	double classification_time_s= 0.0;
+	double sampling_time_s= 0.0;
+};
+
+// Calculate mass properties of given tree.
+// Octree over scene bounding box is built, cells are classified conservatively as fully inside, fully outside or partially filled.
+// Partially filled cells are subdivided up to max depth and than sampled in parallel using stratified sampling.
+MassProperties CalculateMassProperties(const CSGTree::CSGTreeNode& root, const MassPropertiesSettings& settings= MassPropertiesSettings());
+
+} // namespace SZV
@@ -1,7 +1,11 @@
 #include "CSGRenderer.hpp"
 #include "Assert.hpp"
-#include "CSGDataGPU.hpp"
+#include "CSGShaderGenerator.hpp"
 #include "Log.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 
 namespace SZV
 {
@@ -26,66 +30,76 @@ struct Uniforms
 	float ambient_light_color[4];
 };
 
-} // namespace
-
-CSGRenderer::CSGRenderer(I_WindowVulkan& window_vulkan)
-	: vk_device_(window_vulkan.GetVulkanDevice())
-	, tonemapper_(window_vulkan)
+// Scene is identified by pointer, so same empty scene is used each time, in order to avoid its upload in each frame.
+const std::shared_ptr<const CSGSceneData>& GetEmptyScene()
 {
-	const vk::PhysicalDeviceMemoryProperties memory_properties= window_vulkan.GetMemoryProperties();
+	static const std::shared_ptr<const CSGSceneData> empty_scene= std::make_shared<const CSGSceneData>();
+	return empty_scene;
+}
 
-	{ // Create surfaces data buffer
-		const uint32_t buffer_size= 65536u * sizeof(GPUSurface);
-		surfaces_buffer_size_= buffer_size;
+// Alignment of separate arrays in staging buffer.
+const size_t g_staging_data_alignment= 256u;
 
-		surfaces_data_buffer_gpu_=
-			vk_device_.createBufferUnique(
-				vk::BufferCreateInfo(
-					vk::BufferCreateFlags(),
-					buffer_size,
-					vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst));
+// Upload happens only when scene changes and does not depend on render scale, so it is excluded from time, driving dynamic resolution.
+const char g_scene_upload_stage_name[]= "scene upload";
 
-		const vk::MemoryRequirements buffer_memory_requirements=
-			vk_device_.getBufferMemoryRequirements(*surfaces_data_buffer_gpu_);
+void CreateDeviceLocalBuffer(
+	const vk::Device vk_device,
+	const vk::PhysicalDeviceMemoryProperties& memory_properties,
+	const vk::DeviceSize size,
+	const vk::BufferUsageFlags usage,
+	vk::UniqueBuffer& out_buffer,
+	vk::UniqueDeviceMemory& out_memory)
+{
+	out_buffer=
+		vk_device.createBufferUnique(
+			vk::BufferCreateInfo(
+				vk::BufferCreateFlags(),
+				size,
+				usage | vk::BufferUsageFlagBits::eTransferDst));
 
-		vk::MemoryAllocateInfo vk_memory_allocate_info(buffer_memory_requirements.size);
-		for(uint32_t i= 0u; i < memory_properties.memoryTypeCount; ++i)
-		{
-			if((buffer_memory_requirements.memoryTypeBits & (1u << i)) != 0 &&
-				(memory_properties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) != vk::MemoryPropertyFlags())
-				vk_memory_allocate_info.memoryTypeIndex= i;
-		}
+	const vk::MemoryRequirements buffer_memory_requirements= vk_device.getBufferMemoryRequirements(*out_buffer);
 
-		surfaces_data_buffer_memory_= vk_device_.allocateMemoryUnique(vk_memory_allocate_info);
-		vk_device_.bindBufferMemory(*surfaces_data_buffer_gpu_, *surfaces_data_buffer_memory_, 0u);
+	vk::MemoryAllocateInfo vk_memory_allocate_info(buffer_memory_requirements.size);
+	for(uint32_t i= 0u; i < memory_properties.memoryTypeCount; ++i)
+	{
+		if((buffer_memory_requirements.memoryTypeBits & (1u << i)) != 0 &&
+			(memory_properties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) != vk::MemoryPropertyFlags())
+			vk_memory_allocate_info.memoryTypeIndex= i;
 	}
-	{ // Create expressions data buffer
-		const uint32_t buffer_size= 1024u * 1024u * sizeof(CSGExpressionGPUBufferType);
-		expressions_buffer_size_= buffer_size;
 
-		expressions_data_buffer_gpu_=
-			vk_device_.createBufferUnique(
-				vk::BufferCreateInfo(
-					vk::BufferCreateFlags(),
-					buffer_size,
-					vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst));
+	out_memory= vk_device.allocateMemoryUnique(vk_memory_allocate_info);
+	vk_device.bindBufferMemory(*out_buffer, *out_memory, 0u);
+}
 
-		const vk::MemoryRequirements buffer_memory_requirements=
-			vk_device_.getBufferMemoryRequirements(*expressions_data_buffer_gpu_);
+} // namespace
 
-		vk::MemoryAllocateInfo vk_memory_allocate_info(buffer_memory_requirements.size);
-		for(uint32_t i= 0u; i < memory_properties.memoryTypeCount; ++i)
-		{
-			if((buffer_memory_requirements.memoryTypeBits & (1u << i)) != 0 &&
-				(memory_properties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) != vk::MemoryPropertyFlags())
-				vk_memory_allocate_info.memoryTypeIndex= i;
-		}
+CSGRenderer::CSGRenderer(I_WindowVulkan& window_vulkan)
+	: window_vulkan_(window_vulkan)
+	, vk_device_(window_vulkan.GetVulkanDevice())
+	, pipeline_cache_(window_vulkan.GetPipelineCache())
+	, tonemapper_(window_vulkan)
+	, scene_(GetEmptyScene())
+{
+	const vk::PhysicalDeviceMemoryProperties memory_properties= window_vulkan.GetMemoryProperties();
 
-		expressions_data_buffer_memory_= vk_device_.allocateMemoryUnique(vk_memory_allocate_info);
-		vk_device_.bindBufferMemory(*expressions_data_buffer_gpu_, *expressions_data_buffer_memory_, 0u);
+	{ // Calculate buffers sizes and layout of staging buffer.
+		surfaces_buffer_size_= 65536u * sizeof(GPUSurface);
+		expressions_buffer_size_= 1024u * 1024u * sizeof(CSGExpressionGPUBufferType);
+		transforms_buffer_size_= 65536u * sizeof(GPUTransform);
+		vertex_buffer_vertices_= 1024u * 1024u;
+		index_buffer_indeces_= 1024u * 1024u * 2u;
+
+		const auto align= [](const size_t offset) { return (offset + g_staging_data_alignment - 1u) / g_staging_data_alignment * g_staging_data_alignment; };
+		staging_vertices_offset_= 0u;
+		staging_indices_offset_= align(staging_vertices_offset_ + vertex_buffer_vertices_ * sizeof(SurfaceVertex));
+		staging_surfaces_offset_= align(staging_indices_offset_ + index_buffer_indeces_ * sizeof(IndexType));
+		staging_expressions_offset_= align(staging_surfaces_offset_ + surfaces_buffer_size_);
+		staging_transforms_offset_= align(staging_expressions_offset_ + expressions_buffer_size_);
+		staging_buffer_size_= staging_transforms_offset_ + transforms_buffer_size_;
 	}
 	{ // Create descriptor set layout
-		const vk::DescriptorSetLayoutBinding descriptor_set_layout_bindings[2]
+		const vk::DescriptorSetLayoutBinding descriptor_set_layout_bindings[3]
 		{
 			{
 				0u,
@@ -101,6 +115,13 @@ CSGRenderer::CSGRenderer(I_WindowVulkan& window_vulkan)
 				vk::ShaderStageFlagBits::eFragment,
 				nullptr,
 			},
+			{
+				2u,
+				vk::DescriptorType::eStorageBuffer,
+				1u,
+				vk::ShaderStageFlagBits::eFragment,
+				nullptr,
+			},
 		};
 
 		descriptor_set_layout_=
@@ -135,112 +156,16 @@ CSGRenderer::CSGRenderer(I_WindowVulkan& window_vulkan)
 				sizeof(Shaders::surface_frag),
 				Shaders::surface_frag));
 
-		const vk::PipelineShaderStageCreateInfo vk_shader_stage_create_info[]
-		{
-			{
-				vk::PipelineShaderStageCreateFlags(),
-				vk::ShaderStageFlagBits::eVertex,
-				*shader_vert_,
-				"main"
-			},
-			{
-				vk::PipelineShaderStageCreateFlags(),
-				vk::ShaderStageFlagBits::eFragment,
-				*shader_frag_,
-				"main"
-			},
-		};
-
-		const vk::VertexInputBindingDescription vk_vertex_input_binding_description(
-			0u,
-			sizeof(SurfaceVertex),
-			vk::VertexInputRate::eVertex);
-
-		const vk::VertexInputAttributeDescription vk_vertex_input_attribute_description[1]
-		{
-			{0u, 0u, vk::Format::eR32G32B32A32Sfloat, offsetof(SurfaceVertex, pos)},
-		};
-
-		const vk::PipelineVertexInputStateCreateInfo vk_pipiline_vertex_input_state_create_info(
-			vk::PipelineVertexInputStateCreateFlags(),
-			1u, &vk_vertex_input_binding_description,
-			uint32_t(std::size(vk_vertex_input_attribute_description)), vk_vertex_input_attribute_description);
-
-		const vk::PipelineInputAssemblyStateCreateInfo vk_pipeline_input_assembly_state_create_info(
-			vk::PipelineInputAssemblyStateCreateFlags(),
-			vk::PrimitiveTopology::eTriangleList);
-
-		const vk::Extent2D viewport_size= tonemapper_.GetFramebufferSize();
-		const vk::Viewport vk_viewport(0.0f, 0.0f, float(viewport_size.width), float(viewport_size.height), 0.0f, 1.0f);
-		const vk::Rect2D vk_scissor(vk::Offset2D(0, 0), viewport_size);
-
-		const vk::PipelineViewportStateCreateInfo vk_pipieline_viewport_state_create_info(
-			vk::PipelineViewportStateCreateFlags(),
-			1u, &vk_viewport,
-			1u, &vk_scissor);
-
-		const vk::PipelineRasterizationStateCreateInfo vk_pipilane_rasterization_state_create_info(
-			vk::PipelineRasterizationStateCreateFlags(),
-			VK_FALSE,
-			VK_FALSE,
-			vk::PolygonMode::eFill,
-			vk::CullModeFlagBits::eFront,
-			vk::FrontFace::eClockwise,
-			VK_FALSE, 0.0f, 0.0f, 0.0f,
-			1.0f);
-
-		const vk::PipelineMultisampleStateCreateInfo vk_pipeline_multisample_state_create_info;
-
-		const vk::PipelineDepthStencilStateCreateInfo vk_pipeline_depth_state_create_info(
-			vk::PipelineDepthStencilStateCreateFlags(),
-			VK_TRUE,
-			VK_TRUE,
-			vk::CompareOp::eLess,
-			VK_FALSE,
-			VK_FALSE,
-			vk::StencilOpState(),
-			vk::StencilOpState(),
-			0.0f,
-			1.0f);
-
-		const vk::PipelineColorBlendAttachmentState pipeline_color_blend_attachment_state(
-			VK_FALSE,
-			vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd,
-			vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd,
-			vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
-
-		const vk::PipelineColorBlendStateCreateInfo vk_pipeline_color_blend_state_create_info(
-			vk::PipelineColorBlendStateCreateFlags(),
-			VK_FALSE,
-			vk::LogicOp::eCopy,
-			1u, &pipeline_color_blend_attachment_state);
-
-		pipeline_=
-			vk_device_.createGraphicsPipelineUnique(
-				nullptr,
-				vk::GraphicsPipelineCreateInfo(
-					vk::PipelineCreateFlags(),
-					uint32_t(std::size(vk_shader_stage_create_info)), vk_shader_stage_create_info,
-					&vk_pipiline_vertex_input_state_create_info,
-					&vk_pipeline_input_assembly_state_create_info,
-					nullptr,
-					&vk_pipieline_viewport_state_create_info,
-					&vk_pipilane_rasterization_state_create_info,
-					&vk_pipeline_multisample_state_create_info,
-					&vk_pipeline_depth_state_create_info,
-					&vk_pipeline_color_blend_state_create_info,
-					nullptr,
-					*pipeline_layout_,
-					tonemapper_.GetMainRenderPass(),
-					0u));
+		pipeline_= CreatePipeline(*shader_frag_);
 	}
 
+	const uint32_t frames_in_flight= std::max(1u, window_vulkan.GetFramesInFlightCount());
 	{ // Create descriptor pool
 		const vk::DescriptorPoolSize vk_descriptor_pool_sizes[1]
 		{
 			{
 				vk::DescriptorType::eStorageBuffer,
-				2u // global storage buffers
+				3u * frames_in_flight // global storage buffers
 			},
 		};
 
@@ -248,11 +173,273 @@ CSGRenderer::CSGRenderer(I_WindowVulkan& window_vulkan)
 			vk_device_.createDescriptorPoolUnique(
 				vk::DescriptorPoolCreateInfo(
 					vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
-					1u, // max sets.
+					frames_in_flight, // max sets.
 					uint32_t(std::size(vk_descriptor_pool_sizes)), vk_descriptor_pool_sizes));
 	}
+
+	for(uint32_t i= 0u; i < frames_in_flight; ++i)
+		frames_resources_.push_back(CreateFrameResources(memory_properties));
+}
+
+CSGRenderer::~CSGRenderer()
+{
+	// Background build uses device and pipeline objects.
+	if(specialized_pipeline_future_.valid())
+		specialized_pipeline_future_.wait();
+
+	// Sync before destruction.
+	vk_device_.waitIdle();
+
+	for(FrameResources& frame_resources : frames_resources_)
+		vk_device_.unmapMemory(*frame_resources.staging_buffer_memory);
+}
+
+void CSGRenderer::BeginFrame(const vk::CommandBuffer command_buffer, const CameraController& camera_controller)
+{
+	SZV_PROFILE_FUNCTION();
+
+	const CSGSceneData& scene= *scene_;
+	const VerticesVector& vertices= scene.vertices;
+	const IndicesVector& indices= scene.indices;
+	const GPUSurfacesVector& surfaces= scene.surfaces;
+	const GPUTransformsVector& transforms= scene.transforms;
+	const CSGExpressionGPUBuffer& expressions= scene.expressions;
+
+	// Window waits for previous frame with same index, so resources of this frame are not used by GPU now.
+	const uint32_t frame_index= window_vulkan_.GetCurrentFrameIndex();
+	SZV_ASSERT(frame_index < frames_resources_.size());
+	FrameResources& frame_resources= frames_resources_[frame_index];
+
+	// Buffers of this frame keep scene data until it is changed.
+	if(frame_resources.uploaded_scene != scene_)
+	{
+		frame_resources.uploaded_scene= scene_;
+		SZV_PROFILE_ZONE("CSGRenderer::UploadScene");
+		const GPUProfilerStageScope profiler_scope(gpu_profiler_, command_buffer, g_scene_upload_stage_name);
+
+		const vk::Buffer staging_buffer= *frame_resources.staging_buffer;
+
+		const auto update_buffer=
+		[&](const auto& vec, const vk::UniqueBuffer& buffer, const size_t staging_offset)
+		{
+			const size_t data_size= vec.size() * sizeof(vec[0]);
+			if(data_size == 0u)
+				return;
+
+			std::memcpy(frame_resources.staging_buffer_mapped + staging_offset, vec.data(), data_size);
+
+			const vk::BufferCopy copy_region(vk::DeviceSize(staging_offset), 0u, vk::DeviceSize(data_size));
+			command_buffer.copyBuffer(staging_buffer, *buffer, 1u, &copy_region);
+		};
+
+		if(vertices.size() > vertex_buffer_vertices_)
+			Log::FatalError("Vertices buffer overflow");
+		update_buffer(vertices, frame_resources.vertex_buffer, staging_vertices_offset_);
+
+		if(indices.size() > index_buffer_indeces_)
+			Log::FatalError("Indices buffer overflow");
+		update_buffer(indices, frame_resources.index_buffer, staging_indices_offset_);
+
+		if(surfaces.size() * sizeof(GPUSurface) > surfaces_buffer_size_)
+			Log::FatalError("Surfaces buffer overflow");
+		update_buffer(surfaces, frame_resources.surfaces_data_buffer, staging_surfaces_offset_);
+
+		if(expressions.size() * sizeof(CSGExpressionGPUBufferType) > expressions_buffer_size_)
+			Log::FatalError("Expressions buffer overflow");
+		update_buffer(expressions, frame_resources.expressions_data_buffer, staging_expressions_offset_);
+
+		if(transforms.size() * sizeof(GPUTransform) > transforms_buffer_size_)
+			Log::FatalError("Transforms buffer overflow");
+		update_buffer(transforms, frame_resources.transforms_data_buffer, staging_transforms_offset_);
+
+		// Make copied data visible for drawing.
+		const vk::MemoryBarrier memory_barrier(
+			vk::AccessFlagBits::eTransferWrite,
+			vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eShaderRead);
+		command_buffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eFragmentShader,
+			vk::DependencyFlags(),
+			1u, &memory_barrier,
+			0u, nullptr,
+			0u, nullptr);
+	}
+
+	// Window waits for previous frame with same index, so pipelines, retired frames in flight count frames ago, are not used anymore.
+	for(RetiredSpecializedPipeline& retired : retired_specialized_pipelines_)
+		--retired.frames_left;
+	retired_specialized_pipelines_.erase(
+		std::remove_if(
+			retired_specialized_pipelines_.begin(), retired_specialized_pipelines_.end(),
+			[](const RetiredSpecializedPipeline& retired) { return retired.frames_left == 0u; }),
+		retired_specialized_pipelines_.end());
+
+	UpdateSpecializedPipeline(false);
+
+	if(dynamic_resolution_ && gpu_profiler_ != nullptr)
+	{
+		const GPUProfiler::FrameResult& frame_result= gpu_profiler_->GetLastFrameResult();
+		const uint64_t current_frame= gpu_profiler_->GetCurrentFrameIndex();
+		const size_t history_size= std::size(render_scale_history_);
+		if(frame_result.frame_index != ~uint64_t(0) &&
+			frame_result.frame_index != last_processed_profiler_frame_ &&
+			current_frame - frame_result.frame_index < history_size)
+		{
+			last_processed_profiler_frame_= frame_result.frame_index;
+
+			double frame_time_ms= frame_result.total_time_ms;
+			for(const GPUProfiler::StageResult& stage : frame_result.stages)
+				if(stage.name == g_scene_upload_stage_name)
+					frame_time_ms-= stage.time_ms;
+
+			tonemapper_.SetRenderScale(
+				render_scale_controller_.Update(
+					float(std::max(frame_time_ms, 0.0) * 1.0e-3),
+					render_scale_history_[frame_result.frame_index % history_size]));
+		}
+		render_scale_history_[current_frame % history_size]= tonemapper_.GetRenderScale();
+	}
+
+	tonemapper_.DoMainPass(
+		command_buffer,
+		[&]
+		{
+			Draw(command_buffer, camera_controller, frame_resources, indices.size());
+		});
+}
+
+void CSGRenderer::SetScene(std::shared_ptr<const CSGSceneData> scene)
+{
+	scene_= scene != nullptr ? std::move(scene) : GetEmptyScene();
+}
+
+void CSGRenderer::SetDynamicResolution(const bool enable, const RenderScaleSettings& settings)
+{
+	dynamic_resolution_= enable;
+	render_scale_controller_.SetSettings(settings);
+	tonemapper_.SetRenderScale(enable ? render_scale_controller_.GetScale() : 1.0f);
+}
+
+void CSGRenderer::SetGPUProfiler(GPUProfiler* const profiler)
+{
+	gpu_profiler_= profiler;
+	tonemapper_.SetGPUProfiler(profiler);
+}
+
+void CSGRenderer::SetFixedTimeStep(const float time_step_s)
+{
+	tonemapper_.SetFixedTimeStep(time_step_s);
+}
+
+void CSGRenderer::SetExposureSettings(const ExposureSettings& settings)
+{
+	tonemapper_.SetExposureSettings(settings);
+}
+
+const ExposureSettings& CSGRenderer::GetExposureSettings() const
+{
+	return tonemapper_.GetExposureSettings();
+}
+
+void CSGRenderer::SetExposureReadback(const bool enable)
+{
+	tonemapper_.SetExposureReadback(enable);
+}
+
+bool CSGRenderer::GetExposureReadback(ExposureCalculationResult& out_result) const
+{
+	return tonemapper_.GetExposureReadback(out_result);
+}
+
+void CSGRenderer::EndFrame(const vk::CommandBuffer command_buffer)
+{
+	tonemapper_.EndFrame(command_buffer);
+}
+
+void CSGRenderer::Resize(const vk::Extent2D viewport_size)
+{
+	tonemapper_.Resize(viewport_size);
+}
+
+void CSGRenderer::SetUseSpecializedShaders(const bool use)
+{
+	use_specialized_shaders_= use;
+	if(!use)
+		RetireSpecializedPipeline();
+}
+
+void CSGRenderer::WaitForSpecializedPipeline()
+{
+	UpdateSpecializedPipeline(true);
+}
+
+CSGRenderer::FrameResources CSGRenderer::CreateFrameResources(const vk::PhysicalDeviceMemoryProperties& memory_properties)
+{
+	FrameResources frame_resources;
+
+	{ // Create staging buffer.
+		frame_resources.staging_buffer=
+			vk_device_.createBufferUnique(
+				vk::BufferCreateInfo(
+					vk::BufferCreateFlags(),
+					staging_buffer_size_,
+					vk::BufferUsageFlagBits::eTransferSrc));
+
+		const vk::MemoryRequirements buffer_memory_requirements= vk_device_.getBufferMemoryRequirements(*frame_resources.staging_buffer);
+
+		const vk::MemoryPropertyFlags required_flags= vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+		vk::MemoryAllocateInfo vk_memory_allocate_info(buffer_memory_requirements.size, ~0u);
+		for(uint32_t i= 0u; i < memory_properties.memoryTypeCount; ++i)
+		{
+			if((buffer_memory_requirements.memoryTypeBits & (1u << i)) != 0 &&
+				(memory_properties.memoryTypes[i].propertyFlags & required_flags) == required_flags)
+			{
+				vk_memory_allocate_info.memoryTypeIndex= i;
+				break;
+			}
+		}
+		if(vk_memory_allocate_info.memoryTypeIndex == ~0u)
+			Log::FatalError("Could not find host-visible memory for scene staging buffer");
+
+		frame_resources.staging_buffer_memory= vk_device_.allocateMemoryUnique(vk_memory_allocate_info);
+		vk_device_.bindBufferMemory(*frame_resources.staging_buffer, *frame_resources.staging_buffer_memory, 0u);
+
+		frame_resources.staging_buffer_mapped=
+			reinterpret_cast<char*>(vk_device_.mapMemory(*frame_resources.staging_buffer_memory, 0u, vk::DeviceSize(staging_buffer_size_)));
+	}
+
+	CreateDeviceLocalBuffer(
+		vk_device_, memory_properties,
+		surfaces_buffer_size_,
+		vk::BufferUsageFlagBits::eStorageBuffer,
+		frame_resources.surfaces_data_buffer, frame_resources.surfaces_data_buffer_memory);
+
+	CreateDeviceLocalBuffer(
+		vk_device_, memory_properties,
+		expressions_buffer_size_,
+		vk::BufferUsageFlagBits::eStorageBuffer,
+		frame_resources.expressions_data_buffer, frame_resources.expressions_data_buffer_memory);
+
+	CreateDeviceLocalBuffer(
+		vk_device_, memory_properties,
+		transforms_buffer_size_,
+		vk::BufferUsageFlagBits::eStorageBuffer,
+		frame_resources.transforms_data_buffer, frame_resources.transforms_data_buffer_memory);
+
+	CreateDeviceLocalBuffer(
+		vk_device_, memory_properties,
+		vertex_buffer_vertices_ * sizeof(SurfaceVertex),
+		vk::BufferUsageFlagBits::eVertexBuffer,
+		frame_resources.vertex_buffer, frame_resources.vertex_buffer_memory);
+
+	CreateDeviceLocalBuffer(
+		vk_device_, memory_properties,
+		index_buffer_indeces_ * sizeof(IndexType),
+		vk::BufferUsageFlagBits::eIndexBuffer,
+		frame_resources.index_buffer, frame_resources.index_buffer_memory);
+
 	{ // Create and fill descriptor set
-		descriptor_set_=
+		frame_resources.descriptor_set=
 			std::move(
 			vk_device_.allocateDescriptorSetsUnique(
 				vk::DescriptorSetAllocateInfo(
@@ -260,19 +447,24 @@ CSGRenderer::CSGRenderer(I_WindowVulkan& window_vulkan)
 					1u, &*descriptor_set_layout_)).front());
 
 		const vk::DescriptorBufferInfo descriptor_buffer_info_surfaces(
-			*surfaces_data_buffer_gpu_,
+			*frame_resources.surfaces_data_buffer,
 			0u,
 			surfaces_buffer_size_);
 
 		const vk::DescriptorBufferInfo descriptor_buffer_info_expressions(
-			*expressions_data_buffer_gpu_,
+			*frame_resources.expressions_data_buffer,
 			0u,
 			expressions_buffer_size_);
 
+		const vk::DescriptorBufferInfo descriptor_buffer_info_transforms(
+			*frame_resources.transforms_data_buffer,
+			0u,
+			transforms_buffer_size_);
+
 		vk_device_.updateDescriptorSets(
 			{
 				{
-					*descriptor_set_,
+					*frame_resources.descriptor_set,
 					0u,
 					0u,
 					1u,
@@ -282,7 +474,7 @@ CSGRenderer::CSGRenderer(I_WindowVulkan& window_vulkan)
 					nullptr,
 				},
 				{
-					*descriptor_set_,
+					*frame_resources.descriptor_set,
 					1u,
 					0u,
 					1u,
@@ -291,118 +483,200 @@ CSGRenderer::CSGRenderer(I_WindowVulkan& window_vulkan)
 					&descriptor_buffer_info_expressions,
 					nullptr,
 				},
+				{
+					*frame_resources.descriptor_set,
+					2u,
+					0u,
+					1u,
+					vk::DescriptorType::eStorageBuffer,
+					nullptr,
+					&descriptor_buffer_info_transforms,
+					nullptr,
+				},
 			},
 			{});
 	}
 
-	{ // Create vertex buffer.
-		vertex_buffer_vertices_= 1024u * 1024u;
-
-		vertex_buffer_=
-			vk_device_.createBufferUnique(
-				vk::BufferCreateInfo(
-					vk::BufferCreateFlags(),
-					vertex_buffer_vertices_ * sizeof(SurfaceVertex),
-					vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst));
-
-		const vk::MemoryRequirements buffer_memory_requirements= vk_device_.getBufferMemoryRequirements(*vertex_buffer_);
-
-			vk::MemoryAllocateInfo vk_memory_allocate_info(buffer_memory_requirements.size);
-			for(uint32_t i= 0u; i < memory_properties.memoryTypeCount; ++i)
-			{
-				if((buffer_memory_requirements.memoryTypeBits & (1u << i)) != 0 &&
-					(memory_properties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) != vk::MemoryPropertyFlags())
-					vk_memory_allocate_info.memoryTypeIndex= i;
-			}
-
-			vertex_buffer_memory_= vk_device_.allocateMemoryUnique(vk_memory_allocate_info);
-			vk_device_.bindBufferMemory(*vertex_buffer_, *vertex_buffer_memory_, 0u);
-	}
-	{ // Create index buffer.
-		index_buffer_indeces_= 1024u * 1024u * 2u;
-
-		index_buffer_=
-				vk_device_.createBufferUnique(
-					vk::BufferCreateInfo(
-						vk::BufferCreateFlags(),
-						index_buffer_indeces_ * sizeof(IndexType),
-						vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst));
+	return frame_resources;
+}
 
-			const vk::MemoryRequirements buffer_memory_requirements= vk_device_.getBufferMemoryRequirements(*index_buffer_);
+vk::UniquePipeline CSGRenderer::CreatePipeline(const vk::ShaderModule shader_frag) const
+{
+	const vk::PipelineShaderStageCreateInfo vk_shader_stage_create_info[]
+	{
+		{
+			vk::PipelineShaderStageCreateFlags(),
+			vk::ShaderStageFlagBits::eVertex,
+			*shader_vert_,
+			"main"
+		},
+		{
+			vk::PipelineShaderStageCreateFlags(),
+			vk::ShaderStageFlagBits::eFragment,
+			shader_frag,
+			"main"
+		},
+	};
 
-			vk::MemoryAllocateInfo vk_memory_allocate_info(buffer_memory_requirements.size);
-			for(uint32_t i= 0u; i < memory_properties.memoryTypeCount; ++i)
-			{
-				if((buffer_memory_requirements.memoryTypeBits & (1u << i)) != 0 &&
-					(memory_properties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) != vk::MemoryPropertyFlags())
-					vk_memory_allocate_info.memoryTypeIndex= i;
-			}
+	const vk::VertexInputBindingDescription vk_vertex_input_binding_description(
+		0u,
+		sizeof(SurfaceVertex),
+		vk::VertexInputRate::eVertex);
 
-			index_buffer_memory_= vk_device_.allocateMemoryUnique(vk_memory_allocate_info);
-			vk_device_.bindBufferMemory(*index_buffer_, *index_buffer_memory_, 0u);
-	}
-}
+	const vk::VertexInputAttributeDescription vk_vertex_input_attribute_description[1]
+	{
+		{0u, 0u, vk::Format::eR32G32B32A32Sfloat, offsetof(SurfaceVertex, pos)},
+	};
 
-CSGRenderer::~CSGRenderer()
-{
-	// Sync before destruction.
-	vk_device_.waitIdle();
+	const vk::PipelineVertexInputStateCreateInfo vk_pipiline_vertex_input_state_create_info(
+		vk::PipelineVertexInputStateCreateFlags(),
+		1u, &vk_vertex_input_binding_description,
+		uint32_t(std::size(vk_vertex_input_attribute_description)), vk_vertex_input_attribute_description);
+
+	const vk::PipelineInputAssemblyStateCreateInfo vk_pipeline_input_assembly_state_create_info(
+		vk::PipelineInputAssemblyStateCreateFlags(),
+		vk::PrimitiveTopology::eTriangleList);
+
+	// Viewport and scissor are dynamic, so pipeline does not depend on framebuffer size.
+	const vk::PipelineViewportStateCreateInfo vk_pipieline_viewport_state_create_info(
+		vk::PipelineViewportStateCreateFlags(),
+		1u, nullptr,
+		1u, nullptr);
+
+	const vk::DynamicState dynamic_states[]{ vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+	const vk::PipelineDynamicStateCreateInfo pipeline_dynamic_state_create_info(
+		vk::PipelineDynamicStateCreateFlags(),
+		uint32_t(std::size(dynamic_states)), dynamic_states);
+
+	const vk::PipelineRasterizationStateCreateInfo vk_pipilane_rasterization_state_create_info(
+		vk::PipelineRasterizationStateCreateFlags(),
+		VK_FALSE,
+		VK_FALSE,
+		vk::PolygonMode::eFill,
+		vk::CullModeFlagBits::eFront,
+		vk::FrontFace::eClockwise,
+		VK_FALSE, 0.0f, 0.0f, 0.0f,
+		1.0f);
+
+	const vk::PipelineMultisampleStateCreateInfo vk_pipeline_multisample_state_create_info;
+
+	const vk::PipelineDepthStencilStateCreateInfo vk_pipeline_depth_state_create_info(
+		vk::PipelineDepthStencilStateCreateFlags(),
+		VK_TRUE,
+		VK_TRUE,
+		vk::CompareOp::eLess,
+		VK_FALSE,
+		VK_FALSE,
+		vk::StencilOpState(),
+		vk::StencilOpState(),
+		0.0f,
+		1.0f);
+
+	const vk::PipelineColorBlendAttachmentState pipeline_color_blend_attachment_state(
+		VK_FALSE,
+		vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd,
+		vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd,
+		vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+
+	const vk::PipelineColorBlendStateCreateInfo vk_pipeline_color_blend_state_create_info(
+		vk::PipelineColorBlendStateCreateFlags(),
+		VK_FALSE,
+		vk::LogicOp::eCopy,
+		1u, &pipeline_color_blend_attachment_state);
+
+	return
+		vk_device_.createGraphicsPipelineUnique(
+			pipeline_cache_,
+			vk::GraphicsPipelineCreateInfo(
+				vk::PipelineCreateFlags(),
+				uint32_t(std::size(vk_shader_stage_create_info)), vk_shader_stage_create_info,
+				&vk_pipiline_vertex_input_state_create_info,
+				&vk_pipeline_input_assembly_state_create_info,
+				nullptr,
+				&vk_pipieline_viewport_state_create_info,
+				&vk_pipilane_rasterization_state_create_info,
+				&vk_pipeline_multisample_state_create_info,
+				&vk_pipeline_depth_state_create_info,
+				&vk_pipeline_color_blend_state_create_info,
+				&pipeline_dynamic_state_create_info,
+				*pipeline_layout_,
+				tonemapper_.GetMainRenderPass(),
+				0u));
 }
 
-void CSGRenderer::BeginFrame(
-	const vk::CommandBuffer command_buffer,
-	const CameraController& camera_controller,
-	const CSGTree::CSGTreeNode& csg_tree)
+CSGRenderer::SpecializedPipeline CSGRenderer::BuildSpecializedPipeline(std::shared_ptr<const CSGSceneData> scene) const
 {
-	VerticesVector vertices;
-	IndicesVector indices;
-	GPUSurfacesVector surfaces;
-	CSGExpressionGPUBuffer expressions;
-	BuildSceneMeshTree(vertices, indices, expressions, BuildLowLevelTree(surfaces, csg_tree));
-
-	const auto update_buffer=
-	[&](const auto& vec, const vk::UniqueBuffer& buffer)
-	{
-		const size_t data_size= vec.size() * sizeof(vec[0]);
-		const size_t update_granularity= 65536u; // Max size for "VkCmdUpdateBuffer"
-		for(size_t offset= 0; offset < data_size; offset+= update_granularity)
-			command_buffer.updateBuffer(
-				*buffer,
-				vk::DeviceSize(offset),
-				vk::DeviceSize(std::min(data_size - offset, update_granularity)),
-				reinterpret_cast<const char*>(vec.data()) + offset);
-	};
+	SpecializedPipeline result;
+	result.scene= std::move(scene);
 
-	if(vertices.size() > vertex_buffer_vertices_)
-		Log::FatalError("Vertices buffer overflow");
-	update_buffer(vertices, vertex_buffer_);
+	const std::string source=
+		GenerateSpecializedSurfaceFragmentShader(result.scene->surfaces, result.scene->transforms, result.scene->expressions);
+	if(source.empty())
+		return result; // Scene is too large - use generic shader.
 
-	if(indices.size() > index_buffer_indeces_)
-		Log::FatalError("Indices buffer overflow");
-	update_buffer(indices, index_buffer_);
+	const std::vector<uint32_t> spirv= CompileFragmentShader(source);
+	if(spirv.empty())
+	{
+		Log::Warning("Can not build specialized shader, using generic shader");
+		return result;
+	}
 
-	if(surfaces.size() * sizeof(GPUSurface) > surfaces_buffer_size_)
-		Log::FatalError("Surfaces buffer overflow");
-	update_buffer(surfaces, surfaces_data_buffer_gpu_);
+	result.shader_frag=
+		vk_device_.createShaderModuleUnique(
+			vk::ShaderModuleCreateInfo(vk::ShaderModuleCreateFlags(),
+			spirv.size() * sizeof(uint32_t),
+			spirv.data()));
 
-	if(expressions.size() * sizeof(CSGExpressionGPUBufferType) > expressions_buffer_size_)
-		Log::FatalError("Expressions buffer overflow");
-	update_buffer(expressions, expressions_data_buffer_gpu_);
+	// Pipeline cache is internally synchronized, so it is safe to create pipelines in parallel with main thread.
+	result.pipeline= CreatePipeline(*result.shader_frag);
+	return result;
+}
 
-	tonemapper_.DoMainPass(
-		command_buffer,
+void CSGRenderer::UpdateSpecializedPipeline(const bool wait)
+{
+	const auto take_result=
 		[&]
 		{
-			Draw(command_buffer, camera_controller, indices.size());
-		});
+			RetireSpecializedPipeline();
+			specialized_pipeline_= specialized_pipeline_future_.get();
+		};
+
+	if(specialized_pipeline_future_.valid() &&
+		(wait || specialized_pipeline_future_.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+		take_result();
+
+	// Scene is identified by pointer, since scene data is immutable. Build for only one scene is performed at time.
+	if(use_specialized_shaders_ && specialized_pipeline_.scene != scene_ && !specialized_pipeline_future_.valid())
+	{
+		specialized_pipeline_future_=
+			std::async(
+				std::launch::async,
+				[this, scene= scene_]
+				{
+					return BuildSpecializedPipeline(scene);
+				});
+		if(wait)
+			take_result();
+	}
 }
 
-void CSGRenderer::EndFrame(const vk::CommandBuffer command_buffer)
+void CSGRenderer::RetireSpecializedPipeline()
 {
-	tonemapper_.EndFrame(command_buffer);
+	if(specialized_pipeline_.pipeline || specialized_pipeline_.shader_frag)
+	{
+		RetiredSpecializedPipeline retired;
+		retired.pipeline= std::move(specialized_pipeline_);
+		retired.frames_left= frames_resources_.size();
+		retired_specialized_pipelines_.push_back(std::move(retired));
+	}
+	specialized_pipeline_= SpecializedPipeline();
 }
 
-void CSGRenderer::Draw(const vk::CommandBuffer command_buffer, const CameraController& camera_controller, const size_t index_count)
+void CSGRenderer::Draw(
+	const vk::CommandBuffer command_buffer,
+	const CameraController& camera_controller,
+	const FrameResources& frame_resources,
+	const size_t index_count)
 {
 	Uniforms uniforms{};
 	uniforms.view_matrix= camera_controller.CalculateFullViewMatrix();
@@ -421,13 +695,24 @@ void CSGRenderer::Draw(const vk::CommandBuffer command_buffer, const CameraContr
 	uniforms.ambient_light_color[1]= 0.3f;
 	uniforms.ambient_light_color[2]= 0.4f;
 
-	command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipeline_);
+	// Specialized pipeline may be built for other scene, than scene, uploaded into buffers of this frame.
+	const bool use_specialized_pipeline=
+		use_specialized_shaders_ &&
+		specialized_pipeline_.pipeline &&
+		specialized_pipeline_.scene == frame_resources.uploaded_scene;
+	command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, use_specialized_pipeline ? *specialized_pipeline_.pipeline : *pipeline_);
+
+	const vk::Extent2D viewport_size= tonemapper_.GetRenderSize();
+	const vk::Viewport viewport(0.0f, 0.0f, float(viewport_size.width), float(viewport_size.height), 0.0f, 1.0f);
+	const vk::Rect2D scissor(vk::Offset2D(0, 0), viewport_size);
+	command_buffer.setViewport(0u, 1u, &viewport);
+	command_buffer.setScissor(0u, 1u, &scissor);
 
 	command_buffer.bindDescriptorSets(
 		vk::PipelineBindPoint::eGraphics,
 		*pipeline_layout_,
 		0u,
-		1u, &*descriptor_set_,
+		1u, &*frame_resources.descriptor_set,
 		0u, nullptr);
 
 	command_buffer.pushConstants(
@@ -438,8 +723,8 @@ void CSGRenderer::Draw(const vk::CommandBuffer command_buffer, const CameraContr
 		&uniforms);
 
 	const vk::DeviceSize offsets= 0u;
-	command_buffer.bindVertexBuffers(0u, 1u, &*vertex_buffer_, &offsets);
-	command_buffer.bindIndexBuffer(*index_buffer_, 0u, sizeof(IndexType) == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32);
+	command_buffer.bindVertexBuffers(0u, 1u, &*frame_resources.vertex_buffer, &offsets);
+	command_buffer.bindIndexBuffer(*frame_resources.index_buffer, 0u, sizeof(IndexType) == 2 ? vk::IndexType::eUint16 : vk::IndexType::eUint32);
 
 	command_buffer.drawIndexed(uint32_t(index_count), 1u, 0u, 0u, 0u);
 }
@@ -1,8 +1,10 @@
 #pragma once
 #include "CameraController.hpp"
-#include "CSGExpressionTree.hpp"
+#include "CSGDataGPU.hpp"
+#include "RenderScaleController.hpp"
 #include "Tonemapper.hpp"
 #include "I_WindowVulkan.hpp"
+#include <future>
 
 namespace SZV
 {
@@ -13,43 +15,144 @@ public:
 	explicit CSGRenderer(I_WindowVulkan& window_vulkan);
 	~CSGRenderer();
 
-	void BeginFrame(
-		vk::CommandBuffer command_buffer,
-		const CameraController& camera_controller,
-		const CSGTree::CSGTreeNode& csg_tree);
+	// Draw scene, set previously. Scene is uploaded only into frames, where it is not uploaded yet.
+	void BeginFrame(vk::CommandBuffer command_buffer, const CameraController& camera_controller);
 	void EndFrame(vk::CommandBuffer command_buffer);
 
+	// Set scene, built outside renderer (in background thread, for example). Null means empty scene.
+	void SetScene(std::shared_ptr<const CSGSceneData> scene);
+
+	// Recreate only resources, which depend on viewport size. Pipelines are preserved.
+	void Resize(vk::Extent2D viewport_size);
+
+	// Use fragment shader, generated for current scene, with expressions compiled into straight-line code.
+	// Shader is built in background thread for each new scene, generic shader is used until it is ready.
+	void SetUseSpecializedShaders(bool use);
+	// Build specialized shader for current scene (if it is enabled) and wait for it. Useful for reproducible results.
+	void WaitForSpecializedPipeline();
+
+	// Change resolution of main pass for holding target GPU frame time. Result is upscaled in tonemapping pass.
+	// GPU profiler is required for frame time measurement.
+	void SetDynamicResolution(bool enable, const RenderScaleSettings& settings= RenderScaleSettings());
+
+	// Profiler for measuring of render stages. May be null.
+	void SetGPUProfiler(GPUProfiler* profiler);
+
+	// Use fixed time step for time-dependent effects instead of real time. Zero means real time.
+	void SetFixedTimeStep(float time_step_s);
+
+	void SetExposureSettings(const ExposureSettings& settings);
+	const ExposureSettings& GetExposureSettings() const;
+
+	// See Tonemapper.
+	void SetExposureReadback(bool enable);
+	bool GetExposureReadback(ExposureCalculationResult& out_result) const;
+
 private:
-	void Draw(vk::CommandBuffer command_buffer, const CameraController& camera_controller, size_t index_count);
+	// Scene buffers and descriptor set for one frame in flight.
+	// Each frame writes only into its own set, so scene of next frame may be uploaded while GPU still renders previous frame.
+	struct FrameResources
+	{
+		// Host-visible, persistently mapped. Scene data is written here by CPU and then copied into device-local buffers.
+		vk::UniqueBuffer staging_buffer;
+		vk::UniqueDeviceMemory staging_buffer_memory;
+		char* staging_buffer_mapped= nullptr;
+
+		vk::UniqueBuffer surfaces_data_buffer;
+		vk::UniqueDeviceMemory surfaces_data_buffer_memory;
+
+		vk::UniqueBuffer expressions_data_buffer;
+		vk::UniqueDeviceMemory expressions_data_buffer_memory;
+
+		vk::UniqueBuffer transforms_data_buffer;
+		vk::UniqueDeviceMemory transforms_data_buffer_memory;
+
+		vk::UniqueBuffer vertex_buffer;
+		vk::UniqueDeviceMemory vertex_buffer_memory;
+
+		vk::UniqueBuffer index_buffer;
+		vk::UniqueDeviceMemory index_buffer_memory;
+
+		vk::UniqueDescriptorSet descriptor_set;
+
+		// Scene, which data is in buffers of this frame.
+		std::shared_ptr<const CSGSceneData> uploaded_scene;
+	};
+
+	struct SpecializedPipeline
+	{
+		std::shared_ptr<const CSGSceneData> scene; // Scene, for which pipeline is built.
+		vk::UniqueShaderModule shader_frag;
+		vk::UniquePipeline pipeline; // May be null if specialized shader can not be built.
+	};
+
+	// Pipeline, which is replaced, but may be still used by frames in flight.
+	struct RetiredSpecializedPipeline
+	{
+		SpecializedPipeline pipeline;
+		size_t frames_left= 0u;
+	};
+
+private:
+	FrameResources CreateFrameResources(const vk::PhysicalDeviceMemoryProperties& memory_properties);
+	vk::UniquePipeline CreatePipeline(vk::ShaderModule shader_frag) const;
+	// Called from background thread.
+	SpecializedPipeline BuildSpecializedPipeline(std::shared_ptr<const CSGSceneData> scene) const;
+	void UpdateSpecializedPipeline(bool wait);
+	void RetireSpecializedPipeline();
+	void Draw(
+		vk::CommandBuffer command_buffer,
+		const CameraController& camera_controller,
+		const FrameResources& frame_resources,
+		size_t index_count);
 
 private:
+	I_WindowVulkan& window_vulkan_;
 	const vk::Device vk_device_;
+	const vk::PipelineCache pipeline_cache_;
 	Tonemapper tonemapper_;
 
+	GPUProfiler* gpu_profiler_= nullptr;
+
+	bool dynamic_resolution_= false;
+	RenderScaleController render_scale_controller_;
+	// Render scale of recent frames, indexed by profiler frame index, for matching with profiler results.
+	float render_scale_history_[8]{};
+	uint64_t last_processed_profiler_frame_= ~uint64_t(0);
+
 	vk::UniqueShaderModule shader_vert_;
 	vk::UniqueShaderModule shader_frag_;
 	vk::UniqueDescriptorSetLayout descriptor_set_layout_;
 	vk::UniquePipelineLayout pipeline_layout_;
 	vk::UniquePipeline pipeline_;
 
+	bool use_specialized_shaders_= false;
+	SpecializedPipeline specialized_pipeline_;
+	std::vector<RetiredSpecializedPipeline> retired_specialized_pipelines_;
+
 	vk::UniqueDescriptorPool descriptor_pool_;
-	vk::UniqueDescriptorSet descriptor_set_;
 
-	vk::UniqueBuffer surfaces_data_buffer_gpu_;
-	vk::UniqueDeviceMemory surfaces_data_buffer_memory_;
+	// Sizes of buffers, same for all frames.
 	size_t surfaces_buffer_size_= 0;
-
-	vk::UniqueBuffer expressions_data_buffer_gpu_;
-	vk::UniqueDeviceMemory expressions_data_buffer_memory_;
 	size_t expressions_buffer_size_= 0;
-
+	size_t transforms_buffer_size_= 0;
 	size_t vertex_buffer_vertices_= 0;
-	vk::UniqueBuffer vertex_buffer_;
-	vk::UniqueDeviceMemory vertex_buffer_memory_;
-
 	size_t index_buffer_indeces_= 0;
-	vk::UniqueBuffer index_buffer_;
-	vk::UniqueDeviceMemory index_buffer_memory_;
+
+	// Offsets of data in staging buffer.
+	size_t staging_vertices_offset_= 0;
+	size_t staging_indices_offset_= 0;
+	size_t staging_surfaces_offset_= 0;
+	size_t staging_expressions_offset_= 0;
+	size_t staging_transforms_offset_= 0;
+	size_t staging_buffer_size_= 0;
+
+	std::vector<FrameResources> frames_resources_; // One set for each frame in flight.
+
+	std::shared_ptr<const CSGSceneData> scene_;
+
+	// Result of specialized pipeline build in background thread. Declared last, to be destroyed before resources, used by it.
+	std::future<SpecializedPipeline> specialized_pipeline_future_;
 };
 
 } // namespace SZV
@@ -0,0 +1,80 @@
+#include "CSGSceneBuildThread.hpp"
+#include "Profiler.hpp"
+
+namespace SZV
+{
+
+CSGSceneBuildThread::CSGSceneBuildThread()
+{
+	thread_= std::thread([this]{ ThreadFunc(); });
+}
+
+CSGSceneBuildThread::~CSGSceneBuildThread()
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex_);
+		stop_= true;
+		pending_tree_= nullptr;
+	}
+	cv_.notify_one();
+
+	// Wait for finish of running build, if it exists.
+	thread_.join();
+}
+
+void CSGSceneBuildThread::RequestBuild(CSGTreePersistent::NodePtr tree)
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex_);
+		if(tree == last_requested_tree_)
+			return;
+
+		last_requested_tree_= tree;
+		// Replace previous request, if it is not yet started.
+		pending_tree_= std::move(tree);
+	}
+	cv_.notify_one();
+}
+
+std::shared_ptr<const CSGSceneData> CSGSceneBuildThread::GetLastResult() const
+{
+	const std::lock_guard<std::mutex> lock(mutex_);
+	return last_result_;
+}
+
+bool CSGSceneBuildThread::IsBuilding() const
+{
+	const std::lock_guard<std::mutex> lock(mutex_);
+	return build_running_ || pending_tree_ != nullptr;
+}
+
+void CSGSceneBuildThread::ThreadFunc()
+{
+	while(true)
+	{
+		CSGTreePersistent::NodePtr tree;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cv_.wait(lock, [this]{ return stop_ || pending_tree_ != nullptr; });
+			if(stop_)
+				break;
+
+			tree= std::move(pending_tree_);
+			pending_tree_= nullptr;
+			build_running_= true;
+		}
+
+		std::shared_ptr<const CSGSceneData> result;
+		{
+			SZV_PROFILE_ZONE("CSGSceneBuildThread::Build");
+			result= std::make_shared<const CSGSceneData>(BuildCSGSceneData(MakeCSGTree(tree)));
+		}
+
+		// Publish result even if newer version is already requested - it is still closer to current state than previous result.
+		const std::lock_guard<std::mutex> lock(mutex_);
+		last_result_= std::move(result);
+		build_running_= false;
+	}
+}
+
+} // namespace SZV
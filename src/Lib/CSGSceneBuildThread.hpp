@@ -0,0 +1,50 @@
+#pragma once
+#include "CSGDataGPU.hpp"
+#include "CSGTreePersistent.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace SZV
+{
+
+// Builds scene data in background thread, so building of large scene does not block caller (render loop or UI).
+// Tree versions are immutable, so worker reads them without synchronization with editing.
+// Each requested version is converted into full CSG tree (via "MakeCSGTree") and scene data is rebuilt completely - incremental rebuild is not implemented.
+// Only one build is running at once. Requests, arrived while build is running, are merged - only latest of them is built after it.
+class CSGSceneBuildThread final
+{
+public:
+	CSGSceneBuildThread();
+	~CSGSceneBuildThread();
+
+	CSGSceneBuildThread(const CSGSceneBuildThread&)= delete;
+	CSGSceneBuildThread& operator=(const CSGSceneBuildThread&)= delete;
+
+	// Does nothing if same version is already requested.
+	void RequestBuild(CSGTreePersistent::NodePtr tree);
+
+	// Result of last finished build. Returns null if no build is finished yet.
+	// Result is not replaced until next build is finished, so it may be used for rendering while next build is running.
+	std::shared_ptr<const CSGSceneData> GetLastResult() const;
+
+	// Returns true if there is requested but not finished build.
+	bool IsBuilding() const;
+
+private:
+	void ThreadFunc();
+
+private:
+	mutable std::mutex mutex_;
+	std::condition_variable cv_;
+
+	CSGTreePersistent::NodePtr last_requested_tree_;
+	CSGTreePersistent::NodePtr pending_tree_; // Not yet taken by worker.
+	bool build_running_= false;
+	bool stop_= false;
+	std::shared_ptr<const CSGSceneData> last_result_;
+
+	std::thread thread_;
+};
+
+} // namespace SZV
@@ -0,0 +1,252 @@
+#include "CSGShaderGenerator.hpp"
+#include "Assert.hpp"
+#include "CacheDirectory.hpp"
+#include "Log.hpp"
+#include "Process.hpp"
+#include "SHA256.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#ifndef SZV_GLSLANGVALIDATOR
+#define SZV_GLSLANGVALIDATOR "glslangValidator"
+#endif
+
+namespace SZV
+{
+
+namespace
+{
+
+namespace Shaders
+{
+#include "shaders/surface.frag.source.h"
+} // namespace Shaders
+
+std::string FloatLiteral(const float f)
+{
+	char buf[64];
+	std::snprintf(buf, sizeof(buf), "%.9g", double(f));
+	std::string result= buf;
+	if(result.find_first_of(".e") == std::string::npos)
+		result+= ".0";
+	return "(" + result + ")";
+}
+
+std::string GenerateLeafValue(const GPUSurface& s)
+{
+	const std::pair<float, const char*> terms[]
+	{
+		{ s.xx, "pos.x * pos.x" },
+		{ s.yy, "pos.y * pos.y" },
+		{ s.zz, "pos.z * pos.z" },
+		{ s.xy, "pos.x * pos.y" },
+		{ s.xz, "pos.x * pos.z" },
+		{ s.yz, "pos.y * pos.z" },
+		{ s.x, "pos.x" },
+		{ s.y, "pos.y" },
+		{ s.z, "pos.z" },
+	};
+
+	std::string sum;
+	for(const auto& term : terms)
+	{
+		if(term.first == 0.0f)
+			continue;
+		sum+= FloatLiteral(term.first) + " * " + term.second + " + ";
+	}
+	sum+= FloatLiteral(s.k);
+	return "(" + sum + " < 0.0)";
+}
+
+std::string ReadTextFile(const std::filesystem::path& path)
+{
+	std::ifstream file(path);
+	std::ostringstream stream;
+	stream << file.rdbuf();
+	return stream.str();
+}
+
+std::vector<uint32_t> ReadBinaryFile(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if(!file)
+		return {};
+
+	file.seekg(0, std::ios::end);
+	const std::streamoff size= file.tellg();
+	file.seekg(0, std::ios::beg);
+	if(size <= 0 || size % std::streamoff(sizeof(uint32_t)) != 0)
+		return {};
+
+	std::vector<uint32_t> result(size_t(size) / sizeof(uint32_t));
+	file.read(reinterpret_cast<char*>(result.data()), size);
+	if(!file)
+		return {};
+
+	return result;
+}
+
+} // namespace
+
+std::string GenerateSpecializedSurfaceFragmentShader(
+	const GPUSurfacesVector& surfaces,
+	const GPUTransformsVector& transforms,
+	const CSGExpressionGPUBuffer& expressions,
+	const size_t max_expressions_size)
+{
+	if(expressions.size() > max_expressions_size)
+		return std::string();
+
+	std::string code;
+	code+= "#define SPECIALIZED_CSG_EXPRESSIONS\n";
+	code+= "bool IsInsideFigureSpecialized(int offset, vec3 pos)\n";
+	code+= "{\n";
+	code+= "\tswitch(offset)\n";
+	code+= "\t{\n";
+
+	std::vector<size_t> stack;
+	size_t offset= 0u;
+	while(offset < expressions.size())
+	{
+		const size_t start_offset= offset;
+		const size_t end_offset= expressions[offset + 2u];
+		offset+= 3u;
+
+		code+= "\tcase " + std::to_string(start_offset) + ":\n";
+		code+= "\t\t{\n";
+
+		stack.clear();
+		size_t value_index= 0u;
+		while(offset < end_offset)
+		{
+			const auto op= GPUCSGExpressionCodes(expressions[offset]);
+			++offset;
+
+			std::string value;
+			switch(op)
+			{
+			case GPUCSGExpressionCodes::Mul:
+			case GPUCSGExpressionCodes::Add:
+			case GPUCSGExpressionCodes::Sub:
+				{
+					SZV_ASSERT(stack.size() >= 2u);
+					const std::string r= "v" + std::to_string(stack.back());
+					stack.pop_back();
+					const std::string l= "v" + std::to_string(stack.back());
+					stack.pop_back();
+
+					if(op == GPUCSGExpressionCodes::Mul)
+						value= l + " && " + r;
+					else if(op == GPUCSGExpressionCodes::Add)
+						value= l + " || " + r;
+					else
+						value= l + " && !" + r;
+				}
+				break;
+
+			case GPUCSGExpressionCodes::Leaf:
+				value= GenerateLeafValue(surfaces[expressions[offset]]);
+				++offset;
+				break;
+
+			case GPUCSGExpressionCodes::InstancedLeaf:
+				value= GenerateLeafValue(GetWorldSpaceSurface(surfaces[expressions[offset]], transforms[expressions[offset + 1u]]));
+				offset+= 2u;
+				break;
+
+			case GPUCSGExpressionCodes::OneLeaf:
+				value= "true";
+				break;
+			}
+
+			code+= "\t\t\tbool v" + std::to_string(value_index) + "= " + value + ";\n";
+			stack.push_back(value_index);
+			++value_index;
+		}
+		SZV_ASSERT(stack.size() == 1u);
+
+		code+= "\t\t\treturn v" + std::to_string(stack.back()) + ";\n";
+		code+= "\t\t}\n";
+	}
+
+	code+= "\t}\n";
+	code+= "\treturn false;\n";
+	code+= "}\n";
+
+	// Insert generated code after version directive.
+	std::string source= Shaders::surface_frag_source;
+	const size_t version_end= source.find('\n');
+	SZV_ASSERT(version_end != std::string::npos);
+	source.insert(version_end + 1u, code);
+	return source;
+}
+
+std::vector<uint32_t> CompileFragmentShader(const std::string& source, const std::string& cache_directory)
+{
+	// Shaders from cache are loaded without checks, so cache must be writable only by current user.
+	const std::optional<std::filesystem::path> directory= GetCacheDirectory("shaders", cache_directory);
+	if(directory == std::nullopt)
+		return {};
+
+	SHA256 hasher;
+	hasher.Update(source);
+	const std::string hash_str= SHA256DigestToHex(hasher.Finish());
+	const std::filesystem::path spirv_path= *directory / ("surface_" + hash_str + ".spv");
+
+	if(std::filesystem::exists(spirv_path))
+	{
+		std::vector<uint32_t> result= ReadBinaryFile(spirv_path);
+		if(!result.empty())
+			return result;
+	}
+
+	// Other processes may compile same shader at same time, so intermediate files are created in private directory.
+	// Result is moved into cache atomically, so only complete file may be loaded.
+	const std::optional<std::filesystem::path> work_directory= CreatePrivateWorkDirectory(*directory);
+	if(work_directory == std::nullopt)
+		return {};
+
+	const auto compile=
+		[&]() -> bool
+		{
+			const std::filesystem::path source_path= *work_directory / "surface.frag";
+			const std::filesystem::path spirv_temp_path= *work_directory / "surface.spv";
+			const std::filesystem::path log_path= *work_directory / "surface.log";
+			{
+				std::ofstream source_file(source_path);
+				source_file << source;
+				if(!source_file)
+				{
+					Log::Warning("Can not write ", source_path.string());
+					return false;
+				}
+			}
+
+			if(!RunProcess({ SZV_GLSLANGVALIDATOR, "-V", source_path.string(), "-o", spirv_temp_path.string() }, log_path.string()))
+			{
+				Log::Warning("Shader compilation failed\n", ReadTextFile(log_path));
+				return false;
+			}
+
+			std::error_code ec;
+			std::filesystem::rename(spirv_temp_path, spirv_path, ec);
+			if(ec)
+			{
+				Log::Warning("Can not rename ", spirv_temp_path.string(), ": ", ec.message());
+				return false;
+			}
+			return true;
+		};
+
+	const bool compiled= compile();
+
+	std::error_code ec;
+	std::filesystem::remove_all(*work_directory, ec);
+	if(!compiled)
+		return {};
+
+	return ReadBinaryFile(spirv_path);
+}
+
+} // namespace SZV
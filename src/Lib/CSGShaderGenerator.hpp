@@ -0,0 +1,23 @@
+#pragma once
+#include "CSGDataGPU.hpp"
+#include <string>
+
+namespace SZV
+{
+
+// Generate source of surface fragment shader, specialized for given scene.
+// Expression of each leaf is translated into straight-line code with surface coefficients as constants.
+// Instanced surfaces are transformed into world space, so generated code contains no transformations.
+// Returns empty string if scene is too large for specialization.
+std::string GenerateSpecializedSurfaceFragmentShader(
+	const GPUSurfacesVector& surfaces,
+	const GPUTransformsVector& transforms,
+	const CSGExpressionGPUBuffer& expressions,
+	size_t max_expressions_size= 16384u);
+
+// Compile GLSL fragment shader into SPIR-V, using external compiler.
+// Results are cached on disk by SHA-256 of source. Empty cache directory means per-user cache directory (see "GetCacheDirectory").
+// Returns empty vector in case of failure.
+std::vector<uint32_t> CompileFragmentShader(const std::string& source, const std::string& cache_directory= std::string());
+
+} // namespace SZV
@@ -0,0 +1,500 @@
+#include "CSGTreeBinary.hpp"
+#include "Assert.hpp"
+#include "CSGTreeReference.hpp"
+#include "Log.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace SZV
+{
+
+namespace
+{
+
+using CSGTreeBinary::Node;
+using CSGTreeBinary::NodeType;
+using CSGTreeBinary::ReadLeafNode;
+
+bool IsHostLittleEndian()
+{
+	const uint32_t value= 1u;
+	uint8_t first_byte= 0u;
+	std::memcpy(&first_byte, &value, 1u);
+	return first_byte == 1u;
+}
+
+void WriteVec3(float* const dst, const m_Vec3& v)
+{
+	dst[0]= v.x;
+	dst[1]= v.y;
+	dst[2]= v.z;
+}
+
+m_Vec3 ReadVec3(const float* const src)
+{
+	return m_Vec3(src[0], src[1], src[2]);
+}
+
+// Element of traversal queue - tree node or transform of instance.
+struct QueueElement
+{
+	const CSGTree::CSGTreeNode* node= nullptr;
+	const CSGTree::InstanceTransform* instance_transform= nullptr;
+};
+
+struct SerializationState
+{
+	// Breadth-first traversal queue.
+	std::vector<QueueElement> queue;
+	// Index of currently filled node.
+	uint32_t node_index= 0u;
+
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> string_offsets;
+
+	// Indices of reference nodes and their targets. Indices of definitions are known only after traversal of main tree.
+	std::vector<std::pair<uint32_t, const CSGTree::ReferenceTarget*>> definition_references;
+};
+
+uint32_t AddString(SerializationState& state, const std::string& str)
+{
+	const auto it= state.string_offsets.find(str);
+	if(it != state.string_offsets.end())
+		return it->second;
+
+	const uint32_t offset= uint32_t(state.strings.size());
+	state.strings+= str;
+	state.strings.push_back('\0');
+	state.string_offsets.emplace(str, offset);
+	return offset;
+}
+
+template<typename T>
+void FillBranchNode(Node& out_node, const T& node, const NodeType type, SerializationState& state)
+{
+	out_node.type= type;
+	out_node.first_child= uint32_t(state.queue.size());
+	out_node.child_count= uint32_t(node.elements.size());
+	for(const CSGTree::CSGTreeNode& el : node.elements)
+		state.queue.push_back(QueueElement{ &el, nullptr });
+}
+
+template<typename T>
+void FillLeafNode(Node& out_node, const T& node, const NodeType type)
+{
+	out_node.type= type;
+	WriteVec3(out_node.center, node.center);
+	WriteVec3(out_node.size, node.size);
+	WriteVec3(out_node.angles_deg, node.angles_deg);
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::MulChain& node, SerializationState& state)
+{
+	FillBranchNode(out_node, node, NodeType::MulChain, state);
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::AddChain& node, SerializationState& state)
+{
+	FillBranchNode(out_node, node, NodeType::AddChain, state);
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::SubChain& node, SerializationState& state)
+{
+	FillBranchNode(out_node, node, NodeType::SubChain, state);
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::AddArray& node, SerializationState& state)
+{
+	FillBranchNode(out_node, node, NodeType::AddArray, state);
+	for(size_t i= 0; i < 3; ++i)
+		out_node.array_size[i]= node.size[i];
+	WriteVec3(out_node.center, node.step);
+	WriteVec3(out_node.angles_deg, node.angles_deg);
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::Ellipsoid& node, SerializationState&)
+{
+	FillLeafNode(out_node, node, NodeType::Ellipsoid);
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::Box& node, SerializationState&)
+{
+	FillLeafNode(out_node, node, NodeType::Box);
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::Cylinder& node, SerializationState&)
+{
+	FillLeafNode(out_node, node, NodeType::Cylinder);
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::Cone& node, SerializationState&)
+{
+	FillLeafNode(out_node, node, NodeType::Cone);
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::Paraboloid& node, SerializationState&)
+{
+	FillLeafNode(out_node, node, NodeType::Paraboloid);
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::Hyperboloid& node, SerializationState&)
+{
+	FillLeafNode(out_node, node, NodeType::Hyperboloid);
+	out_node.param= node.focus_distance;
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::ParabolicCylinder& node, SerializationState&)
+{
+	FillLeafNode(out_node, node, NodeType::ParabolicCylinder);
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::HyperbolicCylinder& node, SerializationState&)
+{
+	FillLeafNode(out_node, node, NodeType::HyperbolicCylinder);
+	out_node.param= node.focus_distance;
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::HyperbolicParaboloid& node, SerializationState&)
+{
+	out_node.type= NodeType::HyperbolicParaboloid;
+	WriteVec3(out_node.center, node.center);
+	WriteVec3(out_node.angles_deg, node.angles_deg);
+	out_node.param= node.height;
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::Reference& node, SerializationState& state)
+{
+	out_node.type= NodeType::Reference;
+	WriteVec3(out_node.center, node.center);
+	WriteVec3(out_node.angles_deg, node.angles_deg);
+	out_node.source_offset= AddString(state, node.source);
+
+	if(node.target != nullptr && IsDefinitionReferenceSource(node.source))
+	{
+		out_node.child_count= 1u;
+		state.definition_references.emplace_back(state.node_index, node.target.get());
+	}
+}
+
+void FillNode_impl(Node& out_node, const CSGTree::Instance& node, SerializationState& state)
+{
+	FillBranchNode(out_node, node, NodeType::Instance, state);
+	out_node.child_count+= uint32_t(node.transforms.size());
+	out_node.transform_count= uint32_t(node.transforms.size());
+	for(const CSGTree::InstanceTransform& instance_transform : node.transforms)
+		state.queue.push_back(QueueElement{ nullptr, &instance_transform });
+}
+
+void FillInstanceTransformNode(Node& out_node, const CSGTree::InstanceTransform& instance_transform)
+{
+	out_node.type= NodeType::InstanceTransform;
+	WriteVec3(out_node.center, instance_transform.center);
+	WriteVec3(out_node.angles_deg, instance_transform.angles_deg);
+}
+
+struct DeserializationState
+{
+	const CSGTreeBinaryView& view;
+	const std::string& base_directory;
+	// Targets for definitions, by index of definition root.
+	std::unordered_map<uint32_t, std::shared_ptr<CSGTree::ReferenceTarget>> definitions;
+};
+
+CSGTree::CSGTreeNode DeserializeNode_r(DeserializationState& state, const uint32_t index)
+{
+	const CSGTreeBinaryView& view= state.view;
+	const Node& node= view.GetNode(index);
+
+	const auto get_elements=
+	[&]
+	{
+		std::vector<CSGTree::CSGTreeNode> res;
+		res.reserve(node.child_count);
+		for(uint32_t i= 0u; i < node.child_count; ++i)
+			res.push_back(DeserializeNode_r(state, node.first_child + i));
+		return res;
+	};
+
+	switch(node.type)
+	{
+	case NodeType::MulChain:
+		return CSGTree::MulChain{ get_elements() };
+	case NodeType::AddChain:
+		return CSGTree::AddChain{ get_elements() };
+	case NodeType::SubChain:
+		return CSGTree::SubChain{ get_elements() };
+	case NodeType::AddArray:
+		{
+			CSGTree::AddArray add_array;
+			add_array.elements= get_elements();
+			for(size_t i= 0; i < 3; ++i)
+				add_array.size[i]= node.array_size[i];
+			add_array.step= ReadVec3(node.center);
+			add_array.angles_deg= ReadVec3(node.angles_deg);
+			return add_array;
+		}
+	case NodeType::Ellipsoid:
+		return ReadLeafNode<CSGTree::Ellipsoid>(node);
+	case NodeType::Box:
+		return ReadLeafNode<CSGTree::Box>(node);
+	case NodeType::Cylinder:
+		return ReadLeafNode<CSGTree::Cylinder>(node);
+	case NodeType::Cone:
+		return ReadLeafNode<CSGTree::Cone>(node);
+	case NodeType::Paraboloid:
+		return ReadLeafNode<CSGTree::Paraboloid>(node);
+	case NodeType::Hyperboloid:
+		return ReadLeafNode<CSGTree::Hyperboloid>(node);
+	case NodeType::ParabolicCylinder:
+		return ReadLeafNode<CSGTree::ParabolicCylinder>(node);
+	case NodeType::HyperbolicCylinder:
+		return ReadLeafNode<CSGTree::HyperbolicCylinder>(node);
+	case NodeType::HyperbolicParaboloid:
+		return ReadLeafNode<CSGTree::HyperbolicParaboloid>(node);
+	case NodeType::Reference:
+		{
+			CSGTree::Reference reference;
+			reference.source= view.GetString(node.source_offset);
+			reference.center= ReadVec3(node.center);
+			reference.angles_deg= ReadVec3(node.angles_deg);
+			if(node.child_count != 0u)
+			{
+				// Deserialize each definition only once.
+				const auto it= state.definitions.find(node.first_child);
+				if(it != state.definitions.end())
+					reference.target= it->second;
+				else
+				{
+					reference.target= std::make_shared<CSGTree::ReferenceTarget>();
+					reference.target->SetNode(DeserializeNode_r(state, node.first_child));
+					state.definitions.emplace(node.first_child, reference.target);
+				}
+			}
+			else if(!IsDefinitionReferenceSource(reference.source))
+				reference.target= GetExternalReferenceTarget(reference.source, state.base_directory);
+			return reference;
+		}
+	case NodeType::Instance:
+		{
+			// Transforms are stored after elements.
+			const uint32_t element_count= node.child_count - node.transform_count;
+
+			CSGTree::Instance instance;
+			instance.elements.reserve(element_count);
+			for(uint32_t i= 0u; i < element_count; ++i)
+				instance.elements.push_back(DeserializeNode_r(state, node.first_child + i));
+
+			instance.transforms.reserve(node.transform_count);
+			for(uint32_t i= element_count; i < node.child_count; ++i)
+			{
+				const Node& transform_node= view.GetNode(node.first_child + i);
+				instance.transforms.push_back(CSGTree::InstanceTransform{ ReadVec3(transform_node.center), ReadVec3(transform_node.angles_deg) });
+			}
+			return instance;
+		}
+	case NodeType::InstanceTransform: // Transforms are read together with instance.
+	case NodeType::NumTypes:
+		break;
+	}
+
+	SZV_ASSERT(false); // Types are checked in view constructor.
+	return CSGTree::AddChain();
+}
+
+} // namespace
+
+CSGTreeBinaryView::CSGTreeBinaryView(const uint8_t* const data, const size_t size)
+{
+	using CSGTreeBinary::FileHeader;
+
+	if(!IsHostLittleEndian())
+	{
+		Log::Warning("Binary scene format is not supported on big-endian platforms");
+		return;
+	}
+	if(data == nullptr || size < sizeof(FileHeader))
+	{
+		Log::Warning("Binary scene is too small");
+		return;
+	}
+	if(reinterpret_cast<uintptr_t>(data) % alignof(Node) != 0u)
+	{
+		Log::Warning("Binary scene data is not aligned");
+		return;
+	}
+
+	FileHeader header;
+	std::memcpy(&header, data, sizeof(FileHeader));
+	if(std::memcmp(header.id, CSGTreeBinary::c_file_id, sizeof(header.id)) != 0)
+	{
+		Log::Warning("Invalid binary scene file id");
+		return;
+	}
+	if(header.version == 0u || header.version > CSGTreeBinary::c_version)
+	{
+		Log::Warning("Unsupported binary scene version ", header.version, ", expected ", CSGTreeBinary::c_version);
+		return;
+	}
+	if(header.node_count == 0u || (size - sizeof(FileHeader)) / sizeof(Node) < header.node_count ||
+		size - sizeof(FileHeader) - header.node_count * sizeof(Node) < header.strings_size)
+	{
+		Log::Warning("Invalid binary scene size");
+		return;
+	}
+
+	const Node* const nodes= reinterpret_cast<const Node*>(data + sizeof(FileHeader));
+	const char* const strings= reinterpret_cast<const char*>(data + sizeof(FileHeader) + header.node_count * sizeof(Node));
+
+	// Check all nodes once, in order to avoid checks while reading.
+	// Children indices must be greater than node index - this guarantees absence of cycles.
+	for(uint32_t i= 0u; i < header.node_count; ++i)
+	{
+		const Node& node= nodes[i];
+		if(uint32_t(node.type) >= uint32_t(NodeType::NumTypes))
+		{
+			Log::Warning("Invalid type of binary scene node ", i);
+			return;
+		}
+
+		const bool is_branch=
+			node.type == NodeType::MulChain ||
+			node.type == NodeType::AddChain ||
+			node.type == NodeType::SubChain ||
+			node.type == NodeType::AddArray ||
+			node.type == NodeType::Reference ||
+			node.type == NodeType::Instance;
+		if(node.child_count != 0u &&
+			(!is_branch ||
+			(node.type == NodeType::Reference && node.child_count != 1u) ||
+			node.first_child <= i ||
+			node.first_child >= header.node_count ||
+			node.child_count > header.node_count - node.first_child))
+		{
+			Log::Warning("Invalid children of binary scene node ", i);
+			return;
+		}
+
+		// Transforms may be only last children of instance.
+		const uint32_t transform_count= node.type == NodeType::Instance ? node.transform_count : 0u;
+		if(transform_count > node.child_count || (i == 0u && node.type == NodeType::InstanceTransform))
+		{
+			Log::Warning("Invalid transforms of binary scene node ", i);
+			return;
+		}
+		for(uint32_t j= 0u; j < node.child_count; ++j)
+		{
+			const bool is_transform= nodes[node.first_child + j].type == NodeType::InstanceTransform;
+			if(is_transform != (j >= node.child_count - transform_count))
+			{
+				Log::Warning("Invalid transforms of binary scene node ", i);
+				return;
+			}
+		}
+
+		// String must be null-terminated within strings table.
+		if(node.type == NodeType::Reference &&
+			(node.source_offset >= header.strings_size ||
+			std::memchr(strings + node.source_offset, 0, header.strings_size - node.source_offset) == nullptr))
+		{
+			Log::Warning("Invalid source of binary scene node ", i);
+			return;
+		}
+	}
+
+	nodes_= nodes;
+	node_count_= header.node_count;
+	strings_= strings;
+	strings_size_= header.strings_size;
+}
+
+bool CSGTreeBinaryView::IsEmpty() const
+{
+	return node_count_ == 0u;
+}
+
+uint32_t CSGTreeBinaryView::GetNodeCount() const
+{
+	return node_count_;
+}
+
+const CSGTreeBinary::Node& CSGTreeBinaryView::GetNode(const uint32_t index) const
+{
+	SZV_ASSERT(index < node_count_);
+	return nodes_[index];
+}
+
+const char* CSGTreeBinaryView::GetString(const uint32_t offset) const
+{
+	SZV_ASSERT(offset < strings_size_);
+	return strings_ + offset;
+}
+
+std::vector<uint8_t> SerializeCSGTreeBinary(const CSGTree::CSGTreeNode& root)
+{
+	SZV_PROFILE_FUNCTION();
+
+	if(!IsHostLittleEndian())
+	{
+		Log::Warning("Binary scene format is not supported on big-endian platforms");
+		return {};
+	}
+
+	// Definitions are traversed after main tree, in order of usage, so references always point to nodes with greater index.
+	std::vector<CSGTree::ReferenceTarget*> definitions= CollectDefinitions(root);
+	std::reverse(definitions.begin(), definitions.end());
+	std::unordered_map<const CSGTree::ReferenceTarget*, uint32_t> definition_indices;
+
+	// Breadth-first traversal. Children of each node are added into queue together, so they are stored contiguously.
+	SerializationState state;
+	std::vector<Node> nodes;
+	state.queue.push_back(QueueElement{ &root, nullptr });
+	for(size_t next_definition= 0u; ; ++state.node_index)
+	{
+		if(state.node_index == state.queue.size())
+		{
+			if(next_definition == definitions.size())
+				break;
+			definition_indices.emplace(definitions[next_definition], uint32_t(state.queue.size()));
+			state.queue.push_back(QueueElement{ &definitions[next_definition]->GetNode(), nullptr });
+			++next_definition;
+		}
+
+		Node node{};
+		const QueueElement element= state.queue[state.node_index];
+		if(element.node != nullptr)
+			std::visit([&](const auto& n){ FillNode_impl(node, n, state); }, *element.node);
+		else
+			FillInstanceTransformNode(node, *element.instance_transform);
+		nodes.push_back(node);
+	}
+
+	for(const auto& definition_reference : state.definition_references)
+		nodes[definition_reference.first].first_child= definition_indices[definition_reference.second];
+
+	CSGTreeBinary::FileHeader header{};
+	std::memcpy(header.id, CSGTreeBinary::c_file_id, sizeof(header.id));
+	header.version= CSGTreeBinary::c_version;
+	header.node_count= uint32_t(nodes.size());
+	header.strings_size= uint32_t(state.strings.size());
+
+	std::vector<uint8_t> res(sizeof(header) + nodes.size() * sizeof(Node) + state.strings.size());
+	std::memcpy(res.data(), &header, sizeof(header));
+	std::memcpy(res.data() + sizeof(header), nodes.data(), nodes.size() * sizeof(Node));
+	std::memcpy(res.data() + sizeof(header) + nodes.size() * sizeof(Node), state.strings.data(), state.strings.size());
+	return res;
+}
+
+CSGTree::CSGTreeNode DeserializeCSGTreeBinary(const CSGTreeBinaryView& view, const std::string& base_directory)
+{
+	SZV_PROFILE_FUNCTION();
+
+	if(view.IsEmpty())
+		return CSGTree::AddChain();
+
+	DeserializationState state{ view, base_directory, {} };
+	return DeserializeNode_r(state, 0u);
+}
+
+} // namespace SZV
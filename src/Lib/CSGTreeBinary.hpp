@@ -0,0 +1,124 @@
+#pragma once
+#include "CSGExpressionTree.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace SZV
+{
+
+// Compact binary scene format.
+// File consists of header, flat table of nodes and table of null-terminated strings. All values are little-endian.
+// Nodes are stored in breadth-first order, root is first, children of each node are stored contiguously,
+// so each node contains only range of children indices and all children indices are greater than index of parent.
+// Transforms of instance are stored as its last children, after elements.
+// Definitions, used by references, are stored after main tree. Reference to definition has single child - root of definition,
+// which is shared between all references to it. Definitions are ordered in such way, that reference index is always less than index of definition.
+// Format is designed for reading directly from memory-mapped file, without any parsing.
+namespace CSGTreeBinary
+{
+
+constexpr char c_file_id[4]{ 'S', 'Z', 'V', 'B' };
+constexpr uint32_t c_version= 3u;
+
+// Values are stored in files, so never change them.
+enum class NodeType : uint32_t
+{
+	MulChain= 0,
+	AddChain= 1,
+	SubChain= 2,
+	AddArray= 3,
+	Ellipsoid= 4,
+	Box= 5,
+	Cylinder= 6,
+	Cone= 7,
+	Paraboloid= 8,
+	Hyperboloid= 9,
+	ParabolicCylinder= 10,
+	HyperbolicCylinder= 11,
+	HyperbolicParaboloid= 12,
+	Reference= 13,
+	Instance= 14,
+	InstanceTransform= 15,
+	NumTypes,
+};
+
+struct FileHeader
+{
+	char id[4];
+	uint32_t version;
+	uint32_t node_count;
+	uint32_t strings_size; // Zero in version 1.
+};
+static_assert(sizeof(FileHeader) == 16, "Invalid size");
+
+struct Node
+{
+	NodeType type;
+	uint32_t first_child;
+	uint32_t child_count;
+	uint8_t array_size[3]; // For "add_array".
+	uint8_t reserved;
+	float center[3]; // Step for "add_array".
+	float size[3];
+	float angles_deg[3];
+	union
+	{
+		float param; // Focus distance for hyperboloid and hyperbolic cylinder, height for hyperbolic paraboloid.
+		uint32_t source_offset; // Offset of source string in strings table for reference.
+		uint32_t transform_count; // Number of last children of instance, which are transforms.
+	};
+};
+static_assert(sizeof(Node) == 56, "Invalid size");
+
+// Read leaf node of given type. Node type is not checked.
+template<typename T>
+T ReadLeafNode(const Node& node)
+{
+	T res{};
+	res.center= m_Vec3(node.center[0], node.center[1], node.center[2]);
+	res.size= m_Vec3(node.size[0], node.size[1], node.size[2]);
+	res.angles_deg= m_Vec3(node.angles_deg[0], node.angles_deg[1], node.angles_deg[2]);
+	if constexpr(std::is_same_v<T, CSGTree::Hyperboloid> || std::is_same_v<T, CSGTree::HyperbolicCylinder>)
+		res.focus_distance= node.param;
+	return res;
+}
+
+template<>
+inline CSGTree::HyperbolicParaboloid ReadLeafNode<CSGTree::HyperbolicParaboloid>(const Node& node)
+{
+	CSGTree::HyperbolicParaboloid res{};
+	res.center= m_Vec3(node.center[0], node.center[1], node.center[2]);
+	res.angles_deg= m_Vec3(node.angles_deg[0], node.angles_deg[1], node.angles_deg[2]);
+	res.height= node.param;
+	return res;
+}
+
+} // namespace CSGTreeBinary
+
+// Read-only view of serialized tree. Data is not copied, so it must outlive the view.
+class CSGTreeBinaryView
+{
+public:
+	// Data is validated. View is empty if data is invalid.
+	CSGTreeBinaryView(const uint8_t* data, size_t size);
+
+	bool IsEmpty() const;
+	uint32_t GetNodeCount() const;
+	// Root has index 0.
+	const CSGTreeBinary::Node& GetNode(uint32_t index) const;
+	// Offset is checked in constructor for all references.
+	const char* GetString(uint32_t offset) const;
+
+private:
+	const CSGTreeBinary::Node* nodes_= nullptr;
+	uint32_t node_count_= 0u;
+	const char* strings_= nullptr;
+	uint32_t strings_size_= 0u;
+};
+
+std::vector<uint8_t> SerializeCSGTreeBinary(const CSGTree::CSGTreeNode& root);
+// Relative paths of external references are resolved against given directory.
+CSGTree::CSGTreeNode DeserializeCSGTreeBinary(const CSGTreeBinaryView& view, const std::string& base_directory= "");
+
+} // namespace SZV
@@ -0,0 +1,396 @@
+#include "CSGTreePersistent.hpp"
+#include "Assert.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
+
+namespace SZV
+{
+
+namespace
+{
+
+using ElementsVector= std::vector<CSGTree::CSGTreeNode>;
+
+const ElementsVector* GetElementsVectorImpl(const CSGTree::MulChain& node) { return &node.elements; }
+const ElementsVector* GetElementsVectorImpl(const CSGTree::AddChain& node) { return &node.elements; }
+const ElementsVector* GetElementsVectorImpl(const CSGTree::SubChain& node) { return &node.elements; }
+const ElementsVector* GetElementsVectorImpl(const CSGTree::AddArray& node) { return &node.elements; }
+const ElementsVector* GetElementsVectorImpl(const CSGTree::Instance& node) { return &node.elements; }
+template<class T> const ElementsVector* GetElementsVectorImpl(const T&) { return nullptr; }
+
+const ElementsVector* GetElementsVector(const CSGTree::CSGTreeNode& node)
+{
+	return std::visit([&](const auto& el){ return GetElementsVectorImpl(el); }, node);
+}
+
+ElementsVector* GetElementsVector(CSGTree::CSGTreeNode& node)
+{
+	return const_cast<ElementsVector*>(GetElementsVector(static_cast<const CSGTree::CSGTreeNode&>(node)));
+}
+
+// Copy node without its elements.
+CSGTree::CSGTreeNode CopyParamsImpl(const CSGTree::MulChain&) { return CSGTree::MulChain(); }
+CSGTree::CSGTreeNode CopyParamsImpl(const CSGTree::AddChain&) { return CSGTree::AddChain(); }
+CSGTree::CSGTreeNode CopyParamsImpl(const CSGTree::SubChain&) { return CSGTree::SubChain(); }
+
+CSGTree::CSGTreeNode CopyParamsImpl(const CSGTree::AddArray& node)
+{
+	CSGTree::AddArray res;
+	std::copy(std::begin(node.size), std::end(node.size), std::begin(res.size));
+	res.step= node.step;
+	res.angles_deg= node.angles_deg;
+	return res;
+}
+
+CSGTree::CSGTreeNode CopyParamsImpl(const CSGTree::Instance& node)
+{
+	CSGTree::Instance res;
+	res.transforms= node.transforms;
+	return res;
+}
+
+template<class T> CSGTree::CSGTreeNode CopyParamsImpl(const T& node) { return node; }
+
+std::shared_ptr<const CSGTree::CSGTreeNode> MakeParams(const CSGTree::CSGTreeNode& node)
+{
+	return std::make_shared<const CSGTree::CSGTreeNode>(std::visit([&](const auto& el){ return CopyParamsImpl(el); }, node));
+}
+
+// Returns index of chunk, containing child with given index, and index of child in this chunk.
+std::pair<size_t, size_t> FindChildChunk(const CSGTreePersistent::Node& node, const size_t index)
+{
+	const std::vector<size_t>& ends= node.children_chunk_ends;
+	const auto it= std::upper_bound(ends.begin(), ends.end(), index);
+	SZV_ASSERT(it != ends.end());
+	const size_t chunk_index= size_t(it - ends.begin());
+	const size_t chunk_begin= chunk_index == 0u ? 0u : ends[chunk_index - 1u];
+	return { chunk_index, index - chunk_begin };
+}
+
+void SetChildren(CSGTreePersistent::Node& node, CSGTreePersistent::ChildrenChunk children)
+{
+	node.children_chunks.clear();
+	node.children_chunk_ends.clear();
+	for(size_t begin= 0u; begin < children.size(); begin+= CSGTreePersistent::c_children_chunk_size)
+	{
+		const size_t end= std::min(begin + CSGTreePersistent::c_children_chunk_size, children.size());
+		node.children_chunks.push_back(
+			std::make_shared<const CSGTreePersistent::ChildrenChunk>(
+				std::make_move_iterator(children.begin() + std::ptrdiff_t(begin)),
+				std::make_move_iterator(children.begin() + std::ptrdiff_t(end))));
+		node.children_chunk_ends.push_back(end);
+	}
+}
+
+// Replace chunk of node with its copy, changed via given function. Other chunks remain shared.
+// Too large chunk is split, empty chunk is removed.
+template<typename ModifyChunkFunc>
+void ModifyChildrenChunk(CSGTreePersistent::Node& node, const size_t chunk_index, const ModifyChunkFunc& modify)
+{
+	CSGTreePersistent::ChildrenChunk chunk= *node.children_chunks[chunk_index];
+	const size_t old_size= chunk.size();
+	modify(chunk);
+
+	std::vector<size_t>& ends= node.children_chunk_ends;
+	for(size_t i= chunk_index; i < ends.size(); ++i)
+		ends[i]= ends[i] + chunk.size() - old_size;
+
+	if(chunk.empty())
+	{
+		node.children_chunks.erase(node.children_chunks.begin() + std::ptrdiff_t(chunk_index));
+		ends.erase(ends.begin() + std::ptrdiff_t(chunk_index));
+	}
+	else if(chunk.size() > CSGTreePersistent::c_children_chunk_size * 2u)
+	{
+		const size_t half_size= chunk.size() / 2u;
+		CSGTreePersistent::ChildrenChunk second_half(
+			std::make_move_iterator(chunk.begin() + std::ptrdiff_t(half_size)),
+			std::make_move_iterator(chunk.end()));
+		chunk.resize(half_size);
+
+		ends.insert(ends.begin() + std::ptrdiff_t(chunk_index), ends[chunk_index] - second_half.size());
+		node.children_chunks[chunk_index]= std::make_shared<const CSGTreePersistent::ChildrenChunk>(std::move(chunk));
+		node.children_chunks.insert(
+			node.children_chunks.begin() + std::ptrdiff_t(chunk_index + 1u),
+			std::make_shared<const CSGTreePersistent::ChildrenChunk>(std::move(second_half)));
+	}
+	else
+		node.children_chunks[chunk_index]= std::make_shared<const CSGTreePersistent::ChildrenChunk>(std::move(chunk));
+}
+
+void InsertChild(CSGTreePersistent::Node& node, const size_t index, CSGTreePersistent::NodePtr child)
+{
+	SZV_ASSERT(index <= node.GetChildCount());
+	if(node.children_chunks.empty())
+	{
+		node.children_chunks.push_back(std::make_shared<const CSGTreePersistent::ChildrenChunk>(1u, std::move(child)));
+		node.children_chunk_ends.push_back(1u);
+		return;
+	}
+
+	// Insertion after last child is insertion at end of last chunk.
+	const std::pair<size_t, size_t> position=
+		index == node.GetChildCount()
+			? std::make_pair(node.children_chunks.size() - 1u, node.children_chunks.back()->size())
+			: FindChildChunk(node, index);
+
+	ModifyChildrenChunk(
+		node, position.first,
+		[&](CSGTreePersistent::ChildrenChunk& chunk)
+		{
+			chunk.insert(chunk.begin() + std::ptrdiff_t(position.second), std::move(child));
+		});
+}
+
+CSGTreePersistent::NodePtr RemoveChild(CSGTreePersistent::Node& node, const size_t index)
+{
+	SZV_ASSERT(index < node.GetChildCount());
+	const std::pair<size_t, size_t> position= FindChildChunk(node, index);
+
+	CSGTreePersistent::NodePtr child;
+	ModifyChildrenChunk(
+		node, position.first,
+		[&](CSGTreePersistent::ChildrenChunk& chunk)
+		{
+			child= std::move(chunk[position.second]);
+			chunk.erase(chunk.begin() + std::ptrdiff_t(position.second));
+		});
+	return child;
+}
+
+// Copy nodes on path and apply given function to copy of last node.
+// Only chunks of children on path are copied, other chunks are shared.
+template<typename ModifyFunc>
+CSGTreePersistent::NodePtr ModifyNode_r(
+	const CSGTreePersistent::NodePtr& node,
+	const CSGTreePersistent::Path& path,
+	const size_t depth,
+	const ModifyFunc& modify)
+{
+	auto copy= std::make_shared<CSGTreePersistent::Node>(*node);
+	if(depth == path.size())
+		modify(*copy);
+	else
+	{
+		const size_t index= path[depth];
+		SZV_ASSERT(index < copy->GetChildCount());
+		const std::pair<size_t, size_t> position= FindChildChunk(*copy, index);
+		ModifyChildrenChunk(
+			*copy, position.first,
+			[&](CSGTreePersistent::ChildrenChunk& chunk)
+			{
+				chunk[position.second]= ModifyNode_r(chunk[position.second], path, depth + 1u, modify);
+			});
+	}
+	return copy;
+}
+
+// Count same children at begin (or at end, if "from_end" is true), but not more than given number.
+// Chunks, shared by both nodes at same positions, are skipped without comparison of their children.
+size_t CountSameChildren(
+	const CSGTreePersistent::Node& old_node,
+	const CSGTreePersistent::Node& new_node,
+	const size_t max_count,
+	const bool from_end)
+{
+	const size_t old_count= old_node.GetChildCount();
+	const size_t new_count= new_node.GetChildCount();
+
+	size_t count= 0u;
+	while(count < max_count)
+	{
+		const std::pair<size_t, size_t> old_position= FindChildChunk(old_node, from_end ? old_count - 1u - count : count);
+		const std::pair<size_t, size_t> new_position= FindChildChunk(new_node, from_end ? new_count - 1u - count : count);
+		const CSGTreePersistent::ChildrenChunkPtr& old_chunk= old_node.children_chunks[old_position.first];
+		const CSGTreePersistent::ChildrenChunkPtr& new_chunk= new_node.children_chunks[new_position.first];
+
+		const size_t chunk_edge= from_end ? old_chunk->size() - 1u : 0u;
+		if(old_chunk == new_chunk &&
+			old_position.second == chunk_edge && new_position.second == chunk_edge &&
+			count + old_chunk->size() <= max_count)
+			count+= old_chunk->size();
+		else if((*old_chunk)[old_position.second] == (*new_chunk)[new_position.second])
+			++count;
+		else
+			break;
+	}
+	return count;
+}
+
+void DiffPersistentTrees_r(
+	const CSGTreePersistent::NodePtr& old_node,
+	const CSGTreePersistent::NodePtr& new_node,
+	CSGTreePersistent::Path& path,
+	std::vector<CSGTreePersistent::Change>& out_changes)
+{
+	if(old_node == new_node)
+		return;
+
+	CSGTreePersistent::Change change;
+	change.path= path;
+
+	if(old_node->params != new_node->params)
+	{
+		if(old_node->params->index() != new_node->params->index())
+		{
+			change.node_replaced= true;
+			out_changes.push_back(std::move(change));
+			return;
+		}
+		change.params_changed= true;
+	}
+
+	// Find range of changed children, skipping same children at begin and at end.
+	const size_t old_count= old_node->GetChildCount();
+	const size_t new_count= new_node->GetChildCount();
+	const size_t min_count= std::min(old_count, new_count);
+
+	const size_t begin= CountSameChildren(*old_node, *new_node, min_count, false);
+	const size_t end_offset= CountSameChildren(*old_node, *new_node, min_count - begin, true);
+
+	const size_t old_end= old_count - end_offset;
+	const size_t new_end= new_count - end_offset;
+
+	// Single changed child is compared recursively, other ranges are replaced.
+	const bool single_child_changed= old_end == begin + 1u && new_end == begin + 1u;
+	if(!single_child_changed && (old_end > begin || new_end > begin))
+	{
+		change.children_begin= begin;
+		change.old_children_end= old_end;
+		change.new_children_end= new_end;
+	}
+
+	if(change.params_changed || change.old_children_end > change.children_begin || change.new_children_end > change.children_begin)
+		out_changes.push_back(std::move(change));
+
+	if(single_child_changed)
+	{
+		path.push_back(begin);
+		DiffPersistentTrees_r(old_node->GetChild(begin), new_node->GetChild(begin), path, out_changes);
+		path.pop_back();
+	}
+}
+
+} // namespace
+
+CSGTreePersistent::NodePtr MakePersistentTree(const CSGTree::CSGTreeNode& root)
+{
+	auto node= std::make_shared<CSGTreePersistent::Node>();
+	node->params= MakeParams(root);
+	if(const ElementsVector* const elements= GetElementsVector(root))
+	{
+		CSGTreePersistent::ChildrenChunk children;
+		children.reserve(elements->size());
+		for(const CSGTree::CSGTreeNode& element : *elements)
+			children.push_back(MakePersistentTree(element));
+		SetChildren(*node, std::move(children));
+	}
+	return node;
+}
+
+CSGTree::CSGTreeNode MakeCSGTree(const CSGTreePersistent::NodePtr& root)
+{
+	CSGTree::CSGTreeNode result= *root->params;
+	if(ElementsVector* const elements= GetElementsVector(result))
+	{
+		elements->reserve(root->GetChildCount());
+		for(const CSGTreePersistent::ChildrenChunkPtr& chunk : root->children_chunks)
+			for(const CSGTreePersistent::NodePtr& child : *chunk)
+				elements->push_back(MakeCSGTree(child));
+	}
+	return result;
+}
+
+const CSGTreePersistent::NodePtr& GetPersistentNode(const CSGTreePersistent::NodePtr& root, const CSGTreePersistent::Path& path)
+{
+	const CSGTreePersistent::NodePtr* node= &root;
+	for(const size_t index : path)
+		node= &(*node)->GetChild(index);
+	return *node;
+}
+
+CSGTreePersistent::NodePtr SetPersistentNodeParams(
+	const CSGTreePersistent::NodePtr& root,
+	const CSGTreePersistent::Path& path,
+	const CSGTree::CSGTreeNode& node)
+{
+	return ModifyNode_r(
+		root, path, 0u,
+		[&](CSGTreePersistent::Node& n)
+		{
+			SZV_ASSERT(n.params->index() == node.index());
+			n.params= MakeParams(node);
+		});
+}
+
+CSGTreePersistent::NodePtr InsertPersistentNode(
+	const CSGTreePersistent::NodePtr& root,
+	const CSGTreePersistent::Path& path,
+	const CSGTree::CSGTreeNode& node)
+{
+	SZV_ASSERT(!path.empty());
+	const CSGTreePersistent::Path parent_path(path.begin(), path.end() - 1);
+	const size_t index= path.back();
+
+	return ModifyNode_r(
+		root, parent_path, 0u,
+		[&](CSGTreePersistent::Node& n)
+		{
+			InsertChild(n, index, MakePersistentTree(node));
+		});
+}
+
+CSGTreePersistent::NodePtr RemovePersistentNode(const CSGTreePersistent::NodePtr& root, const CSGTreePersistent::Path& path)
+{
+	SZV_ASSERT(!path.empty());
+	const CSGTreePersistent::Path parent_path(path.begin(), path.end() - 1);
+	const size_t index= path.back();
+
+	return ModifyNode_r(
+		root, parent_path, 0u,
+		[&](CSGTreePersistent::Node& n)
+		{
+			RemoveChild(n, index);
+		});
+}
+
+CSGTreePersistent::NodePtr MovePersistentNode(
+	const CSGTreePersistent::NodePtr& root,
+	const CSGTreePersistent::Path& path,
+	const size_t new_index)
+{
+	SZV_ASSERT(!path.empty());
+	const CSGTreePersistent::Path parent_path(path.begin(), path.end() - 1);
+	const size_t index= path.back();
+
+	return ModifyNode_r(
+		root, parent_path, 0u,
+		[&](CSGTreePersistent::Node& n)
+		{
+			SZV_ASSERT(new_index < n.GetChildCount());
+			InsertChild(n, new_index, RemoveChild(n, index));
+		});
+}
+
+namespace CSGTreePersistent
+{
+
+const NodePtr& Node::GetChild(const size_t index) const
+{
+	const std::pair<size_t, size_t> position= FindChildChunk(*this, index);
+	return (*children_chunks[position.first])[position.second];
+}
+
+} // namespace CSGTreePersistent
+
+std::vector<CSGTreePersistent::Change> DiffPersistentTrees(const CSGTreePersistent::NodePtr& old_root, const CSGTreePersistent::NodePtr& new_root)
+{
+	SZV_PROFILE_FUNCTION();
+
+	std::vector<CSGTreePersistent::Change> changes;
+	CSGTreePersistent::Path path;
+	DiffPersistentTrees_r(old_root, new_root, path, changes);
+	return changes;
+}
+
+} // namespace SZV
@@ -0,0 +1,89 @@
+#pragma once
+#include "CSGExpressionTree.hpp"
+#include <memory>
+#include <vector>
+
+namespace SZV
+{
+
+// Immutable version of CSG tree. Each change creates new version, where only nodes on path from root to changed node
+// (and chunks of their children, containing this path) are copied.
+// All other subtrees are shared between versions, so keeping of many versions is cheap.
+// Since unchanged subtrees are shared, changes between two versions are found without visiting of these subtrees.
+namespace CSGTreePersistent
+{
+
+struct Node;
+using NodePtr= std::shared_ptr<const Node>;
+
+// Children are stored in chunks, shared between versions of node, so change of single child of node with many children
+// copies only vector of chunk pointers and one chunk, but not all children.
+using ChildrenChunk= std::vector<NodePtr>;
+using ChildrenChunkPtr= std::shared_ptr<const ChildrenChunk>;
+
+// Chunks are split, when they become twice larger than this.
+constexpr size_t c_children_chunk_size= 64u;
+
+struct Node
+{
+	// Parameters of node itself. Elements of branch nodes are always empty, children are stored separately.
+	// Parameters are shared between versions of node until they are changed.
+	std::shared_ptr<const CSGTree::CSGTreeNode> params;
+	// Chunks are never empty.
+	std::vector<ChildrenChunkPtr> children_chunks;
+	// Index of child after end of each chunk. Last value is number of children.
+	std::vector<size_t> children_chunk_ends;
+
+	size_t GetChildCount() const { return children_chunk_ends.empty() ? 0u : children_chunk_ends.back(); }
+	// Index must be valid. Complexity is logarithmic of number of chunks.
+	const NodePtr& GetChild(size_t index) const;
+};
+
+// Indices of children from root to node.
+using Path= std::vector<size_t>;
+
+// Change of node between two versions of tree.
+// All paths are valid in both versions - changes of children count are reported only as replacement of range of children.
+struct Change
+{
+	Path path;
+	// Whole subtree is replaced, because type of node is changed. Other fields are not used in this case.
+	bool node_replaced= false;
+	bool params_changed= false;
+	// Children in range [children_begin; old_children_end) are replaced with children in range [children_begin; new_children_end).
+	size_t children_begin= 0u;
+	size_t old_children_end= 0u;
+	size_t new_children_end= 0u;
+};
+
+} // namespace CSGTreePersistent
+
+CSGTreePersistent::NodePtr MakePersistentTree(const CSGTree::CSGTreeNode& root);
+CSGTree::CSGTreeNode MakeCSGTree(const CSGTreePersistent::NodePtr& root);
+
+// Path must be valid.
+const CSGTreePersistent::NodePtr& GetPersistentNode(const CSGTreePersistent::NodePtr& root, const CSGTreePersistent::Path& path);
+
+// Functions below return new version of tree, given version is not changed.
+
+// Set own parameters of node, elements of given node are ignored, children of node are preserved. Type of node must be the same.
+CSGTreePersistent::NodePtr SetPersistentNodeParams(
+	const CSGTreePersistent::NodePtr& root,
+	const CSGTreePersistent::Path& path,
+	const CSGTree::CSGTreeNode& node);
+// Last element of path is index of new node in its parent.
+CSGTreePersistent::NodePtr InsertPersistentNode(
+	const CSGTreePersistent::NodePtr& root,
+	const CSGTreePersistent::Path& path,
+	const CSGTree::CSGTreeNode& node);
+CSGTreePersistent::NodePtr RemovePersistentNode(const CSGTreePersistent::NodePtr& root, const CSGTreePersistent::Path& path);
+// Move node into given position in same parent.
+CSGTreePersistent::NodePtr MovePersistentNode(
+	const CSGTreePersistent::NodePtr& root,
+	const CSGTreePersistent::Path& path,
+	size_t new_index);
+
+// Changes are ordered from root to leafs. Subtrees, shared by both versions, are skipped.
+std::vector<CSGTreePersistent::Change> DiffPersistentTrees(const CSGTreePersistent::NodePtr& old_root, const CSGTreePersistent::NodePtr& new_root);
+
+} // namespace SZV
@@ -0,0 +1,143 @@
+#include "CSGTreeReference.hpp"
+#include "CSGTreeSerialization.hpp"
+#include "Log.hpp"
+#include "Profiler.hpp"
+#include <filesystem>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace SZV
+{
+
+namespace
+{
+
+struct ExternalTargetsCache
+{
+	std::mutex mutex;
+	// Key is normalized absolute path.
+	std::unordered_map<std::string, std::shared_ptr<CSGTree::ReferenceTarget>> targets;
+};
+
+ExternalTargetsCache& GetExternalTargetsCache()
+{
+	static ExternalTargetsCache cache;
+	return cache;
+}
+
+void CollectDefinitions_r(
+	const CSGTree::CSGTreeNode& node,
+	std::unordered_set<const CSGTree::ReferenceTarget*>& visited,
+	std::vector<CSGTree::ReferenceTarget*>& out_post_order)
+{
+	std::visit(
+		[&](const auto& el)
+		{
+			using T= std::decay_t<decltype(el)>;
+			if constexpr(std::is_same_v<T, CSGTree::Reference>)
+			{
+				if(el.target != nullptr && IsDefinitionReferenceSource(el.source) && visited.insert(el.target.get()).second)
+				{
+					CollectDefinitions_r(el.target->GetNode(), visited, out_post_order);
+					out_post_order.push_back(el.target.get());
+				}
+			}
+			else if constexpr(
+				std::is_same_v<T, CSGTree::MulChain> ||
+				std::is_same_v<T, CSGTree::AddChain> ||
+				std::is_same_v<T, CSGTree::SubChain> ||
+				std::is_same_v<T, CSGTree::AddArray> ||
+				std::is_same_v<T, CSGTree::Instance>)
+			{
+				for(const CSGTree::CSGTreeNode& child : el.elements)
+					CollectDefinitions_r(child, visited, out_post_order);
+			}
+		},
+		node);
+}
+
+} // namespace
+
+namespace CSGTree
+{
+
+ReferenceTarget::ReferenceTarget()
+{}
+
+ReferenceTarget::ReferenceTarget(std::string file_name)
+	: file_name_(std::move(file_name))
+{}
+
+const CSGTreeNode& ReferenceTarget::GetNode()
+{
+	if(!file_name_.empty())
+	{
+		std::call_once(
+			load_flag_,
+			[&]
+			{
+				SZV_PROFILE_ZONE("LoadReferencedScene");
+
+				// Referenced files may have own references, but they are loaded lazily too, so there is no recursion here.
+				if(std::optional<CSGTreeNode> node= LoadCSGExpressionTree(file_name_))
+					node_= std::move(*node);
+				else
+					Log::Warning("Can not load referenced scene \"", file_name_, "\"");
+			});
+	}
+
+	return node_;
+}
+
+void ReferenceTarget::SetNode(CSGTreeNode node)
+{
+	node_= std::move(node);
+}
+
+const std::string& ReferenceTarget::GetFileName() const
+{
+	return file_name_;
+}
+
+} // namespace CSGTree
+
+bool IsDefinitionReferenceSource(const std::string& source)
+{
+	return !source.empty() && source.front() == '#';
+}
+
+std::shared_ptr<CSGTree::ReferenceTarget> GetExternalReferenceTarget(const std::string& source, const std::string& base_directory)
+{
+	std::filesystem::path path(source);
+	if(path.is_relative() && !base_directory.empty())
+		path= std::filesystem::path(base_directory) / path;
+
+	std::error_code error_code;
+	const std::filesystem::path absolute_path= std::filesystem::absolute(path, error_code);
+	const std::string key= (error_code ? path : absolute_path).lexically_normal().string();
+
+	ExternalTargetsCache& cache= GetExternalTargetsCache();
+	const std::lock_guard<std::mutex> lock(cache.mutex);
+
+	std::shared_ptr<CSGTree::ReferenceTarget>& target= cache.targets[key];
+	if(target == nullptr)
+		target= std::make_shared<CSGTree::ReferenceTarget>(key);
+	return target;
+}
+
+std::vector<CSGTree::ReferenceTarget*> CollectDefinitions(const CSGTree::CSGTreeNode& root)
+{
+	std::unordered_set<const CSGTree::ReferenceTarget*> visited;
+	std::vector<CSGTree::ReferenceTarget*> result;
+	CollectDefinitions_r(root, visited, result);
+	return result;
+}
+
+void ClearExternalReferenceTargetsCache()
+{
+	ExternalTargetsCache& cache= GetExternalTargetsCache();
+	const std::lock_guard<std::mutex> lock(cache.mutex);
+	cache.targets.clear();
+}
+
+} // namespace SZV
@@ -0,0 +1,57 @@
+#pragma once
+#include "CSGExpressionTree.hpp"
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SZV
+{
+
+namespace CSGTree
+{
+
+// Subtree, shared between all references to it.
+// Subtree from external file is loaded on first access, so unused files are never loaded.
+class ReferenceTarget
+{
+public:
+	// Target for definition in same file. Node is set later, while file is loaded.
+	ReferenceTarget();
+	// Target for external scene file.
+	explicit ReferenceTarget(std::string file_name);
+
+	ReferenceTarget(const ReferenceTarget&)= delete;
+	ReferenceTarget& operator=(const ReferenceTarget&)= delete;
+
+	// Thread-safe. Loads file on first call. Result is empty "add" node if file can not be loaded.
+	const CSGTreeNode& GetNode();
+
+	// Not thread-safe. Should be used only for targets of definitions while they are loaded.
+	void SetNode(CSGTreeNode node);
+
+	// Empty for definitions.
+	const std::string& GetFileName() const;
+
+private:
+	const std::string file_name_;
+	std::once_flag load_flag_;
+	CSGTreeNode node_= AddChain();
+};
+
+} // namespace CSGTree
+
+// References with such source point to definitions in same file.
+bool IsDefinitionReferenceSource(const std::string& source);
+
+// Returns shared target for external scene file. Each file is loaded only once, and only if it is actually used.
+// Relative paths are resolved against given directory.
+std::shared_ptr<CSGTree::ReferenceTarget> GetExternalReferenceTarget(const std::string& source, const std::string& base_directory);
+// Returns targets of definitions, used by given tree directly or via other definitions.
+// Each definition is placed after all definitions used by it.
+std::vector<CSGTree::ReferenceTarget*> CollectDefinitions(const CSGTree::CSGTreeNode& root);
+
+// Forget loaded files, so they will be loaded again on next access. Existing references keep their targets.
+// Targets of files, which reference each other, hold each other and are never freed.
+void ClearExternalReferenceTargetsCache();
+
+} // namespace SZV
@@ -0,0 +1,748 @@
+#include "CSGTreeSerialization.hpp"
+#include "CSGTreeBinary.hpp"
+#include "CSGTreeReference.hpp"
+#include "JSONReader.hpp"
+#include "JSONWriter.hpp"
+#include "Log.hpp"
+#include "MappedFile.hpp"
+#include "ParallelFor.hpp"
+#include "Profiler.hpp"
+#include <atomic>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+namespace SZV
+{
+
+namespace
+{
+
+const size_t g_min_parallel_parsing_size= 1u << 20u;
+
+void WriteNode(JSONWriter& writer, const CSGTree::CSGTreeNode& node);
+
+void WriteVec3(JSONWriter& writer, const char* const key, const m_Vec3& v)
+{
+	writer.BeginArray(key);
+	writer.Write(nullptr, v.x);
+	writer.Write(nullptr, v.y);
+	writer.Write(nullptr, v.z);
+	writer.EndArray();
+}
+
+template<typename T>
+void WriteBranchNodeElements(JSONWriter& writer, const T& node)
+{
+	writer.BeginArray("elements");
+	for(const CSGTree::CSGTreeNode& el : node.elements)
+		WriteNode(writer, el);
+	writer.EndArray();
+}
+
+template<typename T>
+void WriteLeafNodeElements(JSONWriter& writer, const T& node)
+{
+	WriteVec3(writer, "center", node.center);
+	WriteVec3(writer, "size", node.size);
+	WriteVec3(writer, "angles", node.angles_deg);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::MulChain& node)
+{
+	writer.Write("type", "mul");
+	WriteBranchNodeElements(writer, node);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::AddChain& node)
+{
+	writer.Write("type", "add");
+	WriteBranchNodeElements(writer, node);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::SubChain& node)
+{
+	writer.Write("type", "sub");
+	WriteBranchNodeElements(writer, node);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::AddArray& node)
+{
+	writer.Write("type", "add_array");
+
+	writer.BeginArray("size");
+	for(size_t i= 0; i < std::size(node.size); ++i)
+		writer.Write(nullptr, size_t(node.size[i]));
+	writer.EndArray();
+
+	WriteVec3(writer, "step", node.step);
+	WriteVec3(writer, "angles", node.angles_deg);
+	WriteBranchNodeElements(writer, node);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::Ellipsoid& node)
+{
+	writer.Write("type", "ellipsoid");
+	WriteLeafNodeElements(writer, node);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::Box& node)
+{
+	writer.Write("type", "box");
+	WriteLeafNodeElements(writer, node);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::Cylinder& node)
+{
+	writer.Write("type", "cylinder");
+	WriteLeafNodeElements(writer, node);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::Cone& node)
+{
+	writer.Write("type", "cone");
+	WriteLeafNodeElements(writer, node);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::Paraboloid& node)
+{
+	writer.Write("type", "paraboloid");
+	WriteLeafNodeElements(writer, node);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::Hyperboloid& node)
+{
+	writer.Write("type", "hyperboloid");
+	WriteLeafNodeElements(writer, node);
+	writer.Write("focus_distance", node.focus_distance);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::ParabolicCylinder& node)
+{
+	writer.Write("type", "parabolic_cylinder");
+	WriteLeafNodeElements(writer, node);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::HyperbolicCylinder& node)
+{
+	writer.Write("type", "hyperbolic_cylinder");
+	WriteLeafNodeElements(writer, node);
+	writer.Write("focus_distance", node.focus_distance);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::HyperbolicParaboloid& node)
+{
+	writer.Write("type", "hyperbolic_paraboloid");
+	WriteVec3(writer, "center", node.center);
+	writer.Write("height", node.height);
+	WriteVec3(writer, "angles", node.angles_deg);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::Reference& node)
+{
+	writer.Write("type", "reference");
+	writer.Write("source", node.source);
+	WriteVec3(writer, "center", node.center);
+	WriteVec3(writer, "angles", node.angles_deg);
+}
+
+void WriteNode_impl(JSONWriter& writer, const CSGTree::Instance& node)
+{
+	writer.Write("type", "instance");
+
+	writer.BeginArray("transforms");
+	for(const CSGTree::InstanceTransform& instance_transform : node.transforms)
+	{
+		writer.BeginObject();
+		WriteVec3(writer, "center", instance_transform.center);
+		WriteVec3(writer, "angles", instance_transform.angles_deg);
+		writer.EndObject();
+	}
+	writer.EndArray();
+
+	WriteBranchNodeElements(writer, node);
+}
+
+void WriteNode(JSONWriter& writer, const CSGTree::CSGTreeNode& node)
+{
+	writer.BeginObject();
+	std::visit([&](const auto& n){ WriteNode_impl(writer, n); }, node);
+	writer.EndObject();
+}
+
+// Node members in JSON may be in any order (Qt, for example, sorts keys), so collect all members before node creation.
+struct NodeMembers
+{
+	std::string type;
+	std::vector<CSGTree::CSGTreeNode> elements;
+	m_Vec3 center{ 0.0f, 0.0f, 0.0f };
+	m_Vec3 size{ 0.0f, 0.0f, 0.0f };
+	m_Vec3 angles_deg{ 0.0f, 0.0f, 0.0f };
+	m_Vec3 step{ 0.0f, 0.0f, 0.0f };
+	float focus_distance= 0.0f;
+	float height= 0.0f;
+	std::string source;
+	std::vector<CSGTree::InstanceTransform> transforms;
+};
+
+struct Definition
+{
+	std::shared_ptr<CSGTree::ReferenceTarget> target;
+	bool defined= false;
+};
+
+struct ReadContext
+{
+	std::string base_directory;
+	// Elements of root may be read in parallel.
+	std::mutex definitions_mutex;
+	// Key is reference source - name with "#" prefix.
+	std::unordered_map<std::string, Definition> definitions;
+	// Definitions may use only previously declared definitions, this prevents reference cycles.
+	bool reading_definitions= false;
+	// For parallel reading of elements.
+	size_t thread_count= 1u;
+};
+
+bool ReadNode(JSONReader& reader, ReadContext& context, CSGTree::CSGTreeNode& out_node, const char* parallel_data= nullptr);
+
+bool ReadNumber(JSONReader& reader, float& out_value)
+{
+	if(reader.Next() != JSONReader::Event::Number)
+		return false;
+	out_value= float(reader.GetNumber());
+	return true;
+}
+
+// Extra array elements are ignored, missing elements are zero.
+bool ReadVec3(JSONReader& reader, m_Vec3& out_vec)
+{
+	if(reader.Next() != JSONReader::Event::BeginArray)
+		return false;
+
+	float values[3]{ 0.0f, 0.0f, 0.0f };
+	for(size_t i= 0u; ; ++i)
+	{
+		const JSONReader::Event event= reader.Next();
+		if(event == JSONReader::Event::EndArray)
+			break;
+		if(event != JSONReader::Event::Number)
+			return false;
+		if(i < std::size(values))
+			values[i]= float(reader.GetNumber());
+	}
+
+	out_vec= m_Vec3(values[0], values[1], values[2]);
+	return true;
+}
+
+bool ReadElements(JSONReader& reader, ReadContext& context, std::vector<CSGTree::CSGTreeNode>& out_elements)
+{
+	if(reader.Next() != JSONReader::Event::BeginArray)
+		return false;
+
+	while(true)
+	{
+		const JSONReader::Event event= reader.Next();
+		if(event == JSONReader::Event::EndArray)
+			return true;
+		if(event != JSONReader::Event::BeginObject)
+			return false;
+
+		out_elements.emplace_back();
+		if(!ReadNode(reader, context, out_elements.back()))
+			return false;
+	}
+}
+
+bool ReadInstanceTransforms(JSONReader& reader, std::vector<CSGTree::InstanceTransform>& out_transforms)
+{
+	if(reader.Next() != JSONReader::Event::BeginArray)
+		return false;
+
+	while(true)
+	{
+		JSONReader::Event event= reader.Next();
+		if(event == JSONReader::Event::EndArray)
+			return true;
+		if(event != JSONReader::Event::BeginObject)
+			return false;
+
+		CSGTree::InstanceTransform instance_transform{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+		while(true)
+		{
+			event= reader.Next();
+			if(event == JSONReader::Event::EndObject)
+				break;
+			if(event != JSONReader::Event::Key)
+				return false;
+
+			const std::string_view key= reader.GetString();
+			bool ok= true;
+			if(key == "center")
+				ok= ReadVec3(reader, instance_transform.center);
+			else if(key == "angles")
+				ok= ReadVec3(reader, instance_transform.angles_deg);
+			else
+				ok= reader.SkipValue();
+
+			if(!ok)
+				return false;
+		}
+		out_transforms.push_back(instance_transform);
+	}
+}
+
+template<typename T>
+T MakeLeafNode(const NodeMembers& members)
+{
+	T res{};
+	res.center= members.center;
+	res.size= members.size;
+	res.angles_deg= members.angles_deg;
+	return res;
+}
+
+std::shared_ptr<CSGTree::ReferenceTarget> ResolveReference(ReadContext& context, const std::string& source)
+{
+	if(!IsDefinitionReferenceSource(source))
+		return GetExternalReferenceTarget(source, context.base_directory);
+
+	const std::lock_guard<std::mutex> lock(context.definitions_mutex);
+	if(context.reading_definitions)
+	{
+		const auto it= context.definitions.find(source);
+		if(it == context.definitions.end() || !it->second.defined)
+		{
+			Log::Warning("Definition \"", source, "\" is used before declaration");
+			return nullptr;
+		}
+		return it->second.target;
+	}
+
+	// Definitions may be declared after root, so create target, which will be filled later.
+	Definition& definition= context.definitions[source];
+	if(definition.target == nullptr)
+		definition.target= std::make_shared<CSGTree::ReferenceTarget>();
+	return definition.target;
+}
+
+CSGTree::CSGTreeNode MakeNode(ReadContext& context, NodeMembers& members)
+{
+	const std::string& type= members.type;
+	if(type == "mul")
+		return CSGTree::MulChain{ std::move(members.elements) };
+	if(type == "add")
+		return CSGTree::AddChain{ std::move(members.elements) };
+	if(type == "sub")
+		return CSGTree::SubChain{ std::move(members.elements) };
+
+	if(type == "add_array")
+	{
+		CSGTree::AddArray add_array;
+		add_array.elements= std::move(members.elements);
+		// Size is read as vector of floats.
+		add_array.size[0]= uint8_t(members.size.x);
+		add_array.size[1]= uint8_t(members.size.y);
+		add_array.size[2]= uint8_t(members.size.z);
+		add_array.step= members.step;
+		add_array.angles_deg= members.angles_deg;
+		return add_array;
+	}
+
+	if(type == "ellipsoid")
+		return MakeLeafNode<CSGTree::Ellipsoid>(members);
+	if(type == "box")
+		return MakeLeafNode<CSGTree::Box>(members);
+	if(type == "cylinder")
+		return MakeLeafNode<CSGTree::Cylinder>(members);
+	if(type == "cone")
+		return MakeLeafNode<CSGTree::Cone>(members);
+	if(type == "paraboloid")
+		return MakeLeafNode<CSGTree::Paraboloid>(members);
+	if(type == "hyperboloid")
+	{
+		CSGTree::Hyperboloid hyperboloid= MakeLeafNode<CSGTree::Hyperboloid>(members);
+		hyperboloid.focus_distance= members.focus_distance;
+		return hyperboloid;
+	}
+	if(type == "parabolic_cylinder")
+		return MakeLeafNode<CSGTree::ParabolicCylinder>(members);
+	if(type == "hyperbolic_cylinder")
+	{
+		CSGTree::HyperbolicCylinder hyperbolic_cylinder= MakeLeafNode<CSGTree::HyperbolicCylinder>(members);
+		hyperbolic_cylinder.focus_distance= members.focus_distance;
+		return hyperbolic_cylinder;
+	}
+	if(type == "reference")
+	{
+		CSGTree::Reference reference;
+		reference.source= std::move(members.source);
+		reference.center= members.center;
+		reference.angles_deg= members.angles_deg;
+		reference.target= ResolveReference(context, reference.source);
+		return reference;
+	}
+	if(type == "instance")
+	{
+		CSGTree::Instance instance;
+		instance.elements= std::move(members.elements);
+		instance.transforms= std::move(members.transforms);
+		return instance;
+	}
+	if(type == "hyperbolic_paraboloid")
+	{
+		CSGTree::HyperbolicParaboloid node{};
+		node.center= members.center;
+		node.angles_deg= members.angles_deg;
+		node.height= members.height;
+		return node;
+	}
+
+	Log::Warning("Unknown CSG node type \"", type, "\"");
+	return CSGTree::AddChain();
+}
+
+// Elements are parsed in parallel, each in separate reader. Results are written directly into "out_elements".
+bool ReadElementsParallel(
+	ReadContext& context,
+	const char* const data,
+	const std::vector<JSONReader::Range>& element_ranges,
+	std::vector<CSGTree::CSGTreeNode>& out_elements)
+{
+	SZV_PROFILE_FUNCTION();
+
+	const size_t elements_offset= out_elements.size();
+	out_elements.resize(elements_offset + element_ranges.size());
+
+	std::atomic<bool> ok{true};
+	ParallelFor(
+		element_ranges.size(),
+		context.thread_count,
+		[&](const size_t i)
+		{
+			SZV_PROFILE_ZONE("ReadElement");
+
+			const JSONReader::Range& range= element_ranges[i];
+			JSONReader reader(data + range.begin, size_t(range.end - range.begin));
+			if(reader.Next() == JSONReader::Event::BeginObject &&
+				ReadNode(reader, context, out_elements[elements_offset + i]) &&
+				reader.Next() == JSONReader::Event::End)
+				return;
+
+			ok.store(false, std::memory_order_relaxed);
+			if(reader.GetErrorMessage().empty())
+				Log::Warning("Invalid scene element structure at position ", range.begin);
+			else
+				Log::Warning("Scene parse error at position ", range.begin + reader.GetErrorPosition(), ": ", reader.GetErrorMessage());
+		});
+
+	return ok.load(std::memory_order_relaxed);
+}
+
+// Object start is already read.
+// If "parallel_data" is not null, reader reads this data in memory and elements of this node are parsed in parallel.
+bool ReadNode(JSONReader& reader, ReadContext& context, CSGTree::CSGTreeNode& out_node, const char* const parallel_data)
+{
+	NodeMembers members;
+	std::vector<JSONReader::Range> element_ranges;
+
+	while(true)
+	{
+		const JSONReader::Event event= reader.Next();
+		if(event == JSONReader::Event::EndObject)
+			break;
+		if(event != JSONReader::Event::Key)
+			return false;
+
+		// Key is valid only until next read.
+		const std::string_view key= reader.GetString();
+		bool ok= true;
+		if(key == "type")
+		{
+			ok= reader.Next() == JSONReader::Event::String;
+			if(ok)
+				members.type= reader.GetString();
+		}
+		else if(key == "source")
+		{
+			ok= reader.Next() == JSONReader::Event::String;
+			if(ok)
+				members.source= reader.GetString();
+		}
+		else if(key == "elements")
+		{
+			if(parallel_data != nullptr)
+			{
+				// Find elements in fast pass, parse them later.
+				element_ranges.clear();
+				ok= reader.SkipArrayUnchecked(element_ranges) && ReadElementsParallel(context, parallel_data, element_ranges, members.elements);
+			}
+			else
+				ok= ReadElements(reader, context, members.elements);
+		}
+		else if(key == "transforms")
+			ok= ReadInstanceTransforms(reader, members.transforms);
+		else if(key == "center")
+			ok= ReadVec3(reader, members.center);
+		else if(key == "size")
+			ok= ReadVec3(reader, members.size);
+		else if(key == "angles")
+			ok= ReadVec3(reader, members.angles_deg);
+		else if(key == "step")
+			ok= ReadVec3(reader, members.step);
+		else if(key == "focus_distance")
+			ok= ReadNumber(reader, members.focus_distance);
+		else if(key == "height")
+			ok= ReadNumber(reader, members.height);
+		else
+			ok= reader.SkipValue();
+
+		if(!ok)
+			return false;
+	}
+
+	out_node= MakeNode(context, members);
+	return true;
+}
+
+bool IsBinarySceneFileName(const std::string& file_name)
+{
+	const char extension[]= ".szvb";
+	const size_t extension_length= std::size(extension) - 1u;
+	if(file_name.size() < extension_length)
+		return false;
+
+	for(size_t i= 0u; i < extension_length; ++i)
+	{
+		if(std::tolower(static_cast<unsigned char>(file_name[file_name.size() - extension_length + i])) != extension[i])
+			return false;
+	}
+	return true;
+}
+
+bool ReadDefinitions(JSONReader& reader, ReadContext& context)
+{
+	if(reader.Next() != JSONReader::Event::BeginObject)
+		return false;
+
+	context.reading_definitions= true;
+	while(true)
+	{
+		const JSONReader::Event event= reader.Next();
+		if(event == JSONReader::Event::EndObject)
+			break;
+		if(event != JSONReader::Event::Key)
+			return false;
+
+		const std::string source= "#" + std::string(reader.GetString());
+		CSGTree::CSGTreeNode node;
+		if(reader.Next() != JSONReader::Event::BeginObject || !ReadNode(reader, context, node))
+			return false;
+
+		Definition& definition= context.definitions[source];
+		if(definition.defined)
+		{
+			Log::Warning("Duplicate definition \"", source, "\"");
+			continue;
+		}
+		if(definition.target == nullptr)
+			definition.target= std::make_shared<CSGTree::ReferenceTarget>();
+		definition.target->SetNode(std::move(node));
+		definition.defined= true;
+	}
+	context.reading_definitions= false;
+
+	return true;
+}
+
+std::optional<CSGTree::CSGTreeNode> DeserializeCSGExpressionTree_impl(
+	JSONReader& reader,
+	const std::string& base_directory,
+	const char* const parallel_data,
+	const size_t thread_count)
+{
+	ReadContext context;
+	context.base_directory= base_directory;
+	context.thread_count= thread_count;
+
+	// Missing root means empty scene.
+	CSGTree::CSGTreeNode root= CSGTree::AddChain();
+
+	bool ok= reader.Next() == JSONReader::Event::BeginObject;
+	while(ok)
+	{
+		const JSONReader::Event event= reader.Next();
+		if(event == JSONReader::Event::EndObject)
+			break;
+		if(event != JSONReader::Event::Key)
+			ok= false;
+		else if(reader.GetString() == "root")
+			ok= reader.Next() == JSONReader::Event::BeginObject && ReadNode(reader, context, root, parallel_data);
+		else if(reader.GetString() == "definitions")
+			ok= ReadDefinitions(reader, context);
+		else
+			ok= reader.SkipValue();
+	}
+	ok= ok && reader.Next() == JSONReader::Event::End;
+
+	if(!ok)
+	{
+		if(reader.GetErrorMessage().empty())
+			Log::Warning("Invalid scene structure");
+		else
+			Log::Warning("Scene parse error at position ", reader.GetErrorPosition(), ": ", reader.GetErrorMessage());
+		return std::nullopt;
+	}
+
+	for(const auto& definition_pair : context.definitions)
+	{
+		if(!definition_pair.second.defined)
+			Log::Warning("Definition \"", definition_pair.first, "\" not found");
+	}
+
+	return root;
+}
+
+} // namespace
+
+void SerializeCSGExpressionTree(const CSGTree::CSGTreeNode& root, std::ostream& stream)
+{
+	SZV_PROFILE_FUNCTION();
+
+	JSONWriter writer(stream);
+	writer.BeginObject();
+	writer.Write("type", "csg_tree_root");
+
+	// Definitions are written in order of dependencies, because each definition may use only previous definitions.
+	const std::vector<CSGTree::ReferenceTarget*> definitions= CollectDefinitions(root);
+	if(!definitions.empty())
+	{
+		// Definition name is taken from any reference to it.
+		std::unordered_map<const CSGTree::ReferenceTarget*, std::string> definition_names;
+		const auto collect_names=
+			[&](const auto& self, const CSGTree::CSGTreeNode& node) -> void
+			{
+				std::visit(
+					[&](const auto& el)
+					{
+						using T= std::decay_t<decltype(el)>;
+						if constexpr(std::is_same_v<T, CSGTree::Reference>)
+						{
+							if(el.target != nullptr && IsDefinitionReferenceSource(el.source))
+								definition_names.emplace(el.target.get(), el.source.substr(1));
+						}
+						else if constexpr(
+							std::is_same_v<T, CSGTree::MulChain> ||
+							std::is_same_v<T, CSGTree::AddChain> ||
+							std::is_same_v<T, CSGTree::SubChain> ||
+							std::is_same_v<T, CSGTree::AddArray> ||
+							std::is_same_v<T, CSGTree::Instance>)
+						{
+							for(const CSGTree::CSGTreeNode& child : el.elements)
+								self(self, child);
+						}
+					},
+					node);
+			};
+		collect_names(collect_names, root);
+		for(CSGTree::ReferenceTarget* const definition : definitions)
+			collect_names(collect_names, definition->GetNode());
+
+		writer.BeginObject("definitions");
+		for(CSGTree::ReferenceTarget* const definition : definitions)
+		{
+			writer.BeginObject(definition_names[definition].c_str());
+			std::visit([&](const auto& n){ WriteNode_impl(writer, n); }, definition->GetNode());
+			writer.EndObject();
+		}
+		writer.EndObject();
+	}
+
+	writer.BeginObject("root");
+	std::visit([&](const auto& n){ WriteNode_impl(writer, n); }, root);
+	writer.EndObject();
+	writer.EndObject();
+	stream << "\n";
+}
+
+std::optional<CSGTree::CSGTreeNode> DeserializeCSGExpressionTree(std::istream& stream, const std::string& base_directory)
+{
+	SZV_PROFILE_FUNCTION();
+
+	JSONReader reader(stream);
+	return DeserializeCSGExpressionTree_impl(reader, base_directory, nullptr, 1u);
+}
+
+std::optional<CSGTree::CSGTreeNode> DeserializeCSGExpressionTree(
+	const char* const data,
+	const size_t size,
+	const std::string& base_directory,
+	size_t thread_count)
+{
+	SZV_PROFILE_FUNCTION();
+
+	// Parallel parsing needs additional pass for finding of elements and thread startup.
+	// It pays off only for large scenes and only if there are several hardware threads.
+	if(thread_count == 0u)
+		thread_count= size < g_min_parallel_parsing_size ? 1u : GetDefaultThreadCount();
+
+	JSONReader reader(data, size);
+	return DeserializeCSGExpressionTree_impl(reader, base_directory, thread_count > 1u ? data : nullptr, thread_count);
+}
+
+bool SaveCSGExpressionTree(const CSGTree::CSGTreeNode& root, const std::string& file_name)
+{
+	std::ofstream file(file_name, std::ios::binary | std::ios::trunc);
+	if(!file.is_open())
+	{
+		Log::Warning("Can not open file \"", file_name, "\" for writing");
+		return false;
+	}
+
+	if(IsBinarySceneFileName(file_name))
+	{
+		const std::vector<uint8_t> data= SerializeCSGTreeBinary(root);
+		file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+	}
+	else
+		SerializeCSGExpressionTree(root, file);
+
+	file.flush();
+	if(!file)
+	{
+		Log::Warning("Can not write file \"", file_name, "\"");
+		return false;
+	}
+	return true;
+}
+
+std::optional<CSGTree::CSGTreeNode> LoadCSGExpressionTree(const std::string& file_name)
+{
+	// Paths of external references are relative to file with these references.
+	const std::string base_directory= std::filesystem::path(file_name).parent_path().string();
+
+	if(IsBinarySceneFileName(file_name))
+	{
+		const MappedFile mapped_file(file_name);
+		if(!mapped_file.IsOpen())
+			return std::nullopt;
+
+		const CSGTreeBinaryView view(mapped_file.GetData(), mapped_file.GetSize());
+		if(view.IsEmpty())
+			return std::nullopt;
+
+		return DeserializeCSGTreeBinary(view, base_directory);
+	}
+
+	// Map whole file to parse its subtrees in parallel.
+	const MappedFile mapped_file(file_name);
+	if(!mapped_file.IsOpen())
+		return std::nullopt;
+
+	return DeserializeCSGExpressionTree(reinterpret_cast<const char*>(mapped_file.GetData()), mapped_file.GetSize(), base_directory);
+}
+
+} // namespace SZV
@@ -0,0 +1,29 @@
+#pragma once
+#include "CSGExpressionTree.hpp"
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+
+namespace SZV
+{
+
+// JSON scene format. Scene is written and read by streams, without building of intermediate document in memory.
+// Subtrees, used by references, are written once, as named definitions.
+void SerializeCSGExpressionTree(const CSGTree::CSGTreeNode& root, std::ostream& stream);
+// Returns empty result on syntax error. Unknown nodes are replaced with empty "add" nodes.
+// Relative paths of external references are resolved against given directory. Referenced files are not loaded here.
+std::optional<CSGTree::CSGTreeNode> DeserializeCSGExpressionTree(std::istream& stream, const std::string& base_directory= "");
+// Same, but for scene in memory. Top-level subtrees are parsed in parallel, if thread count is greater than one.
+// Zero thread count means automatic choice: parallel parsing only for large scenes on machines with several hardware threads.
+std::optional<CSGTree::CSGTreeNode> DeserializeCSGExpressionTree(
+	const char* data,
+	size_t size,
+	const std::string& base_directory= "",
+	size_t thread_count= 0u);
+
+// Format is chosen by extension: binary for ".szvb" files, JSON otherwise.
+bool SaveCSGExpressionTree(const CSGTree::CSGTreeNode& root, const std::string& file_name);
+std::optional<CSGTree::CSGTreeNode> LoadCSGExpressionTree(const std::string& file_name);
+
+} // namespace SZV
@@ -0,0 +1,177 @@
+#include "CacheDirectory.hpp"
+#include "Log.hpp"
+#include <cstdlib>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <atomic>
+#else
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace SZV
+{
+
+namespace
+{
+
+#ifdef _WIN32
+
+std::optional<std::filesystem::path> GetUserCacheBaseDirectory()
+{
+	if(const char* const local_app_data= std::getenv("LOCALAPPDATA"); local_app_data != nullptr && local_app_data[0] != '\0')
+		return std::filesystem::path(local_app_data);
+
+	Log::Warning("Can not find cache directory - LOCALAPPDATA is not set");
+	return std::nullopt;
+}
+
+// Directories inside user profile are not accessible for other users by default.
+bool CreatePrivateDirectory(const std::filesystem::path& path)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(path, ec);
+	if(ec)
+	{
+		Log::Warning("Can not create directory ", path.string(), ": ", ec.message());
+		return false;
+	}
+	return true;
+}
+
+#else
+
+std::optional<std::filesystem::path> GetUserCacheBaseDirectory()
+{
+	// Relative paths in XDG variables are invalid and should be ignored.
+	if(const char* const xdg_cache_home= std::getenv("XDG_CACHE_HOME"); xdg_cache_home != nullptr && xdg_cache_home[0] == '/')
+		return std::filesystem::path(xdg_cache_home);
+
+	const char* home= std::getenv("HOME");
+	if(home == nullptr || home[0] != '/')
+	{
+		const passwd* const pw= getpwuid(getuid());
+		home= pw == nullptr ? nullptr : pw->pw_dir;
+	}
+	if(home == nullptr || home[0] != '/')
+	{
+		Log::Warning("Can not find cache directory - neither XDG_CACHE_HOME nor HOME are set");
+		return std::nullopt;
+	}
+
+	return std::filesystem::path(home) / ".cache";
+}
+
+// Check that directory itself (not symlink to it) is owned by current user and is not accessible for others.
+bool CheckPrivateDirectory(const std::filesystem::path& path)
+{
+	struct stat st{};
+	if(lstat(path.c_str(), &st) != 0)
+	{
+		Log::Warning("Can not access directory ", path.string(), ": ", std::strerror(errno));
+		return false;
+	}
+	if(!S_ISDIR(st.st_mode))
+	{
+		Log::Warning("Cache path ", path.string(), " is not a directory");
+		return false;
+	}
+	if(st.st_uid != geteuid())
+	{
+		Log::Warning("Cache directory ", path.string(), " is not owned by current user");
+		return false;
+	}
+	if((st.st_mode & (S_IRWXG | S_IRWXO)) != 0)
+	{
+		Log::Warning("Cache directory ", path.string(), " is accessible for other users");
+		return false;
+	}
+	return true;
+}
+
+bool CreatePrivateDirectory(const std::filesystem::path& path)
+{
+	if(mkdir(path.c_str(), S_IRWXU) != 0 && errno != EEXIST)
+	{
+		Log::Warning("Can not create directory ", path.string(), ": ", std::strerror(errno));
+		return false;
+	}
+	return CheckPrivateDirectory(path);
+}
+
+#endif
+
+} // namespace
+
+std::optional<std::filesystem::path> GetCacheDirectory(const std::string& name, const std::string& custom_directory)
+{
+	std::filesystem::path directory;
+	if(custom_directory.empty())
+	{
+		const std::optional<std::filesystem::path> base_directory= GetUserCacheBaseDirectory();
+		if(base_directory == std::nullopt)
+			return std::nullopt;
+
+		// Base directory is shared with other programs, create it as usual.
+		std::error_code ec;
+		std::filesystem::create_directories(*base_directory, ec);
+		if(ec)
+		{
+			Log::Warning("Can not create directory ", base_directory->string(), ": ", ec.message());
+			return std::nullopt;
+		}
+
+		directory= *base_directory / "sazava";
+		if(!CreatePrivateDirectory(directory))
+			return std::nullopt;
+	}
+	else
+	{
+		directory= custom_directory;
+		if(!CreatePrivateDirectory(directory))
+			return std::nullopt;
+	}
+
+	directory/= name;
+	if(!CreatePrivateDirectory(directory))
+		return std::nullopt;
+
+	return directory;
+}
+
+std::optional<std::filesystem::path> CreatePrivateWorkDirectory(const std::filesystem::path& parent)
+{
+#ifdef _WIN32
+	static std::atomic<uint32_t> counter{0u};
+	for(uint32_t attempt= 0u; attempt < 16u; ++attempt)
+	{
+		const std::filesystem::path path=
+			parent / ("work_" + std::to_string(GetCurrentProcessId()) + "_" + std::to_string(counter.fetch_add(1u)));
+		std::error_code ec;
+		if(std::filesystem::create_directory(path, ec))
+			return path;
+		if(ec)
+		{
+			Log::Warning("Can not create directory ", path.string(), ": ", ec.message());
+			return std::nullopt;
+		}
+	}
+	Log::Warning("Can not create unique directory in ", parent.string());
+	return std::nullopt;
+#else
+	// "mkdtemp" creates directory with unique name and access only for owner.
+	std::string path_template= (parent / "work_XXXXXX").string();
+	if(mkdtemp(path_template.data()) == nullptr)
+	{
+		Log::Warning("Can not create directory in ", parent.string(), ": ", std::strerror(errno));
+		return std::nullopt;
+	}
+	return std::filesystem::path(path_template);
+#endif
+}
+
+} // namespace SZV
@@ -0,0 +1,21 @@
+#pragma once
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace SZV
+{
+
+// Get directory for cached files with given name. Empty "custom_directory" means per-user cache directory:
+// "$XDG_CACHE_HOME/sazava/<name>", "~/.cache/sazava/<name>" if XDG_CACHE_HOME is not set, "%LOCALAPPDATA%\sazava\<name>" on Windows.
+// Directories are created with access only for current user.
+// Cached files are loaded as code, so directory is rejected if it is not owned by current user or is accessible for others.
+// Returns empty result in case of failure.
+std::optional<std::filesystem::path> GetCacheDirectory(const std::string& name, const std::string& custom_directory= "");
+
+// Create new uniquely-named directory inside given directory, accessible only for current user.
+// Use it for intermediate files, which should not be seen or overwritten by other processes, and remove it after work.
+// Files, created there, may be atomically moved into parent directory, since both are in same file system.
+std::optional<std::filesystem::path> CreatePrivateWorkDirectory(const std::filesystem::path& parent);
+
+} // namespace SZV
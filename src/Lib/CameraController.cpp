@@ -105,4 +105,11 @@ m_Vec3 CameraController::GetCameraPosition() const
 	return pos_;
 }
 
+void CameraController::SetPosition(const m_Vec3& pos, const float azimuth, const float elevation)
+{
+	pos_= pos;
+	azimuth_= azimuth;
+	elevation_= std::max(-0.5f * g_pi, std::min(elevation, +0.5f * g_pi));
+}
+
 } // namespace SZV
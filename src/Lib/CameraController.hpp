@@ -15,6 +15,9 @@ public:
 
 	void Update(float time_delta_s, const InputState& input_state);
 
+	// Set camera state directly, for scripted camera movement.
+	void SetPosition(const m_Vec3& pos, float azimuth, float elevation);
+
 	// Returns rotation + aspect
 	m_Mat4 CalculateViewMatrix() const;
 	m_Mat4 CalculateFullViewMatrix() const;
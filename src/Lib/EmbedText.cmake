@@ -0,0 +1,4 @@
+# Write content of text file into C++ header as raw string literal.
+# Usage: cmake -DINPUT_FILE=... -DOUTPUT_FILE=... -DVARIABLE_NAME=... -P EmbedText.cmake
+file(READ ${INPUT_FILE} CONTENT)
+file(WRITE ${OUTPUT_FILE} "static const char ${VARIABLE_NAME}[]= R\"SZV_EMBED(${CONTENT})SZV_EMBED\";\n")
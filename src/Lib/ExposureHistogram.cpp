@@ -0,0 +1,103 @@
+#include "ExposureHistogram.hpp"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace SZV
+{
+
+uint32_t GetExposureHistogramBin(const float brightness, const ExposureSettings& settings)
+{
+	const float log_brightness= std::log2(std::max(brightness, 1.0e-20f));
+	const float relative=
+		(log_brightness - settings.min_log2_brightness) / (settings.max_log2_brightness - settings.min_log2_brightness);
+
+	const float bin= std::floor(relative * float(c_exposure_histogram_bins));
+	return uint32_t(std::max(0.0f, std::min(bin, float(c_exposure_histogram_bins - 1u))));
+}
+
+ExposureHistogram BuildExposureHistogram(const float* const brightness, const size_t count, const ExposureSettings& settings)
+{
+	ExposureHistogram histogram{};
+	for(size_t i= 0u; i < count; ++i)
+		++histogram[GetExposureHistogramBin(brightness[i], settings)];
+
+	return histogram;
+}
+
+float GetHistogramAverageBrightness(const ExposureHistogram& histogram, const ExposureSettings& settings)
+{
+	float total= 0.0f;
+	for(const uint32_t count : histogram)
+		total+= float(count);
+
+	const float low= total * settings.low_percentile;
+	const float high= total * settings.high_percentile;
+	const float bin_size= (settings.max_log2_brightness - settings.min_log2_brightness) / float(c_exposure_histogram_bins);
+
+	// Take part of each bin, which lies between percentiles.
+	float cumulative= 0.0f;
+	float log_brightness_sum= 0.0f;
+	float weight_sum= 0.0f;
+	for(uint32_t i= 0u; i < c_exposure_histogram_bins; ++i)
+	{
+		const float count= float(histogram[i]);
+		const float weight= std::max(0.0f, std::min(cumulative + count, high) - std::max(cumulative, low));
+		log_brightness_sum+= weight * (settings.min_log2_brightness + (float(i) + 0.5f) * bin_size);
+		weight_sum+= weight;
+		cumulative+= count;
+	}
+
+	if(weight_sum <= 0.0f)
+		return 0.5f;
+
+	return std::exp2(log_brightness_sum / weight_sum);
+}
+
+float GetTargetExposure(const float average_brightness)
+{
+	return 0.6f * std::pow(average_brightness + 0.001f, -0.75f);
+}
+
+float GetExposureMixFactor(const ExposureSettings& settings, const float time_delta_s)
+{
+	const float mix_factor= 1.0f - std::exp(-settings.adaptation_speed * time_delta_s);
+	return std::max(0.0001f, std::min(mix_factor, 1.0f));
+}
+
+float AdaptExposure(const float prev_exposure, const float target_exposure, const float mix_factor)
+{
+	const float inv_exposure= 1.0f / prev_exposure + (1.0f / target_exposure - 1.0f / prev_exposure) * mix_factor;
+	return 1.0f / inv_exposure;
+}
+
+std::string CheckExposureCalculation(const ExposureCalculationResult& result, const ExposureSettings& settings)
+{
+	// GPU transcendental functions are less precise than CPU ones, so only relative closeness is required.
+	const float c_tolerance= 1.0e-3f;
+	const auto is_close=
+		[&](const float a, const float b)
+		{
+			return std::abs(a - b) <= c_tolerance * std::max(std::abs(a), std::abs(b));
+		};
+
+	std::ostringstream stream;
+
+	uint64_t total_samples= 0u;
+	for(const uint32_t count : result.histogram)
+		total_samples+= count;
+	if(total_samples != result.expected_samples)
+		stream << "histogram contains " << total_samples << " samples, expected " << result.expected_samples << "; ";
+
+	const float average_brightness= GetHistogramAverageBrightness(result.histogram, settings);
+	if(!is_close(average_brightness, result.average_brightness))
+		stream << "average brightness " << result.average_brightness << ", expected " << average_brightness << "; ";
+
+	const float exposure= AdaptExposure(result.prev_exposure, GetTargetExposure(average_brightness), result.mix_factor);
+	if(!is_close(exposure, result.exposure))
+		stream << "exposure " << result.exposure << ", expected " << exposure << "; ";
+
+	return stream.str();
+}
+
+} // namespace SZV
@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace SZV
+{
+
+// Number of bins in brightness histogram. Must match value in exposure shader.
+constexpr uint32_t c_exposure_histogram_bins= 64u;
+
+using ExposureHistogram= std::array<uint32_t, c_exposure_histogram_bins>;
+
+struct ExposureSettings
+{
+	// Fraction of darkest and brightest pixels, ignored in average brightness calculation.
+	// Values are in range [0; 1], low percentile must be less than high percentile.
+	float low_percentile= 0.5f;
+	float high_percentile= 0.95f;
+
+	// Exposure change rate, 1/s. Difference between current and target exposure decreases e times per 1/adaptation_speed seconds.
+	float adaptation_speed= 2.0f;
+
+	// Histogram range, in log2 of brightness. Values outside the range are clamped into border bins.
+	float min_log2_brightness= -10.0f;
+	float max_log2_brightness= 6.0f;
+};
+
+// Reference implementation of exposure calculation, performed on GPU in exposure shader.
+
+// Get histogram bin for given brightness.
+uint32_t GetExposureHistogramBin(float brightness, const ExposureSettings& settings);
+
+// Build histogram for given brightness values.
+ExposureHistogram BuildExposureHistogram(const float* brightness, size_t count, const ExposureSettings& settings);
+
+// Calculate average brightness of histogram values between low and high percentiles.
+// Average is calculated in logarithmic space.
+float GetHistogramAverageBrightness(const ExposureHistogram& histogram, const ExposureSettings& settings);
+
+// Exposure, which should be used for given average scene brightness.
+float GetTargetExposure(float average_brightness);
+
+// Get factor for mixing of previous and current exposure after given time.
+float GetExposureMixFactor(const ExposureSettings& settings, float time_delta_s);
+
+// Mix previous exposure with target exposure. Mixing is performed with inverse values for better look.
+float AdaptExposure(float prev_exposure, float target_exposure, float mix_factor);
+
+// Inputs and results of exposure calculation on GPU, read back for comparison with reference implementation.
+struct ExposureCalculationResult
+{
+	ExposureHistogram histogram{};
+	uint64_t expected_samples= 0u; // Number of brightness samples, which should be counted in histogram.
+	float prev_exposure= 1.0f;
+	float mix_factor= 1.0f;
+	float average_brightness= 0.0f;
+	float exposure= 1.0f;
+};
+
+// Compare GPU results with reference implementation, applied to GPU histogram and inputs.
+// Returns empty string if results match, else description of mismatch.
+std::string CheckExposureCalculation(const ExposureCalculationResult& result, const ExposureSettings& settings);
+
+} // namespace SZV
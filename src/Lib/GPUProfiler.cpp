@@ -0,0 +1,258 @@
+#include "GPUProfiler.hpp"
+#include "Assert.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <cstdio>
+
+
+namespace SZV
+{
+
+GPUProfiler::GPUProfiler(I_WindowVulkan& window_vulkan, const uint32_t max_stages_per_frame, const uint32_t latency_frames)
+	: vk_device_(window_vulkan.GetVulkanDevice())
+	, max_stages_per_frame_(max_stages_per_frame)
+{
+	last_frame_result_.frame_index= ~uint64_t(0);
+
+	const vk::PhysicalDevice physical_device= window_vulkan.GetPhysicalDevice();
+	const uint32_t timestamp_valid_bits=
+		physical_device.getQueueFamilyProperties()[window_vulkan.GetQueueFamilyIndex()].timestampValidBits;
+	if(timestamp_valid_bits == 0u)
+	{
+		Log::Info("Timestamps are not supported, GPU profiling is disabled");
+		return;
+	}
+
+	timestamp_mask_= timestamp_valid_bits >= 64u ? ~uint64_t(0) : ((uint64_t(1) << timestamp_valid_bits) - 1u);
+	timestamp_period_ns_= double(physical_device.getProperties().limits.timestampPeriod);
+
+	frames_.resize(std::max(latency_frames, 2u));
+
+	timestamp_query_pool_=
+		vk_device_.createQueryPoolUnique(
+			vk::QueryPoolCreateInfo(
+				vk::QueryPoolCreateFlags(),
+				vk::QueryType::eTimestamp,
+				uint32_t(frames_.size()) * max_stages_per_frame_ * 2u));
+
+	pipeline_statistics_supported_= window_vulkan.GetEnabledDeviceFeatures().pipelineStatisticsQuery != VK_FALSE;
+	if(pipeline_statistics_supported_)
+		statistics_query_pool_=
+			vk_device_.createQueryPoolUnique(
+				vk::QueryPoolCreateInfo(
+					vk::QueryPoolCreateFlags(),
+					vk::QueryType::ePipelineStatistics,
+					uint32_t(frames_.size()) * max_stages_per_frame_,
+					vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations));
+	else
+		Log::Info("Pipeline statistics queries are not enabled, fragment shader invocations will not be counted");
+}
+
+GPUProfiler::~GPUProfiler()
+{
+	// Sync before destruction.
+	vk_device_.waitIdle();
+}
+
+bool GPUProfiler::IsSupported() const
+{
+	return bool(timestamp_query_pool_);
+}
+
+bool GPUProfiler::IsPipelineStatisticsSupported() const
+{
+	return pipeline_statistics_supported_;
+}
+
+void GPUProfiler::BeginFrame(const vk::CommandBuffer command_buffer)
+{
+	if(!timestamp_query_pool_)
+		return;
+
+	if(frame_started_)
+		++current_frame_index_;
+	frame_started_= true;
+
+	const uint32_t slot= uint32_t(current_frame_index_ % frames_.size());
+	FrameData& frame= frames_[slot];
+
+	if(frame.recorded)
+		ReadFrameResults(slot);
+
+	frame.recorded= true;
+	frame.frame_index= current_frame_index_;
+	frame.stages.clear();
+
+	command_buffer.resetQueryPool(*timestamp_query_pool_, slot * max_stages_per_frame_ * 2u, max_stages_per_frame_ * 2u);
+	if(statistics_query_pool_)
+		command_buffer.resetQueryPool(*statistics_query_pool_, slot * max_stages_per_frame_, max_stages_per_frame_);
+}
+
+uint32_t GPUProfiler::BeginStage(const vk::CommandBuffer command_buffer, const char* const name, const bool collect_statistics)
+{
+	if(!timestamp_query_pool_ || !frame_started_)
+		return ~0u;
+
+	const uint32_t slot= uint32_t(current_frame_index_ % frames_.size());
+	FrameData& frame= frames_[slot];
+	if(frame.stages.size() >= max_stages_per_frame_)
+		return ~0u;
+
+	const uint32_t stage_index= uint32_t(frame.stages.size());
+
+	StageData stage;
+	stage.name= name;
+	// Statistics queries of same type can not be nested.
+	stage.collect_statistics= collect_statistics && statistics_query_pool_ && active_statistics_stage_ == ~0u;
+	frame.stages.push_back(stage);
+
+	const uint32_t query_index= slot * max_stages_per_frame_ + stage_index;
+	command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, *timestamp_query_pool_, query_index * 2u);
+	if(stage.collect_statistics)
+	{
+		command_buffer.beginQuery(*statistics_query_pool_, query_index, vk::QueryControlFlags());
+		active_statistics_stage_= stage_index;
+	}
+
+	return stage_index;
+}
+
+void GPUProfiler::EndStage(const vk::CommandBuffer command_buffer, const uint32_t stage_index)
+{
+	if(!timestamp_query_pool_ || stage_index == ~0u)
+		return;
+
+	const uint32_t slot= uint32_t(current_frame_index_ % frames_.size());
+	FrameData& frame= frames_[slot];
+	SZV_ASSERT(stage_index < frame.stages.size());
+	StageData& stage= frame.stages[stage_index];
+
+	const uint32_t query_index= slot * max_stages_per_frame_ + stage_index;
+	if(stage.collect_statistics)
+	{
+		command_buffer.endQuery(*statistics_query_pool_, query_index);
+		active_statistics_stage_= ~0u;
+	}
+	command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, *timestamp_query_pool_, query_index * 2u + 1u);
+
+	stage.finished= true;
+}
+
+uint64_t GPUProfiler::GetCurrentFrameIndex() const
+{
+	return current_frame_index_;
+}
+
+const GPUProfiler::FrameResult& GPUProfiler::GetLastFrameResult() const
+{
+	return last_frame_result_;
+}
+
+void GPUProfiler::LogLastFrameResult() const
+{
+	if(last_frame_result_.frame_index == ~uint64_t(0))
+		return;
+
+	Log::Info("GPU frame ", last_frame_result_.frame_index, " total: ", last_frame_result_.total_time_ms, " ms");
+	for(const StageResult& stage : last_frame_result_.stages)
+	{
+		if(stage.has_statistics)
+			Log::Info("  ", stage.name, ": ", stage.time_ms, " ms, ", stage.fragment_shader_invocations, " fragment invocations");
+		else
+			Log::Info("  ", stage.name, ": ", stage.time_ms, " ms");
+	}
+}
+
+std::string GPUProfiler::GetLastFrameResultSummary() const
+{
+	if(last_frame_result_.frame_index == ~uint64_t(0))
+		return std::string();
+
+	char buf[64];
+	std::snprintf(buf, sizeof(buf), "GPU %.2f ms", last_frame_result_.total_time_ms);
+	std::string result= buf;
+
+	for(const StageResult& stage : last_frame_result_.stages)
+	{
+		std::snprintf(buf, sizeof(buf), " | %s %.2f", stage.name.c_str(), stage.time_ms);
+		result+= buf;
+	}
+
+	return result;
+}
+
+void GPUProfiler::ReadFrameResults(const uint32_t slot)
+{
+	FrameData& frame= frames_[slot];
+	frame.recorded= false;
+
+	FrameResult result;
+	result.frame_index= frame.frame_index;
+
+	uint64_t first_timestamp= ~uint64_t(0);
+	uint64_t last_timestamp= 0u;
+	for(uint32_t i= 0u; i < frame.stages.size(); ++i)
+	{
+		const StageData& stage= frame.stages[i];
+		if(!stage.finished)
+			continue;
+
+		const uint32_t query_index= slot * max_stages_per_frame_ + i;
+
+		uint64_t timestamps[2]{};
+		if(vk_device_.getQueryPoolResults(
+				*timestamp_query_pool_,
+				query_index * 2u, 2u,
+				sizeof(timestamps), timestamps,
+				sizeof(uint64_t),
+				vk::QueryResultFlagBits::e64) != vk::Result::eSuccess)
+			return; // Frame is not finished yet, drop its results.
+
+		StageResult stage_result;
+		stage_result.name= stage.name;
+		stage_result.time_ms= double((timestamps[1] - timestamps[0]) & timestamp_mask_) * timestamp_period_ns_ * 1.0e-6;
+
+		if(stage.collect_statistics)
+		{
+			uint64_t invocations= 0u;
+			if(vk_device_.getQueryPoolResults(
+					*statistics_query_pool_,
+					query_index, 1u,
+					sizeof(invocations), &invocations,
+					sizeof(uint64_t),
+					vk::QueryResultFlagBits::e64) == vk::Result::eSuccess)
+			{
+				stage_result.has_statistics= true;
+				stage_result.fragment_shader_invocations= invocations;
+			}
+		}
+
+		first_timestamp= std::min(first_timestamp, timestamps[0]);
+		last_timestamp= std::max(last_timestamp, timestamps[1]);
+		result.stages.push_back(std::move(stage_result));
+	}
+
+	if(result.stages.empty())
+		return;
+
+	result.total_time_ms= double((last_timestamp - first_timestamp) & timestamp_mask_) * timestamp_period_ns_ * 1.0e-6;
+	last_frame_result_= std::move(result);
+}
+
+GPUProfilerStageScope::GPUProfilerStageScope(
+	GPUProfiler* const profiler,
+	const vk::CommandBuffer command_buffer,
+	const char* const name,
+	const bool collect_statistics)
+	: profiler_(profiler)
+	, command_buffer_(command_buffer)
+	, stage_index_(profiler == nullptr ? ~0u : profiler->BeginStage(command_buffer, name, collect_statistics))
+{}
+
+GPUProfilerStageScope::~GPUProfilerStageScope()
+{
+	if(profiler_ != nullptr)
+		profiler_->EndStage(command_buffer_, stage_index_);
+}
+
+} // namespace SZV
@@ -0,0 +1,115 @@
+#pragma once
+#include "I_WindowVulkan.hpp"
+#include <string>
+#include <vector>
+
+
+namespace SZV
+{
+
+// Measures GPU time of render stages using timestamp queries.
+// Also counts fragment shader invocations for stages if pipeline statistics queries are enabled for device.
+// Results are read without waiting, with latency of several frames.
+class GPUProfiler final
+{
+public:
+	struct StageResult
+	{
+		std::string name;
+		double time_ms= 0.0;
+		bool has_statistics= false;
+		uint64_t fragment_shader_invocations= 0u;
+	};
+
+	struct FrameResult
+	{
+		uint64_t frame_index= 0u;
+		double total_time_ms= 0.0; // Time from first stage start to last stage end.
+		std::vector<StageResult> stages;
+	};
+
+public:
+	explicit GPUProfiler(I_WindowVulkan& window_vulkan, uint32_t max_stages_per_frame= 32u, uint32_t latency_frames= 4u);
+	~GPUProfiler();
+
+	// Returns false if timestamps are not supported. In such case profiler does nothing.
+	bool IsSupported() const;
+	bool IsPipelineStatisticsSupported() const;
+
+	// Call at frame start, outside render pass, before any stage.
+	// Reads results of frame, recorded "latency_frames" ago and resets queries.
+	void BeginFrame(vk::CommandBuffer command_buffer);
+
+	// Stages must be not nested. Stage must begin and end both inside or both outside same render pass.
+	// Name must be string literal or other string, living longer than profiler.
+	// Returns stage index for EndStage, or ~0u if stage can not be recorded.
+	uint32_t BeginStage(vk::CommandBuffer command_buffer, const char* name, bool collect_statistics= false);
+	void EndStage(vk::CommandBuffer command_buffer, uint32_t stage_index);
+
+	// Index of frame, recorded now.
+	uint64_t GetCurrentFrameIndex() const;
+
+	// Result of latest frame, for which results are available. Frame index of empty result is ~0.
+	const FrameResult& GetLastFrameResult() const;
+
+	// Print latest result into log.
+	void LogLastFrameResult() const;
+
+	// Short single-line description of latest result.
+	std::string GetLastFrameResultSummary() const;
+
+private:
+	struct StageData
+	{
+		const char* name= nullptr;
+		bool collect_statistics= false;
+		bool finished= false;
+	};
+
+	struct FrameData
+	{
+		bool recorded= false;
+		uint64_t frame_index= 0u;
+		std::vector<StageData> stages;
+	};
+
+private:
+	void ReadFrameResults(uint32_t slot);
+
+private:
+	const vk::Device vk_device_;
+	const uint32_t max_stages_per_frame_;
+
+	bool pipeline_statistics_supported_= false;
+	uint64_t timestamp_mask_= 0u;
+	double timestamp_period_ns_= 1.0;
+
+	vk::UniqueQueryPool timestamp_query_pool_; // Null if timestamps are not supported.
+	vk::UniqueQueryPool statistics_query_pool_; // Null if pipeline statistics are not supported.
+
+	std::vector<FrameData> frames_;
+	uint64_t current_frame_index_= 0u;
+	bool frame_started_= false;
+	uint32_t active_statistics_stage_= ~0u;
+
+	FrameResult last_frame_result_;
+};
+
+// Helper for measuring of single stage in scope.
+class GPUProfilerStageScope final
+{
+public:
+	// Profiler may be null.
+	GPUProfilerStageScope(GPUProfiler* profiler, vk::CommandBuffer command_buffer, const char* name, bool collect_statistics= false);
+	~GPUProfilerStageScope();
+
+	GPUProfilerStageScope(const GPUProfilerStageScope&)= delete;
+	GPUProfilerStageScope& operator=(const GPUProfilerStageScope&)= delete;
+
+private:
+	GPUProfiler* const profiler_;
+	const vk::CommandBuffer command_buffer_;
+	const uint32_t stage_index_;
+};
+
+} // namespace SZV
@@ -18,6 +18,13 @@ public:
 	virtual bool HasDepthBuffer() const = 0;
 	virtual vk::PhysicalDeviceMemoryProperties GetMemoryProperties() const = 0;
 	virtual vk::PhysicalDevice GetPhysicalDevice() const = 0;
+	virtual vk::PipelineCache GetPipelineCache() const = 0; // Cache for creation of all pipelines.
+	virtual vk::PhysicalDeviceFeatures GetEnabledDeviceFeatures() const = 0;
+	// Number of frames, which may be processed by GPU simultaneously.
+	virtual uint32_t GetFramesInFlightCount() const = 0;
+	// Index of current frame in range [0; frames in flight count).
+	// When frame begins, GPU is guaranteed to finish previous frame with same index, so its resources may be reused.
+	virtual uint32_t GetCurrentFrameIndex() const = 0;
 };
 
 } // namespace SZV
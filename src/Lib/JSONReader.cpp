@@ -0,0 +1,534 @@
+#include "JSONReader.hpp"
+#include <charconv>
+
+namespace SZV
+{
+
+namespace
+{
+
+const size_t g_buffer_size= 65536u;
+const int g_end_of_input= -1;
+
+int HexDigitValue(const int c)
+{
+	if(c >= '0' && c <= '9')
+		return c - '0';
+	if(c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+void AppendUTF8(std::string& str, const uint32_t code_point)
+{
+	if(code_point < 0x80u)
+		str.push_back(char(code_point));
+	else if(code_point < 0x800u)
+	{
+		str.push_back(char(0xC0u | (code_point >> 6u)));
+		str.push_back(char(0x80u | (code_point & 0x3Fu)));
+	}
+	else if(code_point < 0x10000u)
+	{
+		str.push_back(char(0xE0u | (code_point >> 12u)));
+		str.push_back(char(0x80u | ((code_point >> 6u) & 0x3Fu)));
+		str.push_back(char(0x80u | (code_point & 0x3Fu)));
+	}
+	else
+	{
+		str.push_back(char(0xF0u | (code_point >> 18u)));
+		str.push_back(char(0x80u | ((code_point >> 12u) & 0x3Fu)));
+		str.push_back(char(0x80u | ((code_point >> 6u) & 0x3Fu)));
+		str.push_back(char(0x80u | (code_point & 0x3Fu)));
+	}
+}
+
+} // namespace
+
+JSONReader::JSONReader(std::istream& stream)
+	: stream_(&stream), buffer_storage_(g_buffer_size)
+{
+	buffer_= buffer_storage_.data();
+}
+
+JSONReader::JSONReader(const char* const data, const size_t size)
+	: stream_(nullptr), buffer_(data), buffer_size_(size)
+{}
+
+JSONReader::Event JSONReader::Next()
+{
+	if(failed_)
+		return Event::Error;
+
+	SkipWhitespace();
+
+	if(containers_stack_.empty() && root_finished_)
+	{
+		if(PeekChar() == g_end_of_input)
+			return Event::End;
+		return SetError("Unexpected data after end of document");
+	}
+
+	switch(state_)
+	{
+	case State::ExpectValue:
+		return ReadValue();
+
+	case State::ExpectValueOrArrayEnd:
+		if(PeekChar() == ']')
+		{
+			GetChar();
+			containers_stack_.pop_back();
+			return FinishValue(Event::EndArray);
+		}
+		return ReadValue();
+
+	case State::ExpectKeyOrObjectEnd:
+		if(PeekChar() == '}')
+		{
+			GetChar();
+			containers_stack_.pop_back();
+			return FinishValue(Event::EndObject);
+		}
+		break;
+
+	case State::AfterValue:
+		{
+			const int c= GetChar();
+			const char container= containers_stack_.back();
+			if(c == ',')
+			{
+				SkipWhitespace();
+				if(container == '[')
+				{
+					state_= State::ExpectValue;
+					return ReadValue();
+				}
+				break; // Read key.
+			}
+			if((container == '{' && c == '}') || (container == '[' && c == ']'))
+			{
+				containers_stack_.pop_back();
+				return FinishValue(container == '{' ? Event::EndObject : Event::EndArray);
+			}
+			return SetError(container == '{' ? "Expected ',' or '}'" : "Expected ',' or ']'");
+		}
+	}
+
+	// Read object member key.
+	if(PeekChar() != '"')
+		return SetError("Expected object key");
+	if(!ReadString())
+		return Event::Error;
+
+	SkipWhitespace();
+	if(GetChar() != ':')
+		return SetError("Expected ':'");
+
+	state_= State::ExpectValue;
+	return Event::Key;
+}
+
+bool JSONReader::SkipValue()
+{
+	size_t depth= 0u;
+	do
+	{
+		switch(Next())
+		{
+		case Event::BeginObject:
+		case Event::BeginArray:
+			++depth;
+			break;
+		case Event::EndObject:
+		case Event::EndArray:
+			if(depth == 0u)
+				return false;
+			--depth;
+			break;
+		case Event::Key:
+		case Event::String:
+		case Event::Number:
+		case Event::Bool:
+		case Event::Null:
+			break;
+		case Event::End:
+		case Event::Error:
+			return false;
+		}
+	} while(depth > 0u);
+
+	return true;
+}
+
+bool JSONReader::SkipArrayUnchecked(std::vector<Range>& out_element_ranges)
+{
+	if(failed_)
+		return false;
+	if(state_ != State::ExpectValue)
+	{
+		SetError("Array is not expected");
+		return false;
+	}
+
+	SkipWhitespace();
+	if(GetChar() != '[')
+	{
+		SetError("Expected '['");
+		return false;
+	}
+
+	SkipWhitespace();
+	if(PeekChar() == ']')
+	{
+		GetChar();
+		FinishValue(Event::EndArray);
+		return true;
+	}
+
+	while(true)
+	{
+		SkipWhitespace();
+		const uint64_t element_begin= GetPosition();
+
+		// Find end of element - comma or end of array on zero nesting depth.
+		size_t depth= 0u;
+		while(true)
+		{
+			const int c= PeekChar();
+			if(c == g_end_of_input)
+			{
+				SetError("Unexpected end of input");
+				return false;
+			}
+			if(c == '"')
+			{
+				GetChar();
+				while(true)
+				{
+					const int string_c= GetChar();
+					if(string_c == g_end_of_input)
+					{
+						SetError("Unexpected end of input in string");
+						return false;
+					}
+					if(string_c == '\\')
+						GetChar();
+					else if(string_c == '"')
+						break;
+				}
+				continue;
+			}
+			if(c == '{' || c == '[')
+				++depth;
+			else if(c == '}' || c == ']')
+			{
+				if(depth == 0u)
+					break;
+				--depth;
+			}
+			else if(c == ',' && depth == 0u)
+				break;
+			++buffer_pos_;
+		}
+
+		out_element_ranges.push_back(Range{ element_begin, GetPosition() });
+
+		const int c= GetChar();
+		if(c == ']')
+			break;
+		if(c != ',')
+		{
+			SetError("Expected ',' or ']'");
+			return false;
+		}
+	}
+
+	FinishValue(Event::EndArray);
+	return true;
+}
+
+std::string_view JSONReader::GetString() const
+{
+	return string_value_;
+}
+
+double JSONReader::GetNumber() const
+{
+	return number_value_;
+}
+
+bool JSONReader::GetBool() const
+{
+	return bool_value_;
+}
+
+uint64_t JSONReader::GetPosition() const
+{
+	return stream_pos_ + buffer_pos_;
+}
+
+const std::string& JSONReader::GetErrorMessage() const
+{
+	return error_message_;
+}
+
+uint64_t JSONReader::GetErrorPosition() const
+{
+	return error_position_;
+}
+
+int JSONReader::PeekChar()
+{
+	if(buffer_pos_ == buffer_size_)
+	{
+		stream_pos_+= buffer_size_;
+		buffer_pos_= 0u;
+		buffer_size_= 0u;
+		if(stream_ != nullptr && *stream_)
+		{
+			stream_->read(buffer_storage_.data(), std::streamsize(buffer_storage_.size()));
+			buffer_size_= size_t(stream_->gcount());
+		}
+		if(buffer_size_ == 0u)
+			return g_end_of_input;
+	}
+
+	return int(static_cast<unsigned char>(buffer_[buffer_pos_]));
+}
+
+int JSONReader::GetChar()
+{
+	const int c= PeekChar();
+	if(c != g_end_of_input)
+		++buffer_pos_;
+	return c;
+}
+
+void JSONReader::SkipWhitespace()
+{
+	while(true)
+	{
+		const int c= PeekChar();
+		if(c == ' ' || c == '\t' || c == '\n' || c == '\r')
+			++buffer_pos_;
+		else
+			break;
+	}
+}
+
+JSONReader::Event JSONReader::ReadValue()
+{
+	const int c= PeekChar();
+	switch(c)
+	{
+	case '{':
+		GetChar();
+		containers_stack_.push_back('{');
+		state_= State::ExpectKeyOrObjectEnd;
+		return Event::BeginObject;
+
+	case '[':
+		GetChar();
+		containers_stack_.push_back('[');
+		state_= State::ExpectValueOrArrayEnd;
+		return Event::BeginArray;
+
+	case '"':
+		if(!ReadString())
+			return Event::Error;
+		return FinishValue(Event::String);
+
+	case 't':
+		if(!ReadLiteral("true"))
+			return Event::Error;
+		bool_value_= true;
+		return FinishValue(Event::Bool);
+
+	case 'f':
+		if(!ReadLiteral("false"))
+			return Event::Error;
+		bool_value_= false;
+		return FinishValue(Event::Bool);
+
+	case 'n':
+		if(!ReadLiteral("null"))
+			return Event::Error;
+		return FinishValue(Event::Null);
+
+	case g_end_of_input:
+		return SetError("Unexpected end of input");
+	}
+
+	if(c == '-' || (c >= '0' && c <= '9'))
+	{
+		if(!ReadNumber())
+			return Event::Error;
+		return FinishValue(Event::Number);
+	}
+
+	return SetError("Unexpected character");
+}
+
+JSONReader::Event JSONReader::FinishValue(const Event event)
+{
+	state_= State::AfterValue;
+	if(containers_stack_.empty())
+		root_finished_= true;
+	return event;
+}
+
+bool JSONReader::ReadString()
+{
+	GetChar(); // Opening quote.
+	string_value_.clear();
+
+	while(true)
+	{
+		if(PeekChar() == g_end_of_input)
+		{
+			SetError("Unexpected end of input in string");
+			return false;
+		}
+
+		// Fast path - copy all regular characters in buffer at once.
+		size_t end= buffer_pos_;
+		while(end < buffer_size_)
+		{
+			const unsigned char c= static_cast<unsigned char>(buffer_[end]);
+			if(c == '"' || c == '\\' || c < 0x20u)
+				break;
+			++end;
+		}
+		string_value_.append(buffer_ + buffer_pos_, end - buffer_pos_);
+		buffer_pos_= end;
+		if(buffer_pos_ == buffer_size_)
+			continue;
+
+		const int c= GetChar();
+		if(c == '"')
+			return true;
+		if(c != '\\')
+		{
+			SetError("Control character in string");
+			return false;
+		}
+
+		const int escape= GetChar();
+		switch(escape)
+		{
+		case '"': string_value_.push_back('"'); break;
+		case '\\': string_value_.push_back('\\'); break;
+		case '/': string_value_.push_back('/'); break;
+		case 'b': string_value_.push_back('\b'); break;
+		case 'f': string_value_.push_back('\f'); break;
+		case 'n': string_value_.push_back('\n'); break;
+		case 'r': string_value_.push_back('\r'); break;
+		case 't': string_value_.push_back('\t'); break;
+		case 'u':
+			{
+				const auto read_code_unit=
+				[&]() -> int
+				{
+					int code_unit= 0;
+					for(size_t i= 0u; i < 4u; ++i)
+					{
+						const int digit= HexDigitValue(GetChar());
+						if(digit < 0)
+							return -1;
+						code_unit= code_unit * 16 + digit;
+					}
+					return code_unit;
+				};
+
+				const int code_unit= read_code_unit();
+				if(code_unit < 0)
+				{
+					SetError("Invalid unicode escape sequence");
+					return false;
+				}
+
+				uint32_t code_point= uint32_t(code_unit);
+				if(code_point >= 0xD800u && code_point <= 0xDBFFu)
+				{
+					// Surrogate pair.
+					if(GetChar() != '\\' || GetChar() != 'u')
+					{
+						SetError("Invalid unicode surrogate pair");
+						return false;
+					}
+					const int low_code_unit= read_code_unit();
+					if(low_code_unit < 0xDC00 || low_code_unit > 0xDFFF)
+					{
+						SetError("Invalid unicode surrogate pair");
+						return false;
+					}
+					code_point= 0x10000u + ((code_point - 0xD800u) << 10u) + (uint32_t(low_code_unit) - 0xDC00u);
+				}
+				AppendUTF8(string_value_, code_point);
+			}
+			break;
+		default:
+			SetError("Invalid escape sequence");
+			return false;
+		}
+	}
+}
+
+bool JSONReader::ReadNumber()
+{
+	char number[64];
+	size_t length= 0u;
+	while(true)
+	{
+		const int c= PeekChar();
+		if(!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'))
+			break;
+		if(length == std::size(number))
+		{
+			SetError("Number is too long");
+			return false;
+		}
+		number[length]= char(c);
+		++length;
+		++buffer_pos_;
+	}
+
+	// "from_chars" does not depend on locale, unlike "strtod".
+	const std::from_chars_result result= std::from_chars(number, number + length, number_value_);
+	if(result.ec != std::errc() || result.ptr != number + length)
+	{
+		SetError("Invalid number");
+		return false;
+	}
+
+	return true;
+}
+
+bool JSONReader::ReadLiteral(const char* const literal)
+{
+	for(const char* c= literal; *c != '\0'; ++c)
+	{
+		if(GetChar() != *c)
+		{
+			SetError("Invalid literal");
+			return false;
+		}
+	}
+	return true;
+}
+
+JSONReader::Event JSONReader::SetError(const char* const message)
+{
+	if(!failed_)
+	{
+		failed_= true;
+		error_message_= message;
+		error_position_= GetPosition();
+	}
+	return Event::Error;
+}
+
+} // namespace SZV
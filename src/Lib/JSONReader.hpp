@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace SZV
+{
+
+// Streaming pull JSON reader. Input is read by fixed-size chunks, so whole document is never stored in memory.
+// Only structure nesting is tracked, values are reported one by one and should be handled (or skipped) by caller.
+class JSONReader
+{
+public:
+	struct Range
+	{
+		uint64_t begin;
+		uint64_t end;
+	};
+
+public:
+	enum class Event
+	{
+		BeginObject,
+		EndObject,
+		BeginArray,
+		EndArray,
+		Key, // Object member name. Value follows.
+		String,
+		Number,
+		Bool,
+		Null,
+		End, // End of document.
+		Error,
+	};
+
+public:
+	explicit JSONReader(std::istream& stream);
+	// Read data in memory, without copying. Data must outlive reader.
+	JSONReader(const char* data, size_t size);
+
+	// Read next event. After error or end of document same event is returned again.
+	Event Next();
+
+	// Skip value, which follows current key or array element position. Returns false on error.
+	bool SkipValue();
+
+	// Skip array, which follows current key, without parsing of its elements - only strings and brackets nesting are tracked.
+	// This is much faster than full parsing. Positions of elements in input are returned for later parsing,
+	// so elements syntax is not checked here.
+	bool SkipArrayUnchecked(std::vector<Range>& out_element_ranges);
+
+	// Result of last "Key" or "String" event. Valid until next call of "Next".
+	std::string_view GetString() const;
+	// Result of last "Number" event.
+	double GetNumber() const;
+	// Result of last "Bool" event.
+	bool GetBool() const;
+
+	// Current position in input (in bytes).
+	uint64_t GetPosition() const;
+
+	// Error description and position in input (in bytes).
+	const std::string& GetErrorMessage() const;
+	uint64_t GetErrorPosition() const;
+
+private:
+	enum class State
+	{
+		ExpectValue,
+		ExpectValueOrArrayEnd, // Right after "[".
+		ExpectKeyOrObjectEnd, // Right after "{".
+		AfterValue,
+	};
+
+private:
+	int PeekChar();
+	int GetChar();
+	void SkipWhitespace();
+
+	Event ReadValue();
+	Event FinishValue(Event event);
+	bool ReadString();
+	bool ReadNumber();
+	bool ReadLiteral(const char* literal);
+	Event SetError(const char* message);
+
+private:
+	std::istream* const stream_; // Null if data in memory is read.
+	std::vector<char> buffer_storage_;
+	const char* buffer_= nullptr;
+	size_t buffer_pos_= 0u;
+	size_t buffer_size_= 0u;
+	uint64_t stream_pos_= 0u; // Position of buffer start in input.
+
+	std::vector<char> containers_stack_; // '{' or '['.
+	State state_= State::ExpectValue;
+	bool root_finished_= false;
+	bool failed_= false;
+
+	std::string string_value_;
+	double number_value_= 0.0;
+	bool bool_value_= false;
+
+	std::string error_message_;
+	uint64_t error_position_= 0u;
+};
+
+} // namespace SZV
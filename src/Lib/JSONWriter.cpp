@@ -0,0 +1,138 @@
+#include "JSONWriter.hpp"
+#include <charconv>
+#include <cmath>
+#include <string_view>
+
+namespace SZV
+{
+
+namespace
+{
+
+void WriteEscapedString(std::ostream& stream, const std::string_view str)
+{
+	stream << '"';
+	for(const char c : str)
+	{
+		if(c == '"' || c == '\\')
+			stream << '\\' << c;
+		else if(static_cast<unsigned char>(c) < 0x20u)
+		{
+			const char hex_digits[]= "0123456789abcdef";
+			stream << "\\u00" << hex_digits[c >> 4] << hex_digits[c & 15];
+		}
+		else
+			stream << c;
+	}
+	stream << '"';
+}
+
+} // namespace
+
+JSONWriter::JSONWriter(std::ostream& stream)
+	: stream_(stream)
+{}
+
+void JSONWriter::BeginObject(const char* const key)
+{
+	WriteKey(key);
+	stream_ << "{";
+	first_= true;
+	++depth_;
+}
+
+void JSONWriter::EndObject()
+{
+	--depth_;
+	NewLine();
+	stream_ << "}";
+	first_= false;
+}
+
+void JSONWriter::BeginArray(const char* const key)
+{
+	WriteKey(key);
+	stream_ << "[";
+	first_= true;
+	++depth_;
+}
+
+void JSONWriter::EndArray()
+{
+	--depth_;
+	NewLine();
+	stream_ << "]";
+	first_= false;
+}
+
+void JSONWriter::Write(const char* const key, const std::string& value)
+{
+	WriteKey(key);
+	WriteEscapedString(stream_, value);
+}
+
+void JSONWriter::Write(const char* const key, const char* const value)
+{
+	Write(key, std::string(value));
+}
+
+void JSONWriter::Write(const char* const key, const double value)
+{
+	WriteKey(key);
+	stream_ << value;
+}
+
+void JSONWriter::Write(const char* const key, const float value)
+{
+	WriteKey(key);
+
+	// JSON does not support infinity and NaN.
+	if(!std::isfinite(value))
+	{
+		stream_ << "0";
+		return;
+	}
+
+	// "to_chars" does not depend on locale.
+	char buffer[32];
+	const std::to_chars_result result= std::to_chars(buffer, buffer + std::size(buffer), value);
+	stream_.write(buffer, result.ptr - buffer);
+}
+
+void JSONWriter::Write(const char* const key, const size_t value)
+{
+	WriteKey(key);
+	stream_ << value;
+}
+
+void JSONWriter::Write(const char* const key, const bool value)
+{
+	WriteKey(key);
+	stream_ << (value ? "true" : "false");
+}
+
+void JSONWriter::WriteKey(const char* const key)
+{
+	if(depth_ == 0u)
+		return;
+
+	if(!first_)
+		stream_ << ",";
+	first_= false;
+	NewLine();
+
+	if(key != nullptr)
+	{
+		WriteEscapedString(stream_, key);
+		stream_ << ": ";
+	}
+}
+
+void JSONWriter::NewLine()
+{
+	stream_ << "\n";
+	for(size_t i= 0u; i < depth_; ++i)
+		stream_ << "\t";
+}
+
+} // namespace SZV
@@ -0,0 +1,39 @@
+#pragma once
+#include <ostream>
+#include <string>
+
+namespace SZV
+{
+
+// Streaming JSON writer with indentation. Output is written directly into stream.
+// Key is ignored for top-level value and must be null for array elements.
+class JSONWriter
+{
+public:
+	explicit JSONWriter(std::ostream& stream);
+
+	void BeginObject(const char* key= nullptr);
+	void EndObject();
+
+	void BeginArray(const char* key= nullptr);
+	void EndArray();
+
+	void Write(const char* key, const std::string& value);
+	void Write(const char* key, const char* value);
+	void Write(const char* key, double value);
+	// Shortest representation, which is read back exactly.
+	void Write(const char* key, float value);
+	void Write(const char* key, size_t value);
+	void Write(const char* key, bool value);
+
+private:
+	void WriteKey(const char* key);
+	void NewLine();
+
+private:
+	std::ostream& stream_;
+	size_t depth_= 0u;
+	bool first_= true;
+};
+
+} // namespace SZV
@@ -1,16 +1,248 @@
 #include "Log.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
 //#include <SDL_messagebox.h>
 
 
 namespace SZV
 {
 
-Log::LogCallback Log::log_callback_;
-std::ofstream Log::log_file_{ "Sazava_log.log" };
+namespace
+{
+
+using Clock= std::chrono::steady_clock;
+
+struct LogMessage
+{
+	std::string text; // Timestamp + message.
+	size_t message_offset= 0u; // Offset of message itself in text.
+	Log::LogLevel log_level= Log::LogLevel::Info;
+	std::atomic<LogMessage*> next{nullptr};
+};
+
+// Owns writer thread and multi-producer single-consumer queue of messages.
+// Queue is intrusive linked list with stub node (Vyukov's MPSC queue). Producers never block.
+class LogWriter
+{
+public:
+	LogWriter()
+		: start_time_(Clock::now())
+		, log_file_("Sazava_log.log")
+	{
+		thread_= std::thread([this]{ ThreadFunc(); });
+	}
+
+	~LogWriter()
+	{
+		destroyed_.store(true);
+		stop_.store(true);
+		cv_.notify_one();
+		if(thread_.get_id() == std::this_thread::get_id())
+			thread_.detach(); // Exit called from log callback.
+		else
+			thread_.join();
+	}
+
+	static bool IsDestroyed()
+	{
+		return destroyed_.load();
+	}
+
+	void Push(const Log::LogLevel log_level, std::string message)
+	{
+		// Format timestamp in calling thread, since message time is time of this call.
+		const auto time= Clock::now() - start_time_;
+		const double time_s= double(std::chrono::duration_cast<std::chrono::microseconds>(time).count()) * 1.0e-6;
+		char timestamp[32];
+		std::snprintf(timestamp, sizeof(timestamp), "[%10.3f] ", time_s);
+
+		const auto log_message= new LogMessage;
+		log_message->text= timestamp;
+		log_message->message_offset= log_message->text.size();
+		log_message->text+= message;
+		log_message->log_level= log_level;
+
+		Enqueue(log_message);
+		pushed_.fetch_add(1u, std::memory_order_release);
+		cv_.notify_one();
+	}
+
+	void Flush()
+	{
+		// Writer can not wait for itself.
+		if(thread_.get_id() == std::this_thread::get_id())
+			return;
+
+		const uint64_t target= pushed_.load(std::memory_order_acquire);
+		cv_.notify_one();
+
+		std::unique_lock<std::mutex> lock(flush_mutex_);
+		while(written_.load(std::memory_order_acquire) < target)
+			flush_cv_.wait_for(lock, std::chrono::milliseconds(1));
+	}
+
+	void SetCallback(Log::LogCallback callback)
+	{
+		const std::lock_guard<std::mutex> lock(callback_mutex_);
+		log_callback_= std::move(callback);
+	}
+
+private:
+	void Enqueue(LogMessage* const log_message)
+	{
+		log_message->next.store(nullptr, std::memory_order_relaxed);
+		LogMessage* const prev= head_.exchange(log_message, std::memory_order_acq_rel);
+		prev->next.store(log_message, std::memory_order_release);
+	}
+
+	// Called only from writer thread. Returns null if queue is empty or producer is in the middle of insertion.
+	LogMessage* Dequeue()
+	{
+		LogMessage* tail= tail_;
+		LogMessage* next= tail->next.load(std::memory_order_acquire);
+		if(tail == &stub_)
+		{
+			if(next == nullptr)
+				return nullptr;
+			tail_= next;
+			tail= next;
+			next= next->next.load(std::memory_order_acquire);
+		}
+
+		if(next != nullptr)
+		{
+			tail_= next;
+			return tail;
+		}
+
+		if(tail != head_.load(std::memory_order_acquire))
+			return nullptr;
+
+		// Tail is last node, put stub after it in order to extract it.
+		Enqueue(&stub_);
+		next= tail->next.load(std::memory_order_acquire);
+		if(next != nullptr)
+		{
+			tail_= next;
+			return tail;
+		}
+
+		return nullptr;
+	}
+
+	void ThreadFunc()
+	{
+		while(true)
+		{
+			bool any_written= false;
+			while(LogMessage* const log_message= Dequeue())
+			{
+				Write(*log_message);
+				delete log_message;
+				written_.fetch_add(1u, std::memory_order_release);
+				any_written= true;
+			}
+
+			if(any_written)
+			{
+				std::cout.flush();
+				log_file_.flush();
+				const std::lock_guard<std::mutex> lock(flush_mutex_);
+				flush_cv_.notify_all();
+			}
+
+			if(stop_.load() && written_.load() == pushed_.load())
+				break;
+
+			// Producers do not lock mutex, so wake-up may be missed. Use timeout for such case.
+			std::unique_lock<std::mutex> lock(wait_mutex_);
+			cv_.wait_for(lock, std::chrono::milliseconds(10));
+		}
+	}
+
+	void Write(const LogMessage& log_message)
+	{
+		std::cout << log_message.text << '\n';
+		log_file_ << log_message.text << '\n';
+
+		const std::lock_guard<std::mutex> lock(callback_mutex_);
+		if(log_callback_ != nullptr)
+			log_callback_(log_message.text.substr(log_message.message_offset), log_message.log_level);
+	}
+
+private:
+	static std::atomic<bool> destroyed_;
+
+	const Clock::time_point start_time_;
+	std::ofstream log_file_;
+
+	LogMessage stub_;
+	std::atomic<LogMessage*> head_{&stub_}; // Producers side.
+	LogMessage* tail_= &stub_; // Consumer side.
+
+	std::atomic<uint64_t> pushed_{0u};
+	std::atomic<uint64_t> written_{0u};
+	std::atomic<bool> stop_{false};
+
+	std::mutex wait_mutex_;
+	std::condition_variable cv_;
+
+	std::mutex flush_mutex_;
+	std::condition_variable flush_cv_;
+
+	std::mutex callback_mutex_;
+	Log::LogCallback log_callback_;
+
+	std::thread thread_;
+};
+
+std::atomic<bool> LogWriter::destroyed_{false};
+
+LogWriter& GetLogWriter()
+{
+	static LogWriter log_writer;
+	return log_writer;
+}
+
+} // namespace
 
 void Log::SetLogCallback(LogCallback callback)
 {
-	log_callback_= std::move(callback);
+	GetLogWriter().SetCallback(std::move(callback));
+}
+
+void Log::Flush()
+{
+	if(!LogWriter::IsDestroyed())
+		GetLogWriter().Flush();
+}
+
+void Log::PushMessage(const LogLevel log_level, std::string message)
+{
+	if(LogWriter::IsDestroyed())
+	{
+		// Logging during static objects destruction.
+		std::cout << message << std::endl;
+		return;
+	}
+
+	GetLogWriter().Push(log_level, std::move(message));
+}
+
+void Log::FatalErrorImpl(std::string message)
+{
+	PushMessage(LogLevel::FatalError, message);
+	Flush();
+
+	ShowFatalMessageBox(message);
+
+	std::exit(-1);
 }
 
 void Log::ShowFatalMessageBox(const std::string& error_message)
@@ -1,16 +1,21 @@
 #pragma once
 #include <cstdlib>
-#include <fstream>
 #include <functional>
-#include <iostream>
 #include <sstream>
+#include <string>
+
+// Minimal level of messages, compiled into program.
+// 0 - all messages, 1 - info and higher, 2 - warnings and fatal errors. Fatal errors are never disabled.
+#ifndef SZV_LOG_MIN_LEVEL
+#define SZV_LOG_MIN_LEVEL 0
+#endif
 
 
 namespace SZV
 {
 
-// Simple logger. You can write messages to it.
-// Not thread-safe.
+// Asynchronous logger. You can write messages to it from any thread.
+// Messages are formatted in calling thread, passed into lock-free queue and written into console and file by background thread.
 class Log
 {
 public:
@@ -22,7 +27,7 @@ public:
 		FatalError,
 	};
 
-	// Log-out function.
+	// Log-out function. Called from log writer thread.
 	using LogCallback= std::function<void(std::string, LogLevel)>;
 
 	static void SetLogCallback(LogCallback callback);
@@ -36,77 +41,63 @@ public:
 	template<class...Args>
 	static void Warning(const Args&... args);
 
-	// Exits application.
+	// Writes all pending messages and exits application.
 	template<class...Args>
-	static void FatalError(const Args&... args);
+	[[noreturn]] static void FatalError(const Args&... args);
+
+	// Wait until all messages, logged before this call, are written.
+	static void Flush();
 
 private:
-	static inline void Print(std::ostringstream&){}
+	template<class... Args>
+	static std::string Format(const Args&... args);
 
-	template<class Arg0, class... Args>
-	static void Print(std::ostringstream& stream, const Arg0& arg0, const Args&... args);
+	static void PushMessage(LogLevel log_level, std::string message);
 
-	template<class... Args>
-	static void PrinLine(LogLevel log_level, const Args&... args);
+	[[noreturn]] static void FatalErrorImpl(std::string message);
 
 	static void ShowFatalMessageBox(const std::string& error_message);
-
-private:
-	static LogCallback log_callback_;
-	static std::ofstream log_file_;
 };
 
 template<class...Args>
 void Log::User(const Args&... args)
 {
-	PrinLine(LogLevel::User, args...);
+	if constexpr(int(LogLevel::User) >= SZV_LOG_MIN_LEVEL)
+		PushMessage(LogLevel::User, Format(args...));
+	else
+		((void)args, ...);
 }
 
 template<class... Args>
 void Log::Info(const Args&... args)
 {
-	PrinLine(LogLevel::Info, args...);
+	if constexpr(int(LogLevel::Info) >= SZV_LOG_MIN_LEVEL)
+		PushMessage(LogLevel::Info, Format(args...));
+	else
+		((void)args, ...);
 }
 
 template<class... Args>
 void Log::Warning(const Args&... args)
 {
-	PrinLine(LogLevel::Warning, args...);
+	if constexpr(int(LogLevel::Warning) >= SZV_LOG_MIN_LEVEL)
+		PushMessage(LogLevel::Warning, Format(args...));
+	else
+		((void)args, ...);
 }
 
 template<class... Args>
 void Log::FatalError(const Args&... args)
 {
-	std::ostringstream stream;
-	Print(stream, args...);
-	const std::string str= stream.str();
-
-	std::cout << str << std::endl;
-	log_file_ << str << std::endl;
-	ShowFatalMessageBox(str);
-
-	std::exit(-1);
-}
-
-template<class Arg0, class... Args>
-void Log::Print(std::ostringstream& stream, const Arg0& arg0, const Args&... args)
-{
-	stream << arg0;
-	Print(stream, args...);
+	FatalErrorImpl(Format(args...));
 }
 
 template<class... Args>
-void Log::PrinLine(const LogLevel log_level, const Args&... args)
+std::string Log::Format(const Args&... args)
 {
 	std::ostringstream stream;
-	Print(stream, args...);
-	const std::string str= stream.str();
-
-	std::cout << str << std::endl;
-	log_file_ << str << std::endl;
-
-	if(log_callback_ != nullptr)
-		log_callback_(std::move(str), log_level);
+	(stream << ... << args);
+	return stream.str();
 }
 
 } // namespace SZV
@@ -0,0 +1,116 @@
+#include "MappedFile.hpp"
+#include "Log.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace SZV
+{
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& file_name)
+{
+	const HANDLE file= CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		Log::Warning("Can not open file \"", file_name, "\"");
+		return;
+	}
+	file_handle_= file;
+
+	LARGE_INTEGER file_size;
+	if(!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+		return;
+
+	const HANDLE mapping= CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mapping == nullptr)
+	{
+		Log::Warning("Can not map file \"", file_name, "\"");
+		return;
+	}
+	mapping_handle_= mapping;
+
+	const void* const data= MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(data == nullptr)
+	{
+		Log::Warning("Can not map file \"", file_name, "\"");
+		return;
+	}
+
+	data_= static_cast<const uint8_t*>(data);
+	size_= size_t(file_size.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+	if(data_ != nullptr)
+		UnmapViewOfFile(data_);
+	if(mapping_handle_ != nullptr)
+		CloseHandle(mapping_handle_);
+	if(file_handle_ != nullptr)
+		CloseHandle(file_handle_);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& file_name)
+{
+	const int fd= open(file_name.c_str(), O_RDONLY);
+	if(fd == -1)
+	{
+		Log::Warning("Can not open file \"", file_name, "\"");
+		return;
+	}
+
+	struct stat file_stat{};
+	if(fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0)
+	{
+		close(fd);
+		return;
+	}
+
+	void* const data= mmap(nullptr, size_t(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// Mapping is still valid after closing of file descriptor.
+	close(fd);
+
+	if(data == MAP_FAILED)
+	{
+		Log::Warning("Can not map file \"", file_name, "\"");
+		return;
+	}
+
+	data_= static_cast<const uint8_t*>(data);
+	size_= size_t(file_stat.st_size);
+}
+
+MappedFile::~MappedFile()
+{
+	if(data_ != nullptr)
+		munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+#endif
+
+bool MappedFile::IsOpen() const
+{
+	return data_ != nullptr;
+}
+
+const uint8_t* MappedFile::GetData() const
+{
+	return data_;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return size_;
+}
+
+} // namespace SZV
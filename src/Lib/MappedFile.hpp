@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace SZV
+{
+
+// Read-only memory mapping of whole file.
+class MappedFile
+{
+public:
+	// Result is empty if file can not be opened or mapped.
+	explicit MappedFile(const std::string& file_name);
+	~MappedFile();
+
+	MappedFile(const MappedFile&)= delete;
+	MappedFile& operator=(const MappedFile&)= delete;
+
+	bool IsOpen() const;
+	const uint8_t* GetData() const;
+	size_t GetSize() const;
+
+private:
+	const uint8_t* data_= nullptr;
+	size_t size_= 0u;
+#ifdef _WIN32
+	void* file_handle_= nullptr;
+	void* mapping_handle_= nullptr;
+#endif
+};
+
+} // namespace SZV
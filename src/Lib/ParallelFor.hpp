@@ -0,0 +1,51 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+namespace SZV
+{
+
+// Returns number of threads, used for parallel work, if given number is zero.
+inline size_t GetDefaultThreadCount()
+{
+	return std::max(size_t(1u), size_t(std::thread::hardware_concurrency()));
+}
+
+// Call "func(i)" for each i in range [0; count) using several threads.
+// Tasks are distributed dynamically, so tasks with different cost are balanced.
+// Calling thread participates in work too.
+template<typename Func>
+void ParallelFor(const size_t count, size_t thread_count, const Func& func)
+{
+	if(thread_count == 0u)
+		thread_count= GetDefaultThreadCount();
+	thread_count= std::min(thread_count, count);
+
+	std::atomic<size_t> next_task{0u};
+	const auto thread_func=
+	[&]
+	{
+		while(true)
+		{
+			const size_t i= next_task.fetch_add(1u, std::memory_order_relaxed);
+			if(i >= count)
+				break;
+			func(i);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(thread_count);
+	for(size_t i= 1u; i < thread_count; ++i)
+		threads.emplace_back(thread_func);
+
+	thread_func();
+
+	for(std::thread& thread : threads)
+		thread.join();
+}
+
+} // namespace SZV
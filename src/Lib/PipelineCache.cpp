@@ -0,0 +1,121 @@
+#include "PipelineCache.hpp"
+#include "Log.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+
+namespace SZV
+{
+
+namespace
+{
+
+std::vector<char> LoadFile(const std::string& file_path)
+{
+	std::ifstream file(file_path, std::ios::binary);
+	if(!file)
+		return {};
+
+	file.seekg(0, std::ios::end);
+	const std::streamoff size= file.tellg();
+	file.seekg(0, std::ios::beg);
+	if(size <= 0)
+		return {};
+
+	std::vector<char> result(size_t(size), 0);
+	file.read(result.data(), size);
+	if(!file)
+		return {};
+
+	return result;
+}
+
+// Check cache header, to avoid passing of data, created for other device or driver version.
+bool IsCacheDataCompatible(const std::vector<char>& data, const vk::PhysicalDeviceProperties& properties)
+{
+	struct Header
+	{
+		uint32_t header_size;
+		uint32_t header_version;
+		uint32_t vendor_id;
+		uint32_t device_id;
+		uint8_t uuid[VK_UUID_SIZE];
+	};
+
+	if(data.size() < sizeof(Header))
+		return false;
+
+	Header header;
+	std::memcpy(&header, data.data(), sizeof(Header));
+
+	return
+		header.header_size >= sizeof(Header) &&
+		header.header_version == uint32_t(VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+		header.vendor_id == properties.vendorID &&
+		header.device_id == properties.deviceID &&
+		std::memcmp(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+} // namespace
+
+PipelineCache::PipelineCache(const vk::Device vk_device, const vk::PhysicalDevice physical_device, std::string file_path)
+	: vk_device_(vk_device), file_path_(std::move(file_path))
+{
+	std::vector<char> data= LoadFile(file_path_);
+	if(!data.empty() && !IsCacheDataCompatible(data, physical_device.getProperties()))
+	{
+		Log::Info("Ignoring incompatible pipeline cache ", file_path_);
+		data.clear();
+	}
+
+	pipeline_cache_=
+		vk_device_.createPipelineCacheUnique(
+			vk::PipelineCacheCreateInfo(
+				vk::PipelineCacheCreateFlags(),
+				data.size(),
+				data.data()));
+
+	if(!data.empty())
+		Log::Info("Pipeline cache loaded from ", file_path_, ", ", data.size(), " bytes");
+}
+
+PipelineCache::~PipelineCache()
+{
+	Save();
+}
+
+vk::PipelineCache PipelineCache::Get() const
+{
+	return *pipeline_cache_;
+}
+
+void PipelineCache::Save()
+{
+	const std::vector<uint8_t> data= vk_device_.getPipelineCacheData(*pipeline_cache_);
+	if(data.empty())
+		return;
+
+	// Write into temporary file and than replace old file, so that crash during writing does not leave truncated cache.
+	const std::string temp_file_path= file_path_ + ".tmp";
+	{
+		std::ofstream file(temp_file_path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+		file.close();
+		if(!file)
+		{
+			Log::Warning("Can not save pipeline cache into ", temp_file_path);
+			std::error_code ec;
+			std::filesystem::remove(temp_file_path, ec);
+			return;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temp_file_path, file_path_, ec);
+	if(ec)
+		Log::Warning("Can not rename ", temp_file_path, " into ", file_path_, ": ", ec.message());
+}
+
+} // namespace SZV
@@ -0,0 +1,30 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <string>
+
+
+namespace SZV
+{
+
+// Pipeline cache, persistent between application runs.
+// Data is loaded from file in constructor and saved in destructor.
+class PipelineCache final
+{
+public:
+	PipelineCache(vk::Device vk_device, vk::PhysicalDevice physical_device, std::string file_path);
+	~PipelineCache();
+
+	PipelineCache(const PipelineCache&)= delete;
+	PipelineCache& operator=(const PipelineCache&)= delete;
+
+	vk::PipelineCache Get() const;
+
+	void Save();
+
+private:
+	const vk::Device vk_device_;
+	const std::string file_path_;
+	vk::UniquePipelineCache pipeline_cache_;
+};
+
+} // namespace SZV
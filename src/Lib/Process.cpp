@@ -0,0 +1,137 @@
+#include "Process.hpp"
+#include "Assert.hpp"
+#include "Log.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstring>
+
+extern char** environ;
+#endif
+
+namespace SZV
+{
+
+#ifdef _WIN32
+
+namespace
+{
+
+// Quote argument according to rules of CommandLineToArgvW.
+void AppendQuotedArgument(std::string& command_line, const std::string& arg)
+{
+	command_line+= '"';
+	size_t backslashes= 0u;
+	for(const char c : arg)
+	{
+		if(c == '\\')
+			++backslashes;
+		else
+		{
+			if(c == '"')
+				command_line.append(backslashes + 1u, '\\');
+			backslashes= 0u;
+		}
+		command_line+= c;
+	}
+	command_line.append(backslashes, '\\');
+	command_line+= '"';
+}
+
+} // namespace
+
+bool RunProcess(const std::vector<std::string>& args, const std::string& log_file_path)
+{
+	SZV_ASSERT(!args.empty());
+
+	std::string command_line;
+	for(const std::string& arg : args)
+	{
+		if(!command_line.empty())
+			command_line+= ' ';
+		AppendQuotedArgument(command_line, arg);
+	}
+
+	SECURITY_ATTRIBUTES security_attributes{};
+	security_attributes.nLength= sizeof(security_attributes);
+	security_attributes.bInheritHandle= TRUE;
+	const HANDLE log_file=
+		CreateFileA(log_file_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &security_attributes, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(log_file == INVALID_HANDLE_VALUE)
+	{
+		Log::Warning("Can not open file \"", log_file_path, "\"");
+		return false;
+	}
+
+	STARTUPINFOA startup_info{};
+	startup_info.cb= sizeof(startup_info);
+	startup_info.dwFlags= STARTF_USESTDHANDLES;
+	startup_info.hStdInput= GetStdHandle(STD_INPUT_HANDLE);
+	startup_info.hStdOutput= log_file;
+	startup_info.hStdError= log_file;
+
+	PROCESS_INFORMATION process_information{};
+	const BOOL created=
+		CreateProcessA(nullptr, command_line.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup_info, &process_information);
+	CloseHandle(log_file);
+	if(!created)
+	{
+		Log::Warning("Can not start \"", args.front(), "\"");
+		return false;
+	}
+
+	WaitForSingleObject(process_information.hProcess, INFINITE);
+	DWORD exit_code= 1;
+	GetExitCodeProcess(process_information.hProcess, &exit_code);
+	CloseHandle(process_information.hProcess);
+	CloseHandle(process_information.hThread);
+	return exit_code == 0;
+}
+
+#else
+
+bool RunProcess(const std::vector<std::string>& args, const std::string& log_file_path)
+{
+	SZV_ASSERT(!args.empty());
+
+	std::vector<char*> argv;
+	argv.reserve(args.size() + 1u);
+	for(const std::string& arg : args)
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	argv.push_back(nullptr);
+
+	posix_spawn_file_actions_t file_actions;
+	posix_spawn_file_actions_init(&file_actions);
+	posix_spawn_file_actions_addopen(&file_actions, STDOUT_FILENO, log_file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	posix_spawn_file_actions_adddup2(&file_actions, STDOUT_FILENO, STDERR_FILENO);
+
+	pid_t pid= 0;
+	const int spawn_result= posix_spawnp(&pid, argv.front(), &file_actions, nullptr, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&file_actions);
+	if(spawn_result != 0)
+	{
+		Log::Warning("Can not start \"", args.front(), "\": ", std::strerror(spawn_result));
+		return false;
+	}
+
+	int status= 0;
+	while(waitpid(pid, &status, 0) == -1)
+	{
+		if(errno != EINTR)
+		{
+			Log::Warning("Can not wait for \"", args.front(), "\": ", std::strerror(errno));
+			return false;
+		}
+	}
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+#endif
+
+} // namespace SZV
@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+#include <vector>
+
+namespace SZV
+{
+
+// Run program with given arguments and wait for its completion. First argument is program name, it is searched in PATH.
+// Arguments are passed directly, without shell, so no quoting or escaping is needed.
+// Standard output and error output of the program are written into given log file.
+// Returns true if program was started and exited with zero code.
+bool RunProcess(const std::vector<std::string>& args, const std::string& log_file_path);
+
+} // namespace SZV
@@ -0,0 +1,318 @@
+#include "Profiler.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace SZV
+{
+
+namespace
+{
+
+constexpr size_t c_thread_buffer_size= 1u << 14u;
+constexpr size_t c_max_captured_zones= 1u << 22u;
+
+// Ring buffer with single producer (owning thread) and single consumer (collecting thread).
+struct ThreadBuffer
+{
+	Profiler::Zone zones[c_thread_buffer_size];
+	std::atomic<uint64_t> write_pos{0u};
+	std::atomic<uint64_t> read_pos{0u};
+	std::atomic<uint64_t> dropped{0u};
+
+	// Accessed only by owning thread.
+	uint32_t thread_id= 0u;
+	uint32_t depth= 0u;
+};
+
+struct ProfilerState
+{
+	// Protects buffers list and free buffers list.
+	std::mutex buffers_mutex;
+	// Buffers are never destroyed, buffers of finished threads are reused by new threads.
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+	std::vector<ThreadBuffer*> free_buffers;
+	uint32_t next_thread_id= 0u;
+
+	// Protects capture.
+	std::mutex capture_mutex;
+	std::vector<Profiler::Zone> captured_zones;
+	uint64_t capture_start_ns= 0u;
+	uint64_t captured_zones_dropped= 0u;
+};
+
+ProfilerState& GetState()
+{
+	static ProfilerState state;
+	return state;
+}
+
+// Returns buffer to free list at thread exit.
+struct ThreadBufferHolder
+{
+	ThreadBuffer* buffer= nullptr;
+
+	~ThreadBufferHolder()
+	{
+		if(buffer == nullptr)
+			return;
+
+		ProfilerState& state= GetState();
+		const std::lock_guard<std::mutex> lock(state.buffers_mutex);
+		state.free_buffers.push_back(buffer);
+	}
+};
+
+thread_local ThreadBufferHolder g_thread_buffer;
+
+ThreadBuffer& GetThreadBuffer()
+{
+	if(g_thread_buffer.buffer == nullptr)
+	{
+		ProfilerState& state= GetState();
+		const std::lock_guard<std::mutex> lock(state.buffers_mutex);
+
+		if(state.free_buffers.empty())
+		{
+			state.buffers.push_back(std::make_unique<ThreadBuffer>());
+			g_thread_buffer.buffer= state.buffers.back().get();
+		}
+		else
+		{
+			g_thread_buffer.buffer= state.free_buffers.back();
+			state.free_buffers.pop_back();
+		}
+
+		// Each thread gets unique id, even if it reuses buffer of finished thread.
+		g_thread_buffer.buffer->thread_id= state.next_thread_id;
+		g_thread_buffer.buffer->depth= 0u;
+		++state.next_thread_id;
+	}
+
+	return *g_thread_buffer.buffer;
+}
+
+// Requires locked capture mutex.
+void CollectImpl(ProfilerState& state)
+{
+	std::vector<ThreadBuffer*> buffers;
+	{
+		const std::lock_guard<std::mutex> lock(state.buffers_mutex);
+		buffers.reserve(state.buffers.size());
+		for(const auto& buffer : state.buffers)
+			buffers.push_back(buffer.get());
+	}
+
+	for(ThreadBuffer* const buffer : buffers)
+	{
+		const uint64_t write_pos= buffer->write_pos.load(std::memory_order_acquire);
+		uint64_t read_pos= buffer->read_pos.load(std::memory_order_relaxed);
+		for(; read_pos < write_pos; ++read_pos)
+		{
+			const Profiler::Zone& zone= buffer->zones[read_pos % c_thread_buffer_size];
+			// Skip zones, started before current capture.
+			if(zone.start_ns < state.capture_start_ns)
+				continue;
+
+			if(state.captured_zones.size() < c_max_captured_zones)
+				state.captured_zones.push_back(zone);
+			else
+				++state.captured_zones_dropped;
+		}
+		buffer->read_pos.store(write_pos, std::memory_order_release);
+	}
+}
+
+void WriteJSONString(std::ostream& stream, const char* str)
+{
+	stream << '"';
+	for(; *str != '\0'; ++str)
+	{
+		const char c= *str;
+		if(c == '"' || c == '\\')
+			stream << '\\' << c;
+		else if(uint8_t(c) < 0x20u)
+		{
+			char buf[8];
+			std::snprintf(buf, sizeof(buf), "\\u%04x", uint32_t(uint8_t(c)));
+			stream << buf;
+		}
+		else
+			stream << c;
+	}
+	stream << '"';
+}
+
+} // namespace
+
+std::atomic<bool> Profiler::enabled_{false};
+
+void Profiler::SetEnabled(const bool enabled)
+{
+	ProfilerState& state= GetState();
+	const std::lock_guard<std::mutex> lock(state.capture_mutex);
+
+	if(enabled && !enabled_.load(std::memory_order_relaxed))
+	{
+		state.capture_start_ns= GetTimeNs();
+		CollectImpl(state); // Drain zones of previous capture.
+		state.captured_zones.clear();
+		state.captured_zones_dropped= 0u;
+
+		const std::lock_guard<std::mutex> buffers_lock(state.buffers_mutex);
+		for(const auto& buffer : state.buffers)
+			buffer->dropped.store(0u, std::memory_order_relaxed);
+	}
+
+	enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::Collect()
+{
+	ProfilerState& state= GetState();
+	const std::lock_guard<std::mutex> lock(state.capture_mutex);
+	CollectImpl(state);
+}
+
+bool Profiler::WriteChromeTrace(const std::string& file_name)
+{
+	std::vector<Zone> zones;
+	uint64_t capture_start_ns= 0u;
+	{
+		ProfilerState& state= GetState();
+		const std::lock_guard<std::mutex> lock(state.capture_mutex);
+		CollectImpl(state);
+		zones= state.captured_zones;
+		capture_start_ns= state.capture_start_ns;
+	}
+
+	// Sort zones in order of start, parent zones first.
+	std::sort(
+		zones.begin(), zones.end(),
+		[](const Zone& l, const Zone& r)
+		{
+			if(l.thread_id != r.thread_id)
+				return l.thread_id < r.thread_id;
+			if(l.start_ns != r.start_ns)
+				return l.start_ns < r.start_ns;
+			return l.depth < r.depth;
+		});
+
+	std::ofstream file(file_name, std::ios::out | std::ios::trunc);
+	if(!file.is_open())
+	{
+		Log::Warning("Can not open file \"", file_name, "\" for trace writing");
+		return false;
+	}
+
+	file << "{\"traceEvents\":[\n";
+
+	// Write microseconds with nanosecond precision.
+	const auto write_time=
+	[&](const uint64_t time_ns)
+	{
+		char buf[32];
+		std::snprintf(buf, sizeof(buf), "%llu.%03u", (unsigned long long)(time_ns / 1000u), uint32_t(time_ns % 1000u));
+		file << buf;
+	};
+
+	bool first= true;
+	uint32_t prev_thread_id= ~0u;
+	for(const Zone& zone : zones)
+	{
+		if(!first)
+			file << ",\n";
+		first= false;
+
+		if(zone.thread_id != prev_thread_id)
+		{
+			prev_thread_id= zone.thread_id;
+			file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << zone.thread_id
+				<< ",\"args\":{\"name\":\"Thread " << zone.thread_id << "\"}},\n";
+		}
+
+		file << "{\"name\":";
+		WriteJSONString(file, zone.name);
+		file << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << zone.thread_id << ",\"ts\":";
+		write_time(zone.start_ns - capture_start_ns);
+		file << ",\"dur\":";
+		write_time(zone.end_ns - zone.start_ns);
+		file << "}";
+	}
+
+	file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	file.close();
+
+	if(file.fail())
+	{
+		Log::Warning("Failed to write trace into \"", file_name, "\"");
+		return false;
+	}
+
+	Log::Info("Profiler trace with ", zones.size(), " zones written into \"", file_name, "\"");
+	const uint64_t dropped= GetDroppedZonesCount();
+	if(dropped > 0u)
+		Log::Warning(dropped, " profiler zones were lost because of buffers overflow");
+
+	return true;
+}
+
+uint64_t Profiler::GetDroppedZonesCount()
+{
+	ProfilerState& state= GetState();
+	const std::lock_guard<std::mutex> lock(state.capture_mutex);
+
+	uint64_t result= state.captured_zones_dropped;
+
+	const std::lock_guard<std::mutex> buffers_lock(state.buffers_mutex);
+	for(const auto& buffer : state.buffers)
+		result+= buffer->dropped.load(std::memory_order_relaxed);
+
+	return result;
+}
+
+uint64_t Profiler::GetTimeNs()
+{
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint32_t Profiler::BeginZone()
+{
+	ThreadBuffer& buffer= GetThreadBuffer();
+	const uint32_t depth= buffer.depth;
+	++buffer.depth;
+	return depth;
+}
+
+void Profiler::EndZone(const char* const name, const uint64_t start_ns, const uint32_t depth)
+{
+	const uint64_t end_ns= GetTimeNs();
+
+	ThreadBuffer& buffer= GetThreadBuffer();
+	buffer.depth= depth;
+
+	const uint64_t write_pos= buffer.write_pos.load(std::memory_order_relaxed);
+	const uint64_t read_pos= buffer.read_pos.load(std::memory_order_acquire);
+	if(write_pos - read_pos >= c_thread_buffer_size)
+	{
+		buffer.dropped.fetch_add(1u, std::memory_order_relaxed);
+		return;
+	}
+
+	Zone& zone= buffer.zones[write_pos % c_thread_buffer_size];
+	zone.name= name;
+	zone.start_ns= start_ns;
+	zone.end_ns= end_ns;
+	zone.thread_id= buffer.thread_id;
+	zone.depth= depth;
+
+	buffer.write_pos.store(write_pos + 1u, std::memory_order_release);
+}
+
+} // namespace SZV
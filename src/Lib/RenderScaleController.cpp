@@ -0,0 +1,66 @@
+#include "RenderScaleController.hpp"
+#include <algorithm>
+#include <cmath>
+
+
+namespace SZV
+{
+
+RenderScaleController::RenderScaleController(const RenderScaleSettings& settings)
+{
+	SetSettings(settings);
+}
+
+void RenderScaleController::SetSettings(const RenderScaleSettings& settings)
+{
+	settings_= settings;
+	settings_.max_scale= std::max(settings_.min_scale, settings_.max_scale);
+	scale_= std::max(settings_.min_scale, std::min(scale_, settings_.max_scale));
+}
+
+const RenderScaleSettings& RenderScaleController::GetSettings() const
+{
+	return settings_;
+}
+
+float RenderScaleController::Update(const float gpu_frame_time_s, const float frame_scale)
+{
+	if(!(gpu_frame_time_s > 0.0f) || !(frame_scale > 0.0f))
+		return scale_;
+
+	// Measurements come with several frames of latency, so normalize time to current scale.
+	const float relative_scale= scale_ / frame_scale;
+	const float frame_time_s= gpu_frame_time_s * relative_scale * relative_scale;
+
+	if(smoothed_frame_time_s_ <= 0.0f)
+		smoothed_frame_time_s_= frame_time_s;
+	else
+		smoothed_frame_time_s_+= (frame_time_s - smoothed_frame_time_s_) * settings_.smoothing_factor;
+
+	const float time_ratio= settings_.target_frame_time_s / smoothed_frame_time_s_;
+	if(std::abs(time_ratio - 1.0f) <= settings_.tolerance)
+		return scale_;
+
+	const float scale_change=
+		std::max(1.0f - settings_.max_step, std::min(std::sqrt(time_ratio), 1.0f + settings_.max_step));
+
+	const float new_scale= std::max(settings_.min_scale, std::min(scale_ * scale_change, settings_.max_scale));
+
+	// Expect frame time change according to scale change.
+	smoothed_frame_time_s_*= (new_scale / scale_) * (new_scale / scale_);
+	scale_= new_scale;
+
+	return scale_;
+}
+
+float RenderScaleController::GetScale() const
+{
+	return scale_;
+}
+
+float RenderScaleController::GetSmoothedFrameTime() const
+{
+	return smoothed_frame_time_s_;
+}
+
+} // namespace SZV
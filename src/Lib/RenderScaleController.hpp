@@ -0,0 +1,44 @@
+#pragma once
+
+
+namespace SZV
+{
+
+struct RenderScaleSettings
+{
+	// Desired GPU time of whole frame.
+	float target_frame_time_s= 1.0f / 60.0f;
+	// Scale limits (linear, per axis).
+	float min_scale= 0.5f;
+	float max_scale= 1.0f;
+	// Scale is changed only if frame time differs from target more than this relative value.
+	float tolerance= 0.1f;
+	// Maximum relative scale change per update, to avoid oscillations.
+	float max_step= 0.1f;
+	// Weight of new measurement in smoothed frame time.
+	float smoothing_factor= 0.2f;
+};
+
+// Selects render scale for holding target GPU frame time.
+// Fragment cost is assumed to be proportional to number of pixels, which is proportional to squared scale.
+class RenderScaleController final
+{
+public:
+	explicit RenderScaleController(const RenderScaleSettings& settings= RenderScaleSettings());
+
+	void SetSettings(const RenderScaleSettings& settings);
+	const RenderScaleSettings& GetSettings() const;
+
+	// Feed GPU time of frame, rendered with given scale. Returns new scale.
+	float Update(float gpu_frame_time_s, float frame_scale);
+
+	float GetScale() const;
+	float GetSmoothedFrameTime() const;
+
+private:
+	RenderScaleSettings settings_;
+	float scale_= 1.0f;
+	float smoothed_frame_time_s_= 0.0f;
+};
+
+} // namespace SZV
@@ -0,0 +1,131 @@
+#include "SHA256.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace SZV
+{
+
+namespace
+{
+
+const uint32_t c_round_constants[64]
+{
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+uint32_t RotateRight(const uint32_t x, const uint32_t n)
+{
+	return (x >> n) | (x << (32u - n));
+}
+
+} // namespace
+
+SHA256::SHA256()
+	: state_{ 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 }
+{
+}
+
+void SHA256::Update(const void* const data, size_t size)
+{
+	const uint8_t* bytes= static_cast<const uint8_t*>(data);
+	total_size_+= size;
+
+	if(buffer_size_ > 0u)
+	{
+		const size_t copy_size= std::min(size, sizeof(buffer_) - buffer_size_);
+		std::memcpy(buffer_ + buffer_size_, bytes, copy_size);
+		buffer_size_+= copy_size;
+		bytes+= copy_size;
+		size-= copy_size;
+		if(buffer_size_ < sizeof(buffer_))
+			return;
+		ProcessBlock(buffer_);
+		buffer_size_= 0u;
+	}
+
+	for(; size >= sizeof(buffer_); bytes+= sizeof(buffer_), size-= sizeof(buffer_))
+		ProcessBlock(bytes);
+
+	std::memcpy(buffer_, bytes, size);
+	buffer_size_= size;
+}
+
+SHA256::Digest SHA256::Finish()
+{
+	const uint64_t total_bits= total_size_ * 8u;
+
+	// Padding - single one bit, zeros and message length in bits, so that total size is multiple of block size.
+	const uint8_t one= 0x80;
+	Update(&one, 1u);
+	const uint8_t zeros[64]{};
+	Update(zeros, (sizeof(buffer_) * 2u - 8u - buffer_size_) % sizeof(buffer_));
+
+	uint8_t length[8];
+	for(size_t i= 0u; i < 8u; ++i)
+		length[i]= uint8_t(total_bits >> (56u - i * 8u));
+	Update(length, sizeof(length));
+
+	Digest digest;
+	for(size_t i= 0u; i < 8u; ++i)
+		for(size_t j= 0u; j < 4u; ++j)
+			digest[i * 4u + j]= uint8_t(state_[i] >> (24u - j * 8u));
+	return digest;
+}
+
+void SHA256::ProcessBlock(const uint8_t* const block)
+{
+	uint32_t w[64];
+	for(size_t i= 0u; i < 16u; ++i)
+		w[i]= (uint32_t(block[i * 4u]) << 24u) | (uint32_t(block[i * 4u + 1u]) << 16u) | (uint32_t(block[i * 4u + 2u]) << 8u) | uint32_t(block[i * 4u + 3u]);
+	for(size_t i= 16u; i < 64u; ++i)
+	{
+		const uint32_t s0= RotateRight(w[i - 15u], 7u) ^ RotateRight(w[i - 15u], 18u) ^ (w[i - 15u] >> 3u);
+		const uint32_t s1= RotateRight(w[i - 2u], 17u) ^ RotateRight(w[i - 2u], 19u) ^ (w[i - 2u] >> 10u);
+		w[i]= w[i - 16u] + s0 + w[i - 7u] + s1;
+	}
+
+	uint32_t a= state_[0], b= state_[1], c= state_[2], d= state_[3], e= state_[4], f= state_[5], g= state_[6], h= state_[7];
+	for(size_t i= 0u; i < 64u; ++i)
+	{
+		const uint32_t s1= RotateRight(e, 6u) ^ RotateRight(e, 11u) ^ RotateRight(e, 25u);
+		const uint32_t ch= (e & f) ^ (~e & g);
+		const uint32_t temp1= h + s1 + ch + c_round_constants[i] + w[i];
+		const uint32_t s0= RotateRight(a, 2u) ^ RotateRight(a, 13u) ^ RotateRight(a, 22u);
+		const uint32_t maj= (a & b) ^ (a & c) ^ (b & c);
+		const uint32_t temp2= s0 + maj;
+
+		h= g;
+		g= f;
+		f= e;
+		e= d + temp1;
+		d= c;
+		c= b;
+		b= a;
+		a= temp1 + temp2;
+	}
+
+	state_[0]+= a; state_[1]+= b; state_[2]+= c; state_[3]+= d;
+	state_[4]+= e; state_[5]+= f; state_[6]+= g; state_[7]+= h;
+}
+
+std::string SHA256DigestToHex(const SHA256::Digest& digest)
+{
+	const char* const hex_digits= "0123456789abcdef";
+	std::string result;
+	result.reserve(digest.size() * 2u);
+	for(const uint8_t byte : digest)
+	{
+		result.push_back(hex_digits[byte >> 4u]);
+		result.push_back(hex_digits[byte & 15u]);
+	}
+	return result;
+}
+
+} // namespace SZV
@@ -0,0 +1,38 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace SZV
+{
+
+// SHA-256 hash, used as key for caches of generated code, where collisions must be practically impossible.
+class SHA256
+{
+public:
+	using Digest= std::array<uint8_t, 32>;
+
+	SHA256();
+
+	void Update(const void* data, size_t size);
+	void Update(std::string_view data) { Update(data.data(), data.size()); }
+
+	// Hasher must not be updated after this call.
+	Digest Finish();
+
+private:
+	void ProcessBlock(const uint8_t* block);
+
+private:
+	uint32_t state_[8];
+	uint8_t buffer_[64];
+	size_t buffer_size_= 0u;
+	uint64_t total_size_= 0u;
+};
+
+// Lowercase hexadecimal representation of digest.
+std::string SHA256DigestToHex(const SHA256::Digest& digest);
+
+} // namespace SZV
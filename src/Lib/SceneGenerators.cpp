@@ -0,0 +1,242 @@
+#include "SceneGenerators.hpp"
+#include "CSGTreeReference.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+
+namespace SZV
+{
+
+namespace
+{
+
+m_Vec3 GetRandomVec(std::mt19937& generator, const float min, const float max)
+{
+	std::uniform_real_distribution<float> distribution(min, max);
+	const float x= distribution(generator);
+	const float y= distribution(generator);
+	const float z= distribution(generator);
+	return m_Vec3(x, y, z);
+}
+
+CSGTree::CSGTreeNode GenerateRandomPrimitive(std::mt19937& generator, const m_Vec3& center, const float size)
+{
+	const m_Vec3 primitive_size= GetRandomVec(generator, size * 0.5f, size);
+	const m_Vec3 angles_deg= GetRandomVec(generator, 0.0f, 360.0f);
+
+	switch(std::uniform_int_distribution<uint32_t>(0u, 7u)(generator))
+	{
+	case 0: return CSGTree::Ellipsoid{ center, primitive_size, angles_deg };
+	case 1: return CSGTree::Box{ center, primitive_size, angles_deg };
+	case 2: return CSGTree::Cylinder{ center, primitive_size, angles_deg };
+	case 3: return CSGTree::Cone{ center, primitive_size, angles_deg };
+	case 4: return CSGTree::Paraboloid{ center, primitive_size, angles_deg };
+	case 5: return CSGTree::Hyperboloid{ center, primitive_size, angles_deg, primitive_size.z * 0.25f };
+	case 6: return CSGTree::ParabolicCylinder{ center, primitive_size, angles_deg };
+	default: return CSGTree::HyperbolicCylinder{ center, primitive_size, angles_deg, primitive_size.z * 0.25f };
+	}
+}
+
+// Only closed primitives. Primitive with given center and size contains ball with radius 0.25 * size around center
+// and is contained in ball with radius sqrt(3) / 2 * size around center.
+CSGTree::CSGTreeNode GenerateRandomSolidPrimitive(std::mt19937& generator, const m_Vec3& center, const float size)
+{
+	const m_Vec3 primitive_size= GetRandomVec(generator, size * 0.5f, size);
+	const m_Vec3 angles_deg= GetRandomVec(generator, 0.0f, 360.0f);
+
+	switch(std::uniform_int_distribution<uint32_t>(0u, 2u)(generator))
+	{
+	case 0: return CSGTree::Ellipsoid{ center, primitive_size, angles_deg };
+	case 1: return CSGTree::Box{ center, primitive_size, angles_deg };
+	default: return CSGTree::Cylinder{ center, primitive_size, angles_deg };
+	}
+}
+
+m_Vec3 GetRandomDirection(std::mt19937& generator)
+{
+	while(true)
+	{
+		const m_Vec3 v= GetRandomVec(generator, -1.0f, 1.0f);
+		const float square_length= v.GetSquareLength();
+		if(square_length > 0.01f && square_length <= 1.0f)
+			return v / std::sqrt(square_length);
+	}
+}
+
+// Result contains ball with radius 0.25 * size around center, so it is never empty.
+// Operands of Mul have same center and thus intersect at least in this ball.
+// Subtrahend of Sub is shifted aside, so it cuts outer part of minuend, but not central ball.
+CSGTree::CSGTreeNode GenerateNestedMulSubNode_r(
+	std::mt19937& generator,
+	const size_t depth,
+	const bool mul,
+	const m_Vec3& center,
+	const float size)
+{
+	if(depth == 0u)
+		return GenerateRandomSolidPrimitive(generator, center, size);
+
+	std::vector<CSGTree::CSGTreeNode> elements;
+	if(mul)
+	{
+		elements.push_back(GenerateNestedMulSubNode_r(generator, depth - 1u, false, center, size));
+		elements.push_back(GenerateNestedMulSubNode_r(generator, depth - 1u, false, center, size));
+		return CSGTree::MulChain{ std::move(elements) };
+	}
+	else
+	{
+		// Subtrahend is inside ball with radius sqrt(3) / 2 * 0.4 * size ~ 0.35 * size around its center,
+		// which is 0.65 * size away from center, so it does not touch central ball with radius 0.25 * size.
+		const float subtrahend_size= size * 0.4f;
+		const m_Vec3 subtrahend_center= center + GetRandomDirection(generator) * (size * 0.65f);
+		elements.push_back(GenerateNestedMulSubNode_r(generator, depth - 1u, true, center, size));
+		elements.push_back(GenerateNestedMulSubNode_r(generator, depth - 1u, true, subtrahend_center, subtrahend_size));
+		return CSGTree::SubChain{ std::move(elements) };
+	}
+}
+
+} // namespace
+
+CSGTree::CSGTreeNode GenerateDeepSubChainScene(const size_t depth)
+{
+	CSGTree::CSGTreeNode node= CSGTree::Box{ { 0.0f, 0.0f, 0.0f }, { 0.1f, 0.1f, 0.1f }, { 0.0f, 0.0f, 0.0f } };
+
+	// Build from innermost level.
+	for(size_t i= 0u; i < depth; ++i)
+	{
+		const float size= 0.1f + float(i + 1u) * 0.1f;
+		const float angle= float(i) * 7.0f;
+
+		CSGTree::SubChain chain;
+		chain.elements.push_back(CSGTree::Box{ { 0.0f, 0.0f, 0.0f }, { size, size, size }, { 0.0f, 0.0f, angle } });
+		chain.elements.push_back(CSGTree::Cylinder{ { 0.0f, 0.0f, 0.0f }, { size * 0.5f, size * 0.5f, size * 1.5f }, { angle, 0.0f, 0.0f } });
+		chain.elements.push_back(std::move(node));
+		node= std::move(chain);
+	}
+
+	return node;
+}
+
+CSGTree::CSGTreeNode GenerateAddArrayGridScene(const uint8_t grid_size)
+{
+	CSGTree::AddArray array;
+	array.size[0]= grid_size;
+	array.size[1]= grid_size;
+	array.size[2]= grid_size;
+	array.step= m_Vec3(1.5f, 1.5f, 1.5f);
+	array.angles_deg= m_Vec3(0.0f, 0.0f, 15.0f);
+
+	CSGTree::SubChain element;
+	element.elements.push_back(CSGTree::Box{ { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 30.0f } });
+	element.elements.push_back(CSGTree::Ellipsoid{ { 0.0f, 0.0f, 0.5f }, { 0.75f, 0.75f, 0.75f }, { 0.0f, 0.0f, 0.0f } });
+	array.elements.push_back(std::move(element));
+
+	return array;
+}
+
+CSGTree::CSGTreeNode GenerateRandomUnionScene(const size_t primitive_count, const uint32_t seed)
+{
+	std::mt19937 generator(seed);
+
+	// Keep density of primitives constant.
+	const float extent= std::cbrt(float(primitive_count)) * 2.0f;
+
+	CSGTree::AddChain chain;
+	chain.elements.reserve(primitive_count);
+	for(size_t i= 0u; i < primitive_count; ++i)
+		chain.elements.push_back(GenerateRandomPrimitive(generator, GetRandomVec(generator, -extent, extent), 1.0f));
+
+	return chain;
+}
+
+CSGTree::CSGTreeNode GenerateNestedMulSubScene(const size_t depth, const uint32_t seed)
+{
+	std::mt19937 generator(seed);
+	return GenerateNestedMulSubNode_r(generator, depth, true, m_Vec3(0.0f, 0.0f, 0.0f), 4.0f);
+}
+
+CSGTree::CSGTreeNode GenerateReferencedPartsScene(const size_t part_count, const size_t reference_count, const uint32_t seed)
+{
+	std::mt19937 generator(seed);
+
+	std::vector<std::shared_ptr<CSGTree::ReferenceTarget>> parts;
+	for(size_t i= 0u; i < part_count; ++i)
+	{
+		const auto part= std::make_shared<CSGTree::ReferenceTarget>();
+		part->SetNode(GenerateNestedMulSubNode_r(generator, 4u, true, m_Vec3(0.0f, 0.0f, 0.0f), 1.0f));
+		parts.push_back(part);
+	}
+
+	const float extent= std::cbrt(float(reference_count)) * 2.0f;
+
+	CSGTree::AddChain chain;
+	chain.elements.reserve(reference_count);
+	for(size_t i= 0u; i < reference_count && !parts.empty(); ++i)
+	{
+		const size_t part_index= size_t(generator()) % parts.size();
+
+		CSGTree::Reference reference;
+		reference.source= "#part" + std::to_string(part_index);
+		reference.center= GetRandomVec(generator, -extent, extent);
+		reference.angles_deg= GetRandomVec(generator, -180.0f, 180.0f);
+		reference.target= parts[part_index];
+		chain.elements.push_back(std::move(reference));
+	}
+
+	return chain;
+}
+
+CSGTree::CSGTreeNode GenerateInstancedPartScene(const size_t instance_count, const uint32_t seed)
+{
+	std::mt19937 generator(seed);
+
+	CSGTree::Instance instance;
+	instance.elements.push_back(GenerateNestedMulSubNode_r(generator, 4u, true, m_Vec3(0.0f, 0.0f, 0.0f), 1.0f));
+
+	const float extent= std::cbrt(float(instance_count)) * 2.0f;
+
+	instance.transforms.reserve(instance_count);
+	for(size_t i= 0u; i < instance_count; ++i)
+	{
+		CSGTree::InstanceTransform instance_transform;
+		instance_transform.center= GetRandomVec(generator, -extent, extent);
+		instance_transform.angles_deg= GetRandomVec(generator, -180.0f, 180.0f);
+		instance.transforms.push_back(instance_transform);
+	}
+
+	return instance;
+}
+
+std::vector<BenchmarkScene> GenerateBenchmarkScenes(const float scale)
+{
+	const auto scaled=
+	[&](const float value, const float max)
+	{
+		return std::max(1.0f, std::min(value * scale, max));
+	};
+
+	const size_t sub_chain_depth= size_t(scaled(64.0f, 4096.0f));
+	const uint8_t grid_size= uint8_t(scaled(8.0f, 255.0f));
+	const size_t primitive_count= size_t(scaled(512.0f, 1.0e6f));
+	// Tree size grows exponentially with depth, so scale number of leafs, not depth.
+	const size_t mul_sub_depth= size_t(std::max(1.0f, std::min(std::round(8.0f + std::log2(std::max(scale, 1.0e-3f))), 20.0f)));
+	const size_t reference_count= size_t(scaled(256.0f, 1.0e5f));
+	const size_t part_count= 8u;
+
+	std::vector<BenchmarkScene> result;
+	result.push_back({ "deep_sub_chain", "depth=" + std::to_string(sub_chain_depth), GenerateDeepSubChainScene(sub_chain_depth) });
+	result.push_back({ "add_array_grid", "size=" + std::to_string(grid_size), GenerateAddArrayGridScene(grid_size) });
+	result.push_back({ "random_union", "count=" + std::to_string(primitive_count), GenerateRandomUnionScene(primitive_count, 0u) });
+	result.push_back({ "nested_mul_sub", "depth=" + std::to_string(mul_sub_depth), GenerateNestedMulSubScene(mul_sub_depth, 0u) });
+	result.push_back(
+		{
+			"referenced_parts",
+			"parts=" + std::to_string(part_count) + " references=" + std::to_string(reference_count),
+			GenerateReferencedPartsScene(part_count, reference_count, 0u),
+		});
+	result.push_back({ "instanced_part", "instances=" + std::to_string(reference_count), GenerateInstancedPartScene(reference_count, 0u) });
+	return result;
+}
+
+} // namespace SZV
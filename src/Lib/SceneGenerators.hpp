@@ -0,0 +1,41 @@
+#pragma once
+#include "CSGExpressionTree.hpp"
+#include <string>
+#include <vector>
+
+
+namespace SZV
+{
+
+// Synthetic scenes for benchmarking of scene build pipeline.
+// All generators are deterministic - same parameters produce same scene.
+
+// Sub-chains, nested into each other with given depth. Each level subtracts smaller primitives from box.
+CSGTree::CSGTreeNode GenerateDeepSubChainScene(size_t depth);
+
+// AddArray grid of given size with several rotated primitives as elements.
+CSGTree::CSGTreeNode GenerateAddArrayGridScene(uint8_t grid_size);
+
+// Union of given number of random primitives with random rotations.
+CSGTree::CSGTreeNode GenerateRandomUnionScene(size_t primitive_count, uint32_t seed);
+
+// Binary tree of alternating Mul and Sub chains with given depth, with random primitives in leafs.
+CSGTree::CSGTreeNode GenerateNestedMulSubScene(size_t depth, uint32_t seed);
+
+// Union of references with random positions and rotations to given number of shared parts.
+CSGTree::CSGTreeNode GenerateReferencedPartsScene(size_t part_count, size_t reference_count, uint32_t seed);
+
+// Single instance node with given number of copies of part with random positions and rotations.
+CSGTree::CSGTreeNode GenerateInstancedPartScene(size_t instance_count, uint32_t seed);
+
+struct BenchmarkScene
+{
+	std::string name;
+	std::string parameters; // Human-readable description of generator parameters.
+	CSGTree::CSGTreeNode root;
+};
+
+// Standard set of benchmark scenes. Scale multiplies sizes of scenes.
+std::vector<BenchmarkScene> GenerateBenchmarkScenes(float scale);
+
+} // namespace SZV
@@ -17,10 +17,9 @@ struct Uniforms
 } // namespace
 
 SelectionRenderer::SelectionRenderer(I_WindowVulkan& window_vulkan)
-	: vk_device_(window_vulkan.GetVulkanDevice())
+	: window_vulkan_(window_vulkan)
+	, vk_device_(window_vulkan.GetVulkanDevice())
 {
-	const vk::Extent2D& viewport_size= window_vulkan.GetViewportSize();
-
 	// Create shaders
 	shader_vert_=
 		vk_device_.createShaderModuleUnique(
@@ -83,13 +82,16 @@ SelectionRenderer::SelectionRenderer(I_WindowVulkan& window_vulkan)
 		vk::PipelineInputAssemblyStateCreateFlags(),
 		vk::PrimitiveTopology::eLineStrip);
 
-	const vk::Viewport vk_viewport(0.0f, 0.0f, float(viewport_size.width), float(viewport_size.height), 0.0f, 1.0f);
-	const vk::Rect2D vk_scissor(vk::Offset2D(0, 0), viewport_size);
-
+	// Viewport and scissor are dynamic, so pipeline does not depend on framebuffer size.
 	const vk::PipelineViewportStateCreateInfo pipieline_viewport_state_create_info(
 		vk::PipelineViewportStateCreateFlags(),
-		1u, &vk_viewport,
-		1u, &vk_scissor);
+		1u, nullptr,
+		1u, nullptr);
+
+	const vk::DynamicState dynamic_states[]{ vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+	const vk::PipelineDynamicStateCreateInfo pipeline_dynamic_state_create_info(
+		vk::PipelineDynamicStateCreateFlags(),
+		uint32_t(std::size(dynamic_states)), dynamic_states);
 
 	const float line_width= 2.0f;
 
@@ -131,7 +133,7 @@ SelectionRenderer::SelectionRenderer(I_WindowVulkan& window_vulkan)
 
 	pipeline_=
 		vk_device_.createGraphicsPipelineUnique(
-			nullptr,
+			window_vulkan.GetPipelineCache(),
 			vk::GraphicsPipelineCreateInfo(
 				vk::PipelineCreateFlags(),
 				uint32_t(std::size(shader_stage_create_info)), shader_stage_create_info,
@@ -143,7 +145,7 @@ SelectionRenderer::SelectionRenderer(I_WindowVulkan& window_vulkan)
 				&pipeline_multisample_state_create_info,
 				window_vulkan.HasDepthBuffer() ? &vk_pipeline_depth_state_create_info : nullptr,
 				&vk_pipeline_color_blend_state_create_info,
-				nullptr,
+				&pipeline_dynamic_state_create_info,
 				*pipeline_layout_,
 				window_vulkan.GetRenderPass(),
 				0u));
@@ -161,6 +163,8 @@ void SelectionRenderer::EndFrame(
 	const CameraController& camera_controller,
 	const m_Vec3& bb_center, const m_Vec3& bb_size, const m_Vec3& angles_deg)
 {
+	const GPUProfilerStageScope profiler_scope(gpu_profiler_, command_buffer, "selection", true);
+
 	m_Mat4 scale_mat, rotate_x, rotate_y, rotate_z, translate_mat;
 	scale_mat.Scale(bb_size);
 
@@ -176,6 +180,12 @@ void SelectionRenderer::EndFrame(
 
 	command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipeline_);
 
+	const vk::Extent2D viewport_size= window_vulkan_.GetViewportSize();
+	const vk::Viewport viewport(0.0f, 0.0f, float(viewport_size.width), float(viewport_size.height), 0.0f, 1.0f);
+	const vk::Rect2D scissor(vk::Offset2D(0, 0), viewport_size);
+	command_buffer.setViewport(0u, 1u, &viewport);
+	command_buffer.setScissor(0u, 1u, &scissor);
+
 	command_buffer.pushConstants(
 		*pipeline_layout_,
 		vk::ShaderStageFlagBits::eVertex,
@@ -186,5 +196,10 @@ void SelectionRenderer::EndFrame(
 	command_buffer.draw(9, 1, 0, 0);
 }
 
+void SelectionRenderer::SetGPUProfiler(GPUProfiler* const profiler)
+{
+	gpu_profiler_= profiler;
+}
+
 
 } // namespace SZV
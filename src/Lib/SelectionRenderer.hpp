@@ -1,5 +1,6 @@
 #pragma once
 #include "CameraController.hpp"
+#include "GPUProfiler.hpp"
 #include "I_WindowVulkan.hpp"
 
 namespace SZV
@@ -16,9 +17,13 @@ public:
 		const CameraController& camera_controller,
 		const m_Vec3& bb_center, const m_Vec3& bb_size, const m_Vec3& angles_deg);
 
+	// Profiler for measuring of selection drawing. May be null.
+	void SetGPUProfiler(GPUProfiler* profiler);
+
 private:
 
 private:
+	I_WindowVulkan& window_vulkan_;
 	const vk::Device vk_device_;
 
 	vk::UniqueShaderModule shader_vert_;
@@ -26,6 +31,8 @@ private:
 	vk::UniqueDescriptorSetLayout descriptor_set_layout_;
 	vk::UniquePipelineLayout pipeline_layout_;
 	vk::UniquePipeline pipeline_;
+
+	GPUProfiler* gpu_profiler_= nullptr;
 };
 
 } // namespace SZV
@@ -1,6 +1,8 @@
 #include "Tonemapper.hpp"
 #include "Log.hpp"
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 
 namespace SZV
@@ -13,50 +15,69 @@ namespace
 namespace Shaders
 {
 #include "shaders/blur.vert.h"
-#include "shaders/blur.frag.h"
+#include "shaders/bloom_downsample.frag.h"
+#include "shaders/bloom_upsample.frag.h"
+#include "shaders/exposure.comp.h"
 #include "shaders/tonemapping.vert.h"
 #include "shaders/tonemapping.frag.h"
 } // namespace Shaders
 
 struct Uniforms
 {
-	struct
-	{
-		float mix_factor;
-		float padding[3];
-	} vertex;
-
-	struct
-	{
-		float bloom_scale;
-		float padding[3];
-	} fragment;
+	float bloom_scale;
+	float padding[3];
+	float tex_coord_scale[2];
+	float tex_coord_max[2];
 };
 
-struct UniformsBloom
+struct UniformsExposure
 {
-	float blur_vector[2];
-	float padding[2];
+	float mix_factor;
+	float low_percentile;
+	float high_percentile;
+	float min_log2_brightness;
+	float max_log2_brightness;
+	float padding[3];
 };
 
+// Number of workgroups for exposure calculation. Must match value in shader.
+const uint32_t g_exposure_groups_x= 8u;
+const uint32_t g_exposure_groups_y= 8u;
+
 struct ExposureAccumulateBuffer
 {
-	float exposure[6];
+	float exposure;
+	uint32_t groups_finished;
+	uint32_t histogram[c_exposure_histogram_bins];
+
+	// Inputs and results of last calculation.
+	uint32_t last_histogram[c_exposure_histogram_bins];
+	float last_prev_exposure;
+	float last_mix_factor;
+	float last_average_brightness;
 };
 
 const uint32_t g_tex_uniform_binding= 0u;
-const uint32_t g_brightness_tex_uniform_binding= 1u;
 const uint32_t g_exposure_accumulate_tex_uniform_binding= 2u;
 const uint32_t g_blured_tex_uniform_binding= 3u;
 
+const uint32_t g_exposure_brightness_tex_uniform_binding= 0u;
+const uint32_t g_exposure_accumulate_buffer_uniform_binding= 1u;
+
+// Maximum number of downsample steps for bloom. Bloom size is proportional to 2^levels.
+const uint32_t g_max_bloom_levels= 5u;
+
 } // namespace
 
 Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
-	: vk_device_(window_vulkan.GetVulkanDevice())
+	: window_vulkan_(window_vulkan)
+	, vk_device_(window_vulkan.GetVulkanDevice())
 	, queue_family_index_(window_vulkan.GetQueueFamilyIndex())
+	, pipeline_cache_(window_vulkan.GetPipelineCache())
+	, memory_properties_(window_vulkan.GetMemoryProperties())
+	, prev_exposure_update_time_(Clock::now())
 {
-	const vk::Extent2D viewport_size= window_vulkan.GetViewportSize();
-	const vk::PhysicalDeviceMemoryProperties memory_properties= window_vulkan.GetMemoryProperties();
+	const vk::PhysicalDeviceMemoryProperties& memory_properties= memory_properties_;
 
 	// Select color buffer format.
 	const vk::Format hdr_color_formats[]
@@ -69,7 +90,7 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 		vk::Format::eR32G32B32A32Sfloat,
 		vk::Format::eB10G11R11UfloatPack32, // Keep it last, 5-6 bit mantissa is too low.
 	};
-	vk::Format framebuffer_image_format= hdr_color_formats[0];
+	framebuffer_image_format_= hdr_color_formats[0];
 	for(const vk::Format format_candidate : hdr_color_formats)
 	{
 		const vk::FormatProperties format_properties=
@@ -79,7 +100,7 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 			vk::FormatFeatureFlagBits::eColorAttachment | vk::FormatFeatureFlagBits::eColorAttachmentBlend;
 		if((format_properties.optimalTilingFeatures & required_falgs) == required_falgs)
 		{
-			framebuffer_image_format= format_candidate;
+			framebuffer_image_format_= format_candidate;
 			break;
 		}
 	}
@@ -92,7 +113,7 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 		vk::Format::eD32Sfloat,
 		vk::Format::eD32SfloatS8Uint,
 	};
-	vk::Format framebuffer_depth_format= vk::Format::eD16Unorm;
+	framebuffer_depth_format_= vk::Format::eD16Unorm;
 	for(const vk::Format depth_format_candidate : depth_formats)
 	{
 		const vk::FormatProperties format_properties=
@@ -101,13 +122,296 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 		const vk::FormatFeatureFlags required_falgs= vk::FormatFeatureFlagBits::eDepthStencilAttachment;
 		if((format_properties.optimalTilingFeatures & required_falgs) == required_falgs)
 		{
-			framebuffer_depth_format= depth_format_candidate;
+			framebuffer_depth_format_= depth_format_candidate;
 			break;
 		}
 	}
 
+	Log::Info("Main framebuffer color format: ", vk::to_string(framebuffer_image_format_));
+	Log::Info("Main framebuffer depth format: ", vk::to_string(framebuffer_depth_format_));
+
+	{ // Create main render pass.
+		const vk::AttachmentDescription attachment_description[]
+		{
+			{
+				vk::AttachmentDescriptionFlags(),
+				framebuffer_image_format_,
+				vk::SampleCountFlagBits::e1,
+				vk::AttachmentLoadOp::eClear,
+				vk::AttachmentStoreOp::eStore,
+				vk::AttachmentLoadOp::eDontCare,
+				vk::AttachmentStoreOp::eDontCare,
+				vk::ImageLayout::eUndefined,
+				vk::ImageLayout::eTransferSrcOptimal,
+			},
+			{
+				vk::AttachmentDescriptionFlags(),
+				framebuffer_depth_format_,
+				vk::SampleCountFlagBits::e1,
+				vk::AttachmentLoadOp::eClear,
+				vk::AttachmentStoreOp::eStore,
+				vk::AttachmentLoadOp::eClear,
+				vk::AttachmentStoreOp::eStore,
+				vk::ImageLayout::eUndefined,
+				vk::ImageLayout::eDepthStencilAttachmentOptimal,
+			},
+		};
+
+		const vk::AttachmentReference attachment_reference_color(0u, vk::ImageLayout::eColorAttachmentOptimal);
+		const vk::AttachmentReference vk_attachment_reference_depth(1u, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+
+		const vk::SubpassDescription subpass_description(
+				vk::SubpassDescriptionFlags(),
+				vk::PipelineBindPoint::eGraphics,
+				0u, nullptr,
+				1u, &attachment_reference_color,
+				nullptr,
+				&vk_attachment_reference_depth);
+
+		main_pass_=
+			vk_device_.createRenderPassUnique(
+				vk::RenderPassCreateInfo(
+					vk::RenderPassCreateFlags(),
+					uint32_t(std::size(attachment_description)), attachment_description,
+					1u, &subpass_description));
+	}
+
+	// Create bloom render pass.
+	{
+		const vk::AttachmentDescription attachment_description(
+				vk::AttachmentDescriptionFlags(),
+				framebuffer_image_format_,
+				vk::SampleCountFlagBits::e1,
+				vk::AttachmentLoadOp::eDontCare,
+				vk::AttachmentStoreOp::eStore,
+				vk::AttachmentLoadOp::eDontCare,
+				vk::AttachmentStoreOp::eDontCare,
+				vk::ImageLayout::eUndefined,
+				vk::ImageLayout::eShaderReadOnlyOptimal);
+
+		const vk::AttachmentReference attachment_reference(0u, vk::ImageLayout::eColorAttachmentOptimal);
+
+		const vk::SubpassDescription subpass_description(
+				vk::SubpassDescriptionFlags(),
+				vk::PipelineBindPoint::eGraphics,
+				0u, nullptr,
+				1u, &attachment_reference,
+				nullptr,
+				nullptr);
+
+		// Bloom passes are chained - result of each pass is read in next pass.
+		// So, wait for reading of previous pass result before writing and make written result visible for reading.
+		const vk::SubpassDependency subpass_dependencies[]
+		{
+			{
+				VK_SUBPASS_EXTERNAL,
+				0u,
+				vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eColorAttachmentOutput,
+				vk::PipelineStageFlagBits::eColorAttachmentOutput,
+				vk::AccessFlagBits::eShaderRead,
+				vk::AccessFlagBits::eColorAttachmentWrite,
+				vk::DependencyFlags(),
+			},
+			{
+				0u,
+				VK_SUBPASS_EXTERNAL,
+				vk::PipelineStageFlagBits::eColorAttachmentOutput,
+				vk::PipelineStageFlagBits::eFragmentShader,
+				vk::AccessFlagBits::eColorAttachmentWrite,
+				vk::AccessFlagBits::eShaderRead,
+				vk::DependencyFlags(),
+			},
+		};
+
+		bloom_render_pass_=
+			vk_device_.createRenderPassUnique(
+				vk::RenderPassCreateInfo(
+					vk::RenderPassCreateFlags(),
+					1u, &attachment_description,
+					1u, &subpass_description,
+					uint32_t(std::size(subpass_dependencies)), subpass_dependencies));
+	}
+
+	// Create uniforms buffer.
+	{
+		exposure_accumulate_buffer_=
+			vk_device_.createBufferUnique(
+				vk::BufferCreateInfo(
+					vk::BufferCreateFlags(),
+					sizeof(ExposureAccumulateBuffer),
+					vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc));
+
+		const vk::MemoryRequirements buffer_memory_requirements= vk_device_.getBufferMemoryRequirements(*exposure_accumulate_buffer_);
+
+		vk::MemoryAllocateInfo memory_allocate_info(buffer_memory_requirements.size);
+		for(uint32_t i= 0u; i < memory_properties.memoryTypeCount; ++i)
+		{
+			if((buffer_memory_requirements.memoryTypeBits & (1u << i)) != 0 &&
+				(memory_properties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) != vk::MemoryPropertyFlags())
+				memory_allocate_info.memoryTypeIndex= i;
+		}
+
+		exposure_accumulate_memory_= vk_device_.allocateMemoryUnique(memory_allocate_info);
+		vk_device_.bindBufferMemory(*exposure_accumulate_buffer_, *exposure_accumulate_memory_, 0u);
+	}
+
+	main_pipeline_= CreateMainPipeline(window_vulkan);
+	bloom_downsample_pipeline_= CreateBloomPipeline(Shaders::bloom_downsample_frag, sizeof(Shaders::bloom_downsample_frag));
+	bloom_upsample_pipeline_= CreateBloomPipeline(Shaders::bloom_upsample_frag, sizeof(Shaders::bloom_upsample_frag));
+	exposure_pipeline_= CreateExposurePipeline();
+
+	// Create descriptor set pool.
+	const vk::DescriptorPoolSize vk_descriptor_pool_sizes[]
+	{
+		// Main set, exposure set, downsample and upsample set for each bloom level.
+		{ vk::DescriptorType::eCombinedImageSampler, 2u + 1u + 2u * g_max_bloom_levels },
+		{ vk::DescriptorType::eStorageBuffer, 1u + 1u }
+	};
+	descriptor_pool_=
+		vk_device_.createDescriptorPoolUnique(
+			vk::DescriptorPoolCreateInfo(
+				vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+				2u + 2u * g_max_bloom_levels, // max sets.
+				uint32_t(std::size(vk_descriptor_pool_sizes)), vk_descriptor_pool_sizes));
+
+	CreateFramebuffers(window_vulkan.GetViewportSize());
+}
+
+Tonemapper::~Tonemapper()
+{
+	// Sync before destruction.
+	vk_device_.waitIdle();
+
+	if(exposure_readback_mapped_ != nullptr)
+		vk_device_.unmapMemory(*exposure_readback_memory_);
+}
+
+vk::Extent2D Tonemapper::GetFramebufferSize() const
+{
+	return framebuffer_size_;
+}
+
+vk::RenderPass Tonemapper::GetMainRenderPass() const
+{
+	return *main_pass_;
+}
+
+void Tonemapper::SetRenderScale(const float scale)
+{
+	render_scale_= std::max(0.25f, std::min(scale, 1.0f));
+	UpdateRenderSize();
+}
+
+float Tonemapper::GetRenderScale() const
+{
+	return render_scale_;
+}
+
+vk::Extent2D Tonemapper::GetRenderSize() const
+{
+	return render_size_;
+}
+
+void Tonemapper::SetGPUProfiler(GPUProfiler* const profiler)
+{
+	gpu_profiler_= profiler;
+}
+
+void Tonemapper::SetExposureSettings(const ExposureSettings& settings)
+{
+	exposure_settings_= settings;
+	exposure_settings_.low_percentile= std::max(0.0f, std::min(exposure_settings_.low_percentile, 1.0f));
+	exposure_settings_.high_percentile= std::max(exposure_settings_.low_percentile, std::min(exposure_settings_.high_percentile, 1.0f));
+	exposure_settings_.adaptation_speed= std::max(0.0f, exposure_settings_.adaptation_speed);
+	if(exposure_settings_.max_log2_brightness <= exposure_settings_.min_log2_brightness)
+		exposure_settings_.max_log2_brightness= exposure_settings_.min_log2_brightness + 1.0f;
+}
+
+const ExposureSettings& Tonemapper::GetExposureSettings() const
+{
+	return exposure_settings_;
+}
+
+void Tonemapper::SetExposureReadback(const bool enable)
+{
+	exposure_readback_= enable;
+	if(!enable || exposure_readback_buffer_)
+		return;
+
+	exposure_readback_buffer_=
+		vk_device_.createBufferUnique(
+			vk::BufferCreateInfo(
+				vk::BufferCreateFlags(),
+				sizeof(ExposureAccumulateBuffer),
+				vk::BufferUsageFlagBits::eTransferDst));
+
+	const vk::MemoryRequirements buffer_memory_requirements= vk_device_.getBufferMemoryRequirements(*exposure_readback_buffer_);
+
+	const vk::MemoryPropertyFlags required_flags= vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+	vk::MemoryAllocateInfo memory_allocate_info(buffer_memory_requirements.size, ~0u);
+	for(uint32_t i= 0u; i < memory_properties_.memoryTypeCount; ++i)
+	{
+		if((buffer_memory_requirements.memoryTypeBits & (1u << i)) != 0 &&
+			(memory_properties_.memoryTypes[i].propertyFlags & required_flags) == required_flags)
+		{
+			memory_allocate_info.memoryTypeIndex= i;
+			break;
+		}
+	}
+	if(memory_allocate_info.memoryTypeIndex == ~0u)
+		Log::FatalError("Could not find host-visible memory for exposure readback buffer");
+
+	exposure_readback_memory_= vk_device_.allocateMemoryUnique(memory_allocate_info);
+	vk_device_.bindBufferMemory(*exposure_readback_buffer_, *exposure_readback_memory_, 0u);
+	exposure_readback_mapped_= vk_device_.mapMemory(*exposure_readback_memory_, 0u, vk::DeviceSize(sizeof(ExposureAccumulateBuffer)));
+}
+
+bool Tonemapper::GetExposureReadback(ExposureCalculationResult& out_result) const
+{
+	if(!exposure_readback_written_)
+		return false;
+
+	ExposureAccumulateBuffer data;
+	std::memcpy(&data, exposure_readback_mapped_, sizeof(ExposureAccumulateBuffer));
+
+	std::copy(std::begin(data.last_histogram), std::end(data.last_histogram), out_result.histogram.begin());
+	// Exposure shader processes brightness image in 2x2 blocks.
+	out_result.expected_samples=
+		uint64_t(std::max(aux_image_size_.width / 2u, 1u)) * uint64_t(std::max(aux_image_size_.height / 2u, 1u));
+	out_result.prev_exposure= data.last_prev_exposure;
+	out_result.mix_factor= data.last_mix_factor;
+	out_result.average_brightness= data.last_average_brightness;
+	out_result.exposure= data.exposure;
+	return true;
+}
+
+void Tonemapper::SetFixedTimeStep(const float time_step_s)
+{
+	fixed_time_step_s_= std::max(0.0f, time_step_s);
+}
+
+void Tonemapper::Resize(const vk::Extent2D viewport_size)
+{
+	if(viewport_size == framebuffer_size_)
+		return;
+
+	// Resources may be still in use.
+	vk_device_.waitIdle();
+	CreateFramebuffers(viewport_size);
+}
+
+void Tonemapper::CreateFramebuffers(const vk::Extent2D viewport_size)
+{
+	const vk::PhysicalDeviceMemoryProperties& memory_properties= memory_properties_;
+
+	// Free old descriptor sets first, since descriptor pool has space only for one set of descriptors.
+	main_descriptor_set_.reset();
+	exposure_descriptor_set_.reset();
+	bloom_buffers_.clear();
+
 	// Calculate image sizes.
 	framebuffer_size_ = viewport_size;
+	UpdateRenderSize();
 
 	// Use powert of two sizes, because we needs iterative downsampling and it works properly only for power of two images.
 	const vk::Extent2D aux_image_size_log2(
@@ -120,8 +424,6 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 
 	Log::Info("Main framebuffer size: ", framebuffer_size_.width, "x", framebuffer_size_.height);
 	Log::Info("Auxilarity images size: ", aux_image_size_.width, "x", aux_image_size_.height);
-	Log::Info("Main framebuffer color format: ", vk::to_string(framebuffer_image_format));
-	Log::Info("Main framebuffer depth format: ", vk::to_string(framebuffer_depth_format));
 
 	{
 		framebuffer_image_=
@@ -129,7 +431,7 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 				vk::ImageCreateInfo(
 					vk::ImageCreateFlags(),
 					vk::ImageType::e2D,
-					framebuffer_image_format,
+					framebuffer_image_format_,
 					vk::Extent3D(framebuffer_size_.width, framebuffer_size_.height, 1u),
 					1u,
 					1u,
@@ -159,7 +461,7 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 					vk::ImageViewCreateFlags(),
 					*framebuffer_image_,
 					vk::ImageViewType::e2D,
-					framebuffer_image_format,
+					framebuffer_image_format_,
 					vk::ComponentMapping(),
 					vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0u, 1u, 0u, 1u)));
 	}
@@ -169,7 +471,7 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 				vk::ImageCreateInfo(
 					vk::ImageCreateFlags(),
 					vk::ImageType::e2D,
-					framebuffer_depth_format,
+					framebuffer_depth_format_,
 					vk::Extent3D(framebuffer_size_.width, framebuffer_size_.height, 1u),
 					1u,
 					1u,
@@ -199,56 +501,12 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 					vk::ImageViewCreateFlags(),
 					*framebuffer_depth_image_,
 					vk::ImageViewType::e2D,
-					framebuffer_depth_format,
+					framebuffer_depth_format_,
 					vk::ComponentMapping(),
 					vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth, 0u, 1u, 0u, 1u)));
 	}
 
-	{ // Create main render pass.
-		const vk::AttachmentDescription attachment_description[]
-		{
-			{
-				vk::AttachmentDescriptionFlags(),
-				framebuffer_image_format,
-				vk::SampleCountFlagBits::e1,
-				vk::AttachmentLoadOp::eClear,
-				vk::AttachmentStoreOp::eStore,
-				vk::AttachmentLoadOp::eDontCare,
-				vk::AttachmentStoreOp::eDontCare,
-				vk::ImageLayout::eUndefined,
-				vk::ImageLayout::eTransferSrcOptimal,
-			},
-			{
-				vk::AttachmentDescriptionFlags(),
-				framebuffer_depth_format,
-				vk::SampleCountFlagBits::e1,
-				vk::AttachmentLoadOp::eClear,
-				vk::AttachmentStoreOp::eStore,
-				vk::AttachmentLoadOp::eClear,
-				vk::AttachmentStoreOp::eStore,
-				vk::ImageLayout::eUndefined,
-				vk::ImageLayout::eDepthStencilAttachmentOptimal,
-			},
-		};
-
-		const vk::AttachmentReference attachment_reference_color(0u, vk::ImageLayout::eColorAttachmentOptimal);
-		const vk::AttachmentReference vk_attachment_reference_depth(1u, vk::ImageLayout::eDepthStencilAttachmentOptimal);
-
-		const vk::SubpassDescription subpass_description(
-				vk::SubpassDescriptionFlags(),
-				vk::PipelineBindPoint::eGraphics,
-				0u, nullptr,
-				1u, &attachment_reference_color,
-				nullptr,
-				&vk_attachment_reference_depth);
-
-		main_pass_=
-			vk_device_.createRenderPassUnique(
-				vk::RenderPassCreateInfo(
-					vk::RenderPassCreateFlags(),
-					uint32_t(std::size(attachment_description)), attachment_description,
-					1u, &subpass_description));
-
+	{ // Create main framebuffer.
 		const vk::ImageView framebuffer_images[]{ *framebuffer_image_view_, *framebuffer_depth_image_view_ };
 		main_pass_framebuffer_=
 			vk_device_.createFramebufferUnique(
@@ -260,21 +518,18 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 	}
 
 	{ // Create brightness calculate image.
-		brightness_calculate_image_mip_levels_=
-			1u + std::max(aux_image_size_log2.width, aux_image_size_log2.height);
-
 		brightness_calculate_image_=
 			vk_device_.createImageUnique(
 				vk::ImageCreateInfo(
 					vk::ImageCreateFlags(),
 					vk::ImageType::e2D,
-					framebuffer_image_format,
+					framebuffer_image_format_,
 					vk::Extent3D(aux_image_size_.width, aux_image_size_.height, 1u),
-					brightness_calculate_image_mip_levels_,
+					1u,
 					1u,
 					vk::SampleCountFlagBits::e1,
 					vk::ImageTiling::eOptimal,
-					vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst,
+					vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
 					vk::SharingMode::eExclusive,
 					0u, nullptr,
 					vk::ImageLayout::eUndefined));
@@ -298,52 +553,31 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 					vk::ImageViewCreateFlags(),
 					*brightness_calculate_image_,
 					vk::ImageViewType::e2D,
-					framebuffer_image_format,
+					framebuffer_image_format_,
 					vk::ComponentMapping(),
-					vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0u, brightness_calculate_image_mip_levels_, 0u, 1u)));
-	}
-
-	// Create bloom render pass.
-	{
-		const vk::AttachmentDescription attachment_description(
-				vk::AttachmentDescriptionFlags(),
-				framebuffer_image_format,
-				vk::SampleCountFlagBits::e1,
-				vk::AttachmentLoadOp::eDontCare,
-				vk::AttachmentStoreOp::eStore,
-				vk::AttachmentLoadOp::eDontCare,
-				vk::AttachmentStoreOp::eDontCare,
-				vk::ImageLayout::eUndefined,
-				vk::ImageLayout::eShaderReadOnlyOptimal);
-
-		const vk::AttachmentReference attachment_reference(0u, vk::ImageLayout::eColorAttachmentOptimal);
-
-		const vk::SubpassDescription subpass_description(
-				vk::SubpassDescriptionFlags(),
-				vk::PipelineBindPoint::eGraphics,
-				0u, nullptr,
-				1u, &attachment_reference,
-				nullptr,
-				nullptr);
-
-		bloom_render_pass_=
-			vk_device_.createRenderPassUnique(
-				vk::RenderPassCreateInfo(
-					vk::RenderPassCreateFlags(),
-					1u, &attachment_description,
-					1u, &subpass_description));
+					vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0u, 1u, 0u, 1u)));
 	}
 
 	// Create bloom images and framebuffers.
-	for(BloomBuffer& bloom_buffer : bloom_buffers_)
+	// Level 0 has size of brightness image, each next level has half size of previous level.
+	const uint32_t bloom_levels=
+		std::max(1u, std::min(g_max_bloom_levels, std::min(aux_image_size_log2.width, aux_image_size_log2.height)));
+	bloom_buffers_.resize(bloom_levels + 1u);
+	for(size_t level= 0u; level < bloom_buffers_.size(); ++level)
 	{
+		BloomBuffer& bloom_buffer= bloom_buffers_[level];
+		bloom_buffer.size=
+			vk::Extent2D(
+				std::max(1u, aux_image_size_.width  >> level),
+				std::max(1u, aux_image_size_.height >> level));
+
 		bloom_buffer.image=
 			vk_device_.createImageUnique(
 				vk::ImageCreateInfo(
 					vk::ImageCreateFlags(),
 					vk::ImageType::e2D,
-					framebuffer_image_format,
-					vk::Extent3D(aux_image_size_.width, aux_image_size_.height, 1u),
+					framebuffer_image_format_,
+					vk::Extent3D(bloom_buffer.size.width, bloom_buffer.size.height, 1u),
 					1u,
 					1u,
 					vk::SampleCountFlagBits::e1,
@@ -372,57 +606,18 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 					vk::ImageViewCreateFlags(),
 					*bloom_buffer.image,
 					vk::ImageViewType::e2D,
-					framebuffer_image_format,
+					framebuffer_image_format_,
 					vk::ComponentMapping(),
 					vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0u, 1u, 0u, 1u)));
 
 		bloom_buffer.framebuffer=
 			vk_device_.createFramebufferUnique(
-				vk::FramebufferCreateInfo(
-					vk::FramebufferCreateFlags(),
-					*bloom_render_pass_,
-					1u, &*bloom_buffer.image_view,
-					aux_image_size_.width, aux_image_size_.height, 1u));
-	}
-
-	// Create uniforms buffer.
-	{
-		exposure_accumulate_buffer_=
-			vk_device_.createBufferUnique(
-				vk::BufferCreateInfo(
-					vk::BufferCreateFlags(),
-					sizeof(ExposureAccumulateBuffer),
-					vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst));
-
-		const vk::MemoryRequirements buffer_memory_requirements= vk_device_.getBufferMemoryRequirements(*exposure_accumulate_buffer_);
-
-		vk::MemoryAllocateInfo memory_allocate_info(buffer_memory_requirements.size);
-		for(uint32_t i= 0u; i < memory_properties.memoryTypeCount; ++i)
-		{
-			if((buffer_memory_requirements.memoryTypeBits & (1u << i)) != 0 &&
-				(memory_properties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) != vk::MemoryPropertyFlags())
-				memory_allocate_info.memoryTypeIndex= i;
-		}
-
-		exposure_accumulate_memory_= vk_device_.allocateMemoryUnique(memory_allocate_info);
-		vk_device_.bindBufferMemory(*exposure_accumulate_buffer_, *exposure_accumulate_memory_, 0u);
-	}
-
-	main_pipeline_= CreateMainPipeline(window_vulkan);
-	bloom_pipeline_= CreateBloomPipeline();
-
-	// Create descriptor set pool.
-	const vk::DescriptorPoolSize vk_descriptor_pool_sizes[]
-	{
-		{ vk::DescriptorType::eCombinedImageSampler, 2u * 3u },
-		{ vk::DescriptorType::eStorageBuffer, 1u * 3u }
-	};
-	descriptor_pool_=
-		vk_device_.createDescriptorPoolUnique(
-			vk::DescriptorPoolCreateInfo(
-				vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
-				3u, // max sets.
-				uint32_t(std::size(vk_descriptor_pool_sizes)), vk_descriptor_pool_sizes));
+				vk::FramebufferCreateInfo(
+					vk::FramebufferCreateFlags(),
+					*bloom_render_pass_,
+					1u, &*bloom_buffer.image_view,
+					bloom_buffer.size.width, bloom_buffer.size.height, 1u));
+	}
 
 	{
 		// Create descriptor set.
@@ -443,12 +638,7 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 			},
 			{
 				vk::Sampler(),
-				*brightness_calculate_image_view_,
-				vk::ImageLayout::eShaderReadOnlyOptimal
-			},
-			{
-				vk::Sampler(),
-				*bloom_buffers_[1].image_view,
+				*bloom_buffers_[0].image_view,
 				vk::ImageLayout::eShaderReadOnlyOptimal
 			},
 		};
@@ -470,16 +660,6 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 					nullptr,
 					nullptr
 				},
-				{
-					*main_descriptor_set_,
-					g_brightness_tex_uniform_binding,
-					0u,
-					1u,
-					vk::DescriptorType::eCombinedImageSampler,
-					&descriptor_image_info[1],
-					nullptr,
-					nullptr
-				},
 				{
 					*main_descriptor_set_,
 					g_exposure_accumulate_tex_uniform_binding,
@@ -496,7 +676,7 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 					0u,
 					1u,
 					vk::DescriptorType::eCombinedImageSampler,
-					&descriptor_image_info[2],
+					&descriptor_image_info[1],
 					nullptr,
 					nullptr
 				},
@@ -504,53 +684,110 @@ Tonemapper::Tonemapper(I_WindowVulkan& window_vulkan)
 			{});
 	}
 
-	for(BloomBuffer& bloom_buffer : bloom_buffers_)
 	{
-		// Create descriptor set.
-		bloom_buffer.descriptor_set=
+		// Create exposure descriptor set.
+		exposure_descriptor_set_=
 			std::move(
 			vk_device_.allocateDescriptorSetsUnique(
 				vk::DescriptorSetAllocateInfo(
 					*descriptor_pool_,
-					1u, &*bloom_pipeline_.decriptor_set_layout)).front());
+					1u, &*exposure_pipeline_.decriptor_set_layout)).front());
 
 		// Write descriptor set.
 		const vk::DescriptorImageInfo descriptor_image_info(
 			vk::Sampler(),
-			&bloom_buffer == &bloom_buffers_[0] ? *brightness_calculate_image_view_ : *bloom_buffers_[0].image_view,
+			*brightness_calculate_image_view_,
 			vk::ImageLayout::eShaderReadOnlyOptimal);
 
+		const vk::DescriptorBufferInfo descriptor_exposure_accumulate_buffer_info(
+			*exposure_accumulate_buffer_,
+			0u,
+			sizeof(ExposureAccumulateBuffer));
+
 		vk_device_.updateDescriptorSets(
 			{
 				{
-					*bloom_buffer.descriptor_set,
-					g_tex_uniform_binding,
+					*exposure_descriptor_set_,
+					g_exposure_brightness_tex_uniform_binding,
 					0u,
 					1u,
 					vk::DescriptorType::eCombinedImageSampler,
 					&descriptor_image_info,
 					nullptr,
 					nullptr
-				}
+				},
+				{
+					*exposure_descriptor_set_,
+					g_exposure_accumulate_buffer_uniform_binding,
+					0u,
+					1u,
+					vk::DescriptorType::eStorageBuffer,
+					nullptr,
+					&descriptor_exposure_accumulate_buffer_info,
+					nullptr
+				},
 			},
 			{});
 	}
-}
 
-Tonemapper::~Tonemapper()
-{
-	// Sync before destruction.
-	vk_device_.waitIdle();
+	for(size_t level= 0u; level < bloom_buffers_.size(); ++level)
+	{
+		BloomBuffer& bloom_buffer= bloom_buffers_[level];
+
+		// Downsample into this level from previous level or from brightness image.
+		if(level > 0u)
+			bloom_buffer.downsample_descriptor_set=
+				CreateBloomDescriptorSet(
+					bloom_downsample_pipeline_,
+					level == 1u ? *brightness_calculate_image_view_ : *bloom_buffers_[level - 1u].image_view);
+
+		// Upsample into this level from next level.
+		if(level + 1u < bloom_buffers_.size())
+			bloom_buffer.upsample_descriptor_set=
+				CreateBloomDescriptorSet(bloom_upsample_pipeline_, *bloom_buffers_[level + 1u].image_view);
+	}
 }
 
-vk::Extent2D Tonemapper::GetFramebufferSize() const
+void Tonemapper::UpdateRenderSize()
 {
-	return framebuffer_size_;
+	render_size_=
+		vk::Extent2D(
+			std::max(1u, std::min(uint32_t(std::lround(float(framebuffer_size_.width ) * render_scale_)), framebuffer_size_.width )),
+			std::max(1u, std::min(uint32_t(std::lround(float(framebuffer_size_.height) * render_scale_)), framebuffer_size_.height)));
 }
 
-vk::RenderPass Tonemapper::GetMainRenderPass() const
+vk::UniqueDescriptorSet Tonemapper::CreateBloomDescriptorSet(const Pipeline& pipeline, const vk::ImageView src_image_view)
 {
-	return *main_pass_;
+	// Create descriptor set.
+	vk::UniqueDescriptorSet descriptor_set=
+		std::move(
+		vk_device_.allocateDescriptorSetsUnique(
+			vk::DescriptorSetAllocateInfo(
+				*descriptor_pool_,
+				1u, &*pipeline.decriptor_set_layout)).front());
+
+	// Write descriptor set.
+	const vk::DescriptorImageInfo descriptor_image_info(
+		vk::Sampler(),
+		src_image_view,
+		vk::ImageLayout::eShaderReadOnlyOptimal);
+
+	vk_device_.updateDescriptorSets(
+		{
+			{
+				*descriptor_set,
+				g_tex_uniform_binding,
+				0u,
+				1u,
+				vk::DescriptorType::eCombinedImageSampler,
+				&descriptor_image_info,
+				nullptr,
+				nullptr
+			}
+		},
+		{});
+
+	return descriptor_set;
 }
 
 void Tonemapper::DoMainPass(const vk::CommandBuffer command_buffer, const std::function<void()>& draw_function)
@@ -559,9 +796,9 @@ void Tonemapper::DoMainPass(const vk::CommandBuffer command_buffer, const std::f
 	{
 		exposure_buffer_prepared_= true;
 
-		ExposureAccumulateBuffer exposure_accumulate_buffer;
-		for(float& exposure : exposure_accumulate_buffer.exposure)
-			exposure= 1.0f;
+		ExposureAccumulateBuffer exposure_accumulate_buffer{};
+		exposure_accumulate_buffer.exposure= 1.0f;
+		exposure_accumulate_buffer.groups_finished= 0u;
 
 		command_buffer.updateBuffer(
 			*exposure_accumulate_buffer_,
@@ -569,10 +806,12 @@ void Tonemapper::DoMainPass(const vk::CommandBuffer command_buffer, const std::f
 			sizeof(ExposureAccumulateBuffer),
 			&exposure_accumulate_buffer);
 
-		const vk::MemoryBarrier memory_barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead);
+		const vk::MemoryBarrier memory_barrier(
+			vk::AccessFlagBits::eTransferWrite,
+			vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
 		command_buffer.pipelineBarrier(
 			vk::PipelineStageFlagBits::eTransfer,
-			vk::PipelineStageFlagBits::eAllGraphics,
+			vk::PipelineStageFlagBits::eComputeShader,
 			vk::DependencyFlags(),
 			1u, &memory_barrier,
 			0u, nullptr,
@@ -585,17 +824,21 @@ void Tonemapper::DoMainPass(const vk::CommandBuffer command_buffer, const std::f
 		{ vk::ClearDepthStencilValue(1.0f, 0u) },
 	};
 
-	command_buffer.beginRenderPass(
-		vk::RenderPassBeginInfo(
-			*main_pass_,
-			*main_pass_framebuffer_,
-			vk::Rect2D(vk::Offset2D(0, 0), framebuffer_size_),
-			2u, clear_value),
-		vk::SubpassContents::eInline);
+	{
+		const GPUProfilerStageScope profiler_scope(gpu_profiler_, command_buffer, "main pass", true);
 
-	draw_function();
+		command_buffer.beginRenderPass(
+			vk::RenderPassBeginInfo(
+				*main_pass_,
+				*main_pass_framebuffer_,
+				vk::Rect2D(vk::Offset2D(0, 0), render_size_),
+				2u, clear_value),
+			vk::SubpassContents::eInline);
 
-	command_buffer.endRenderPass();
+		draw_function();
+
+		command_buffer.endRenderPass();
+	}
 
 	// Wait for finish of main rendering.
 	// TODO - check all barrienrs in this function !!!
@@ -607,22 +850,22 @@ void Tonemapper::DoMainPass(const vk::CommandBuffer command_buffer, const std::f
 		{},
 		{});
 
-	// Calculate exposure.
+	const uint32_t exposure_stage= gpu_profiler_ == nullptr ? ~0u : gpu_profiler_->BeginStage(command_buffer, "exposure");
 
 	// Transfer layout of brightness image to optimal for tranfer destination.
 	{
 		const vk::ImageMemoryBarrier image_memory_barrier_dst(
+			vk::AccessFlagBits::eShaderRead,
 			vk::AccessFlagBits::eTransferWrite,
-			vk::AccessFlagBits::eMemoryRead,
 			vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
 			queue_family_index_,
 			queue_family_index_,
 			*brightness_calculate_image_,
-			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0u, brightness_calculate_image_mip_levels_, 0u, 1u));
+			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0u, 1u, 0u, 1u));
 
 		command_buffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader,
 			vk::PipelineStageFlagBits::eTransfer,
-			vk::PipelineStageFlagBits::eBottomOfPipe,
 			vk::DependencyFlags(),
 			0u, nullptr,
 			0u, nullptr,
@@ -634,12 +877,12 @@ void Tonemapper::DoMainPass(const vk::CommandBuffer command_buffer, const std::f
 			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0u, 0u, 1u),
 			{
 				vk::Offset3D(0, 0, 0),
-				vk::Offset3D(framebuffer_size_.width, framebuffer_size_.height, 1),
+				vk::Offset3D(int32_t(render_size_.width), int32_t(render_size_.height), 1),
 			},
 			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0u, 0u, 1u),
 			{
 				vk::Offset3D(0, 0, 0),
-				vk::Offset3D(aux_image_size_.width, aux_image_size_.height, 1),
+				vk::Offset3D(int32_t(aux_image_size_.width), int32_t(aux_image_size_.height), 1),
 			});
 
 		command_buffer.blitImage(
@@ -650,74 +893,36 @@ void Tonemapper::DoMainPass(const vk::CommandBuffer command_buffer, const std::f
 			1u, &image_blit,
 			vk::Filter::eLinear);
 	}
-	// Calculate mip levels of brightness texture.
-	for(uint32_t i= 1u; i < brightness_calculate_image_mip_levels_; ++i)
-	{
-		// Transform previous mip level layout from dst_optimal to src_optimal
-		const vk::ImageMemoryBarrier image_memory_barrier_src(
-			vk::AccessFlagBits::eTransferWrite,
-			vk::AccessFlagBits::eMemoryRead,
-			vk::ImageLayout::eTransferDstOptimal,
-			vk::ImageLayout::eTransferSrcOptimal,
-			queue_family_index_,
-			queue_family_index_,
-			*brightness_calculate_image_,
-			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, i - 1u, 1u, 0u, 1u));
-
-		command_buffer.pipelineBarrier(
-			vk::PipelineStageFlagBits::eTransfer,
-			vk::PipelineStageFlagBits::eBottomOfPipe,
-			vk::DependencyFlags(),
-			0u, nullptr,
-			0u, nullptr,
-			1u, &image_memory_barrier_src);
-
-		const vk::ImageBlit image_blit(
-			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i - 1u, 0u, 1u),
-			{
-				vk::Offset3D(0, 0, 0),
-				vk::Offset3D(std::max(1u, aux_image_size_.width  >> (i-1u)), std::max(1u, aux_image_size_.height >> (i-1u)), 1),
-			},
-			vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i - 0u, 0u, 1u),
-			{
-				vk::Offset3D(0, 0, 0),
-				vk::Offset3D(std::max(1u, aux_image_size_.width >> i), std::max(1u, aux_image_size_.height >> i), 1),
-			});
-
-		command_buffer.blitImage(
-			*brightness_calculate_image_,
-			vk::ImageLayout::eTransferSrcOptimal,
-			*brightness_calculate_image_,
-			vk::ImageLayout::eTransferDstOptimal,
-			1u, &image_blit,
-			vk::Filter::eLinear);
-	}
 	// Transfer layout of brightness image to shader read optimal.
-	for(uint32_t i= 0u; i < brightness_calculate_image_mip_levels_; ++i)
+	// Also wait for previous exposure calculation and its usage before next calculation.
 	{
+		const vk::MemoryBarrier memory_barrier(
+			vk::AccessFlagBits::eShaderWrite,
+			vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+
 		const vk::ImageMemoryBarrier image_memory_barrier_final(
 			vk::AccessFlagBits::eTransferWrite,
-			vk::AccessFlagBits::eMemoryRead,
-			i + 1u == brightness_calculate_image_mip_levels_ ? vk::ImageLayout::eTransferDstOptimal : vk::ImageLayout::eTransferSrcOptimal,
+			vk::AccessFlagBits::eShaderRead,
+			vk::ImageLayout::eTransferDstOptimal,
 			vk::ImageLayout::eShaderReadOnlyOptimal,
 			queue_family_index_,
 			queue_family_index_,
 			*brightness_calculate_image_,
-			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, i, 1u, 0u, 1u));
+			vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0u, 1u, 0u, 1u));
 
 		command_buffer.pipelineBarrier(
-			vk::PipelineStageFlagBits::eTransfer,
-			vk::PipelineStageFlagBits::eBottomOfPipe,
+			vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eVertexShader,
+			vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eFragmentShader,
 			vk::DependencyFlags(),
-			0u, nullptr,
+			1u, &memory_barrier,
 			0u, nullptr,
 			1u, &image_memory_barrier_final);
 	}
 	// Transfer layout of main image to shader read optimal.
 	{
 		const vk::ImageMemoryBarrier image_memory_barrier_final(
-			vk::AccessFlagBits::eTransferWrite,
-			vk::AccessFlagBits::eMemoryRead,
+			vk::AccessFlagBits::eTransferRead,
+			vk::AccessFlagBits::eShaderRead,
 			vk::ImageLayout::eTransferSrcOptimal,
 			vk::ImageLayout::eShaderReadOnlyOptimal,
 			queue_family_index_,
@@ -727,73 +932,137 @@ void Tonemapper::DoMainPass(const vk::CommandBuffer command_buffer, const std::f
 
 		command_buffer.pipelineBarrier(
 			vk::PipelineStageFlagBits::eTransfer,
-			vk::PipelineStageFlagBits::eBottomOfPipe,
+			vk::PipelineStageFlagBits::eFragmentShader,
 			vk::DependencyFlags(),
 			0u, nullptr,
 			0u, nullptr,
 			1u, &image_memory_barrier_final);
 	}
 
-	// Make blur for bloom.
+	// Calculate exposure.
 	{
-		for(BloomBuffer& bloom_buffer : bloom_buffers_)
-		{
-			command_buffer.beginRenderPass(
-				vk::RenderPassBeginInfo(
-					*bloom_render_pass_,
-					*bloom_buffer.framebuffer,
-					vk::Rect2D(vk::Offset2D(0, 0), aux_image_size_),
-					0u, nullptr),
-				vk::SubpassContents::eInline);
+		command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, *exposure_pipeline_.pipeline);
 
-			command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *bloom_pipeline_.pipeline);
+		command_buffer.bindDescriptorSets(
+			vk::PipelineBindPoint::eCompute,
+			*exposure_pipeline_.pipeline_layout,
+			0u,
+			1u, &*exposure_descriptor_set_,
+			0u, nullptr);
 
-			command_buffer.bindDescriptorSets(
-				vk::PipelineBindPoint::eGraphics,
-				*bloom_pipeline_.pipeline_layout,
-				0u,
-				1u, &*bloom_buffer.descriptor_set,
-				0u, nullptr);
+		// Adapt exposure according to real time between frames. Limit time step to avoid jumps after long pauses.
+		const Clock::time_point current_time= Clock::now();
+		const float time_delta_s=
+			fixed_time_step_s_ > 0.0f
+				? fixed_time_step_s_
+				: std::min(0.25f, std::chrono::duration<float>(current_time - prev_exposure_update_time_).count());
+		prev_exposure_update_time_= current_time;
+
+		UniformsExposure uniforms{};
+		uniforms.mix_factor= GetExposureMixFactor(exposure_settings_, time_delta_s);
+		uniforms.low_percentile= exposure_settings_.low_percentile;
+		uniforms.high_percentile= exposure_settings_.high_percentile;
+		uniforms.min_log2_brightness= exposure_settings_.min_log2_brightness;
+		uniforms.max_log2_brightness= exposure_settings_.max_log2_brightness;
+
+		command_buffer.pushConstants(
+			*exposure_pipeline_.pipeline_layout,
+			vk::ShaderStageFlagBits::eCompute,
+			0u,
+			sizeof(uniforms),
+			&uniforms);
 
-			const float bloom_size= 0.03125f;
+		command_buffer.dispatch(g_exposure_groups_x, g_exposure_groups_y, 1u);
 
-			UniformsBloom uniforms;
-			if(&bloom_buffer == &bloom_buffers_[0])
-			{
-				uniforms.blur_vector[0]= bloom_size * float(framebuffer_size_.height) / float(framebuffer_size_.width);
-				uniforms.blur_vector[1]= 0.0f;
-			}
-			else
-			{
-				uniforms.blur_vector[0]= 0.0f;
-				uniforms.blur_vector[1]= bloom_size;
-			}
+		// Wait for exposure calculation before tonemapping.
+		const vk::MemoryBarrier memory_barrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead);
+		command_buffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eVertexShader,
+			vk::DependencyFlags(),
+			1u, &memory_barrier,
+			0u, nullptr,
+			0u, nullptr);
+	}
 
-			command_buffer.pushConstants(
-				*bloom_pipeline_.pipeline_layout,
-				vk::ShaderStageFlagBits::eFragment,
-				0u,
-				sizeof(uniforms),
-				&uniforms);
+	if(exposure_readback_)
+	{
+		// Copy calculation results into host-visible buffer.
+		const vk::MemoryBarrier memory_barrier_copy(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eTransferRead);
+		command_buffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eComputeShader,
+			vk::PipelineStageFlagBits::eTransfer,
+			vk::DependencyFlags(),
+			1u, &memory_barrier_copy,
+			0u, nullptr,
+			0u, nullptr);
 
-			command_buffer.draw(6u, 1u, 0u, 0u);
+		const vk::BufferCopy copy_region(0u, 0u, vk::DeviceSize(sizeof(ExposureAccumulateBuffer)));
+		command_buffer.copyBuffer(*exposure_accumulate_buffer_, *exposure_readback_buffer_, 1u, &copy_region);
+
+		const vk::MemoryBarrier memory_barrier_host(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+		command_buffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer,
+			vk::PipelineStageFlagBits::eHost,
+			vk::DependencyFlags(),
+			1u, &memory_barrier_host,
+			0u, nullptr,
+			0u, nullptr);
 
-			command_buffer.endRenderPass();
+		exposure_readback_written_= true;
+	}
 
-			command_buffer.pipelineBarrier(
-				vk::PipelineStageFlagBits::eColorAttachmentOutput,
-				vk::PipelineStageFlagBits::eFragmentShader,
-				vk::DependencyFlags(),
-				{ {vk::AccessFlagBits::eColorAttachmentWrite, vk::AccessFlagBits::eShaderRead} },
-				{},
-				{});
+	if(gpu_profiler_ != nullptr)
+		gpu_profiler_->EndStage(command_buffer, exposure_stage);
 
-		} // for bloom buffers.
+	// Make bloom. Downsample brightness image down to smallest level, than upsample back to level 0.
+	// Each pass uses fixed number of texture fetches, so bloom cost is proportional to number of pixels.
+	{
+		const GPUProfilerStageScope profiler_scope(gpu_profiler_, command_buffer, "bloom");
+		for(size_t level= 1u; level < bloom_buffers_.size(); ++level)
+			DoBloomPass(command_buffer, bloom_downsample_pipeline_, bloom_buffers_[level], *bloom_buffers_[level].downsample_descriptor_set);
+		for(size_t level= bloom_buffers_.size() - 1u; level > 0u; --level)
+			DoBloomPass(command_buffer, bloom_upsample_pipeline_, bloom_buffers_[level - 1u], *bloom_buffers_[level - 1u].upsample_descriptor_set);
 	}
 }
 
+void Tonemapper::DoBloomPass(
+	const vk::CommandBuffer command_buffer,
+	const Pipeline& pipeline,
+	const BloomBuffer& dst_buffer,
+	const vk::DescriptorSet descriptor_set)
+{
+	command_buffer.beginRenderPass(
+		vk::RenderPassBeginInfo(
+			*bloom_render_pass_,
+			*dst_buffer.framebuffer,
+			vk::Rect2D(vk::Offset2D(0, 0), dst_buffer.size),
+			0u, nullptr),
+		vk::SubpassContents::eInline);
+
+	command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *pipeline.pipeline);
+
+	const vk::Viewport viewport(0.0f, 0.0f, float(dst_buffer.size.width), float(dst_buffer.size.height), 0.0f, 1.0f);
+	const vk::Rect2D scissor(vk::Offset2D(0, 0), dst_buffer.size);
+	command_buffer.setViewport(0u, 1u, &viewport);
+	command_buffer.setScissor(0u, 1u, &scissor);
+
+	command_buffer.bindDescriptorSets(
+		vk::PipelineBindPoint::eGraphics,
+		*pipeline.pipeline_layout,
+		0u,
+		1u, &descriptor_set,
+		0u, nullptr);
+
+	command_buffer.draw(6u, 1u, 0u, 0u);
+
+	command_buffer.endRenderPass();
+}
+
 void Tonemapper::EndFrame(const vk::CommandBuffer command_buffer)
 {
+	const GPUProfilerStageScope profiler_scope(gpu_profiler_, command_buffer, "tonemapping", true);
+
 	command_buffer.bindDescriptorSets(
 		vk::PipelineBindPoint::eGraphics,
 		*main_pipeline_.pipeline_layout,
@@ -803,35 +1072,35 @@ void Tonemapper::EndFrame(const vk::CommandBuffer command_buffer)
 
 	const float bloom_scale= 0.125f;
 
-	Uniforms uniforms;
-	uniforms.fragment.bloom_scale= bloom_scale;
-
-	const float c_exposure_change_speed= 8.0f;
-	uniforms.vertex.mix_factor= 1.0f - std::pow(c_exposure_change_speed, -1.0f / 10.0f); // TODO - use here current frequency.
-	uniforms.vertex.mix_factor= std::max(0.0001f, std::min(uniforms.vertex.mix_factor, 0.9999f));
-
-	command_buffer.pushConstants(
-		*main_pipeline_.pipeline_layout,
-		vk::ShaderStageFlagBits::eVertex,
-		offsetof(Uniforms, vertex),
-		sizeof(uniforms.vertex),
-		&uniforms.vertex);
+	Uniforms uniforms{};
+	uniforms.bloom_scale= bloom_scale;
+	// Main image may occupy only part of framebuffer. Avoid fetching texels outside it.
+	uniforms.tex_coord_scale[0]= float(render_size_.width ) / float(framebuffer_size_.width );
+	uniforms.tex_coord_scale[1]= float(render_size_.height) / float(framebuffer_size_.height);
+	uniforms.tex_coord_max[0]= (float(render_size_.width ) - 0.5f) / float(framebuffer_size_.width );
+	uniforms.tex_coord_max[1]= (float(render_size_.height) - 0.5f) / float(framebuffer_size_.height);
 
 	command_buffer.pushConstants(
 		*main_pipeline_.pipeline_layout,
 		vk::ShaderStageFlagBits::eFragment,
-		offsetof(Uniforms, fragment),
-		sizeof(uniforms.fragment),
-		&uniforms.fragment);
+		0u,
+		sizeof(uniforms),
+		&uniforms);
 
 	command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *main_pipeline_.pipeline);
+
+	const vk::Extent2D viewport_size= window_vulkan_.GetViewportSize();
+	const vk::Viewport viewport(0.0f, 0.0f, float(viewport_size.width), float(viewport_size.height), 0.0f, 1.0f);
+	const vk::Rect2D scissor(vk::Offset2D(0, 0), viewport_size);
+	command_buffer.setViewport(0u, 1u, &viewport);
+	command_buffer.setScissor(0u, 1u, &scissor);
+
 	command_buffer.draw(6u, 1u, 0u, 0u);
+
 }
 
 Tonemapper::Pipeline Tonemapper::CreateMainPipeline(I_WindowVulkan& window_vulkan)
 {
-	const vk::Extent2D& viewport_size= window_vulkan.GetViewportSize();
-
 	Pipeline pipeline;
 
 	// Create shaders
@@ -878,13 +1147,6 @@ Tonemapper::Pipeline Tonemapper::CreateMainPipeline(I_WindowVulkan& window_vulka
 			vk::ShaderStageFlagBits::eFragment,
 			&*pipeline.sampler,
 		},
-		{
-			g_brightness_tex_uniform_binding,
-			vk::DescriptorType::eCombinedImageSampler,
-			1u,
-			vk::ShaderStageFlagBits::eVertex,
-			&*pipeline.sampler,
-		},
 		{
 			g_exposure_accumulate_tex_uniform_binding,
 			vk::DescriptorType::eStorageBuffer,
@@ -907,26 +1169,17 @@ Tonemapper::Pipeline Tonemapper::CreateMainPipeline(I_WindowVulkan& window_vulka
 				vk::DescriptorSetLayoutCreateFlags(),
 				uint32_t(std::size(descriptor_set_layout_bindings)), descriptor_set_layout_bindings));
 
-	const vk::PushConstantRange push_constant_ranges[]
-	{
-		{
-			vk::ShaderStageFlagBits::eVertex,
-			offsetof(Uniforms, vertex),
-			sizeof(Uniforms::vertex)
-		},
-		{
-			vk::ShaderStageFlagBits::eFragment,
-			offsetof(Uniforms, fragment),
-			sizeof(Uniforms::fragment)
-		},
-	};
+	const vk::PushConstantRange push_constant_range(
+		vk::ShaderStageFlagBits::eFragment,
+		0u,
+		sizeof(Uniforms));
 
 	pipeline.pipeline_layout=
 		vk_device_.createPipelineLayoutUnique(
 			vk::PipelineLayoutCreateInfo(
 				vk::PipelineLayoutCreateFlags(),
 				1u, &*pipeline.decriptor_set_layout,
-				uint32_t(std::size(push_constant_ranges)), push_constant_ranges));
+				1u, &push_constant_range));
 
 	// Create pipeline.
 	const vk::PipelineShaderStageCreateInfo shader_stage_create_info[2]
@@ -954,13 +1207,16 @@ Tonemapper::Pipeline Tonemapper::CreateMainPipeline(I_WindowVulkan& window_vulka
 		vk::PipelineInputAssemblyStateCreateFlags(),
 		vk::PrimitiveTopology::eTriangleList);
 
-	const vk::Viewport vk_viewport(0.0f, 0.0f, float(viewport_size.width), float(viewport_size.height), 0.0f, 1.0f);
-	const vk::Rect2D vk_scissor(vk::Offset2D(0, 0), viewport_size);
-
+	// Viewport and scissor are dynamic, so pipeline does not depend on framebuffer size.
 	const vk::PipelineViewportStateCreateInfo pipieline_viewport_state_create_info(
 		vk::PipelineViewportStateCreateFlags(),
-		1u, &vk_viewport,
-		1u, &vk_scissor);
+		1u, nullptr,
+		1u, nullptr);
+
+	const vk::DynamicState dynamic_states[]{ vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+	const vk::PipelineDynamicStateCreateInfo pipeline_dynamic_state_create_info(
+		vk::PipelineDynamicStateCreateFlags(),
+		uint32_t(std::size(dynamic_states)), dynamic_states);
 
 	const vk::PipelineRasterizationStateCreateInfo pipilane_rasterization_state_create_info(
 		vk::PipelineRasterizationStateCreateFlags(),
@@ -1000,7 +1256,7 @@ Tonemapper::Pipeline Tonemapper::CreateMainPipeline(I_WindowVulkan& window_vulka
 
 	pipeline.pipeline=
 		vk_device_.createGraphicsPipelineUnique(
-			nullptr,
+			pipeline_cache_,
 			vk::GraphicsPipelineCreateInfo(
 				vk::PipelineCreateFlags(),
 				uint32_t(std::size(shader_stage_create_info)), shader_stage_create_info,
@@ -1012,7 +1268,7 @@ Tonemapper::Pipeline Tonemapper::CreateMainPipeline(I_WindowVulkan& window_vulka
 				&pipeline_multisample_state_create_info,
 				window_vulkan.HasDepthBuffer() ? &vk_pipeline_depth_state_create_info : nullptr,
 				&vk_pipeline_color_blend_state_create_info,
-				nullptr,
+				&pipeline_dynamic_state_create_info,
 				*pipeline.pipeline_layout,
 				window_vulkan.GetRenderPass(),
 				0u));
@@ -1020,7 +1276,7 @@ Tonemapper::Pipeline Tonemapper::CreateMainPipeline(I_WindowVulkan& window_vulka
 	return pipeline;
 }
 
-Tonemapper::Pipeline Tonemapper::CreateBloomPipeline()
+Tonemapper::Pipeline Tonemapper::CreateBloomPipeline(const uint32_t* const shader_frag_code, const size_t shader_frag_code_size)
 {
 	Pipeline pipeline;
 
@@ -1034,8 +1290,8 @@ Tonemapper::Pipeline Tonemapper::CreateBloomPipeline()
 	pipeline.shader_frag=
 		vk_device_.createShaderModuleUnique(
 			vk::ShaderModuleCreateInfo(vk::ShaderModuleCreateFlags(),
-			sizeof(Shaders::blur_frag),
-			Shaders::blur_frag));
+			shader_frag_code_size,
+			shader_frag_code));
 
 	// Create image sampler
 	pipeline.sampler=
@@ -1076,17 +1332,12 @@ Tonemapper::Pipeline Tonemapper::CreateBloomPipeline()
 				vk::DescriptorSetLayoutCreateFlags(),
 				uint32_t(std::size(descriptor_set_layout_bindings)), descriptor_set_layout_bindings));
 
-	const vk::PushConstantRange push_constant_range(
-		vk::ShaderStageFlagBits::eFragment,
-		0u,
-		sizeof(UniformsBloom));
-
 	pipeline.pipeline_layout=
 		vk_device_.createPipelineLayoutUnique(
 			vk::PipelineLayoutCreateInfo(
 				vk::PipelineLayoutCreateFlags(),
 				1u, &*pipeline.decriptor_set_layout,
-				1u, &push_constant_range));
+				0u, nullptr));
 
 	// Create pipeline.
 	const vk::PipelineShaderStageCreateInfo shader_stage_create_info[2]
@@ -1114,13 +1365,16 @@ Tonemapper::Pipeline Tonemapper::CreateBloomPipeline()
 		vk::PipelineInputAssemblyStateCreateFlags(),
 		vk::PrimitiveTopology::eTriangleList);
 
-	const vk::Viewport vk_viewport(0.0f, 0.0f, float(aux_image_size_.width), float(aux_image_size_.height), 0.0f, 1.0f);
-	const vk::Rect2D vk_scissor(vk::Offset2D(0, 0), aux_image_size_);
-
+	// Viewport and scissor are dynamic, so pipeline does not depend on framebuffer size.
 	const vk::PipelineViewportStateCreateInfo pipieline_viewport_state_create_info(
 		vk::PipelineViewportStateCreateFlags(),
-		1u, &vk_viewport,
-		1u, &vk_scissor);
+		1u, nullptr,
+		1u, nullptr);
+
+	const vk::DynamicState dynamic_states[]{ vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+	const vk::PipelineDynamicStateCreateInfo pipeline_dynamic_state_create_info(
+		vk::PipelineDynamicStateCreateFlags(),
+		uint32_t(std::size(dynamic_states)), dynamic_states);
 
 	const vk::PipelineRasterizationStateCreateInfo pipeline_rasterization_state_create_info(
 		vk::PipelineRasterizationStateCreateFlags(),
@@ -1148,7 +1402,7 @@ Tonemapper::Pipeline Tonemapper::CreateBloomPipeline()
 
 	pipeline.pipeline=
 		vk_device_.createGraphicsPipelineUnique(
-			nullptr,
+			pipeline_cache_,
 			vk::GraphicsPipelineCreateInfo(
 				vk::PipelineCreateFlags(),
 				uint32_t(std::size(shader_stage_create_info)), shader_stage_create_info,
@@ -1160,7 +1414,7 @@ Tonemapper::Pipeline Tonemapper::CreateBloomPipeline()
 				&pipeline_multisample_state_create_info,
 				nullptr,
 				&pipeline_color_blend_state_create_info,
-				nullptr,
+				&pipeline_dynamic_state_create_info,
 				*pipeline.pipeline_layout,
 				*bloom_render_pass_,
 				0u));
@@ -1168,4 +1422,88 @@ Tonemapper::Pipeline Tonemapper::CreateBloomPipeline()
 	return pipeline;
 }
 
-} // namespace KK
+Tonemapper::ComputePipeline Tonemapper::CreateExposurePipeline()
+{
+	ComputePipeline pipeline;
+
+	pipeline.shader=
+		vk_device_.createShaderModuleUnique(
+			vk::ShaderModuleCreateInfo(vk::ShaderModuleCreateFlags(),
+			sizeof(Shaders::exposure_comp),
+			Shaders::exposure_comp));
+
+	// Create image sampler. Linear filtering is used for averaging of 2x2 texel blocks.
+	pipeline.sampler=
+		vk_device_.createSamplerUnique(
+			vk::SamplerCreateInfo(
+				vk::SamplerCreateFlags(),
+				vk::Filter::eLinear,
+				vk::Filter::eLinear,
+				vk::SamplerMipmapMode::eNearest,
+				vk::SamplerAddressMode::eClampToEdge,
+				vk::SamplerAddressMode::eClampToEdge,
+				vk::SamplerAddressMode::eClampToEdge,
+				0.0f,
+				VK_FALSE,
+				0.0f,
+				VK_FALSE,
+				vk::CompareOp::eNever,
+				0.0f,
+				0.0f,
+				vk::BorderColor::eFloatTransparentBlack,
+				VK_FALSE));
+
+	// Create pipeline layout
+	const vk::DescriptorSetLayoutBinding descriptor_set_layout_bindings[]
+	{
+		{
+			g_exposure_brightness_tex_uniform_binding,
+			vk::DescriptorType::eCombinedImageSampler,
+			1u,
+			vk::ShaderStageFlagBits::eCompute,
+			&*pipeline.sampler,
+		},
+		{
+			g_exposure_accumulate_buffer_uniform_binding,
+			vk::DescriptorType::eStorageBuffer,
+			1u,
+			vk::ShaderStageFlagBits::eCompute,
+			nullptr,
+		},
+	};
+
+	pipeline.decriptor_set_layout=
+		vk_device_.createDescriptorSetLayoutUnique(
+			vk::DescriptorSetLayoutCreateInfo(
+				vk::DescriptorSetLayoutCreateFlags(),
+				uint32_t(std::size(descriptor_set_layout_bindings)), descriptor_set_layout_bindings));
+
+	const vk::PushConstantRange push_constant_range(
+		vk::ShaderStageFlagBits::eCompute,
+		0u,
+		sizeof(UniformsExposure));
+
+	pipeline.pipeline_layout=
+		vk_device_.createPipelineLayoutUnique(
+			vk::PipelineLayoutCreateInfo(
+				vk::PipelineLayoutCreateFlags(),
+				1u, &*pipeline.decriptor_set_layout,
+				1u, &push_constant_range));
+
+	// Create pipeline.
+	pipeline.pipeline=
+		vk_device_.createComputePipelineUnique(
+			pipeline_cache_,
+			vk::ComputePipelineCreateInfo(
+				vk::PipelineCreateFlags(),
+				vk::PipelineShaderStageCreateInfo(
+					vk::PipelineShaderStageCreateFlags(),
+					vk::ShaderStageFlagBits::eCompute,
+					*pipeline.shader,
+					"main"),
+				*pipeline.pipeline_layout));
+
+	return pipeline;
+}
+
+} // namespace SZV
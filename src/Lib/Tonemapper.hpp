@@ -1,5 +1,9 @@
 #pragma once
+#include "ExposureHistogram.hpp"
+#include "GPUProfiler.hpp"
 #include "I_WindowVulkan.hpp"
+#include <chrono>
+#include <vector>
 
 
 namespace SZV
@@ -14,17 +18,44 @@ public:
 	vk::Extent2D GetFramebufferSize() const;
 	vk::RenderPass GetMainRenderPass() const;
 
+	// Recreate framebuffers for new viewport size. Render passes and pipelines are preserved.
+	void Resize(vk::Extent2D viewport_size);
+
+	// Main pass is rendered into part of framebuffer, scaled by this value, and upscaled in tonemapping pass.
+	// Scale is in range [0.25; 1]. Changing it does not require resources recreation.
+	void SetRenderScale(float scale);
+	float GetRenderScale() const;
+	vk::Extent2D GetRenderSize() const;
+
+	// Profiler for measuring of main pass, exposure, bloom and tonemapping stages. May be null.
+	void SetGPUProfiler(GPUProfiler* profiler);
+
+	// Exposure is calculated on GPU using brightness histogram.
+	void SetExposureSettings(const ExposureSettings& settings);
+	const ExposureSettings& GetExposureSettings() const;
+
+	// Copy inputs and results of exposure calculation into host-visible memory each frame.
+	void SetExposureReadback(bool enable);
+	// Get results of last recorded frame. Frame must be finished on GPU. Returns false if there is no data yet.
+	bool GetExposureReadback(ExposureCalculationResult& out_result) const;
+
+	// Use fixed time step for exposure adaptation instead of real time between frames. Zero means real time.
+	// Useful for reproducible offscreen rendering.
+	void SetFixedTimeStep(float time_step_s);
+
 	void DoMainPass(vk::CommandBuffer command_buffer, const std::function<void()>& draw_function);
 	void EndFrame(vk::CommandBuffer command_buffer);
 
 private:
 	struct BloomBuffer
 	{
+		vk::Extent2D size;
 		vk::UniqueImage image;
 		vk::UniqueDeviceMemory image_memory;
 		vk::UniqueImageView image_view;
 		vk::UniqueFramebuffer framebuffer;
-		vk::UniqueDescriptorSet descriptor_set;
+		vk::UniqueDescriptorSet downsample_descriptor_set; // Read previous level, write this level.
+		vk::UniqueDescriptorSet upsample_descriptor_set; // Read next level, write this level.
 	};
 
 	struct Pipeline
@@ -37,15 +68,37 @@ private:
 		vk::UniquePipeline pipeline;
 	};
 
+	struct ComputePipeline
+	{
+		vk::UniqueShaderModule shader;
+		vk::UniqueSampler sampler;
+		vk::UniqueDescriptorSetLayout decriptor_set_layout;
+		vk::UniquePipelineLayout pipeline_layout;
+		vk::UniquePipeline pipeline;
+	};
+
 private:
+	void CreateFramebuffers(vk::Extent2D viewport_size);
+	void UpdateRenderSize();
+	vk::UniqueDescriptorSet CreateBloomDescriptorSet(const Pipeline& pipeline, vk::ImageView src_image_view);
+	void DoBloomPass(vk::CommandBuffer command_buffer, const Pipeline& pipeline, const BloomBuffer& dst_buffer, vk::DescriptorSet descriptor_set);
 	Pipeline CreateMainPipeline(I_WindowVulkan& window_vulkan);
-	Pipeline CreateBloomPipeline();
+	Pipeline CreateBloomPipeline(const uint32_t* shader_frag_code, size_t shader_frag_code_size);
+	ComputePipeline CreateExposurePipeline();
 
 private:
+	I_WindowVulkan& window_vulkan_;
 	const vk::Device vk_device_;
 	const uint32_t queue_family_index_;
+	const vk::PipelineCache pipeline_cache_;
+	const vk::PhysicalDeviceMemoryProperties memory_properties_;
+
+	vk::Format framebuffer_image_format_= vk::Format::eUndefined;
+	vk::Format framebuffer_depth_format_= vk::Format::eUndefined;
 
 	vk::Extent2D framebuffer_size_;
+	float render_scale_= 1.0f;
+	vk::Extent2D render_size_; // Part of framebuffer, used for main pass.
 	vk::UniqueImage framebuffer_image_;
 	vk::UniqueDeviceMemory framebuffer_image_memory_;
 	vk::UniqueImageView framebuffer_image_view_;
@@ -63,21 +116,36 @@ private:
 	vk::UniqueImage brightness_calculate_image_;
 	vk::UniqueDeviceMemory brightness_calculate_image_memory_;
 	vk::UniqueImageView brightness_calculate_image_view_;
-	uint32_t brightness_calculate_image_mip_levels_;
 
 	vk::UniqueBuffer exposure_accumulate_buffer_;
 	vk::UniqueDeviceMemory exposure_accumulate_memory_;
 	bool exposure_buffer_prepared_= false;
+	ExposureSettings exposure_settings_;
+
+	bool exposure_readback_= false;
+	bool exposure_readback_written_= false;
+	vk::UniqueBuffer exposure_readback_buffer_;
+	vk::UniqueDeviceMemory exposure_readback_memory_;
+	const void* exposure_readback_mapped_= nullptr;
+
+	using Clock= std::chrono::steady_clock;
+	Clock::time_point prev_exposure_update_time_;
+	float fixed_time_step_s_= 0.0f;
 
 	Pipeline main_pipeline_;
-	Pipeline bloom_pipeline_;
+	Pipeline bloom_downsample_pipeline_;
+	Pipeline bloom_upsample_pipeline_;
+	ComputePipeline exposure_pipeline_;
 
 	vk::UniqueDescriptorPool descriptor_pool_;
 
 	vk::UniqueRenderPass bloom_render_pass_;
-	BloomBuffer bloom_buffers_[2];
+	std::vector<BloomBuffer> bloom_buffers_; // Bloom pyramid levels.
+
+	GPUProfiler* gpu_profiler_= nullptr;
 
 	vk::UniqueDescriptorSet main_descriptor_set_;
+	vk::UniqueDescriptorSet exposure_descriptor_set_;
 };
 
 } // namespace KK
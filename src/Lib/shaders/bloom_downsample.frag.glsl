@@ -0,0 +1,24 @@
+#version 450
+
+// Dual filter downsample.
+// Output image has half size of input image, so each linear tap calculates average for 2x2 texels.
+// 5 taps cover 4x4 texels area.
+
+layout(binding= 0) uniform sampler2D tex;
+
+layout(location= 0) in noperspective vec2 f_tex_coord;
+
+layout(location= 0) out vec4 color;
+
+void main()
+{
+	vec2 offset= 1.0 / vec2(textureSize(tex, 0));
+
+	vec4 r= texture(tex, f_tex_coord) * 4.0;
+	r+= texture(tex, f_tex_coord + vec2(-offset.x, -offset.y));
+	r+= texture(tex, f_tex_coord + vec2(+offset.x, -offset.y));
+	r+= texture(tex, f_tex_coord + vec2(-offset.x, +offset.y));
+	r+= texture(tex, f_tex_coord + vec2(+offset.x, +offset.y));
+
+	color= r / 8.0;
+}
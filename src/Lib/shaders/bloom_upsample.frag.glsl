@@ -0,0 +1,28 @@
+#version 450
+
+// Dual filter upsample.
+// Output image has double size of input image.
+// Diagonal taps are placed between texels, so linear filtering merges 4 texels into one tap.
+
+layout(binding= 0) uniform sampler2D tex;
+
+layout(location= 0) in noperspective vec2 f_tex_coord;
+
+layout(location= 0) out vec4 color;
+
+void main()
+{
+	vec2 offset= 0.5 / vec2(textureSize(tex, 0));
+
+	vec4 r= vec4(0.0, 0.0, 0.0, 0.0);
+	r+= texture(tex, f_tex_coord + vec2(-2.0 * offset.x, 0.0));
+	r+= texture(tex, f_tex_coord + vec2(+2.0 * offset.x, 0.0));
+	r+= texture(tex, f_tex_coord + vec2(0.0, -2.0 * offset.y));
+	r+= texture(tex, f_tex_coord + vec2(0.0, +2.0 * offset.y));
+	r+= texture(tex, f_tex_coord + vec2(-offset.x, -offset.y)) * 2.0;
+	r+= texture(tex, f_tex_coord + vec2(+offset.x, -offset.y)) * 2.0;
+	r+= texture(tex, f_tex_coord + vec2(-offset.x, +offset.y)) * 2.0;
+	r+= texture(tex, f_tex_coord + vec2(+offset.x, +offset.y)) * 2.0;
+
+	color= r / 12.0;
+}
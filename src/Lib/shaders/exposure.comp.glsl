@@ -0,0 +1,142 @@
+#version 450
+
+// Build brightness histogram and update exposure in single dispatch.
+// Each workgroup builds own histogram in shared memory and adds it to global histogram.
+// Last finished workgroup calculates average brightness between low and high percentiles and updates exposure.
+// Subgroup operations are not used, since Vulkan 1.0 is required.
+// This shader must match reference implementation in ExposureHistogram.cpp.
+
+const uint c_group_size_x= 16;
+const uint c_group_size_y= 16;
+const uint c_group_size= c_group_size_x * c_group_size_y;
+const uint c_num_groups= 64; // Must match dispatch size.
+const uint c_histogram_bins= 64; // Must match c_exposure_histogram_bins.
+
+layout(local_size_x= c_group_size_x, local_size_y= c_group_size_y) in;
+
+layout(push_constant) uniform uniforms_block
+{
+	float mix_factor;
+	float low_percentile;
+	float high_percentile;
+	float min_log2_brightness;
+	float max_log2_brightness;
+};
+
+layout(binding= 0) uniform sampler2D brightness_tex;
+
+layout(binding= 1, std430) coherent buffer exposure_accumulate_buffer
+{
+	float exposure;
+	uint groups_finished;
+	uint histogram[c_histogram_bins];
+
+	// Inputs and results of last calculation, for comparison with reference implementation.
+	uint last_histogram[c_histogram_bins];
+	float last_prev_exposure;
+	float last_mix_factor;
+	float last_average_brightness;
+};
+
+shared uint group_histogram[c_histogram_bins];
+shared bool is_last_group;
+
+uint GetHistogramBin(vec2 tex_coord)
+{
+	float brightness= dot(textureLod(brightness_tex, tex_coord, 0.0).rgb, vec3(0.299, 0.587, 0.114));
+	float log_brightness= log2(max(brightness, 1.0e-20));
+	float relative= (log_brightness - min_log2_brightness) / (max_log2_brightness - min_log2_brightness);
+	return uint(clamp(floor(relative * float(c_histogram_bins)), 0.0, float(c_histogram_bins - 1)));
+}
+
+float GetHistogramAverageBrightness()
+{
+	float total= 0.0;
+	for(uint i= 0; i < c_histogram_bins; ++i)
+		total+= float(group_histogram[i]);
+
+	float low= total * low_percentile;
+	float high= total * high_percentile;
+	float bin_size= (max_log2_brightness - min_log2_brightness) / float(c_histogram_bins);
+
+	// Take part of each bin, which lies between percentiles.
+	float cumulative= 0.0;
+	float log_brightness_sum= 0.0;
+	float weight_sum= 0.0;
+	for(uint i= 0; i < c_histogram_bins; ++i)
+	{
+		float count= float(group_histogram[i]);
+		float weight= max(0.0, min(cumulative + count, high) - max(cumulative, low));
+		log_brightness_sum+= weight * (min_log2_brightness + (float(i) + 0.5) * bin_size);
+		weight_sum+= weight;
+		cumulative+= count;
+	}
+
+	if(weight_sum <= 0.0)
+		return 0.5;
+
+	return exp2(log_brightness_sum / weight_sum);
+}
+
+void main()
+{
+	if(gl_LocalInvocationIndex < c_histogram_bins)
+		group_histogram[gl_LocalInvocationIndex]= 0;
+	memoryBarrierShared();
+	barrier();
+
+	// Fetch image in 2x2 blocks, linear filtering calculates average for block.
+	ivec2 size= max(textureSize(brightness_tex, 0) / 2, ivec2(1, 1));
+	vec2 inv_size= 1.0 / vec2(size);
+	uvec2 stride= gl_NumWorkGroups.xy * gl_WorkGroupSize.xy;
+
+	for(uint y= gl_GlobalInvocationID.y; y < uint(size.y); y+= stride.y)
+	for(uint x= gl_GlobalInvocationID.x; x < uint(size.x); x+= stride.x)
+		atomicAdd(group_histogram[GetHistogramBin((vec2(x, y) + vec2(0.5, 0.5)) * inv_size)], 1);
+
+	memoryBarrierShared();
+	barrier();
+
+	if(gl_LocalInvocationIndex < c_histogram_bins)
+	{
+		uint count= group_histogram[gl_LocalInvocationIndex];
+		if(count != 0)
+			atomicAdd(histogram[gl_LocalInvocationIndex], count);
+	}
+	memoryBarrierBuffer();
+	barrier();
+
+	if(gl_LocalInvocationIndex == 0)
+		is_last_group= atomicAdd(groups_finished, 1) == c_num_groups - 1;
+	memoryBarrierShared();
+	barrier();
+
+	if(!is_last_group)
+		return;
+
+	// Copy global histogram and reset it for next frame.
+	if(gl_LocalInvocationIndex < c_histogram_bins)
+	{
+		uint count= atomicExchange(histogram[gl_LocalInvocationIndex], 0);
+		group_histogram[gl_LocalInvocationIndex]= count;
+		last_histogram[gl_LocalInvocationIndex]= count;
+	}
+	memoryBarrierShared();
+	barrier();
+
+	if(gl_LocalInvocationIndex == 0)
+	{
+		float brightness= GetHistogramAverageBrightness();
+		float target_exposure= 0.6 * pow(brightness + 0.001, -0.75);
+
+		last_prev_exposure= exposure;
+		last_mix_factor= mix_factor;
+		last_average_brightness= brightness;
+
+		// Mix current exposure with previous.
+		// Use inverse values in mix function for better look.
+		exposure= 1.0 / mix(1.0 / exposure, 1.0 / target_exposure, mix_factor);
+
+		groups_finished= 0;
+	}
+}
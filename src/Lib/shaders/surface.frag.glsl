@@ -22,6 +22,11 @@ layout(set= 0, binding= 1, std430) buffer readonly csg_expressions_block
 	int expressions_description[];
 };
 
+layout(set= 0, binding= 2, std430) buffer readonly csg_transforms_block
+{
+	float transforms_description[];
+};
+
 layout(location=0) out vec4 out_color;
 
 struct SurfaceDescription
@@ -45,6 +50,52 @@ SurfaceDescription FetchSurface(int index)
 	return s;
 }
 
+float GetSurfaceValue(SurfaceDescription s, vec3 pos)
+{
+	return
+		dot( s.xx_yy_zz, pos * pos ) +
+		dot( s.xy_xz_yz, pos.xxy * pos.yzz ) +
+		dot( s.x_y_z, pos ) +
+		s.k;
+}
+
+// Rigid transformation from space of instance into world space.
+struct Transform
+{
+	vec3 x_vec;
+	vec3 y_vec;
+	vec3 z_vec;
+	vec3 shift;
+};
+
+Transform FetchTransform(int index)
+{
+	Transform t;
+
+	int offset= index * 12;
+	t.x_vec= vec3( transforms_description[offset+0], transforms_description[offset+ 1], transforms_description[offset+ 2] );
+	t.y_vec= vec3( transforms_description[offset+3], transforms_description[offset+ 4], transforms_description[offset+ 5] );
+	t.z_vec= vec3( transforms_description[offset+6], transforms_description[offset+ 7], transforms_description[offset+ 8] );
+	t.shift= vec3( transforms_description[offset+9], transforms_description[offset+10], transforms_description[offset+11] );
+
+	return t;
+}
+
+vec3 TransformVectorIntoInstanceSpace(Transform t, vec3 v)
+{
+	return vec3( dot( v, t.x_vec ), dot( v, t.y_vec ), dot( v, t.z_vec ) );
+}
+
+vec3 TransformPointIntoInstanceSpace(Transform t, vec3 pos)
+{
+	return TransformVectorIntoInstanceSpace( t, pos - t.shift );
+}
+
+vec3 TransformVectorIntoWorldSpace(Transform t, vec3 v)
+{
+	return t.x_vec * v.x + t.y_vec * v.y + t.z_vec * v.z;
+}
+
 struct TextureVecs
 {
 	vec3 u;
@@ -73,6 +124,10 @@ vec3 TextureFetch3d( vec3 coord, float smooth_size )
 
 bool IsInsideFigure(vec3 pos)
 {
+#ifdef SPECIALIZED_CSG_EXPRESSIONS
+	// Function with straight-line code for each leaf expression is generated at runtime and inserted at the beginning of this shader.
+	return IsInsideFigureSpecialized(int(f_surface_description_offset), pos);
+#else
 	bool expressions_stack[16];
 	int stack_size= 0;
 
@@ -81,11 +136,12 @@ bool IsInsideFigure(vec3 pos)
 		op_code_add= 1,
 		op_code_sub= 2,
 		op_code_leaf= 3,
-		op_code_one_leaf= 4;
+		op_code_one_leaf= 4,
+		op_code_instanced_leaf= 5;
 
 	int
-		offset= int(f_surface_description_offset) + 2,
-		end_offset= expressions_description[ int(f_surface_description_offset) + 1 ];
+		offset= int(f_surface_description_offset) + 3,
+		end_offset= expressions_description[ int(f_surface_description_offset) + 2 ];
 	while( offset < end_offset )
 	{
 		int op= expressions_description[offset];
@@ -122,13 +178,19 @@ bool IsInsideFigure(vec3 pos)
 				++offset;
 				SurfaceDescription s= FetchSurface( surface_index );
 
-				float val=
-					dot( s.xx_yy_zz, pos * pos ) +
-					dot( s.xy_xz_yz, pos.xxy * pos.yzz ) +
-					dot( s.x_y_z, pos ) +
-					s.k;
+				expressions_stack[stack_size]= GetSurfaceValue( s, pos ) < 0.0;
+				++stack_size;
+			}
+			break;
+		case op_code_instanced_leaf:
+			{
+				int surface_index= expressions_description[offset];
+				int transform_index= expressions_description[offset + 1];
+				offset+= 2;
+				SurfaceDescription s= FetchSurface( surface_index );
+				vec3 instance_pos= TransformPointIntoInstanceSpace( FetchTransform( transform_index ), pos );
 
-				expressions_stack[stack_size]= val < 0.0;
+				expressions_stack[stack_size]= GetSurfaceValue( s, instance_pos ) < 0.0;
 				++stack_size;
 			}
 			break;
@@ -145,6 +207,7 @@ bool IsInsideFigure(vec3 pos)
 	}
 
 	return expressions_stack[0];
+#endif
 }
 
 void main()
@@ -152,10 +215,20 @@ void main()
 	// Find itersection between ray from camera and surface, solving quadratic equation relative to "distance" variable.
 	// This variable is not real distance, since input direction vector is not normalized.
 	int surface_index= expressions_description[int(f_surface_description_offset)];
+	int transform_index= expressions_description[int(f_surface_description_offset) + 1];
 	SurfaceDescription s= FetchSurface( surface_index );
 
+	// Intersection is calculated in space of surface.
+	// Value of "distance" is the same as in world space, since transformation is rigid.
 	vec3 n= f_dir;
 	vec3 v= cam_pos.xyz;
+	Transform transform;
+	if( transform_index != 0 )
+	{
+		transform= FetchTransform( transform_index );
+		n= TransformVectorIntoInstanceSpace( transform, n );
+		v= TransformPointIntoInstanceSpace( transform, v );
+	}
 	float a= dot( s.xx_yy_zz, n * n ) + dot( s.xy_xz_yz, n.xxy * n.yzz );
 	float b= 2.0 * dot( s.xx_yy_zz, n * v ) + dot( s.xy_xz_yz, v.xxy * n.yzz + v.yzz * n.xxy ) + dot( s.x_y_z, n );
 	float c= dot( s.xx_yy_zz, v * v ) + dot( s.xy_xz_yz, v.xxy * v.yzz ) + dot( s.x_y_z, v ) + s.k;
@@ -192,13 +265,14 @@ void main()
 	vec3 vec_to_intersection_pos= n * dist;
 	vec3 intersection_pos= v + vec_to_intersection_pos;
 
-	if( !IsInsideFigure( intersection_pos ) )
+	// Figure expression is evaluated in world space.
+	if( !IsInsideFigure( cam_pos.xyz + f_dir * dist ) )
 	{
 		dist= dist_max;
 		vec_to_intersection_pos= n * dist;
 		intersection_pos= v + vec_to_intersection_pos;
 
-		if( !IsInsideFigure( intersection_pos ) )
+		if( !IsInsideFigure( cam_pos.xyz + f_dir * dist ) )
 			discard;
 	}
 
@@ -214,6 +288,9 @@ void main()
 	if( dir_normal_dot > 0.0 )
 		normal= -normal;
 
+	if( transform_index != 0 )
+		normal= TransformVectorIntoWorldSpace( transform, normal );
+
 	float sun_light_dot= max( dot( normal, dir_to_sun_normalized.xyz ), 0.0 );
 
 	TextureVecs texture_vecs= FetchTextureVecs( surface_index );
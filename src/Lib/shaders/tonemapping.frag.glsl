@@ -6,10 +6,11 @@ layout(binding= 3) uniform sampler2D blured_tex;
 
 layout(push_constant) uniform uniforms_block
 {
-	layout(offset = 16) vec4 bloom_scale; // .x used
+	vec4 bloom_scale; // .x used
+	vec4 tex_coord_scale; // .xy - scale, .zw - max texture coordinates. Used for upscaling of main image, rendered with lower resolution.
 };
 
-layout(location= 0) in vec2 f_tex_coord; // In range [-1; 1]
+layout(location= 0) in vec2 f_tex_coord; // In range [0; 1]
 layout(location= 1) in flat float f_exposure;
 
 layout(location = 0) out vec4 out_color;
@@ -28,7 +29,7 @@ vec3 tonemapping_function(vec3 x, float exposure)
 
 void main()
 {
-	vec3 color= texture(tex, f_tex_coord).rgb;
+	vec3 color= texture(tex, min(f_tex_coord * tex_coord_scale.xy, tex_coord_scale.zw)).rgb;
 	vec3 blured_color= texture(blured_tex, f_tex_coord).rgb;
 
 	color= tonemapping_function(color + blured_color * bloom_scale.x, f_exposure);
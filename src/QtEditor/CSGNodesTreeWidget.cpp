@@ -41,6 +41,13 @@ m_Vec3 GetNodePosImpl(const CSGTree::AddArray& node)
 	return m_Vec3(0.0f, 0.0f, 0.0f);
 }
 
+m_Vec3 GetNodePosImpl(const CSGTree::Instance& node)
+{
+	if(!node.elements.empty())
+		return GetNodePos(node.elements.front());
+	return m_Vec3(0.0f, 0.0f, 0.0f);
+}
+
 m_Vec3 GetNodePos(const CSGTree::CSGTreeNode& node)
 {
 	return std::visit([](const auto& n){ return GetNodePosImpl(n); }, node);
@@ -79,11 +86,23 @@ m_Vec3 GetNodeSizeImpl(const CSGTree::AddArray& node)
 	return m_Vec3(1.0f, 1.0f, 1.0f);
 }
 
+m_Vec3 GetNodeSizeImpl(const CSGTree::Instance& node)
+{
+	if(!node.elements.empty())
+		return GetNodeSize(node.elements.front());
+	return m_Vec3(1.0f, 1.0f, 1.0f);
+}
+
 m_Vec3 GetNodeSizeImpl(const CSGTree::HyperbolicParaboloid&)
 {
 	return m_Vec3(1.0f, 1.0f, 1.0f);
 }
 
+m_Vec3 GetNodeSizeImpl(const CSGTree::Reference&)
+{
+	return m_Vec3(1.0f, 1.0f, 1.0f);
+}
+
 m_Vec3 GetNodeSize(const CSGTree::CSGTreeNode& node)
 {
 	return std::visit([](const auto& n){ return GetNodeSizeImpl(n); }, node);
@@ -115,6 +134,13 @@ m_Vec3 GetNodeAnglesImpl(const CSGTree::SubChain& node)
 	return m_Vec3(0.0f, 0.0f, 0.0f);
 }
 
+m_Vec3 GetNodeAnglesImpl(const CSGTree::Instance& node)
+{
+	if(!node.elements.empty())
+		return GetNodeAngles(node.elements.front());
+	return m_Vec3(0.0f, 0.0f, 0.0f);
+}
+
 m_Vec3 GetNodeAngles(const CSGTree::CSGTreeNode& node)
 {
 	return std::visit([](const auto& n){ return GetNodeAnglesImpl(n); }, node);
@@ -124,6 +150,7 @@ void SetNodePosImpl(CSGTree::MulChain&, const m_Vec3&){}
 void SetNodePosImpl(CSGTree::AddChain&, const m_Vec3&){}
 void SetNodePosImpl(CSGTree::SubChain&, const m_Vec3&){}
 void SetNodePosImpl(CSGTree::AddArray&, const m_Vec3&){}
+void SetNodePosImpl(CSGTree::Instance&, const m_Vec3&){}
 
 template<typename T> void SetNodePosImpl(T& node, const m_Vec3& pos){ node.center= pos; }
 
@@ -137,6 +164,8 @@ void SetNodeSizeImpl(CSGTree::AddChain&, const m_Vec3&){}
 void SetNodeSizeImpl(CSGTree::SubChain&, const m_Vec3&){}
 void SetNodeSizeImpl(CSGTree::AddArray&, const m_Vec3&){}
 void SetNodeSizeImpl(CSGTree::HyperbolicParaboloid&, const m_Vec3&){}
+void SetNodeSizeImpl(CSGTree::Reference&, const m_Vec3&){}
+void SetNodeSizeImpl(CSGTree::Instance&, const m_Vec3&){}
 
 template<typename T> void SetNodeSizeImpl(T& node, const m_Vec3& size){ node.size= size; }
 
@@ -149,6 +178,7 @@ void SetNodeAnglesImpl(CSGTree::MulChain&, const m_Vec3&){}
 void SetNodeAnglesImpl(CSGTree::AddChain&, const m_Vec3&){}
 void SetNodeAnglesImpl(CSGTree::SubChain&, const m_Vec3&){}
 void SetNodeAnglesImpl(CSGTree::HyperbolicParaboloid&, const m_Vec3&){}
+void SetNodeAnglesImpl(CSGTree::Instance&, const m_Vec3&){}
 
 template<typename T> void SetNodeAnglesImpl(T& node, const m_Vec3& angles_deg){ node.angles_deg= angles_deg; }
 
@@ -179,6 +209,13 @@ CSGNodesTreeWidget::CSGNodesTreeWidget(CSGTreeModel& csg_tree_model, QWidget* co
 		this,
 		&CSGNodesTreeWidget::OnSelectionChanged);
 
+	// Edited node is destroyed on reset.
+	connect(
+		&csg_tree_model_,
+		&QAbstractItemModel::modelReset,
+		this,
+		[this]{ OnNodeActivated(QModelIndex()); });
+
 	setLayout(&layout_);
 	layout_.addWidget(&csg_tree_view_);
 }
@@ -189,10 +226,11 @@ void CSGNodesTreeWidget::AddNode(CSGTree::CSGTreeNode node_template)
 	if(!index.isValid())
 		return;
 
-	const auto& node= *reinterpret_cast<CSGTree::CSGTreeNode*>(index.internalPointer());
+	const auto& node= *csg_tree_model_.GetNode(index);
 
-	if(node.index() == node_template.index())
-		node_template= node; // If new node have same type - copy all params.
+	// If new node have same type - copy all params. Do not copy reference, because it has user-selected source.
+	if(node.index() == node_template.index() && !std::holds_alternative<CSGTree::Reference>(node_template))
+		node_template= node;
 
 	const m_Vec3 current_pos= GetNodePos(node);
 	const m_Vec3 current_size= GetNodeSize(node);
@@ -204,11 +242,26 @@ void CSGNodesTreeWidget::AddNode(CSGTree::CSGTreeNode node_template)
 	SetNodePos(node_template, pos_shifted);
 	SetNodeSize(node_template, current_size);
 	SetNodeAngles(node_template, current_angles);
-	csg_tree_model_.AddNode(index, std::move(node_template));
+	const QModelIndex new_index= csg_tree_model_.AddNode(index, std::move(node_template));
+	if(new_index.isValid())
+		csg_tree_view_.setCurrentIndex(new_index);
 
 	OnNodeActivated(csg_tree_view_.currentIndex());
 }
 
+void CSGNodesTreeWidget::Undo()
+{
+	// Edited node may be changed or removed.
+	if(csg_tree_model_.Undo())
+		OnNodeActivated(csg_tree_view_.currentIndex());
+}
+
+void CSGNodesTreeWidget::Redo()
+{
+	if(csg_tree_model_.Redo())
+		OnNodeActivated(csg_tree_view_.currentIndex());
+}
+
 void CSGNodesTreeWidget::OnContextMenu(const QPoint& p)
 {
 	const auto menu= new QMenu(this);
@@ -259,14 +312,21 @@ void CSGNodesTreeWidget::OnNodeActivated(const QModelIndex& index)
 		edit_widget_= nullptr;
 	}
 
+	// Changes of newly activated node are not merged with changes of previous node.
+	csg_tree_model_.FinishNodeChanges();
+
 	if(!index.isValid())
 	{
 		emit selectionBoxChanged(m_Vec3(0.0f, 0.0f, 0.0f), m_Vec3(0.1f, 0.1f, 0.1f), m_Vec3(0.0f, 0.0f, 0.0f));
 		return;
 	}
 
-	auto& node= *reinterpret_cast<CSGTree::CSGTreeNode*>(index.internalPointer());
-	edit_widget_= new CSGTreeNodeEditWidget(node, this);
+	auto& node= *csg_tree_model_.GetNode(index);
+	edit_widget_=
+		new CSGTreeNodeEditWidget(
+			node,
+			[this, persistent_index= QPersistentModelIndex(index)]{ csg_tree_model_.OnNodeChanged(persistent_index); },
+			this);
 	layout_.addWidget(edit_widget_);
 
 	emit selectionBoxChanged(GetNodePos(node), GetNodeSize(node), GetNodeAngles(node));
@@ -14,6 +14,8 @@ class CSGNodesTreeWidget final : public QWidget
 public:
 	CSGNodesTreeWidget(CSGTreeModel& csg_tree_model, QWidget*  parent);
 	void AddNode(CSGTree::CSGTreeNode node_template);
+	void Undo();
+	void Redo();
 
 signals:
 	void selectionBoxChanged(const m_Vec3& box_center, const m_Vec3& box_size, const m_Vec3& box_angles_deg);
@@ -1,4 +1,5 @@
 #include "CSGTreeModel.hpp"
+#include <algorithm>
 
 namespace SZV
 {
@@ -11,6 +12,7 @@ ElementsVector* GetElementsVectorImpl(CSGTree::MulChain& node) { return &node.el
 ElementsVector* GetElementsVectorImpl(CSGTree::AddChain& node) { return &node.elements; }
 ElementsVector* GetElementsVectorImpl(CSGTree::SubChain& node) { return &node.elements; }
 ElementsVector* GetElementsVectorImpl(CSGTree::AddArray& node) { return &node.elements; }
+ElementsVector* GetElementsVectorImpl(CSGTree::Instance& node) { return &node.elements; }
 template<class T> ElementsVector* GetElementsVectorImpl(T&) { return nullptr; }
 ElementsVector* GetElementsVector(CSGTree::CSGTreeNode& node)
 {
@@ -22,26 +24,11 @@ ElementsVector* GetElementsVector(CSGTree::CSGTreeNode& node)
 		node);
 }
 
-CSGTree::CSGTreeNode* FindParent(const CSGTree::CSGTreeNode& child, CSGTree::CSGTreeNode& current_node)
-{
-	return std::visit(
-		[&](auto& el) -> CSGTree::CSGTreeNode*
-		{
-			if (const auto vec= GetElementsVectorImpl(el))
-			{
-				for (auto& vec_el : *vec)
-				{
-					if(&vec_el == &child)
-						return &current_node;
-					else if(const auto p= FindParent(child, vec_el))
-						return p;
-				}
-			}
+// Moving of node moves its vector of elements, so items of children of moved node remain valid.
+// Nodes must not be copied instead of moving, when vector is reallocated.
+static_assert(std::is_nothrow_move_constructible_v<CSGTree::CSGTreeNode>, "Expected nothrow move");
 
-			return nullptr;
-		},
-		current_node);
-}
+const size_t c_max_undo_steps= 256u;
 
 QString GetElementTypeNameImpl(const CSGTree::MulChain&) { return "mul"; }
 QString GetElementTypeNameImpl(const CSGTree::AddChain&) { return "add"; }
@@ -56,6 +43,8 @@ QString GetElementTypeNameImpl(const CSGTree::Hyperboloid&) { return "hyperboloi
 QString GetElementTypeNameImpl(const CSGTree::ParabolicCylinder&) { return "parabolic cylinder"; }
 QString GetElementTypeNameImpl(const CSGTree::HyperbolicCylinder&) { return "hyperbolic cylinder"; }
 QString GetElementTypeNameImpl(const CSGTree::HyperbolicParaboloid&) { return "hyperbolic paraboloid"; }
+QString GetElementTypeNameImpl(const CSGTree::Reference& node) { return "reference " + QString::fromStdString(node.source); }
+QString GetElementTypeNameImpl(const CSGTree::Instance& node) { return "instance x" + QString::number(node.transforms.size()); }
 QString GetElementTypeName(const CSGTree::CSGTreeNode& node)
 {
 	return std::visit(
@@ -69,9 +58,11 @@ QString GetElementTypeName(const CSGTree::CSGTreeNode& node)
 } // namespace
 
 CSGTreeModel::CSGTreeModel(CSGTree::CSGTreeNode& root)
-	: root_(root)
+	: root_(root), root_item_(CreateItem_r(root_, nullptr)), version_(MakePersistentTree(root_))
 {}
 
+CSGTreeModel::~CSGTreeModel()= default;
+
 CSGTree::CSGTreeNode& CSGTreeModel::GetRoot()
 {
 	return root_;
@@ -82,133 +73,183 @@ const CSGTree::CSGTreeNode& CSGTreeModel::GetRoot() const
 	return root_;
 }
 
+CSGTree::CSGTreeNode* CSGTreeModel::GetNode(const QModelIndex& index) const
+{
+	if(const Item* const item= GetItem(index))
+		return item->node;
+	return nullptr;
+}
+
 void CSGTreeModel::Reset(CSGTree::CSGTreeNode new_root)
 {
 	beginResetModel();
 	root_= std::move(new_root);
+	root_item_= CreateItem_r(root_, nullptr);
 	endResetModel();
+
+	version_= MakePersistentTree(root_);
+	undo_stack_.clear();
+	redo_stack_.clear();
+	last_changed_item_= nullptr;
 }
 
 void CSGTreeModel::DeleteNode(const QModelIndex& index)
 {
-	if(!index.isValid())
+	const Item* const item= GetItem(index);
+	if(item == nullptr || item->parent == nullptr)
 		return;
 
-	const auto element_ptr= reinterpret_cast<CSGTree::CSGTreeNode*>(index.internalPointer());
+	Item& parent= *item->parent;
+	ElementsVector& vec= *GetElementsVector(*parent.node);
+	const int row= int(item->row);
+	CSGTreePersistent::NodePtr new_version= RemovePersistentNode(version_, GetItemPath(*item));
 
-	if(const auto parent= FindParent(*element_ptr, root_))
-	{
-		if(const auto vec= GetElementsVector(*parent))
-		{
-			const auto index_in_parent= int(element_ptr - vec->data());
+	beginRemoveRows(index.parent(), row, row);
+	vec.erase(vec.begin() + row);
+	parent.children.erase(parent.children.begin() + row);
+	UpdateChildren(parent);
+	endRemoveRows();
 
-			beginRemoveRows(CSGTreeModel::parent(index), index_in_parent, index_in_parent);
-			vec->erase(vec->begin() + index_in_parent);
-			endRemoveRows();
-		}
-	}
+	CommitVersion(std::move(new_version), nullptr);
 }
 
-void CSGTreeModel::AddNode(const QModelIndex& index, CSGTree::CSGTreeNode node)
+QModelIndex CSGTreeModel::AddNode(const QModelIndex& index, CSGTree::CSGTreeNode node)
 {
-	if(!index.isValid())
-		return;
+	const Item* const item= GetItem(index);
+	if(item == nullptr || item->parent == nullptr)
+		return QModelIndex();
 
-	const auto element_ptr= reinterpret_cast<CSGTree::CSGTreeNode*>(index.internalPointer());
+	Item& parent= *item->parent;
+	ElementsVector& vec= *GetElementsVector(*parent.node);
+	const int row= int(item->row);
+	const QModelIndex parent_index= index.parent();
+	CSGTreePersistent::NodePtr new_version= InsertPersistentNode(version_, GetItemPath(*item), node);
 
-	if(const auto parent= FindParent(*element_ptr, root_))
-	{
-		if(const auto vec= GetElementsVector(*parent))
-		{
-			const auto index_in_parent= int(element_ptr - vec->data());
-			// Reset model because indexes are invalidated after insertion into vector. TODO - maybe invalidate only small part of model?
-			beginResetModel();
-			vec->insert(vec->begin() + index_in_parent, std::move(node));
-			endResetModel();
-		}
-	}
+	beginInsertRows(parent_index, row, row);
+	vec.insert(vec.begin() + row, std::move(node));
+	parent.children.insert(parent.children.begin() + row, CreateItem_r(vec[size_t(row)], &parent));
+	UpdateChildren(parent);
+	endInsertRows();
+
+	CommitVersion(std::move(new_version), nullptr);
+
+	return CSGTreeModel::index(row, 0, parent_index);
 }
 
 void CSGTreeModel::MoveUpNode(const QModelIndex& index)
 {
-	if(!index.isValid())
+	const Item* const item= GetItem(index);
+	if(item == nullptr || item->parent == nullptr)
 		return;
 
-	const auto element_ptr= reinterpret_cast<CSGTree::CSGTreeNode*>(index.internalPointer());
-
-	if(const auto parent= FindParent(*element_ptr, root_))
+	Item& parent= *item->parent;
+	ElementsVector& vec= *GetElementsVector(*parent.node);
+	const int row= int(item->row);
+	if(row > 0)
 	{
-		ElementsVector& vec= *GetElementsVector(*parent);
+		const QModelIndex parent_index= index.parent();
+		CSGTreePersistent::NodePtr new_version= MovePersistentNode(version_, GetItemPath(*item), size_t(row - 1));
 
-		const size_t index_in_parent= size_t(element_ptr - vec.data());
-		if(index_in_parent > 0u)
-		{
-			std::swap(vec[index_in_parent - 1u], vec[index_in_parent]);
+		beginMoveRows(parent_index, row, row, parent_index, row - 1);
+		std::swap(vec[size_t(row - 1)], vec[size_t(row)]);
+		std::swap(parent.children[size_t(row - 1)], parent.children[size_t(row)]);
+		UpdateChildren(parent);
+		endMoveRows();
 
-			const auto parent_index= CSGTreeModel::parent(index);
-			emit dataChanged(
-				CSGTreeModel::index(int(index_in_parent - 1), 0, parent_index),
-				CSGTreeModel::index(int(index_in_parent    ), 0, parent_index));
-		}
+		CommitVersion(std::move(new_version), nullptr);
 	}
 }
 
 void CSGTreeModel::MoveDownNode(const QModelIndex& index)
 {
-	if(!index.isValid())
+	const Item* const item= GetItem(index);
+	if(item == nullptr || item->parent == nullptr)
 		return;
 
-	const auto element_ptr= reinterpret_cast<CSGTree::CSGTreeNode*>(index.internalPointer());
-
-	if(const auto parent= FindParent(*element_ptr, root_))
+	Item& parent= *item->parent;
+	ElementsVector& vec= *GetElementsVector(*parent.node);
+	const int row= int(item->row);
+	if(size_t(row) + 1u < vec.size())
 	{
-		ElementsVector& vec= *GetElementsVector(*parent);
+		// Destination is row before which node is placed, counted before moving.
+		const QModelIndex parent_index= index.parent();
+		CSGTreePersistent::NodePtr new_version= MovePersistentNode(version_, GetItemPath(*item), size_t(row + 1));
 
-		const size_t index_in_parent= size_t(element_ptr - vec.data());
-		if(index_in_parent + 1u < vec.size())
-		{
-			std::swap(vec[index_in_parent], vec[index_in_parent + 1u]);
+		beginMoveRows(parent_index, row, row, parent_index, row + 2);
+		std::swap(vec[size_t(row)], vec[size_t(row + 1)]);
+		std::swap(parent.children[size_t(row)], parent.children[size_t(row + 1)]);
+		UpdateChildren(parent);
+		endMoveRows();
 
-			const auto parent_index= CSGTreeModel::parent(index);
-			emit dataChanged(
-				CSGTreeModel::index(int(index_in_parent    ), 0, parent_index),
-				CSGTreeModel::index(int(index_in_parent + 1), 0, parent_index));
-		}
+		CommitVersion(std::move(new_version), nullptr);
 	}
 }
 
+void CSGTreeModel::OnNodeChanged(const QModelIndex& index)
+{
+	const Item* const item= GetItem(index);
+	if(item == nullptr)
+		return;
+
+	CommitVersion(SetPersistentNodeParams(version_, GetItemPath(*item), *item->node), item);
+
+	// Name of node may depend on its parameters.
+	emit dataChanged(index, index);
+}
+
+void CSGTreeModel::FinishNodeChanges()
+{
+	last_changed_item_= nullptr;
+}
+
+bool CSGTreeModel::Undo()
+{
+	if(undo_stack_.empty())
+		return false;
+
+	const CSGTreePersistent::NodePtr target_version= std::move(undo_stack_.back());
+	undo_stack_.pop_back();
+	redo_stack_.push_back(version_);
+	ApplyVersion(target_version);
+	return true;
+}
+
+bool CSGTreeModel::Redo()
+{
+	if(redo_stack_.empty())
+		return false;
+
+	const CSGTreePersistent::NodePtr target_version= std::move(redo_stack_.back());
+	redo_stack_.pop_back();
+	undo_stack_.push_back(version_);
+	ApplyVersion(target_version);
+	return true;
+}
+
+const CSGTreePersistent::NodePtr& CSGTreeModel::GetVersion() const
+{
+	return version_;
+}
+
 QModelIndex CSGTreeModel::index(const int row, const int column, const QModelIndex& parent) const
 {
+	if(!hasIndex(row, column, parent))
+		return QModelIndex();
+
 	if(!parent.isValid())
-		return createIndex(row, column, reinterpret_cast<uintptr_t>(&root_));
+		return createIndex(row, column, reinterpret_cast<uintptr_t>(root_item_.get()));
 
-	const auto element_ptr= reinterpret_cast<CSGTree::CSGTreeNode*>(parent.internalPointer());
-	if(const auto vec= GetElementsVector(*element_ptr))
-	{
-		if(row >= int(vec->size()) || row < 0)
-			return QModelIndex();
-		return createIndex(row, column, reinterpret_cast<uintptr_t>(&(*vec)[row]));
-	}
-	return QModelIndex();
+	return createIndex(row, column, reinterpret_cast<uintptr_t>(GetItem(parent)->children[size_t(row)].get()));
 }
 
 QModelIndex CSGTreeModel::parent(const QModelIndex& child) const
 {
-	if(!child.isValid())
+	const Item* const item= GetItem(child);
+	if(item == nullptr || item->parent == nullptr)
 		return QModelIndex();
 
-	const auto element_ptr= reinterpret_cast<CSGTree::CSGTreeNode*>(child.internalPointer());
-	const auto parent= FindParent(*element_ptr, const_cast<CSGTree::CSGTreeNode&>(root_));
-	if(parent == nullptr)
-		return QModelIndex();
-
-	if(const auto parent_of_parent= FindParent(*parent, const_cast<CSGTree::CSGTreeNode&>(root_)))
-	{
-		if(const auto vec= GetElementsVector(*parent_of_parent))
-			return createIndex(int(parent - vec->data()), 0, reinterpret_cast<uintptr_t>(parent));
-	}
-
-	return createIndex(0, 0, reinterpret_cast<uintptr_t>(parent));
+	const Item* const parent= item->parent;
+	return createIndex(int(parent->row), 0, reinterpret_cast<uintptr_t>(parent));
 }
 
 int CSGTreeModel::rowCount(const QModelIndex& parent) const
@@ -216,11 +257,7 @@ int CSGTreeModel::rowCount(const QModelIndex& parent) const
 	if(!parent.isValid())
 		return 1;
 
-	const auto element_ptr= reinterpret_cast<CSGTree::CSGTreeNode*>(parent.internalPointer());
-	if (const auto vec= GetElementsVector(*element_ptr))
-		return int(vec->size());
-
-	return 0;
+	return int(GetItem(parent)->children.size());
 }
 
 int CSGTreeModel::columnCount(const QModelIndex& parent) const
@@ -234,11 +271,168 @@ QVariant CSGTreeModel::data(const QModelIndex &index, const int role) const
 	if(role != Qt::DisplayRole)
 		return QVariant();
 
-	const auto ptr= reinterpret_cast<const CSGTree::CSGTreeNode*>(index.internalPointer());
-	if(ptr == nullptr)
+	const CSGTree::CSGTreeNode* const node= GetNode(index);
+	if(node == nullptr)
 		return QVariant();
 
-	return GetElementTypeName(*ptr);
+	return GetElementTypeName(*node);
+}
+
+std::unique_ptr<CSGTreeModel::Item> CSGTreeModel::CreateItem_r(CSGTree::CSGTreeNode& node, Item* const parent)
+{
+	auto item= std::make_unique<Item>();
+	item->node= &node;
+	item->parent= parent;
+
+	if(const auto vec= GetElementsVector(node))
+	{
+		item->children.reserve(vec->size());
+		for(CSGTree::CSGTreeNode& child : *vec)
+		{
+			item->children.push_back(CreateItem_r(child, item.get()));
+			item->children.back()->row= item->children.size() - 1u;
+		}
+	}
+
+	return item;
+}
+
+void CSGTreeModel::UpdateChildren(Item& item)
+{
+	ElementsVector& vec= *GetElementsVector(*item.node);
+	for(size_t i= 0u; i < vec.size(); ++i)
+	{
+		item.children[i]->node= &vec[i];
+		item.children[i]->row= i;
+	}
+}
+
+CSGTreeModel::Item* CSGTreeModel::GetItem(const QModelIndex& index)
+{
+	if(!index.isValid())
+		return nullptr;
+	return reinterpret_cast<Item*>(index.internalPointer());
+}
+
+CSGTreePersistent::Path CSGTreeModel::GetItemPath(const Item& item)
+{
+	CSGTreePersistent::Path path;
+	for(const Item* i= &item; i->parent != nullptr; i= i->parent)
+		path.push_back(i->row);
+
+	std::reverse(path.begin(), path.end());
+	return path;
+}
+
+QModelIndex CSGTreeModel::GetItemIndex(const Item& item) const
+{
+	return createIndex(int(item.row), 0, reinterpret_cast<uintptr_t>(&item));
+}
+
+CSGTreeModel::Item* CSGTreeModel::FindItem(const CSGTreePersistent::Path& path) const
+{
+	Item* item= root_item_.get();
+	for(const size_t index : path)
+		item= item->children[index].get();
+	return item;
+}
+
+void CSGTreeModel::ReplaceChildren(
+	Item& item,
+	const size_t begin,
+	const size_t old_end,
+	const CSGTreePersistent::Node& new_node,
+	const size_t new_end)
+{
+	const QModelIndex index= GetItemIndex(item);
+
+	if(old_end > begin)
+	{
+		ElementsVector& vec= *GetElementsVector(*item.node);
+		beginRemoveRows(index, int(begin), int(old_end - 1u));
+		vec.erase(vec.begin() + std::ptrdiff_t(begin), vec.begin() + std::ptrdiff_t(old_end));
+		item.children.erase(item.children.begin() + std::ptrdiff_t(begin), item.children.begin() + std::ptrdiff_t(old_end));
+		UpdateChildren(item);
+		endRemoveRows();
+	}
+
+	if(new_end > begin)
+	{
+		ElementsVector& vec= *GetElementsVector(*item.node);
+		beginInsertRows(index, int(begin), int(new_end - 1u));
+		for(size_t i= begin; i < new_end; ++i)
+			vec.insert(vec.begin() + std::ptrdiff_t(i), MakeCSGTree(new_node.GetChild(i)));
+		for(size_t i= begin; i < new_end; ++i)
+			item.children.insert(item.children.begin() + std::ptrdiff_t(i), CreateItem_r(vec[i], &item));
+		UpdateChildren(item);
+		endInsertRows();
+	}
+}
+
+void CSGTreeModel::CommitVersion(CSGTreePersistent::NodePtr new_version, const Item* const changed_item)
+{
+	// Merge continuous changes of same node (like spinning of value) into single step.
+	if(!(changed_item != nullptr && changed_item == last_changed_item_ && !undo_stack_.empty()))
+	{
+		if(undo_stack_.size() >= c_max_undo_steps)
+			undo_stack_.erase(undo_stack_.begin());
+		undo_stack_.push_back(std::move(version_));
+	}
+
+	version_= std::move(new_version);
+	redo_stack_.clear();
+	last_changed_item_= changed_item;
+}
+
+void CSGTreeModel::ApplyVersion(const CSGTreePersistent::NodePtr& target_version)
+{
+	// Changes are ordered from root to leafs and paths are valid in both versions, so items may be found via paths.
+	for(const CSGTreePersistent::Change& change : DiffPersistentTrees(version_, target_version))
+	{
+		Item& item= *FindItem(change.path);
+		const CSGTreePersistent::Node& target_node= *GetPersistentNode(target_version, change.path);
+
+		if(change.node_replaced)
+		{
+			// Remove children of old node before replacing node itself, since items of children refer to its elements.
+			if(!item.children.empty())
+				ReplaceChildren(item, 0u, item.children.size(), target_node, 0u);
+
+			*item.node= *target_node.params;
+
+			const QModelIndex index= GetItemIndex(item);
+			emit dataChanged(index, index);
+
+			if(target_node.GetChildCount() > 0u)
+				ReplaceChildren(item, 0u, 0u, target_node, target_node.GetChildCount());
+			continue;
+		}
+
+		if(change.params_changed)
+		{
+			// Keep elements of node - they are changed separately.
+			ElementsVector elements;
+			if(ElementsVector* const vec= GetElementsVector(*item.node))
+				elements= std::move(*vec);
+
+			*item.node= *target_node.params;
+
+			if(ElementsVector* const vec= GetElementsVector(*item.node))
+			{
+				*vec= std::move(elements);
+				UpdateChildren(item);
+			}
+
+			const QModelIndex index= GetItemIndex(item);
+			emit dataChanged(index, index);
+		}
+
+		if(change.old_children_end > change.children_begin || change.new_children_end > change.children_begin)
+			ReplaceChildren(item, change.children_begin, change.old_children_end, target_node, change.new_children_end);
+	}
+
+	version_= target_version;
+	last_changed_item_= nullptr;
 }
 
 } // namespace SZV
@@ -1,6 +1,8 @@
 #pragma once
-#include "../Lib/CSGExpressionTree.hpp"
+#include "../Lib/CSGTreePersistent.hpp"
 #include <QtCore/QAbstractItemModel>
+#include <memory>
+#include <vector>
 
 namespace SZV
 {
@@ -9,17 +11,34 @@ class CSGTreeModel final : public QAbstractItemModel
 {
 public:
 	explicit CSGTreeModel(CSGTree::CSGTreeNode& root);
+	~CSGTreeModel() override;
 
 	CSGTree::CSGTreeNode& GetRoot();
 	const CSGTree::CSGTreeNode& GetRoot() const;
+	// Returns null for invalid index.
+	CSGTree::CSGTreeNode* GetNode(const QModelIndex& index) const;
 
+	// Clears history of changes.
 	void Reset(CSGTree::CSGTreeNode new_root);
 
 	void DeleteNode(const QModelIndex& index);
-	void AddNode(const QModelIndex& index, CSGTree::CSGTreeNode node);
+	// Insert node before given node. Returns index of new node.
+	QModelIndex AddNode(const QModelIndex& index, CSGTree::CSGTreeNode node);
 	void MoveUpNode(const QModelIndex& index);
 	void MoveDownNode(const QModelIndex& index);
 
+	// Must be called after each change of parameters of node, done directly via pointer to node.
+	// Subsequent changes of same node are merged into single undo step, until "FinishNodeChanges" is called.
+	void OnNodeChanged(const QModelIndex& index);
+	void FinishNodeChanges();
+
+	// Return false if there is nothing to undo/redo.
+	bool Undo();
+	bool Redo();
+
+	// Immutable snapshot of current state of tree. Cheap to keep and to compare with other versions.
+	const CSGTreePersistent::NodePtr& GetVersion() const;
+
 public: // QAbstractItemModel
 	QModelIndex index(int row, int column, const QModelIndex& parent) const override;
 	QModelIndex parent(const QModelIndex& child) const override;
@@ -28,10 +47,42 @@ public: // QAbstractItemModel
 	QVariant data(const QModelIndex& index, int role) const override;
 
 private:
-	using Path= QVector<size_t>;
+	// Item for each node of tree. Items are allocated separately and are not moved, when nodes are inserted, removed or moved,
+	// so they are used as internal pointers of indices. Pointers to nodes and rows are updated when vector of nodes is changed.
+	struct Item
+	{
+		CSGTree::CSGTreeNode* node= nullptr;
+		Item* parent= nullptr;
+		// Index in children of parent. Allows to create index of parent without search.
+		size_t row= 0u;
+		std::vector<std::unique_ptr<Item>> children;
+	};
+
+private:
+	static std::unique_ptr<Item> CreateItem_r(CSGTree::CSGTreeNode& node, Item* parent);
+	static void UpdateChildren(Item& item);
+	static Item* GetItem(const QModelIndex& index);
+	static CSGTreePersistent::Path GetItemPath(const Item& item);
+
+	QModelIndex GetItemIndex(const Item& item) const;
+	Item* FindItem(const CSGTreePersistent::Path& path) const;
+	// Replace children in range [begin; old_end) with children of given persistent node in range [begin; new_end).
+	void ReplaceChildren(Item& item, size_t begin, size_t old_end, const CSGTreePersistent::Node& new_node, size_t new_end);
+
+	void CommitVersion(CSGTreePersistent::NodePtr new_version, const Item* changed_item);
+	// Apply difference between current version and given version to tree and items.
+	void ApplyVersion(const CSGTreePersistent::NodePtr& target_version);
 
 private:
 	CSGTree::CSGTreeNode& root_;
+	std::unique_ptr<Item> root_item_;
+
+	// Each edit stores only nodes on path to changed node, all other nodes are shared with previous versions.
+	CSGTreePersistent::NodePtr version_;
+	std::vector<CSGTreePersistent::NodePtr> undo_stack_;
+	std::vector<CSGTreePersistent::NodePtr> redo_stack_;
+	// Item, changed by last commit of parameters. Cleared by structural changes, so it always points to live item or is null.
+	const Item* last_changed_item_= nullptr;
 };
 
 } // namespace SZV
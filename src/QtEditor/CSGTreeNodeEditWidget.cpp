@@ -1,12 +1,13 @@
 #include "CSGTreeNodeEditWidget.hpp"
 #include <QtWidgets/QDoubleSpinBox>
 #include <QtWidgets/QLabel>
+#include <algorithm>
 
 namespace SZV
 {
 
-CSGTreeNodeEditWidget::CSGTreeNodeEditWidget(CSGTree::CSGTreeNode& node, QWidget* const parent)
-	: QWidget(parent)
+CSGTreeNodeEditWidget::CSGTreeNodeEditWidget(CSGTree::CSGTreeNode& node, NodeChangedCallback node_changed_callback, QWidget* const parent)
+	: QWidget(parent), node_changed_callback_(std::move(node_changed_callback))
 {
 	std::visit(
 			[&](auto& el)
@@ -52,7 +53,7 @@ void CSGTreeNodeEditWidget::AddValueControl(QGridLayout& layout, float& value, c
 		box,
 		static_cast<void(QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged),
 		this,
-		[value_ptr](const double value){ *value_ptr= float(value); });
+		[this, value_ptr](const double value){ *value_ptr= float(value); node_changed_callback_(); });
 
 	const int row= layout.rowCount();
 	layout.addWidget(label, row, 0);
@@ -116,7 +117,7 @@ void CSGTreeNodeEditWidget::AddWidgets(CSGTree::AddArray& node)
 			box,
 			static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
 			this,
-			[value_ptr](const int value){ *value_ptr= uint8_t(value); });
+			[this, value_ptr](const int value){ *value_ptr= uint8_t(value); node_changed_callback_(); });
 
 		const int row= layout->rowCount();
 		layout->addWidget(new QLabel(captions_size[i]), row, 0);
@@ -139,7 +140,7 @@ void CSGTreeNodeEditWidget::AddWidgets(CSGTree::AddArray& node)
 			box,
 			static_cast<void(QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged),
 			this,
-			[value_ptr](const double value){ *value_ptr= float(value); });
+			[this, value_ptr](const double value){ *value_ptr= float(value); node_changed_callback_(); });
 
 		const int row= layout->rowCount();
 		layout->addWidget(new QLabel(captions_step[i]), row, 0);
@@ -233,4 +234,31 @@ void CSGTreeNodeEditWidget::AddWidgets(CSGTree::HyperbolicParaboloid& node)
 	setLayout(layout);
 }
 
+void CSGTreeNodeEditWidget::AddWidgets(CSGTree::Reference& node)
+{
+	const auto layout= new QGridLayout(this);
+	layout->addWidget(new QLabel("Source:"), 0, 0);
+	layout->addWidget(new QLabel(QString::fromStdString(node.source)), 0, 1);
+	AddPosControl(*layout, node.center);
+	AddAnglesControl(*layout, node.angles_deg);
+	setLayout(layout);
+}
+
+void CSGTreeNodeEditWidget::AddWidgets(CSGTree::Instance& node)
+{
+	// Instance may have thousands of copies, show controls only for first of them.
+	const size_t max_shown_transforms= 16u;
+
+	const auto layout= new QGridLayout(this);
+	layout->addWidget(new QLabel("Copies:"), 0, 0);
+	layout->addWidget(new QLabel(QString::number(node.transforms.size())), 0, 1);
+	for(size_t i= 0u; i < std::min(node.transforms.size(), max_shown_transforms); ++i)
+	{
+		layout->addWidget(new QLabel("Copy " + QString::number(i)), layout->rowCount(), 0);
+		AddPosControl(*layout, node.transforms[i].center);
+		AddAnglesControl(*layout, node.transforms[i].angles_deg);
+	}
+	setLayout(layout);
+}
+
 } // namespace SZV
@@ -2,6 +2,7 @@
 #include "../Lib/CSGExpressionTree.hpp"
 #include <QtWidgets/QWidget>
 #include <QtWidgets/QGridLayout>
+#include <functional>
 
 namespace SZV
 {
@@ -9,7 +10,10 @@ namespace SZV
 class CSGTreeNodeEditWidget final : public QWidget
 {
 public:
-	CSGTreeNodeEditWidget(CSGTree::CSGTreeNode& node, QWidget* parent = nullptr);
+	// Callback is called after each change of node.
+	using NodeChangedCallback= std::function<void()>;
+
+	CSGTreeNodeEditWidget(CSGTree::CSGTreeNode& node, NodeChangedCallback node_changed_callback, QWidget* parent = nullptr);
 
 private:
 	enum class ValueKind{ Pos, Size, Angle };
@@ -32,6 +36,11 @@ private:
 	void AddWidgets(CSGTree::ParabolicCylinder& node);
 	void AddWidgets(CSGTree::HyperbolicCylinder& node);
 	void AddWidgets(CSGTree::HyperbolicParaboloid& node);
+	void AddWidgets(CSGTree::Reference& node);
+	void AddWidgets(CSGTree::Instance& node);
+
+private:
+	const NodeChangedCallback node_changed_callback_;
 };
 
 } // namespace SZV
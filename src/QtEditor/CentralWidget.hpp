@@ -1,6 +1,7 @@
 #pragma once
 #include "../Lib/CSGExpressionTree.hpp"
 #include <QtWidgets/QWidget>
+#include <string>
 
 namespace SZV
 {
@@ -12,6 +13,14 @@ public:
 
 	virtual CSGTree::CSGTreeNode& GetCSGTreeRoot() = 0;
 	virtual const CSGTree::CSGTreeNode& GetCSGTreeRoot() const = 0;
+	// Replace whole tree. Views of tree are reset.
+	virtual void SetCSGTreeRoot(CSGTree::CSGTreeNode root) = 0;
+
+	virtual void Undo() = 0;
+	virtual void Redo() = 0;
+
+	// Short single-line description of renderer state (GPU stage times), shown in status bar. May be empty.
+	virtual std::string GetStatusText() const = 0;
 };
 
 CentralWidgetBase* CreateCentralWidget(QWidget* parent);
@@ -1,4 +1,8 @@
 #include "../Lib/CSGRenderer.hpp"
+#include "../Lib/CSGSceneBuildThread.hpp"
+#include "../Lib/GPUProfiler.hpp"
+#include "../Lib/PipelineCache.hpp"
+#include "../Lib/Profiler.hpp"
 #include "../Lib/SelectionRenderer.hpp"
 #include "CentralWidget.hpp"
 #include "CSGNodesTreeWidget.hpp"
@@ -32,39 +36,52 @@ class VulkanRenderer final : public QVulkanWindowRenderer, public I_WindowVulkan
 public:
 	explicit VulkanRenderer(
 		QVulkanWindow& window,
-		const CSGTree::CSGTreeNode& csg_tree_root,
+		const CSGTreeModel& csg_tree_model,
 		const SelectionBox& selection_box,
-		const InputState& input_state)
+		const InputState& input_state,
+		std::string& gpu_profiler_summary)
 		: window_(window)
-		, csg_tree_root_(csg_tree_root)
+		, csg_tree_model_(csg_tree_model)
 		, selection_box_(selection_box)
 		, input_state_(input_state)
+		, gpu_profiler_summary_(gpu_profiler_summary)
 		, camera_controller_(1.0f)
 		, prev_tick_time_(Clock::now())
 	{}
 
 	void initResources() override
-	{}
+	{
+		pipeline_cache_= std::make_unique<PipelineCache>(window_.device(), window_.physicalDevice(), "SazavaEditor_pipeline_cache.bin");
+		gpu_profiler_= std::make_unique<GPUProfiler>(*this);
+	}
 
 	void initSwapChainResources() override
 	{
-		csg_renderer_= nullptr;
-		csg_renderer_= std::make_unique<CSGRenderer>(*this);
+		// Create renderers only once, pipelines do not depend on swapchain size, since viewport is dynamic.
+		if(csg_renderer_ == nullptr)
+		{
+			csg_renderer_= std::make_unique<CSGRenderer>(*this);
+			csg_renderer_->SetGPUProfiler(gpu_profiler_.get());
+		}
+		else
+			csg_renderer_->Resize(GetViewportSize());
 
-		selection_renderer_= nullptr;
-		selection_renderer_= std::make_unique<SelectionRenderer>(*this);
+		if(selection_renderer_ == nullptr)
+		{
+			selection_renderer_= std::make_unique<SelectionRenderer>(*this);
+			selection_renderer_->SetGPUProfiler(gpu_profiler_.get());
+		}
 	}
 
 	void releaseSwapChainResources() override
-	{
-		csg_renderer_= nullptr;
-		selection_renderer_ = nullptr;
-	}
+	{}
 
 	void releaseResources() override
 	{
 		csg_renderer_= nullptr;
 		selection_renderer_ = nullptr;
+		gpu_profiler_= nullptr;
+		pipeline_cache_= nullptr;
 	}
 
 	void startNextFrame() override
@@ -72,10 +89,23 @@ public:
 		if(csg_renderer_ == nullptr || selection_renderer_ == nullptr)
 			return;
 
+		// Drain profiler buffers from previous frame.
+		if(Profiler::IsEnabled())
+			Profiler::Collect();
+
+		SZV_PROFILE_ZONE("VulkanRenderer::startNextFrame");
+
 		UpdateCamera();
 
 		vk::CommandBuffer command_buffer = window_.currentCommandBuffer();
-		csg_renderer_->BeginFrame(command_buffer, camera_controller_, csg_tree_root_);
+		gpu_profiler_->BeginFrame(command_buffer);
+		gpu_profiler_summary_= gpu_profiler_->GetLastFrameResultSummary();
+
+		// Building of large scene may take many frames. Draw last built scene meanwhile.
+		// Changes, made while build is running, are built together after it.
+		scene_build_thread_.RequestBuild(csg_tree_model_.GetVersion());
+		csg_renderer_->SetScene(scene_build_thread_.GetLastResult());
+		csg_renderer_->BeginFrame(command_buffer, camera_controller_);
 
 		const vk::ClearValue clear_value[]
 		{
@@ -145,6 +175,27 @@ public: // I_WindowVulkan
 		return window_.physicalDevice();
 	}
 
+	vk::PipelineCache GetPipelineCache() const override
+	{
+		return pipeline_cache_->Get();
+	}
+
+	vk::PhysicalDeviceFeatures GetEnabledDeviceFeatures() const override
+	{
+		// QVulkanWindow does not allow to enable additional features.
+		return vk::PhysicalDeviceFeatures();
+	}
+
+	uint32_t GetFramesInFlightCount() const override
+	{
+		return uint32_t(window_.concurrentFrameCount());
+	}
+
+	uint32_t GetCurrentFrameIndex() const override
+	{
+		return uint32_t(window_.currentFrame());
+	}
+
 private:
 	void UpdateCamera()
 	{
@@ -168,10 +219,14 @@ private:
 
 private:
 	QVulkanWindow& window_;
-	const CSGTree::CSGTreeNode& csg_tree_root_;
+	const CSGTreeModel& csg_tree_model_;
 	const SelectionBox& selection_box_;
 	const InputState& input_state_;
+	std::string& gpu_profiler_summary_;
+	CSGSceneBuildThread scene_build_thread_;
 	CameraController camera_controller_;
+	std::unique_ptr<PipelineCache> pipeline_cache_;
+	std::unique_ptr<GPUProfiler> gpu_profiler_;
 	std::unique_ptr<CSGRenderer> csg_renderer_;
 	std::unique_ptr<SelectionRenderer> selection_renderer_;
 
@@ -182,13 +237,19 @@ private:
 class VulkanWindow final : public QVulkanWindow
 {
 public:
-	VulkanWindow(QWindow* const parent, const CSGTree::CSGTreeNode& csg_tree_root, const SelectionBox& selection_box)
-		: QVulkanWindow(parent), csg_tree_root_(csg_tree_root), selection_box_(selection_box)
+	VulkanWindow(QWindow* const parent, const CSGTreeModel& csg_tree_model, const SelectionBox& selection_box)
+		: QVulkanWindow(parent), csg_tree_model_(csg_tree_model), selection_box_(selection_box)
 	{}
 
 	QVulkanWindowRenderer *createRenderer() override
 	{
-		return new VulkanRenderer(*this, csg_tree_root_, selection_box_, input_state_);
+		return new VulkanRenderer(*this, csg_tree_model_, selection_box_, input_state_, gpu_profiler_summary_);
+	}
+
+	// Renderer works in GUI thread, so no synchronization is needed.
+	const std::string& GetGPUProfilerSummary() const
+	{
+		return gpu_profiler_summary_;
 	}
 
 private:
@@ -233,7 +294,8 @@ private:
 
 private:
 	InputState input_state_{};
-	const CSGTree::CSGTreeNode& csg_tree_root_;
+	std::string gpu_profiler_summary_;
+	const CSGTreeModel& csg_tree_model_;
 	const SelectionBox& selection_box_;
 };
 
@@ -254,7 +316,7 @@ public:
 	{
 		vulkan_instance_.setFlags(QVulkanInstance::NoDebugOutputRedirect);
 		vulkan_instance_.create();
-		vulkan_window_= new VulkanWindow(this->windowHandle(), csg_tree_root_, selection_box_);
+		vulkan_window_= new VulkanWindow(this->windowHandle(), csg_tree_model_, selection_box_);
 		vulkan_window_->setVulkanInstance(&vulkan_instance_);
 
 		QVector<VkFormat> color_formats;
@@ -295,6 +357,26 @@ public: // CentralWidgetBase
 		return csg_tree_model_.GetRoot();
 	}
 
+	void SetCSGTreeRoot(CSGTree::CSGTreeNode root) override
+	{
+		csg_tree_model_.Reset(std::move(root));
+	}
+
+	void Undo() override
+	{
+		csg_nodes_tree_widget_.Undo();
+	}
+
+	void Redo() override
+	{
+		csg_nodes_tree_widget_.Redo();
+	}
+
+	std::string GetStatusText() const override
+	{
+		return vulkan_window_->GetGPUProfilerSummary();
+	}
+
 private:
 	QVulkanInstance vulkan_instance_;
 	VulkanWindow* vulkan_window_= nullptr;
@@ -49,9 +49,36 @@ public: // ICentralWidget
 		return csg_tree_model_.GetRoot();
 	}
 
+	void SetCSGTreeRoot(CSGTree::CSGTreeNode root) override
+	{
+		csg_tree_model_.Reset(std::move(root));
+	}
+
+	void Undo() override
+	{
+		csg_nodes_tree_widget_.Undo();
+	}
+
+	void Redo() override
+	{
+		csg_nodes_tree_widget_.Redo();
+	}
+
+	std::string GetStatusText() const override
+	{
+		// Host shows GPU profiler results in title of its own window.
+		return std::string();
+	}
+
 private:
 	void Loop()
 	{
+		// Model modifies tree of host directly, so notify host about changes.
+		if(csg_tree_model_.GetVersion() != last_csg_tree_version_)
+		{
+			last_csg_tree_version_= csg_tree_model_.GetVersion();
+			host_.OnCSGTreeChanged();
+		}
 		host_.Loop();
 	}
 
@@ -59,6 +86,7 @@ private:
 	Host host_;
 	QTimer timer_;
 	CSGTreeModel csg_tree_model_;
+	CSGTreePersistent::NodePtr last_csg_tree_version_;
 	QVBoxLayout layout_;
 	NewNodeListWidget new_node_list_widget_;
 	CSGNodesTreeWidget csg_nodes_tree_widget_;
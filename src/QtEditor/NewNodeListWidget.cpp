@@ -1,4 +1,6 @@
 #include "NewNodeListWidget.hpp"
+#include "../Lib/CSGTreeReference.hpp"
+#include <QtWidgets/QFileDialog>
 
 namespace SZV
 {
@@ -19,6 +21,8 @@ NewNodeListWidget::NewNodeListWidget(QWidget* const parent, NodeAddCallback node
 	, button_parabolic_cylinder_("parabolic cylinder", this)
 	, button_hyperbolic_cylinder_("hyperbolic cylinder", this)
 	, button_hyperbolic_paraboloid_("hyperbolic paraboloid", this)
+	, button_reference_("reference", this)
+	, button_instance_("instance", this)
 {
 	connect(&button_mul_chain_, &QPushButton::clicked, this, &NewNodeListWidget::OnAddMulChain);
 	connect(&button_add_chain_, &QPushButton::clicked, this, &NewNodeListWidget::OnAddAddChain);
@@ -33,6 +37,8 @@ NewNodeListWidget::NewNodeListWidget(QWidget* const parent, NodeAddCallback node
 	connect(&button_parabolic_cylinder_, &QPushButton::clicked, this, &NewNodeListWidget::OnAddParabolicCylinder);
 	connect(&button_hyperbolic_cylinder_, &QPushButton::clicked, this, &NewNodeListWidget::OnAddHyperbolicCylinder);
 	connect(&button_hyperbolic_paraboloid_, &QPushButton::clicked, this, &NewNodeListWidget::OnAddHyperbolicParaboloid);
+	connect(&button_reference_, &QPushButton::clicked, this, &NewNodeListWidget::OnAddReference);
+	connect(&button_instance_, &QPushButton::clicked, this, &NewNodeListWidget::OnAddInstance);
 
 	layout_.addWidget(&button_mul_chain_);
 	layout_.addWidget(&button_add_chain_);
@@ -47,6 +53,8 @@ NewNodeListWidget::NewNodeListWidget(QWidget* const parent, NodeAddCallback node
 	layout_.addWidget(&button_parabolic_cylinder_);
 	layout_.addWidget(&button_hyperbolic_cylinder_);
 	layout_.addWidget(&button_hyperbolic_paraboloid_);
+	layout_.addWidget(&button_reference_);
+	layout_.addWidget(&button_instance_);
 
 	layout_.addStretch(1);
 
@@ -160,4 +168,30 @@ void NewNodeListWidget::OnAddHyperbolicParaboloid()
 	node_add_callback_(hyperbolic_paraboloid);
 }
 
+void NewNodeListWidget::OnAddReference()
+{
+	const QString path= QFileDialog::getOpenFileName(this, "Sazava - reference scene", QString(), "Sazava scene (*.json *.szvb)");
+	if(path.isEmpty())
+		return;
+
+	// Absolute path is used, because it is unknown where current scene will be saved.
+	CSGTree::Reference reference{};
+	reference.source= path.toStdString();
+	reference.target= GetExternalReferenceTarget(reference.source, "");
+	node_add_callback_(std::move(reference));
+}
+
+void NewNodeListWidget::OnAddInstance()
+{
+	CSGTree::Instance instance
+	{
+		{ CSGTree::Ellipsoid{ { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } } },
+		{
+			CSGTree::InstanceTransform{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } },
+			CSGTree::InstanceTransform{ { 1.5f, 0.0f, 0.0f }, { 0.0f, 0.0f, 45.0f } },
+		},
+	};
+	node_add_callback_(std::move(instance));
+}
+
 } // namespace SZV
@@ -28,6 +28,8 @@ private:
 	void OnAddParabolicCylinder();
 	void OnAddHyperbolicCylinder();
 	void OnAddHyperbolicParaboloid();
+	void OnAddReference();
+	void OnAddInstance();
 
 private:
 	const NodeAddCallback node_add_callback_;
@@ -44,6 +46,8 @@ private:
 	QPushButton button_parabolic_cylinder_;
 	QPushButton button_hyperbolic_cylinder_;
 	QPushButton button_hyperbolic_paraboloid_;
+	QPushButton button_reference_;
+	QPushButton button_instance_;
 	QHBoxLayout layout_;
 };
 
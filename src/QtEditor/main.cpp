@@ -1,10 +1,14 @@
+#include "../Lib/CSGTreeReference.hpp"
+#include "../Lib/CSGTreeSerialization.hpp"
+#include "../Lib/Profiler.hpp"
 #include "CentralWidget.hpp"
-#include "Serialization.hpp"
-#include <QtCore/QFile>
+#include <QtCore/QTimer>
+#include <QtWidgets/QAction>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QFileDialog>
 #include <QtWidgets/QMainWindow>
 #include <QtWidgets/QMenuBar>
+#include <QtWidgets/QStatusBar>
 
 namespace SZV
 {
@@ -12,6 +16,8 @@ namespace SZV
 namespace
 {
 
+const char g_file_filter[]= "Sazava scene (*.json *.szvb);;JSON scene (*.json);;Binary scene (*.szvb);;All files (*)";
+
 class MainWindow final : public QMainWindow
 {
 public:
@@ -24,10 +30,20 @@ public:
 		file_menu->addAction("&Open", this, &MainWindow::OnOpen);
 		file_menu->addAction("&Save", this, &MainWindow::OnSave);
 		file_menu->addAction("&Quit", this, &QWidget::close);
+		const auto edit_menu = menu_bar->addMenu("&Edit");
+		edit_menu->addAction("&Undo", this, &MainWindow::OnUndo, QKeySequence::Undo);
+		edit_menu->addAction("&Redo", this, &MainWindow::OnRedo, QKeySequence::Redo);
+		const auto tools_menu = menu_bar->addMenu("&Tools");
+		cpu_trace_action_= tools_menu->addAction("Capture CPU &trace", this, &MainWindow::OnToggleCPUTrace);
+		cpu_trace_action_->setCheckable(true);
 		setMenuBar(menu_bar);
 
 		setCentralWidget(central_widget_);
 
+		// Refresh status not every frame, in order to keep it readable.
+		connect(&status_timer_, &QTimer::timeout, this, &MainWindow::OnUpdateStatus);
+		status_timer_.start(500);
+
 		setMinimumSize(640, 480);
 		resize(1024, 768);
 	}
@@ -35,38 +51,59 @@ public:
 private:
 	void OnOpen()
 	{
-		const QString open_path= QFileDialog::getOpenFileName(this, "Sazava - open");
+		const QString open_path= QFileDialog::getOpenFileName(this, "Sazava - open", QString(), g_file_filter);
 		if(open_path.isEmpty())
 			return;
 
-		QFile f(open_path);
-		if(!f.open(QIODevice::ReadOnly))
-			return;
-
-		const QByteArray file_data= f.readAll();
-		f.close();
+		// Referenced files may be changed since previous loading.
+		ClearExternalReferenceTargetsCache();
 
-		central_widget_->GetCSGTreeRoot()= DeserializeCSGExpressionTree(file_data);
+		// Format is chosen by extension.
+		if(std::optional<CSGTree::CSGTreeNode> root= LoadCSGExpressionTree(open_path.toStdString()))
+			central_widget_->SetCSGTreeRoot(std::move(*root));
 	}
 
 	void OnSave()
 	{
-		const QString save_path= QFileDialog::getSaveFileName(this, "Sazava - save");
+		const QString save_path= QFileDialog::getSaveFileName(this, "Sazava - save", QString(), g_file_filter);
 		if(save_path.isEmpty())
 			return;
 
-		const QByteArray csg_tree_serialized= SerializeCSGExpressionTree(central_widget_->GetCSGTreeRoot());
+		SaveCSGExpressionTree(central_widget_->GetCSGTreeRoot(), save_path.toStdString());
+	}
 
-		QFile f(save_path);
-		if(!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
-			return;
+	void OnUndo()
+	{
+		central_widget_->Undo();
+	}
 
-		f.write(csg_tree_serialized);
-		f.close();
+	void OnRedo()
+	{
+		central_widget_->Redo();
+	}
+
+	void OnUpdateStatus()
+	{
+		statusBar()->showMessage(QString::fromStdString(central_widget_->GetStatusText()));
+	}
+
+	void OnToggleCPUTrace()
+	{
+		if(Profiler::IsEnabled())
+		{
+			Profiler::SetEnabled(false);
+			Profiler::WriteChromeTrace("SazavaEditor_trace.json");
+		}
+		else
+			Profiler::SetEnabled(true);
+
+		cpu_trace_action_->setChecked(Profiler::IsEnabled());
 	}
 
 private:
 	CentralWidgetBase* central_widget_= nullptr;
+	QAction* cpu_trace_action_= nullptr;
+	QTimer status_timer_;
 };
 
 int Main(int argc, char* argv[])
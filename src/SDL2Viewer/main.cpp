@@ -1,14 +1,24 @@
+#include "../Lib/CSGTreeSerialization.hpp"
 #include "../Lib/Log.hpp"
 #include "../SDL2ViewerLib/Host.hpp"
 
 namespace SZV
 {
 
-extern "C" int main()
+extern "C" int main(int argc, char* argv[])
 {
 	try
 	{
-		Host host;
+		// Optional argument - scene file (JSON or binary).
+		std::optional<CSGTree::CSGTreeNode> csg_tree;
+		if(argc >= 2)
+		{
+			csg_tree= LoadCSGExpressionTree(argv[1]);
+			if(csg_tree == std::nullopt)
+				Log::FatalError("Can not load scene \"", argv[1], "\"");
+		}
+
+		Host host= csg_tree == std::nullopt ? Host() : Host(std::move(*csg_tree));
 		while(!host.Loop()){}
 	}
 	catch(const std::exception& ex)
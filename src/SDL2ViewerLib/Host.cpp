@@ -1,5 +1,7 @@
 #include "Host.hpp"
 #include "../Lib/Assert.hpp"
+#include "../Lib/Log.hpp"
+#include "../Lib/Profiler.hpp"
 #include <thread>
 
 
@@ -26,19 +28,38 @@ CSGTree::CSGTreeNode GetTestCSGTree()
 
 
 Host::Host()
+	: Host(GetTestCSGTree())
+{}
+
+Host::Host(CSGTree::CSGTreeNode csg_tree)
 	:  system_window_()
 	, window_vulkan_(system_window_)
+	, gpu_profiler_(window_vulkan_)
 	, csg_renderer_(window_vulkan_)
 	, camera_controller_(CalculateAspect(window_vulkan_.GetViewportSize()))
 	, init_time_(Clock::now())
 	, prev_tick_time_(init_time_)
-	, csg_tree_(GetTestCSGTree())
+	, prev_gpu_profile_title_time_(init_time_)
+	, prev_gpu_profile_log_time_(init_time_)
+	, csg_tree_(std::move(csg_tree))
 {
+	// Viewer scenes are stable, so it is worth to compile shaders for them.
+	csg_renderer_.SetUseSpecializedShaders(true);
+	csg_renderer_.SetGPUProfiler(&gpu_profiler_);
+	csg_renderer_.SetDynamicResolution(true);
+	OnCSGTreeChanged();
 }
 
 bool Host::Loop()
 {
 	const Clock::time_point tick_start_time= Clock::now();
+
+	// Drain profiler buffers from previous frame.
+	if(Profiler::IsEnabled())
+		Profiler::Collect();
+
+	SZV_PROFILE_FUNCTION();
+
 	const auto dt= tick_start_time - prev_tick_time_;
 	prev_tick_time_ = tick_start_time;
 
@@ -47,6 +68,28 @@ bool Host::Loop()
 	{
 		if(std::get_if<SystemEventTypes::QuitEvent>(&system_event) != nullptr)
 			return true;
+		if(const auto key_event= std::get_if<SystemEventTypes::KeyEvent>(&system_event))
+		{
+			if(key_event->pressed && key_event->key_code == SystemEventTypes::KeyCode::P)
+			{
+				show_gpu_profile_= !show_gpu_profile_;
+				if(!show_gpu_profile_)
+					system_window_.SetTitle("Sazava");
+			}
+			if(key_event->pressed && key_event->key_code == SystemEventTypes::KeyCode::T)
+			{
+				if(Profiler::IsEnabled())
+				{
+					Profiler::SetEnabled(false);
+					Profiler::WriteChromeTrace("Sazava_trace.json");
+				}
+				else
+				{
+					Log::Info("CPU profiler capture started, press T again to stop it and write trace");
+					Profiler::SetEnabled(true);
+				}
+			}
+		}
 	}
 
 	{
@@ -55,7 +98,8 @@ bool Host::Loop()
 	}
 
 	const auto command_buffer= window_vulkan_.BeginFrame();
-	csg_renderer_.BeginFrame(command_buffer, camera_controller_, csg_tree_);
+	gpu_profiler_.BeginFrame(command_buffer);
+	csg_renderer_.BeginFrame(command_buffer, camera_controller_);
 
 	window_vulkan_.EndFrame(
 		{
@@ -69,6 +113,20 @@ bool Host::Loop()
 			},
 		});
 
+	if(show_gpu_profile_)
+	{
+		if(tick_start_time - prev_gpu_profile_title_time_ >= std::chrono::milliseconds(500))
+		{
+			prev_gpu_profile_title_time_= tick_start_time;
+			system_window_.SetTitle("Sazava - " + gpu_profiler_.GetLastFrameResultSummary());
+		}
+		if(tick_start_time - prev_gpu_profile_log_time_ >= std::chrono::seconds(10))
+		{
+			prev_gpu_profile_log_time_= tick_start_time;
+			gpu_profiler_.LogLastFrameResult();
+		}
+	}
+
 	const Clock::time_point tick_end_time= Clock::now();
 	const auto frame_dt= tick_end_time - tick_start_time;
 
@@ -77,6 +135,7 @@ bool Host::Loop()
 	const std::chrono::milliseconds min_frame_duration(uint32_t(1000.0f / max_fps));
 	if(frame_dt <= min_frame_duration)
 	{
+		SZV_PROFILE_ZONE("frame rate limit sleep");
 		std::this_thread::sleep_for(min_frame_duration - frame_dt);
 	}
 
@@ -88,4 +147,9 @@ CSGTree::CSGTreeNode& Host::GetCSGTree()
 	return csg_tree_;
 }
 
+void Host::OnCSGTreeChanged()
+{
+	csg_renderer_.SetScene(std::make_shared<const CSGSceneData>(BuildCSGSceneData(csg_tree_)));
+}
+
 } // namespace SZV
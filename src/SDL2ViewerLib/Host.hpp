@@ -1,6 +1,7 @@
 #pragma once
 #include "../Lib/CameraController.hpp"
 #include "../Lib/CSGRenderer.hpp"
+#include "../Lib/GPUProfiler.hpp"
 #include "SystemWindow.hpp"
 #include "WindowVulkan.hpp"
 #include <chrono>
@@ -12,24 +13,33 @@ namespace SZV
 class Host final
 {
 public:
-	Host();
+	Host(); // Use test scene.
+	explicit Host(CSGTree::CSGTreeNode csg_tree);
 
 	// Returns false on quit
 	bool Loop();
 
 	CSGTree::CSGTreeNode& GetCSGTree();
+	// Rebuild scene for renderer. Call it after each modification of tree, returned by "GetCSGTree".
+	void OnCSGTreeChanged();
 
 private:
 	using Clock= std::chrono::steady_clock;
 
 	SystemWindow system_window_;
 	WindowVulkan window_vulkan_;
+	GPUProfiler gpu_profiler_;
 	CSGRenderer csg_renderer_;
 	CameraController camera_controller_;
 
 	const Clock::time_point init_time_;
 	Clock::time_point prev_tick_time_;
 
+	// GPU profiler results are shown in window title and periodically printed into log. Toggled by "P" key.
+	bool show_gpu_profile_= true;
+	Clock::time_point prev_gpu_profile_title_time_;
+	Clock::time_point prev_gpu_profile_log_time_;
+
 	CSGTree::CSGTreeNode csg_tree_;
 
 	bool quit_requested_= false;
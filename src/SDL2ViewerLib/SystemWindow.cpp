@@ -1,6 +1,7 @@
 #include "SystemWindow.hpp"
 #include "../Lib/Assert.hpp"
 #include "../Lib/Log.hpp"
+#include "../Lib/Profiler.hpp"
 #include <SDL.h>
 #include <algorithm>
 #include <cstring>
@@ -128,6 +129,8 @@ SystemWindow::~SystemWindow()
 
 SystemEvents SystemWindow::ProcessEvents()
 {
+	SZV_PROFILE_FUNCTION();
+
 	SystemEvents result_events;
 
 	SDL_Event event;
@@ -224,4 +227,9 @@ SDL_Window* SystemWindow::GetSDLWindow() const
 	return window_;
 }
 
+void SystemWindow::SetTitle(const std::string& title)
+{
+	SDL_SetWindowTitle(window_, title.c_str());
+}
+
 } // namespace SZV
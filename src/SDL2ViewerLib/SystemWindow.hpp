@@ -1,6 +1,7 @@
 #pragma once
 #include "../Lib/SystemEvent.hpp"
 #include <SDL_video.h>
+#include <string>
 
 
 namespace SZV
@@ -18,6 +19,8 @@ public:
 
 	SDL_Window* GetSDLWindow() const;
 
+	void SetTitle(const std::string& title);
+
 private:
 	SDL_Window* window_= nullptr;
 };
@@ -1,6 +1,7 @@
 #include "WindowVulkan.hpp"
 #include "../Lib/Assert.hpp"
 #include "../Lib/Log.hpp"
+#include "../Lib/Profiler.hpp"
 #include "SystemWindow.hpp"
 #include <SDL_vulkan.h>
 #include <algorithm>
@@ -12,12 +13,15 @@ namespace SZV
 namespace
 {
 
-vk::PhysicalDeviceFeatures GetRequiredDeviceFeatures()
+vk::PhysicalDeviceFeatures GetRequiredDeviceFeatures(const vk::PhysicalDevice physical_device)
 {
 	// http://vulkan.gpuinfo.org/listfeatures.php
 
+	const vk::PhysicalDeviceFeatures supported_features= physical_device.getFeatures();
+
+	// Exposure is now calculated in compute shader, vertex shader stores are not needed anymore.
 	vk::PhysicalDeviceFeatures features;
-	features.setVertexPipelineStoresAndAtomics(VK_TRUE); // For tonemapping, 99.7%
+	features.setPipelineStatisticsQuery(supported_features.pipelineStatisticsQuery); // Optional, for GPU profiling.
 	return features;
 }
 
@@ -202,7 +206,8 @@ WindowVulkan::WindowVulkan(const SystemWindow& system_window)
 
 	const char* const device_extension_names[]{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
-	const vk::PhysicalDeviceFeatures physical_device_features= GetRequiredDeviceFeatures();
+	const vk::PhysicalDeviceFeatures physical_device_features= GetRequiredDeviceFeatures(physical_device);
+	enabled_features_= physical_device_features;
 
 	const vk::DeviceCreateInfo vk_device_create_info(
 		vk::DeviceCreateFlags(),
@@ -220,6 +225,8 @@ WindowVulkan::WindowVulkan(const SystemWindow& system_window)
 	vk_device_.reset(vk_device_tmp);
 	Log::Info("Vulkan logical device created");
 
+	pipeline_cache_= std::make_unique<PipelineCache>(*vk_device_, physical_device, "Sazava_pipeline_cache.bin");
+
 	vk_queue_= vk_device_->getQueue(queue_family_index, 0u);
 
 	// Select surface format. Prefer usage of normalized rbga32.
@@ -366,13 +373,17 @@ WindowVulkan::~WindowVulkan()
 
 vk::CommandBuffer WindowVulkan::BeginFrame()
 {
-	current_frame_command_buffer_= &command_buffers_[frame_count_ % command_buffers_.size()];
+	current_frame_index_= uint32_t(frame_count_ % command_buffers_.size());
+	current_frame_command_buffer_= &command_buffers_[current_frame_index_];
 	++frame_count_;
 
-	vk_device_->waitForFences(
-		1u, &*current_frame_command_buffer_->submit_fence,
-		VK_TRUE,
-		std::numeric_limits<uint64_t>::max());
+	{
+		SZV_PROFILE_ZONE("wait for frame fence");
+		vk_device_->waitForFences(
+			1u, &*current_frame_command_buffer_->submit_fence,
+			VK_TRUE,
+			std::numeric_limits<uint64_t>::max());
+	}
 
 	vk_device_->resetFences(1u, &*current_frame_command_buffer_->submit_fence);
 
@@ -386,12 +397,16 @@ void WindowVulkan::EndFrame(const DrawFunctions& draw_functions)
 	const vk::CommandBuffer command_buffer= *current_frame_command_buffer_->command_buffer;
 
 	// Get next swapchain image.
-	const uint32_t swapchain_image_index=
-		vk_device_->acquireNextImageKHR(
-			*vk_swapchain_,
-			std::numeric_limits<uint64_t>::max(),
-			*current_frame_command_buffer_->image_available_semaphore,
-			vk::Fence()).value;
+	uint32_t swapchain_image_index= 0u;
+	{
+		SZV_PROFILE_ZONE("acquire swapchain image");
+		swapchain_image_index=
+			vk_device_->acquireNextImageKHR(
+				*vk_swapchain_,
+				std::numeric_limits<uint64_t>::max(),
+				*current_frame_command_buffer_->image_available_semaphore,
+				vk::Fence()).value;
+	}
 
 	// Begin render pass.
 	command_buffer.beginRenderPass(
@@ -403,9 +418,12 @@ void WindowVulkan::EndFrame(const DrawFunctions& draw_functions)
 		vk::SubpassContents::eInline);
 
 	// Draw into framebuffer.
-	for(const DrawFunction& draw_function : draw_functions)
 	{
-		draw_function(command_buffer);
+		SZV_PROFILE_ZONE("draw functions");
+		for(const DrawFunction& draw_function : draw_functions)
+		{
+			draw_function(command_buffer);
+		}
 	}
 
 	// End render pass.
@@ -424,6 +442,7 @@ void WindowVulkan::EndFrame(const DrawFunctions& draw_functions)
 	vk_queue_.submit(vk_submit_info, *current_frame_command_buffer_->submit_fence);
 
 	// Present queue.
+	SZV_PROFILE_ZONE("present");
 	vk_queue_.presentKHR(
 		vk::PresentInfoKHR(
 			1u, &*current_frame_command_buffer_->rendering_finished_semaphore,
@@ -467,4 +486,24 @@ vk::PhysicalDevice WindowVulkan::GetPhysicalDevice() const
 	return physical_device_;
 }
 
+vk::PipelineCache WindowVulkan::GetPipelineCache() const
+{
+	return pipeline_cache_->Get();
+}
+
+vk::PhysicalDeviceFeatures WindowVulkan::GetEnabledDeviceFeatures() const
+{
+	return enabled_features_;
+}
+
+uint32_t WindowVulkan::GetFramesInFlightCount() const
+{
+	return uint32_t(command_buffers_.size());
+}
+
+uint32_t WindowVulkan::GetCurrentFrameIndex() const
+{
+	return current_frame_index_;
+}
+
 } // namespace SZV
@@ -1,6 +1,7 @@
 #pragma once
 #include "SystemWindow.hpp"
 #include "../Lib/I_WindowVulkan.hpp"
+#include "../Lib/PipelineCache.hpp"
 
 namespace SZV
 {
@@ -25,6 +26,10 @@ public:
 	bool HasDepthBuffer() const override;
 	vk::PhysicalDeviceMemoryProperties GetMemoryProperties() const override;
 	vk::PhysicalDevice GetPhysicalDevice() const;
+	vk::PipelineCache GetPipelineCache() const override;
+	vk::PhysicalDeviceFeatures GetEnabledDeviceFeatures() const override;
+	uint32_t GetFramesInFlightCount() const override;
+	uint32_t GetCurrentFrameIndex() const override;
 
 private:
 	struct CommandBufferData
@@ -48,11 +53,13 @@ private:
 	VkDebugReportCallbackEXT vk_debug_report_callback_= VK_NULL_HANDLE;
 	vk::UniqueSurfaceKHR vk_surface_;
 	vk::UniqueDevice vk_device_;
+	std::unique_ptr<PipelineCache> pipeline_cache_;
 	vk::Queue vk_queue_= nullptr;
 	uint32_t vk_queue_family_index_= ~0u;
 	vk::Extent2D viewport_size_;
 	vk::PhysicalDeviceMemoryProperties memory_properties_;
 	vk::PhysicalDevice physical_device_;
+	vk::PhysicalDeviceFeatures enabled_features_;
 	vk::UniqueSwapchainKHR vk_swapchain_;
 
 	vk::UniqueRenderPass vk_render_pass_;
@@ -62,6 +69,7 @@ private:
 
 	std::vector<CommandBufferData> command_buffers_;
 	const CommandBufferData* current_frame_command_buffer_= nullptr;
+	uint32_t current_frame_index_= 0u;
 	size_t frame_count_= 0u;
 };
 